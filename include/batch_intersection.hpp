@@ -0,0 +1,203 @@
+#pragma once
+
+#include "intersection.hpp"
+
+/* interleaved execution of a batch of k-way DAAT intersections (AMAC).
+   one intersection spends most of its time waiting for the cache misses
+   of skip(), as every skip() depends on the result of the previous one.
+   the batch keeps group_size intersections in flight and advances them
+   round robin by a single step. after its skip() an intersection
+   prefetches what its next skip() reads, so the miss is served while the
+   other intersections of the group are advanced. iterators which find
+   the location of their data through a dependent load prefetch in
+   stages, one stage per step. a finished intersection is replaced by the
+   next one of the batch.
+
+   each intersection computes exactly the result of daat_intersect (or
+   daat_pos_intersect) with the same lists and limit. */
+const size_t default_batch_group_size = 8;
+
+/* itr.prefetch(pos,stage) if the iterator supports it. returns true if
+   the iterator has a further prefetch stage */
+template<class t_itr>
+auto prefetch_skip(const t_itr& itr,uint64_t pos,size_t stage,int) -> decltype(itr.prefetch(pos,stage))
+{
+    return itr.prefetch(pos,stage);
+}
+
+template<class t_itr>
+bool prefetch_skip(const t_itr&,uint64_t,size_t,long)
+{
+    return false;
+}
+
+template<class t_list>
+class batch_intersection
+{
+    public:
+        using list_itr = decltype(std::declval<const t_list&>().begin());
+        using size_type = sdsl::int_vector<>::size_type;
+    private:
+        // the loop state of intersection_view_itr::find() between two skip() calls
+        struct query_state {
+            std::vector<list_itr> itrs;
+            std::vector<list_itr> ends;
+            std::vector<uint64_t> deltas;
+            uint64_t candidate = 0;
+            size_t cur = 0;     // list skipped next
+            size_t matched = 0; // lists known to contain candidate
+            size_t stage = 0;   // prefetch stage of the next skip()
+            bool prefetching = false;
+            size_t limit = no_result_limit;
+            size_t n = 0;       // results found
+        };
+        std::vector<query_state> m_states;
+        std::vector<intersection_result> m_results;
+    public:
+        size_t size() const
+        {
+            return m_states.size();
+        }
+        // add the intersection of the lists. returns the number of the query
+        size_t add(std::vector<t_list> lists,size_t limit = no_result_limit)
+        {
+            std::sort(lists.begin(),lists.end());
+            return add(lists,std::vector<uint64_t>(lists.size(),0),0,limit);
+        }
+        // add the positional intersection of the lists, see daat_pos_intersect
+        size_t add_pos(std::vector<t_list> lists,size_t limit = no_result_limit)
+        {
+            std::sort(lists.begin(),lists.end());
+            int64_t min_offset = lists.empty() ? 0 : lists[0].offset();
+            for (const auto& list : lists) min_offset = std::min(min_offset,list.offset());
+            std::vector<uint64_t> deltas;
+            for (const auto& list : lists) deltas.push_back(list.offset() - min_offset);
+            return add(lists,deltas,min_offset,limit);
+        }
+        // x is a result if list i contains x+deltas[i]. the lists have to be sorted by size
+        size_t add(const std::vector<t_list>& lists,const std::vector<uint64_t>& deltas,int64_t offset,size_t limit)
+        {
+            query_state q;
+            for (const auto& list : lists) {
+                q.itrs.push_back(list.begin());
+                q.ends.push_back(list.end());
+            }
+            q.deltas = deltas;
+            q.limit = limit;
+            size_type size = lists.empty() ? 0 : lists[0].size();
+            m_states.push_back(std::move(q));
+            m_results.emplace_back(std::min(size,limit));
+            m_results.back().offset = offset;
+            return m_states.size()-1;
+        }
+        /* runs all intersections, group_size at a time. the results are
+           returned in the order the queries were added */
+        std::vector<intersection_result> run(size_t group_size = default_batch_group_size)
+        {
+            group_size = std::max<size_t>(group_size,1);
+            std::vector<size_t> group;
+            size_t next = 0;
+            auto admit = [&]() {
+                while (next < m_states.size()) {
+                    size_t q = next++;
+                    if (start(q)) return q;
+                    m_results[q].resize(0);
+                }
+                return m_states.size();
+            };
+            while (group.size() < group_size) {
+                size_t q = admit();
+                if (q == m_states.size()) break;
+                group.push_back(q);
+            }
+            while (!group.empty()) {
+                for (size_t s=0; s<group.size();) {
+                    size_t q = group[s];
+                    if (step(m_states[q],m_results[q])) {
+                        s++;
+                        continue;
+                    }
+                    m_results[q].resize(m_states[q].n);
+                    m_states[q] = query_state();
+                    size_t r = admit();
+                    if (r != m_states.size()) {
+                        group[s++] = r;
+                    } else {
+                        group[s] = group.back();
+                        group.pop_back();
+                    }
+                }
+            }
+            m_states.clear();
+            std::vector<intersection_result> results;
+            results.swap(m_results);
+            return results;
+        }
+    private:
+        // prefetch for the first skip(). false if the intersection is empty
+        bool start(size_t q)
+        {
+            auto& state = m_states[q];
+            if (state.itrs.empty() || state.limit == 0) return false;
+            for (size_t i=0; i<state.itrs.size(); i++) {
+                if (state.itrs[i] == state.ends[i]) return false;
+            }
+            state.prefetching = prefetch_skip(state.itrs[0],state.deltas[0],0,0);
+            return true;
+        }
+        /* the next prefetch stage or one iteration of the loop of find().
+           false once the intersection is finished */
+        bool step(query_state& q,intersection_result& res)
+        {
+            if (q.prefetching) {
+                q.prefetching = prefetch_skip(q.itrs[q.cur],q.candidate+q.deltas[q.cur],++q.stage,0);
+                return true;
+            }
+            size_t k = q.itrs.size();
+            auto& itr = q.itrs[q.cur];
+            uint64_t target = q.candidate + q.deltas[q.cur];
+            itr.skip(target);
+            if (itr == q.ends[q.cur]) return false;
+            uint64_t value = *itr;
+            if (value != target) {
+                // list cur can not contain candidate. value is the new candidate
+                q.candidate = value - q.deltas[q.cur];
+                q.matched = 1;
+            } else {
+                q.matched++;
+            }
+            if (q.matched == k) {
+                res[q.n++] = q.candidate;
+                if (q.n == q.limit) return false;
+                // the next result is searched from the shortest list again
+                q.candidate++;
+                q.matched = 0;
+                q.cur = 0;
+            } else {
+                q.cur = (q.cur+1 == k) ? 0 : q.cur+1;
+            }
+            q.stage = 0;
+            q.prefetching = prefetch_skip(q.itrs[q.cur],q.candidate+q.deltas[q.cur],0,0);
+            return true;
+        }
+};
+
+// the intersections of the lists of each query, see daat_intersect
+template<class t_list>
+std::vector<intersection_result>
+batch_intersect(const std::vector<std::vector<t_list>>& queries,size_t group_size = default_batch_group_size,size_t limit = no_result_limit)
+{
+    batch_intersection<t_list> batch;
+    for (const auto& lists : queries) batch.add(lists,limit);
+    return batch.run(group_size);
+}
+
+// the positional intersections of the lists of each query, see daat_pos_intersect
+template<class t_list>
+std::vector<intersection_result>
+batch_pos_intersect(const std::vector<std::vector<t_list>>& queries,size_t group_size = default_batch_group_size,size_t limit = no_result_limit)
+{
+    batch_intersection<t_list> batch;
+    for (const auto& lists : queries) batch.add_pos(lists,limit);
+    return batch.run(group_size);
+}
@@ -3,9 +3,47 @@
 #include "sdsl/bits.hpp"
 #include "sdsl/int_vector.hpp"
 
+#if defined(__x86_64__)
+#include <immintrin.h>
+#define BIT_MAGIC_X86 1
+#endif
+
+/* next_Xth_one and next_Xth_zero return the position of the x-th one
+   (zero) after position idx. they are the inner loop of the Elias-Fano
+   iterators. on x86 the kernel is picked at runtime from the CPU features
+   like the intersection kernels:
+
+     bmi2   : hardware popcount per word and select in a word with PDEP
+     avx2   : as bmi2, long skips count 8 words (a cache line) at a time
+              with the nibble lookup popcount of Mula, Kurz and Lemire
+     avx512 : as avx2 with VPOPCNTQ
+
+   a cache line is only counted if x is larger than the number of bits of
+   the line, so no word after the word of the result is read. the generic
+   kernels use sdsl::bits and run on every CPU. */
 namespace bit_magic
 {
 
+enum class select_level {generic,bmi2,avx2,avx512};
+
+inline select_level detect_select_level()
+{
+#ifdef BIT_MAGIC_X86
+    __builtin_cpu_init();
+    if (!__builtin_cpu_supports("popcnt") || !__builtin_cpu_supports("bmi2")) return select_level::generic;
+    if (__builtin_cpu_supports("avx512f") && __builtin_cpu_supports("avx512vpopcntdq")) return select_level::avx512;
+    if (__builtin_cpu_supports("avx2")) return select_level::avx2;
+    return select_level::bmi2;
+#endif
+    return select_level::generic;
+}
+
+inline select_level select_cpu()
+{
+    static const select_level level = detect_select_level();
+    return level;
+}
+
 void print_word(const uint64_t w,const char* prefix)
 {
     sdsl::bit_vector bv(64);
@@ -29,9 +67,8 @@ inline uint64_t next0(const uint64_t* word,uint64_t idx)
     return idx + sdsl::bits::lo(~(*word));
 }
 
-inline uint64_t next_Xth_zero(const uint64_t* word,uint64_t idx,uint64_t x)
+inline uint64_t next_Xth_zero_generic(const uint64_t* word,uint64_t idx,uint64_t x)
 {
-    if (x==1) return next0(word,idx);
     word += (idx>>6);
     auto masked_inverse_word = ~(*word | sdsl::bits::lo_set[(idx&0x3F)+1]);
     auto zero_cnt = sdsl::bits::cnt(masked_inverse_word);
@@ -51,7 +88,7 @@ inline uint64_t next_Xth_zero(const uint64_t* word,uint64_t idx,uint64_t x)
     return idx + sdsl::bits::sel(~*word,x);
 }
 
-inline uint64_t next_Xth_one(const uint64_t* word,uint64_t idx,uint64_t x)
+inline uint64_t next_Xth_one_generic(const uint64_t* word,uint64_t idx,uint64_t x)
 {
     word += (idx>>6);
     auto masked_word = *word & ~sdsl::bits::lo_set[(idx&0x3F)+1];
@@ -69,8 +106,144 @@ inline uint64_t next_Xth_one(const uint64_t* word,uint64_t idx,uint64_t x)
         x -= one_cnt;
         one_cnt = sdsl::bits::cnt(*word);
     }
-    return idx + sdsl::bits::sel(*word,x);;
+    return idx + sdsl::bits::sel(*word,x);
+}
+
+#ifdef BIT_MAGIC_X86
+
+template<bool t_one>
+inline uint64_t bits_of(uint64_t w)
+{
+    return t_one ? w : ~w;
+}
+
+// position of the x-th one of w, x >= 1
+__attribute__((target("popcnt,bmi,bmi2")))
+inline uint64_t select64_bmi2(uint64_t w,uint64_t x)
+{
+    return _tzcnt_u64(_pdep_u64(1ULL << (x-1),w));
+}
+
+/* the x-th one (zero) after idx if it is in the word of idx. otherwise
+   word, idx and x are moved to the start of the next word */
+template<bool t_one>
+__attribute__((target("popcnt,bmi,bmi2")))
+inline bool select_first_word_bmi2(const uint64_t*& word,uint64_t& idx,uint64_t& x)
+{
+    word += (idx>>6);
+    auto masked_word = bits_of<t_one>(*word) & ~sdsl::bits::lo_set[(idx&0x3F)+1];
+    uint64_t cnt = _mm_popcnt_u64(masked_word);
+    idx &= ~((uint64_t)0x3F);
+    if (cnt >= x) {
+        idx += select64_bmi2(masked_word,x);
+        return true;
+    }
+    idx += 64;
+    x -= cnt;
+    ++word;
+    return false;
 }
 
+// the x-th one (zero) starting at word whose first bit is at idx
+template<bool t_one>
+__attribute__((target("popcnt,bmi,bmi2")))
+inline uint64_t select_words_bmi2(const uint64_t* word,uint64_t idx,uint64_t x)
+{
+    uint64_t cnt = _mm_popcnt_u64(bits_of<t_one>(*word));
+    while (x > cnt) {
+        ++word;
+        idx += 64;
+        x -= cnt;
+        cnt = _mm_popcnt_u64(bits_of<t_one>(*word));
+    }
+    return idx + select64_bmi2(bits_of<t_one>(*word),x);
 }
 
+template<bool t_one>
+__attribute__((target("popcnt,bmi,bmi2")))
+inline uint64_t next_Xth_bmi2(const uint64_t* word,uint64_t idx,uint64_t x)
+{
+    if (select_first_word_bmi2<t_one>(word,idx,x)) return idx;
+    return select_words_bmi2<t_one>(word,idx,x);
+}
+
+// number of ones in the 8 words at word
+__attribute__((target("avx2,popcnt,bmi,bmi2")))
+inline uint64_t popcount_line_avx2(const uint64_t* word)
+{
+    const __m256i lookup = _mm256_setr_epi8(0,1,1,2,1,2,2,3,1,2,2,3,2,3,3,4,
+                                            0,1,1,2,1,2,2,3,1,2,2,3,2,3,3,4);
+    const __m256i low_mask = _mm256_set1_epi8(0x0F);
+    __m256i a = _mm256_loadu_si256((const __m256i*)word);
+    __m256i b = _mm256_loadu_si256((const __m256i*)(word+4));
+    __m256i cnt_a = _mm256_add_epi8(_mm256_shuffle_epi8(lookup,_mm256_and_si256(a,low_mask)),
+                                    _mm256_shuffle_epi8(lookup,_mm256_and_si256(_mm256_srli_epi16(a,4),low_mask)));
+    __m256i cnt_b = _mm256_add_epi8(_mm256_shuffle_epi8(lookup,_mm256_and_si256(b,low_mask)),
+                                    _mm256_shuffle_epi8(lookup,_mm256_and_si256(_mm256_srli_epi16(b,4),low_mask)));
+    __m256i sums = _mm256_sad_epu8(_mm256_add_epi8(cnt_a,cnt_b),_mm256_setzero_si256());
+    __m128i sum = _mm_add_epi64(_mm256_castsi256_si128(sums),_mm256_extracti128_si256(sums,1));
+    return _mm_cvtsi128_si64(sum) + _mm_extract_epi64(sum,1);
+}
+
+template<bool t_one>
+__attribute__((target("avx2,popcnt,bmi,bmi2")))
+inline uint64_t next_Xth_avx2(const uint64_t* word,uint64_t idx,uint64_t x)
+{
+    if (select_first_word_bmi2<t_one>(word,idx,x)) return idx;
+    while (x > 512) {
+        uint64_t cnt = popcount_line_avx2(word);
+        x -= t_one ? cnt : 512-cnt;
+        word += 8;
+        idx += 512;
+    }
+    return select_words_bmi2<t_one>(word,idx,x);
+}
+
+template<bool t_one>
+__attribute__((target("avx512f,avx512vpopcntdq,popcnt,bmi,bmi2")))
+inline uint64_t next_Xth_avx512(const uint64_t* word,uint64_t idx,uint64_t x)
+{
+    if (select_first_word_bmi2<t_one>(word,idx,x)) return idx;
+    while (x > 512) {
+        uint64_t cnts[8];
+        _mm512_storeu_si512(cnts,_mm512_popcnt_epi64(_mm512_loadu_si512(word)));
+        uint64_t cnt = cnts[0]+cnts[1]+cnts[2]+cnts[3]+cnts[4]+cnts[5]+cnts[6]+cnts[7];
+        x -= t_one ? cnt : 512-cnt;
+        word += 8;
+        idx += 512;
+    }
+    return select_words_bmi2<t_one>(word,idx,x);
+}
+
+#endif
+
+template<bool t_one>
+inline uint64_t next_Xth(const uint64_t* word,uint64_t idx,uint64_t x)
+{
+#ifdef BIT_MAGIC_X86
+    switch (select_cpu()) {
+        case select_level::avx512:
+            return next_Xth_avx512<t_one>(word,idx,x);
+        case select_level::avx2:
+            return next_Xth_avx2<t_one>(word,idx,x);
+        case select_level::bmi2:
+            return next_Xth_bmi2<t_one>(word,idx,x);
+        default:
+            break;
+    }
+#endif
+    return t_one ? next_Xth_one_generic(word,idx,x) : next_Xth_zero_generic(word,idx,x);
+}
+
+inline uint64_t next_Xth_zero(const uint64_t* word,uint64_t idx,uint64_t x)
+{
+    if (x==1) return next0(word,idx);
+    return next_Xth<false>(word,idx,x);
+}
+
+inline uint64_t next_Xth_one(const uint64_t* word,uint64_t idx,uint64_t x)
+{
+    return next_Xth<true>(word,idx,x);
+}
+
+}
@@ -182,13 +182,28 @@ struct bit_istream {
         using value_type = sdsl::bit_vector::value_type;
         // constructor
         explicit bit_istream(const sdsl::bit_vector& bv,size_t start_offset=0) :
-            m_bv(bv),
+            m_bv(&bv),
             data_ptr(bv.data()+(start_offset>>6)),
             in_word_offset(start_offset%64) {}
+        // read size bits starting at data, e.g. from a memory mapped file
+        bit_istream(const uint64_t* data,size_type size,size_t start_offset=0) :
+            m_data(data),
+            m_size(size),
+            data_ptr(data+(start_offset>>6)),
+            in_word_offset(start_offset%64) {}
         explicit bit_istream(const bit_istream& is)
-            : m_bv(is.m_bv),data_ptr(is.data_ptr),in_word_offset(is.in_word_offset)
+            : m_bv(is.m_bv),m_data(is.m_data),m_size(is.m_size),data_ptr(is.data_ptr),in_word_offset(is.in_word_offset)
         {
 
+        }
+        bit_istream& operator=(const bit_istream& is)
+        {
+            m_bv = is.m_bv;
+            m_data = is.m_data;
+            m_size = is.m_size;
+            data_ptr = is.data_ptr;
+            in_word_offset = is.in_word_offset;
+            return *this;
         }
         // get a bit
         value_type get() const
@@ -276,25 +291,31 @@ struct bit_istream {
         }
         pos_type tellg() const
         {
-            std::ptrdiff_t cur_word_offset = data_ptr-m_bv.data();
+            std::ptrdiff_t cur_word_offset = data_ptr-data();
             return (cur_word_offset<<6)+in_word_offset;
         }
         void seek(size_type offset) const
         {
-            data_ptr = m_bv.data()+(offset>>6);
+            data_ptr = data()+(offset>>6);
             in_word_offset = offset&0x3F;
         }
         bool eof() const
         {
-            return tellg() == m_bv.size();
+            return tellg() == size();
         }
         explicit operator bool() const
         {
             return !eof();
         }
+        // the bit vector is read at each access as it may be loaded after
+        // the stream was created
         const uint64_t* data() const
         {
-            return m_bv.data();
+            return m_bv ? m_bv->data() : m_data;
+        }
+        size_type size() const
+        {
+            return m_bv ? m_bv->size() : m_size;
         }
         const uint64_t* cur_data() const
         {
@@ -306,7 +327,9 @@ struct bit_istream {
         }
 
     private:
-        const sdsl::bit_vector& m_bv;
+        const sdsl::bit_vector* m_bv = nullptr;
+        const uint64_t* m_data = nullptr;
+        size_type m_size = 0;
         mutable const uint64_t* data_ptr = nullptr;
         mutable uint8_t in_word_offset = 0;
 };
@@ -123,21 +123,34 @@ class bv_iterator : public std::iterator<std::random_access_iterator_tag,uint64_
                 m_cur_offset = m_size;
                 return false;
             }
+            auto prev_bit_offset = m_bit_offset;
             m_bit_offset = m_bit_start_offset + pos;
             const auto data_ptr = m_data + (m_bit_offset>>6);
             const auto in_word_offset = m_bit_offset&0x3F;
+            bool found = true;
             if (sdsl::bits::read_int(data_ptr,in_word_offset,1) == 0) {
                 m_bit_offset = sdsl::bits::next(m_data,m_bit_offset); // select next one
-                if (m_bit_offset - m_bit_start_offset > m_universe) {
-                    m_cur_offset = m_size;
-                }
-                return false;
+                found = false;
             }
             if (m_bit_offset - m_bit_start_offset > m_universe) {
                 m_cur_offset = m_size;
                 return false;
             }
-            return true;
+            m_cur_offset += ones(prev_bit_offset,m_bit_offset);
+            return found;
+        }
+    private:
+        // number of one bits in [from,to)
+        size_type ones(size_type from,size_type to) const
+        {
+            size_type cnt = 0;
+            while (from < to) {
+                uint8_t in_word_offset = from&0x3F;
+                uint8_t len = std::min((size_type)(64-in_word_offset),to-from);
+                cnt += sdsl::bits::cnt(sdsl::bits::read_int(m_data+(from>>6),in_word_offset,len));
+                from += len;
+            }
+            return cnt;
         }
 };
 
@@ -158,8 +171,8 @@ struct bitvector_list {
 
         if (!t_compact) {
             // write size
-            os.encode<coder::elias_gamma>(m);
-            os.encode<coder::elias_gamma>(u);
+            os.encode_check_size<coder::elias_gamma>(m);
+            os.encode_check_size<coder::elias_gamma>(u);
         }
 
         // write the bits
@@ -0,0 +1,60 @@
+#pragma once
+
+#include <cstdint>
+#include <cstddef>
+#include <limits>
+#include <algorithm>
+
+#ifdef __SSE2__
+#include <emmintrin.h>
+#endif
+
+/* searches used by skip() of the block based lists. the block maxima are
+   searched by galloping from the current block followed by a binary
+   search, so a skip over d blocks costs O(log d) instead of O(d). inside
+   a decoded block the lower bound is computed by counting the values
+   smaller than the key, 16 values per step with SSE2 comparisons. the
+   counting does not branch on the values, the loop only stops at the
+   first group which contains the lower bound. */
+
+// the first block in [b,n) whose maximum is >= pos, galloping from b. n if there is none
+inline size_t
+block_max_search(const uint32_t* block_max,size_t b,size_t n,uint64_t pos)
+{
+    size_t lo = b;
+    size_t hi = b;
+    size_t step = 1;
+    while (hi < n && block_max[hi] < pos) {
+        lo = hi + 1;
+        hi += step;
+        step *= 2;
+    }
+    hi = std::min(hi,n);
+    return std::lower_bound(block_max+lo,block_max+hi,pos) - block_max;
+}
+
+// the first i in [b,n) with data[i] >= pos in the sorted data. n if there is none
+inline size_t
+block_lower_bound(const uint32_t* data,size_t b,size_t n,uint64_t pos)
+{
+    if (pos > std::numeric_limits<uint32_t>::max()) return n;
+    size_t i = b;
+#ifdef __SSE2__
+    // unsigned compare with the signed SSE2 compare by flipping the sign bits
+    const __m128i sign = _mm_set1_epi32(0x80000000);
+    const __m128i key = _mm_xor_si128(_mm_set1_epi32((uint32_t)pos),sign);
+    for (; i+16<=n; i+=16) {
+        __m128i x0 = _mm_xor_si128(_mm_loadu_si128((const __m128i*)(data+i)),sign);
+        __m128i x1 = _mm_xor_si128(_mm_loadu_si128((const __m128i*)(data+i+4)),sign);
+        __m128i x2 = _mm_xor_si128(_mm_loadu_si128((const __m128i*)(data+i+8)),sign);
+        __m128i x3 = _mm_xor_si128(_mm_loadu_si128((const __m128i*)(data+i+12)),sign);
+        __m128i l01 = _mm_packs_epi32(_mm_cmpgt_epi32(key,x0),_mm_cmpgt_epi32(key,x1));
+        __m128i l23 = _mm_packs_epi32(_mm_cmpgt_epi32(key,x2),_mm_cmpgt_epi32(key,x3));
+        uint32_t less = _mm_movemask_epi8(_mm_packs_epi16(l01,l23));
+        if (less != 0xFFFF) return i + __builtin_popcount(less);
+    }
+#endif
+    size_t less = 0;
+    for (size_t j=i; j<n; j++) less += (data[j] < pos);
+    return i + less;
+}
@@ -0,0 +1,166 @@
+#pragma once
+
+#include <string>
+#include <vector>
+#include <set>
+#include <deque>
+#include <thread>
+#include <mutex>
+#include <condition_variable>
+#include <functional>
+#include <exception>
+#include <chrono>
+#include <stdexcept>
+
+#include "utils.hpp"
+
+/* a step of a build pipeline produces the artifacts in outputs from the
+   artifacts in inputs. memory is the estimated peak memory of the step
+   in bytes. */
+struct build_step {
+    std::string name;
+    std::vector<std::string> inputs;
+    std::vector<std::string> outputs;
+    uint64_t memory;
+    std::function<void()> build;
+};
+
+struct build_step_report {
+    std::string name;
+    bool skipped;      // all outputs were already available
+    double start;      // seconds since the start of the pipeline
+    double time;       // seconds
+    uint64_t memory;   // estimated peak memory of the step in bytes
+    uint64_t peak_rss; // peak memory of the process when the step finished
+};
+
+/* runs the steps of a dependency graph of artifacts. a step is started as
+   soon as all of its inputs are available and the estimated memory of the
+   running steps plus its own estimate fits into the memory budget. a step
+   which does not fit is started once no other step is running. every step
+   runs on a thread of its own, ready steps are started in the order they
+   were added.
+
+   steps whose outputs are all available when the pipeline starts are
+   skipped, so a pipeline which was interrupted resumes with the steps that
+   did not finish. if a step fails no further steps are started, the
+   running steps are finished and the exception of the first failed step
+   is rethrown. */
+class build_pipeline
+{
+    private:
+        using clock = std::chrono::high_resolution_clock;
+        uint64_t m_memory_budget;
+        std::vector<build_step> m_steps;
+    public:
+        build_pipeline(uint64_t memory_budget) : m_memory_budget(memory_budget) {}
+
+        void add(build_step step)
+        {
+            m_steps.push_back(std::move(step));
+        }
+
+        /* available(artifact) tells whether an artifact exists before the
+           pipeline runs. returns one report per step in the order the steps
+           finished */
+        std::vector<build_step_report> run(std::function<bool(const std::string&)> available)
+        {
+            std::vector<build_step_report> reports;
+            std::set<std::string> produced;
+            std::set<std::string> outputs;
+            for (const auto& step : m_steps) {
+                outputs.insert(step.outputs.begin(),step.outputs.end());
+            }
+            // pending steps in the order they were added
+            std::vector<size_t> pending;
+            for (size_t i=0; i<m_steps.size(); i++) {
+                bool done = true;
+                for (const auto& out : m_steps[i].outputs) done = done && available(out);
+                if (done) {
+                    produced.insert(m_steps[i].outputs.begin(),m_steps[i].outputs.end());
+                    reports.push_back(build_step_report {m_steps[i].name,true,0,0,m_steps[i].memory,0});
+                } else {
+                    pending.push_back(i);
+                }
+            }
+            for (size_t i : pending) {
+                for (const auto& in : m_steps[i].inputs) {
+                    if (outputs.count(in) == 0 && !available(in)) {
+                        throw std::runtime_error("build_pipeline: no step produces '"+in+"' required by '"+m_steps[i].name+"'");
+                    }
+                }
+            }
+
+            auto pipeline_start = clock::now();
+            std::mutex m;
+            std::condition_variable cv;
+            std::deque<size_t> finished;
+            std::vector<std::exception_ptr> errors(m_steps.size());
+            std::vector<double> start_times(m_steps.size(),0);
+            std::vector<std::thread> threads;
+            size_t running = 0;
+            uint64_t running_memory = 0;
+            std::exception_ptr first_error;
+
+            auto seconds_since = [](clock::time_point t) {
+                return std::chrono::duration_cast<std::chrono::milliseconds>(clock::now()-t).count()/1000.0;
+            };
+            auto is_ready = [&](size_t i) {
+                for (const auto& in : m_steps[i].inputs) {
+                    if (produced.count(in) == 0 && !available(in)) return false;
+                }
+                return true;
+            };
+
+            while (true) {
+                // start the ready steps which fit into the memory budget
+                for (size_t p=0; p<pending.size() && first_error == nullptr;) {
+                    size_t i = pending[p];
+                    uint64_t mem = m_steps[i].memory;
+                    if (is_ready(i) && (running == 0 || running_memory+mem <= m_memory_budget)) {
+                        pending.erase(pending.begin()+p);
+                        running++;
+                        running_memory += mem;
+                        start_times[i] = seconds_since(pipeline_start);
+                        threads.emplace_back([&,i] {
+                            try {
+                                m_steps[i].build();
+                            } catch (...) {
+                                errors[i] = std::current_exception();
+                            }
+                            std::lock_guard<std::mutex> lock(m);
+                            finished.push_back(i);
+                            cv.notify_one();
+                        });
+                    } else {
+                        p++;
+                    }
+                }
+                if (running == 0) break;
+                size_t i;
+                {
+                    std::unique_lock<std::mutex> lock(m);
+                    cv.wait(lock,[&finished] { return !finished.empty(); });
+                    i = finished.front();
+                    finished.pop_front();
+                }
+                running--;
+                running_memory -= m_steps[i].memory;
+                if (errors[i] != nullptr) {
+                    if (first_error == nullptr) first_error = errors[i];
+                    continue;
+                }
+                produced.insert(m_steps[i].outputs.begin(),m_steps[i].outputs.end());
+                double now = seconds_since(pipeline_start);
+                reports.push_back(build_step_report {m_steps[i].name,false,start_times[i],now-start_times[i],
+                                                     m_steps[i].memory,utils::peak_memory_bytes()
+                                                    });
+            }
+            for (auto& t : threads) t.join();
+            if (first_error != nullptr) std::rethrow_exception(first_error);
+            if (!pending.empty()) {
+                throw std::runtime_error("build_pipeline: the inputs of step '"+m_steps[pending[0]].name+"' were never produced");
+            }
+            return reports;
+        }
+};
@@ -8,8 +8,16 @@
 #include <sdsl/select_support.hpp>
 #include <sdsl/sd_vector.hpp>
 
+#include <mutex>
+#include <cstdio>
+#include <unistd.h>
+
 #include "utils.hpp"
 #include "doc_perm.hpp"
+#include "sa_construction.hpp"
+#include "symbol_counts.hpp"
+#include "sa_derivation.hpp"
+#include "build_pipeline.hpp"
 
 #include "easylogging++.h"
 
@@ -45,10 +53,96 @@ std::vector<std::string> collection_keys = {KEY_SA,
                                             KEY_CST
                                            };
 
+// half of the physical memory
+inline uint64_t
+default_memory_budget()
+{
+    return (uint64_t)sysconf(_SC_PHYS_PAGES)*(uint64_t)sysconf(_SC_PAGESIZE)/2;
+}
+
+/* automatic picks the parallel in-memory construction if it fits into
+   the memory budget and the external bucket construction otherwise */
+inline sa_algorithm
+select_sa_algorithm(uint64_t n,uint64_t text_bytes,const sa_construction_options& opts)
+{
+    if (opts.algorithm != sa_algorithm::automatic) return opts.algorithm;
+    if (text_bytes+prefix_doubling_sa_space(n) <= opts.memory_budget) return sa_algorithm::prefix_doubling;
+    return sa_algorithm::bucket;
+}
+
+// estimated peak memory of construct_sa in bytes
+inline uint64_t
+sa_construction_memory(uint64_t n,uint64_t text_bytes,const sa_construction_options& opts)
+{
+    switch (select_sa_algorithm(n,text_bytes,opts)) {
+        case sa_algorithm::qsufsort:
+            return 2*n*sizeof(uint64_t);
+        case sa_algorithm::prefix_doubling:
+            return text_bytes+prefix_doubling_sa_space(n);
+        default:
+            return opts.memory_budget;
+    }
+}
+
+/* build the suffix array of the text stored at text_path with the
+   algorithm selected in opts */
+inline void
+construct_sa(const std::string& text_path,const std::string& sa_path,sa_construction_options opts)
+{
+    if (opts.memory_budget == 0) opts.memory_budget = default_memory_budget();
+    uint64_t n = 0;
+    uint64_t text_bytes = 0;
+    {
+        const sdsl::int_vector_mapper<0,std::ios_base::in> text(text_path);
+        n = text.size();
+        text_bytes = (n*text.width()+7)/8;
+    }
+    opts.algorithm = select_sa_algorithm(n,text_bytes,opts);
+    LOG(INFO) << "   - " << n << " suffixes, memory budget " << opts.memory_budget/(1024*1024) << " MB";
+    uint8_t width = sdsl::bits::hi(std::max<uint64_t>(n,1))+1;
+    switch (opts.algorithm) {
+        case sa_algorithm::qsufsort: {
+                LOG(INFO) << "   - qsufsort (sequential, in memory)";
+                sdsl::int_vector<> sa;
+                sdsl::qsufsort::construct_sa(sa,text_path.c_str(),0);
+                sdsl::store_to_file(sa,sa_path);
+            }
+            break;
+        case sa_algorithm::prefix_doubling: {
+                LOG(INFO) << "   - prefix doubling (parallel, in memory)";
+                sdsl::int_vector<> text;
+                sdsl::load_from_file(text,text_path);
+                sdsl::int_vector_buffer<> SA(sa_path,std::ios::out,1024*1024,width);
+                if (n < std::numeric_limits<uint32_t>::max()) {
+                    std::vector<uint32_t> sa;
+                    prefix_doubling_sa(text,sa);
+                    for (size_t i=0; i<n; i++) SA[i] = sa[i];
+                } else {
+                    std::vector<uint64_t> sa;
+                    prefix_doubling_sa(text,sa);
+                    for (size_t i=0; i<n; i++) SA[i] = sa[i];
+                }
+            }
+            break;
+        default: {
+                LOG(INFO) << "   - bucket sort (parallel, external memory)";
+                const sdsl::int_vector_mapper<0,std::ios_base::in> text(text_path);
+                sdsl::int_vector_buffer<> SA(sa_path,std::ios::out,1024*1024,width);
+                size_t written = 0;
+                bool fits = bucket_sa(text,opts.memory_budget,[&](const std::vector<uint64_t>& positions) {
+                    for (const auto& pos : positions) SA[written++] = pos;
+                });
+                if (!fits) LOG(WARNING) << "   - suffix batches exceeded the memory budget";
+            }
+            break;
+    }
+}
+
 struct collection {
     std::string path;
     std::map<std::string,std::string> file_map;
-    collection(const std::string& p) : path(p+"/")
+    std::vector<build_step_report> build_report;
+    collection(const std::string& p,const sa_construction_options& sa_opts = sa_construction_options()) : path(p+"/")
     {
         if (! utils::directory_exists(path)) {
             throw std::runtime_error("collection path not found.");
@@ -77,9 +171,45 @@ struct collection {
             }
         }
 
-        /* create stuff we are missing */
-        if (file_map.count(KEY_DOCPERM) == 0) {
-            auto docperm_path = path+"/"+KEY_PREFIX+KEY_DOCPERM;
+        /* create stuff we are missing. every artifact is built by a step of
+           the build pipeline, which runs the steps whose inputs exist
+           concurrently. a step writes to a partial file and renames it once
+           it is complete, so after a crash the construction resumes with
+           the artifacts which are still missing. */
+        uint64_t memory_budget = sa_opts.memory_budget ? sa_opts.memory_budget : default_memory_budget();
+        uint64_t n = 0;
+        uint64_t text_bytes = 0;
+        {
+            const sdsl::int_vector_mapper<0,std::ios_base::in> text(file_map[KEY_TEXT]);
+            n = text.size();
+            text_bytes = (n*text.width()+7)/8;
+        }
+        std::mutex file_map_mutex;
+        auto input = [&](const std::string& key) {
+            std::lock_guard<std::mutex> lock(file_map_mutex);
+            return file_map.at(key);
+        };
+        auto partial = [&](const std::string& key) {
+            return path+"/"+KEY_PREFIX+key+".partial";
+        };
+        auto commit = [&](const std::string& key) {
+            auto file_path = path+"/"+KEY_PREFIX+key;
+            if (std::rename(partial(key).c_str(),file_path.c_str()) != 0) {
+                throw std::runtime_error("could not rename '"+partial(key)+"' to '"+file_path+"'");
+            }
+            std::lock_guard<std::mutex> lock(file_map_mutex);
+            file_map[key] = file_path;
+            LOG(INFO) << "DONE " << key;
+        };
+        sa_construction_options sa_build_opts = sa_opts;
+        sa_build_opts.memory_budget = memory_budget;
+        uint64_t cc_budget = std::min(memory_budget/2,n*2*sizeof(uint64_t));
+        // chunks in flight and the output buffer while deriving POSPL and D
+        uint64_t chunk_memory = 2*shared_thread_pool().size()*construction_chunk_postings*3*sizeof(uint64_t)
+                                + 64*1024*1024;
+
+        build_pipeline pipeline(memory_budget);
+        pipeline.add({KEY_DOCPERM,{},{KEY_DOCPERM},0,[&] {
             LOG(INFO) << "CONSTRUCT " << KEY_DOCPERM;
             doc_perm dp;
             if (utils::file_exists(path+"/"+URLORDER) && utils::file_exists(path+"/"+DOCNAMES)) {
@@ -115,30 +245,31 @@ struct collection {
                 // identity permutation
                 dp.is_identity = true;
             }
-            sdsl::store_to_file(dp,docperm_path);
-            file_map[KEY_DOCPERM] = docperm_path;
-            LOG(INFO) << "DONE";
-        }
-        if (file_map.count(KEY_TEXTPERM) == 0) {
+            sdsl::store_to_file(dp,partial(KEY_DOCPERM));
+            commit(KEY_DOCPERM);
+        }});
+        pipeline.add({KEY_TEXTPERM,{KEY_DOCPERM},{KEY_TEXTPERM},2*text_bytes+n/4,[&] {
             doc_perm dp;
-            sdsl::load_from_file(dp,file_map[KEY_DOCPERM]);
+            sdsl::load_from_file(dp,input(KEY_DOCPERM));
             if (dp.is_identity) {
+                std::lock_guard<std::mutex> lock(file_map_mutex);
                 file_map[KEY_TEXTPERM] = file_map[KEY_TEXT];
-            } else {
-                LOG(INFO) << "CONSTRUCT " << KEY_TEXTPERM;
-                sdsl::int_vector<> text;
-                sdsl::load_from_file(text,file_map[KEY_TEXT]);
-                sdsl::bit_vector doc_border(text.size(), 0);
-                size_t num_docs = 0;
-                for (uint64_t i=0; i < text.size(); ++i) {
-                    if (1 == text[i]) {
-                        doc_border[i] = 1;
-                        num_docs++;
-                    }
+                return;
+            }
+            LOG(INFO) << "CONSTRUCT " << KEY_TEXTPERM;
+            sdsl::int_vector<> text;
+            sdsl::load_from_file(text,input(KEY_TEXT));
+            sdsl::bit_vector doc_border(text.size(), 0);
+            size_t num_docs = 0;
+            for (uint64_t i=0; i < text.size(); ++i) {
+                if (1 == text[i]) {
+                    doc_border[i] = 1;
+                    num_docs++;
                 }
-                sdsl::select_support_mcl<1> doc_border_select(&doc_border);
-                auto tp_path = path+"/"+KEY_PREFIX+KEY_TEXTPERM;
-                sdsl::int_vector_buffer<> TPERM(tp_path,std::ios::out,1024*1024,text.width());
+            }
+            sdsl::select_support_mcl<1> doc_border_select(&doc_border);
+            {
+                sdsl::int_vector_buffer<> TPERM(partial(KEY_TEXTPERM),std::ios::out,1024*1024,text.width());
                 size_t cur = 0;
                 for (size_t i=0; i<num_docs; i++) {
                     auto mapped_id = dp.len2id[i];
@@ -156,91 +287,64 @@ struct collection {
                     }
                 }
                 TPERM[cur] = 0; // terminate to allow suffix sorting
-                file_map[KEY_TEXTPERM] = tp_path;
-                LOG(INFO) << "DONE";
             }
-        }
-
-        if (file_map.count(KEY_SA) == 0) {
+            commit(KEY_TEXTPERM);
+        }});
+        pipeline.add({KEY_SA,{KEY_TEXTPERM},{KEY_SA},sa_construction_memory(n,text_bytes,sa_build_opts),[&] {
             LOG(INFO) << "CONSTRUCT " << KEY_SA;
-            sdsl::int_vector<> sa;
-            sdsl::qsufsort::construct_sa(sa,file_map[KEY_TEXTPERM].c_str(),0);
-            auto sa_path = path+"/"+KEY_PREFIX+KEY_SA;
-            sdsl::store_to_file(sa,sa_path);
-            file_map[KEY_SA] = sa_path;
-        }
-        if (file_map.count(KEY_C) == 0) {
+            construct_sa(input(KEY_TEXTPERM),partial(KEY_SA),sa_build_opts);
+            commit(KEY_SA);
+        }});
+        pipeline.add({KEY_C,{KEY_TEXTPERM},{KEY_C},text_bytes,[&] {
             LOG(INFO) << "CONSTRUCT " << KEY_C;
-            sdsl::int_vector_mapper<> text(file_map[KEY_TEXTPERM]);
-            std::unordered_map<uint64_t,uint64_t> tmpC(5000000);
-            for (uint64_t i=0; i < text.size(); ++i) {
-                tmpC[text[i]] += 1;
-            }
-            sdsl::int_vector<> C(tmpC.size());
-            for (const auto& p : tmpC) {
-                C[p.first] = p.second;
+            const sdsl::int_vector_mapper<0,std::ios_base::in> text(input(KEY_TEXTPERM));
+            auto counts = symbol_histogram(text);
+            sdsl::int_vector<> C(counts.size());
+            for (size_t i=0; i<counts.size(); i++) {
+                C[i] = counts[i];
             }
             sdsl::util::bit_compress(C);
-            auto c_path = path+"/"+KEY_PREFIX+KEY_C;
-            sdsl::store_to_file(C,c_path);
-            file_map[KEY_C] = c_path;
-            LOG(INFO) << "DONE";
-        }
-        if (file_map.count(KEY_CC) == 0) {
+            sdsl::store_to_file(C,partial(KEY_C));
+            commit(KEY_C);
+        }});
+        pipeline.add({KEY_CC,{KEY_TEXTPERM,KEY_C},{KEY_CC,KEY_SCC},text_bytes+cc_budget,[&] {
             LOG(INFO) << "CONSTRUCT " << KEY_CC;
-            sdsl::int_vector_mapper<> text(file_map[KEY_TEXTPERM]);
-            sdsl::int_vector_mapper<> C(file_map[KEY_C]);
-            LOG(INFO) << "   - determine 2-token syms";
-            std::unordered_map<uint64_t,uint64_t> tmpCC(50000000);
-            for (uint64_t i=0; i < text.size()-1; ++i) {
-                uint64_t sym = (text[i] << text.width()) + text[i+1];
-                tmpCC[sym] += 1;
-            }
-
-            LOG(INFO) << "   - sort 2-token syms";
-            sdsl::int_vector<> CC(tmpCC.size());
-            size_t i = 0;
-            for (const auto& p : tmpCC) {
-                CC[i++] = p.first;
-            }
-            std::sort(CC.begin(),CC.end());
-            {
-                LOG(INFO) << "   - store syms";
-                sdsl::util::bit_compress(CC);
-                auto cc_path = path+"/"+KEY_PREFIX+KEY_CC;
-                sdsl::store_to_file(CC,cc_path);
-                file_map[KEY_CC] = cc_path;
-            }
+            const sdsl::int_vector_mapper<0,std::ios_base::in> text(input(KEY_TEXTPERM));
+            const sdsl::int_vector_mapper<0,std::ios_base::in> C(input(KEY_C));
+            std::vector<uint64_t> counts(C.begin(),C.end());
+            LOG(INFO) << "   - count and store 2-token syms";
             {
-                sdsl::int_vector<> SCC(tmpCC.size());
-                for (size_t i=0; i<CC.size(); i++) {
-                    auto cnt = tmpCC[CC[i]];
-                    SCC[i] = cnt;
-                }
-                auto SCC_path = path+"/"+KEY_PREFIX+KEY_SCC;
-                sdsl::util::bit_compress(SCC);
-                sdsl::store_to_file(SCC,SCC_path);
-                file_map[KEY_SCC] = SCC_path;
+                /* the 2-token syms are written as they are emitted, the step
+                   only needs the budget of count_symbol_pairs and the write
+                   buffers. a 2-token sym occurs at most as often as its
+                   first sym */
+                uint64_t max_sym = counts.empty() ? 1 : ((counts.size()-1) << text.width()) + counts.size()-1;
+                uint64_t max_count = std::max<uint64_t>(1,counts.empty() ? 1 : *std::max_element(counts.begin(),counts.end()));
+                sdsl::int_vector_buffer<> CC(partial(KEY_CC),std::ios::out,1024*1024,sdsl::bits::hi(max_sym)+1);
+                sdsl::int_vector_buffer<> SCC(partial(KEY_SCC),std::ios::out,1024*1024,sdsl::bits::hi(max_count)+1);
+                count_symbol_pairs(text,text.width(),counts,cc_budget,[&](uint64_t sym,uint64_t cnt) {
+                    CC.push_back(sym);
+                    SCC.push_back(cnt);
+                });
             }
-            LOG(INFO) << "DONE";
-        }
-        if (file_map.count(KEY_DBV) == 0) {
+            // CC is committed last, the step is complete once both exist
+            commit(KEY_SCC);
+            commit(KEY_CC);
+        }});
+        pipeline.add({KEY_DBV,{KEY_TEXTPERM},{KEY_DBV},text_bytes+n/8,[&] {
             LOG(INFO) << "CONSTRUCT " << KEY_DBV;
-            auto dbv_path = path+"/"+KEY_PREFIX+KEY_DBV;
-            sdsl::int_vector_mapper<> text(file_map[KEY_TEXTPERM]);
+            const sdsl::int_vector_mapper<0,std::ios_base::in> text(input(KEY_TEXTPERM));
             sdsl::bit_vector doc_border(text.size(), 0);
             for (uint64_t i=0; i < text.size(); ++i) {
                 if (1 == text[i]) doc_border[i] = 1;
             }
-            sdsl::store_to_file(doc_border,dbv_path);
-            file_map[KEY_DBV] = dbv_path;
-            LOG(INFO) << "DONE";
-        }
-        if (file_map.count(KEY_DOCLEN) == 0) {
+            sdsl::store_to_file(doc_border,partial(KEY_DBV));
+            commit(KEY_DBV);
+        }});
+        pipeline.add({KEY_DOCLEN,{KEY_DBV},{KEY_DOCLEN},n/8,[&] {
             LOG(INFO) << "CONSTRUCT " << KEY_DOCLEN;
-            auto doclen_path = path+"/"+KEY_PREFIX+KEY_DOCLEN;
             sdsl::bit_vector doc_border;
-            sdsl::load_from_file(doc_border, file_map[KEY_DBV]);
+            sdsl::load_from_file(doc_border, input(KEY_DBV));
             size_t num_docs = 0;
             for (uint64_t i=0; i < doc_border.size(); ++i) {
                 if (doc_border[i] == 1) num_docs++;
@@ -257,44 +361,51 @@ struct collection {
                     len++;
                 }
             }
-            sdsl::store_to_file(doc_lens,doclen_path);
-            file_map[KEY_DOCLEN] = doclen_path;
-            LOG(INFO) << "DONE";
-        }
-        if (file_map.count(KEY_POSPL) == 0) {
-            auto pospl_path = path+"/"+KEY_PREFIX+KEY_POSPL;
+            sdsl::store_to_file(doc_lens,partial(KEY_DOCLEN));
+            commit(KEY_DOCLEN);
+        }});
+        pipeline.add({KEY_POSPL,{KEY_SA,KEY_C},{KEY_POSPL},chunk_memory,[&] {
             LOG(INFO) << "CONSTRUCT " << KEY_POSPL;
-            sdsl::int_vector_mapper<> SA(file_map[KEY_SA]);
-            sdsl::int_vector_mapper<> C(file_map[KEY_C]);
-            sdsl::int_vector_buffer<> oPOSPL(pospl_path,std::ios::out,1024*1024,SA.width());
-            size_t cum_sum = 0;
-            for (size_t i=0; i<C.size(); i++) {
-                auto start = SA.begin()+cum_sum;
-                auto end = start + C[i];
-                std::vector<uint64_t> tmp(start,end);
-                std::sort(tmp.begin(),tmp.end());
-                for (size_t j=0; j<C[i]; j++) {
-                    oPOSPL[cum_sum+j] = tmp[j];
-                }
-                cum_sum += C[i];
+            {
+                const sdsl::int_vector_mapper<0,std::ios_base::in> SA(input(KEY_SA));
+                const sdsl::int_vector_mapper<0,std::ios_base::in> C(input(KEY_C));
+                sdsl::int_vector_buffer<> oPOSPL(partial(KEY_POSPL),std::ios::out,64*1024*1024,SA.width());
+                positions_lists(SA,C,[&oPOSPL](const std::vector<uint64_t>& pos) {
+                    for (const auto& p : pos) oPOSPL.push_back(p);
+                });
             }
-            file_map[KEY_POSPL] = pospl_path;
-            LOG(INFO) << "DONE";
-        }
-        if (file_map.count(KEY_D) == 0) {
-            auto docpl_path = path+"/"+KEY_PREFIX+KEY_D;
+            commit(KEY_POSPL);
+        }});
+        // assumes documents of 64 tokens on average for the document borders
+        pipeline.add({KEY_D,{KEY_SA,KEY_DBV},{KEY_D},chunk_memory+n/8+n/8,[&] {
             LOG(INFO) << "CONSTRUCT " << KEY_D;
-            sdsl::int_vector_mapper<> SA(file_map[KEY_SA]);
-            sdsl::bit_vector doc_border;
-            sdsl::load_from_file(doc_border, file_map[KEY_DBV]);
-            sdsl::rank_support_v<> doc_border_rank(&doc_border);
-            uint64_t doc_cnt = doc_border_rank(doc_border.size());
-            sdsl::int_vector_buffer<> D(docpl_path,std::ios::out,1024*1024,sdsl::bits::hi(doc_cnt)+1);
-            for (size_t i=0; i<SA.size(); i++) {
-                D[i] = doc_border_rank(SA[i]);
+            {
+                const sdsl::int_vector_mapper<0,std::ios_base::in> SA(input(KEY_SA));
+                std::vector<uint64_t> borders;
+                {
+                    sdsl::bit_vector doc_border;
+                    sdsl::load_from_file(doc_border, input(KEY_DBV));
+                    const uint64_t* data = doc_border.data();
+                    for (size_t i=0; i<(doc_border.size()+63)/64; i++) {
+                        uint64_t w = data[i];
+                        while (w) {
+                            borders.push_back(i*64+sdsl::bits::lo(w));
+                            w &= w-1;
+                        }
+                    }
+                }
+                uint64_t doc_cnt = borders.size();
+                sdsl::int_vector_buffer<> D(partial(KEY_D),std::ios::out,64*1024*1024,sdsl::bits::hi(doc_cnt)+1);
+                document_array(SA,borders,[&D](const std::vector<uint64_t>& docs) {
+                    for (const auto& d : docs) D.push_back(d);
+                });
             }
-            file_map[KEY_D] = docpl_path;
-            LOG(INFO) << "DONE";
-        }
+            commit(KEY_D);
+        }});
+
+        build_report = pipeline.run([&](const std::string& key) {
+            std::lock_guard<std::mutex> lock(file_map_mutex);
+            return file_map.count(key) != 0;
+        });
     }
 };
\ No newline at end of file
@@ -8,6 +8,9 @@ struct query_t {
     uint64_t id;
     std::string org;
     std::vector<uint64_t> ids;
+    uint64_t k;   // result limit, 0 if the query does not specify one
+    bool ranked;  // top-k by score instead of the first k in docid order
+    std::string error; // why a malformed query was rejected, empty otherwise
 };
 
 std::ostream&
@@ -18,9 +21,24 @@ operator<<(std::ostream& os, const query_t& q)
         os << id << ",";
     }
     os << "] (" << q.org << ")";
+    if (q.k) os << " k=" << q.k << (q.ranked ? " topk" : "");
+    if (!q.error.empty()) os << " error='" << q.error << "'";
     return os;
 }
 
+// a non-empty string of decimal digits which fits into 64 bits
+inline bool
+parse_number(const std::string& str,uint64_t& value)
+{
+    if (str.empty() || str.find_first_not_of("0123456789") != std::string::npos) return false;
+    try {
+        value = std::stoull(str);
+    } catch (const std::exception&) {
+        return false;
+    }
+    return true;
+}
+
 struct dict_map {
     std::unordered_map<std::string,uint64_t> id_mapping;
     std::unordered_map<uint64_t,std::string> reverse_id_mapping;
@@ -48,13 +66,38 @@ struct dict_map {
             throw std::runtime_error("dictionary file '"+file_name+"' not found.");
         }
     }
+    /* query format: <qid>;<terms>[;<k>[;topk]]. the query comes from a
+       client, so a malformed query is returned incomplete instead of
+       throwing */
     query_t
     parse_query(const std::string& query_str)
     {
         auto id_sep_pos = query_str.find(';');
-        auto qryid_str = query_str.substr(0,id_sep_pos);
-        auto qry_id = std::stoull(qryid_str);
+        if (id_sep_pos == std::string::npos) {
+            LOG(ERROR) << "ERROR: missing query id in '" << query_str << "'.";
+            return {false,0,query_str,{},0,false,"missing query id"};
+        }
+        uint64_t qry_id = 0;
+        if (!parse_number(query_str.substr(0,id_sep_pos),qry_id)) {
+            LOG(ERROR) << "ERROR: invalid query id in '" << query_str << "'.";
+            return {false,0,query_str,{},0,false,"invalid query id"};
+        }
         auto qry_content = query_str.substr(id_sep_pos+1);
+        uint64_t k = 0;
+        bool ranked = false;
+        auto k_sep_pos = qry_content.find(';');
+        if (k_sep_pos != std::string::npos) {
+            auto options = qry_content.substr(k_sep_pos+1);
+            qry_content = qry_content.substr(0,k_sep_pos);
+            auto mode_sep_pos = options.find(';');
+            if (!parse_number(options.substr(0,mode_sep_pos),k)) {
+                LOG(ERROR) << "ERROR: invalid result limit in '" << query_str << "'.";
+                return {false,qry_id,qry_content,{},0,false,"invalid result limit"};
+            }
+            if (mode_sep_pos != std::string::npos) {
+                ranked = options.substr(mode_sep_pos+1) == "topk";
+            }
+        }
 
         std::vector<uint64_t> ids;
         std::istringstream qry_content_stream(qry_content);
@@ -64,10 +107,10 @@ struct dict_map {
                 ids.push_back(id_itr->second);
             } else {
                 LOG(ERROR) << "ERROR: could not find '" << qry_token << "' in the dictionary.";
-                return {false,qry_id,qry_content,ids};
+                return {false,qry_id,qry_content,ids,k,ranked,""};
             }
         }
-        return {true,qry_id,qry_content,ids};
+        return {true,qry_id,qry_content,ids,k,ranked,""};
     }
 
 };
@@ -267,6 +267,31 @@ class ef_skip_iterator : public std::iterator<std::random_access_iterator_tag,ui
             }
             return false;
         }
+        /* prefetch what skip(pos) reads. a skip over a skip pointer is
+           prefetched in two stages: stage 0 fetches the skip pointer, stage 1
+           reads it and fetches the high and low bits it points to. returns
+           true if there is a further stage */
+        bool prefetch(uint64_t pos,size_t stage = 0) const
+        {
+            if (m_universe < pos) return false;
+            uint64_t high_bucket = pos >> m_width_low;
+            uint64_t cur_bucket = m_cur_high_offset - m_cur_offset;
+            if (high_bucket > cur_bucket + SKIP_OFFSET_THRESHOLD && high_bucket > t_skip) {
+                if (stage == 0) {
+                    prefetch_bits(m_data,m_skip_start_offset + (high_bucket/t_skip)*m_skip_width);
+                    return true;
+                }
+                auto high_skip = skip_offset(high_bucket);
+                auto skip_fast = high_bucket % t_skip;
+                auto first_low = high_skip - m_high_offset + 1 - (high_bucket - skip_fast);
+                prefetch_bits(m_data,m_low_offset + first_low*m_width_low);
+                prefetch_bits(m_data,high_skip);
+                return false;
+            }
+            prefetch_bits(m_data,m_high_offset+m_cur_high_offset);
+            prefetch_bits(m_data,m_low_offset+m_cur_offset*m_width_low);
+            return false;
+        }
     private:
         inline value_type low(size_type i) const
         {
@@ -0,0 +1,387 @@
+#pragma once
+
+#include <iterator>
+#include <array>
+#include <type_traits>
+
+#include "bit_streams.hpp"
+#include "bit_coders.hpp"
+#include "list_basics.hpp"
+#include "bitvector_list.hpp"
+#include "eliasfano_list.hpp"
+#include "uniform_elias_fano.hpp"
+#include "optpfor_list.hpp"
+
+/* a list of sorted integers whose codec is chosen per list when the list
+   is created. the codec is not stored in the list, create() returns it
+   and materialize() expects it, so the index keeps it in its list
+   metadata (see create_list and materialize_list below). */
+enum class list_codec : uint8_t
+{
+    BV = 0, EF = 1, UEF = 2, OPTPFOR = 3
+};
+
+const size_t num_list_codecs = 4;
+
+/* the cost of a codec for a list is its estimated size in bits plus
+   t_time_weight times the number of postings times the relative time
+   to decode one posting of the codec. t_time_weight = 0 picks the
+   smallest encoding, larger weights prefer the faster codecs.
+
+   the sizes are computed from the gaps of the list with the size
+   formulas of the codecs. the OptPFor block size is the cheapest bit
+   width for the gaps of the block with an estimate of the exception
+   cost. the decode times are relative to OptPFor, the bitvector cost
+   grows with the number of words scanned per posting. */
+template<uint32_t t_time_weight = 1>
+struct hybrid_cost_model {
+    static double decode_time(list_codec codec,uint64_t m,uint64_t u)
+    {
+        switch (codec) {
+            case list_codec::BV:
+                return 0.5 + (double)u/m/64;
+            case list_codec::EF:
+                return 2.0;
+            case list_codec::UEF:
+                return 2.5;
+            case list_codec::OPTPFOR:
+                return 1.0;
+        }
+        return 0;
+    }
+
+    static uint64_t gamma_bits(uint64_t x)
+    {
+        return coder::elias_gamma::encoded_length(x);
+    }
+
+    static uint64_t ef_bits(uint64_t m,uint64_t u)
+    {
+        uint8_t logm = sdsl::bits::hi(m)+1;
+        uint8_t logu = sdsl::bits::hi(u)+1;
+        uint8_t width_low = 1;
+        if (logu >= logm) {
+            if (logm == logu) logm--;
+            width_low = logu - logm;
+        }
+        return m*width_low + (u >> width_low) + m + 1;
+    }
+
+    // OptPFor block of gaps with the given bit width histogram
+    static uint64_t pfor_block_bits(const std::array<uint32_t,65>& width_hist)
+    {
+        uint64_t max_width = 0;
+        for (size_t w=0; w<width_hist.size(); w++) if (width_hist[w]) max_width = w;
+        uint64_t best = std::numeric_limits<uint64_t>::max();
+        uint64_t exceptions = 0;
+        for (int64_t b=max_width; b>=0; b--) {
+            // exception positions and their high bits
+            uint64_t bits = 32 + 128*b + exceptions*(8 + max_width - b);
+            best = std::min(best,bits);
+            exceptions += width_hist[b];
+        }
+        return best;
+    }
+
+    template<class t_itr>
+    static std::array<uint64_t,num_list_codecs> estimate_bits(t_itr begin,t_itr end)
+    {
+        const uint64_t block_size = 128;
+        uint64_t m = std::distance(begin,end);
+        uint64_t last = *(end-1);
+        uint64_t num_blocks = (m + block_size - 1) / block_size;
+        std::array<uint64_t,num_list_codecs> bits;
+
+        bits[(size_t)list_codec::BV] = gamma_bits(m) + gamma_bits(last) + last + 2;
+        bits[(size_t)list_codec::EF] = gamma_bits(m) + gamma_bits(last+1) + ef_bits(m,last+1);
+
+        uint64_t uef = gamma_bits(m);
+        uint64_t pfor = gamma_bits(m);
+        if (m <= block_size) {
+            uef += ef_bits(m,last+1) + 2*gamma_bits(m);
+            uint64_t prev = 0;
+            for (auto itr = begin; itr != end; ++itr) {
+                pfor += coder::vbyte::encoded_length(*itr - prev);
+                prev = *itr;
+            }
+        } else {
+            uef += 64 + 64*num_blocks + ef_bits(num_blocks,last+1) + 2*gamma_bits(num_blocks);
+            pfor += 64 + 64*num_blocks;
+            uint64_t prev = 0;
+            auto itr = begin;
+            for (uint64_t b=0; b<num_blocks; b++) {
+                uint64_t n = std::min(block_size,m-b*block_size);
+                uint64_t block_base = prev;
+                std::array<uint32_t,65> width_hist {};
+                uint64_t vbyte_bits = 0;
+                for (uint64_t j=0; j<n; j++) {
+                    uint64_t gap = *itr - prev;
+                    width_hist[sdsl::bits::hi(gap)+1]++;
+                    vbyte_bits += coder::vbyte::encoded_length(gap);
+                    prev = *itr;
+                    ++itr;
+                }
+                // uef blocks are relative to the last value of the previous block
+                uint64_t universe = (b == 0) ? prev : prev - block_base - 1;
+                if (universe != n-1) {
+                    uef += std::min(eliasfano_list<true,true>::estimate_size(n,universe),
+                                    bitvector_list<true>::estimate_size(n,universe));
+                }
+                pfor += (n == block_size) ? pfor_block_bits(width_hist) : vbyte_bits;
+            }
+        }
+        bits[(size_t)list_codec::UEF] = uef;
+        bits[(size_t)list_codec::OPTPFOR] = pfor;
+        return bits;
+    }
+
+    template<class t_itr>
+    static list_codec select(t_itr begin,t_itr end)
+    {
+        uint64_t m = std::distance(begin,end);
+        uint64_t last = *(end-1);
+        auto bits = estimate_bits(begin,end);
+        list_codec best = list_codec::OPTPFOR;
+        double best_cost = std::numeric_limits<double>::max();
+        for (size_t c=0; c<num_list_codecs; c++) {
+            auto codec = (list_codec)c;
+            if (codec == list_codec::BV && last == 0) continue; // the bitvector needs a universe > 0
+            double cost = bits[c] + (double)t_time_weight*m*decode_time(codec,m,last+1);
+            if (cost < best_cost) {
+                best_cost = cost;
+                best = codec;
+            }
+        }
+        return best;
+    }
+};
+
+class hybrid_iterator : public std::iterator<std::random_access_iterator_tag,uint64_t,std::ptrdiff_t>
+{
+    public:
+        using size_type = sdsl::int_vector<>::size_type;
+        using bv_itr_type = bv_iterator<false>;
+        using ef_itr_type = ef_iterator<true,false>;
+        using uef_itr_type = uniform_ef_iterator<128>;
+        using pfor_itr_type = optpfor_iterator<128,true>;
+    private:
+        list_codec m_codec = list_codec::OPTPFOR;
+        bv_itr_type m_bv;
+        ef_itr_type m_ef;
+        uef_itr_type m_uef;
+        pfor_itr_type m_pfor;
+    public:
+        hybrid_iterator() = default;
+        hybrid_iterator(const hybrid_iterator& pi) = default;
+        hybrid_iterator(hybrid_iterator&& pi) = default;
+        hybrid_iterator& operator=(const hybrid_iterator& pi) = default;
+        hybrid_iterator& operator=(hybrid_iterator&& pi) = default;
+        hybrid_iterator(const bit_istream& is,size_t start_offset,bool end,list_codec codec) : m_codec(codec)
+        {
+            switch (m_codec) {
+                case list_codec::BV:
+                    m_bv = bv_itr_type(is,start_offset,end);
+                    break;
+                case list_codec::EF:
+                    m_ef = ef_itr_type(is,start_offset,end);
+                    break;
+                case list_codec::UEF:
+                    m_uef = uef_itr_type(is,start_offset,end);
+                    break;
+                case list_codec::OPTPFOR:
+                    m_pfor = pfor_itr_type(is,start_offset,end);
+                    break;
+            }
+        }
+    public:
+        list_codec codec() const
+        {
+            return m_codec;
+        }
+        size_type offset() const
+        {
+            switch (m_codec) {
+                case list_codec::BV:
+                    return m_bv.offset();
+                case list_codec::EF:
+                    return m_ef.offset();
+                case list_codec::UEF:
+                    return m_uef.offset();
+                default:
+                    return m_pfor.offset();
+            }
+        }
+        size_type size() const
+        {
+            switch (m_codec) {
+                case list_codec::BV:
+                    return m_bv.size();
+                case list_codec::EF:
+                    return m_ef.size();
+                case list_codec::UEF:
+                    return m_uef.size();
+                default:
+                    return m_pfor.size();
+            }
+        }
+        size_type remaining() const
+        {
+            return size() - offset();
+        }
+        uint64_t operator*() const
+        {
+            switch (m_codec) {
+                case list_codec::BV:
+                    return *m_bv;
+                case list_codec::EF:
+                    return *m_ef;
+                case list_codec::UEF:
+                    return *m_uef;
+                default:
+                    return *m_pfor;
+            }
+        }
+        bool operator ==(const hybrid_iterator& b) const
+        {
+            return offset() == b.offset();
+        }
+        bool operator !=(const hybrid_iterator& b) const
+        {
+            return offset() != b.offset();
+        }
+        hybrid_iterator operator++(int)
+        {
+            hybrid_iterator tmp(*this);
+            ++(*this);
+            return tmp;
+        }
+        hybrid_iterator& operator++()
+        {
+            switch (m_codec) {
+                case list_codec::BV:
+                    ++m_bv;
+                    break;
+                case list_codec::EF:
+                    ++m_ef;
+                    break;
+                case list_codec::UEF:
+                    ++m_uef;
+                    break;
+                case list_codec::OPTPFOR:
+                    ++m_pfor;
+                    break;
+            }
+            return *this;
+        }
+        hybrid_iterator& operator+=(size_type i)
+        {
+            switch (m_codec) {
+                case list_codec::BV:
+                    m_bv += i;
+                    break;
+                case list_codec::EF:
+                    m_ef += i;
+                    break;
+                case list_codec::UEF:
+                    m_uef += i;
+                    break;
+                case list_codec::OPTPFOR:
+                    m_pfor += i;
+                    break;
+            }
+            return *this;
+        }
+        hybrid_iterator operator+(size_type i)
+        {
+            hybrid_iterator tmp(*this);
+            tmp += i;
+            return tmp;
+        }
+        template<class t_itr>
+        auto operator-(const t_itr& b) const -> difference_type
+        {
+            return (difference_type)offset() - (difference_type)b.offset();
+        }
+        bool skip(uint64_t pos)
+        {
+            switch (m_codec) {
+                case list_codec::BV:
+                    return m_bv.skip(pos);
+                case list_codec::EF:
+                    return m_ef.skip(pos);
+                case list_codec::UEF:
+                    return m_uef.skip(pos);
+                default:
+                    return m_pfor.skip(pos);
+            }
+        }
+};
+
+template<uint32_t t_time_weight = 1>
+struct hybrid_list {
+    using size_type = sdsl::int_vector<>::size_type;
+    using iterator_type = hybrid_iterator;
+    using list_type = list_dummy<iterator_type>;
+    using cost_model = hybrid_cost_model<t_time_weight>;
+
+    template<class t_itr>
+    static size_type create(bit_ostream& os,t_itr begin,t_itr end,list_codec& codec)
+    {
+        codec = cost_model::select(begin,end);
+        switch (codec) {
+            case list_codec::BV:
+                return bitvector_list<false>::create(os,begin,end);
+            case list_codec::EF:
+                return eliasfano_list<true,false>::create(os,begin,end);
+            case list_codec::UEF:
+                return uniform_eliasfano_list<128>::create(os,begin,end);
+            default:
+                return optpfor_list<128,true>::create(os,begin,end);
+        }
+    }
+
+    static list_dummy<iterator_type> materialize(const bit_istream& is,size_t start_offset,list_codec codec)
+    {
+        return list_dummy<iterator_type>(iterator_type(is,start_offset,false,codec),iterator_type(is,start_offset,true,codec));
+    }
+};
+
+template<class t_list>
+struct is_hybrid_list : std::false_type {};
+
+template<uint32_t t_time_weight>
+struct is_hybrid_list<hybrid_list<t_time_weight>> : std::true_type {};
+
+/* create and materialize lists with and without a per list codec. lists
+   with a single codec ignore the codec and report codec 0 */
+template<class t_list,class t_itr>
+typename std::enable_if<!is_hybrid_list<t_list>::value,uint64_t>::type
+create_list(bit_ostream& os,t_itr begin,t_itr end,uint8_t& codec)
+{
+    codec = 0;
+    return t_list::create(os,begin,end);
+}
+
+template<class t_list,class t_itr>
+typename std::enable_if<is_hybrid_list<t_list>::value,uint64_t>::type
+create_list(bit_ostream& os,t_itr begin,t_itr end,uint8_t& codec)
+{
+    list_codec c;
+    auto offset = t_list::create(os,begin,end,c);
+    codec = (uint8_t)c;
+    return offset;
+}
+
+template<class t_list>
+typename std::enable_if<!is_hybrid_list<t_list>::value,typename t_list::list_type>::type
+materialize_list(const bit_istream& is,size_t start_offset,uint8_t)
+{
+    return t_list::materialize(is,start_offset);
+}
+
+template<class t_list>
+typename std::enable_if<is_hybrid_list<t_list>::value,typename t_list::list_type>::type
+materialize_list(const bit_istream& is,size_t start_offset,uint8_t codec)
+{
+    return t_list::materialize(is,start_offset,(list_codec)codec);
+}
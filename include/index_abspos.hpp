@@ -4,6 +4,7 @@
 #include "index_invidx.hpp"
 #include "doc_pos_mapper.hpp"
 #include "intersection.hpp"
+#include "batch_intersection.hpp"
 
 #include "easylogging++.h"
 
@@ -25,18 +26,19 @@ class index_abspos
     public:
         invidx_type m_docidx;
         size_t m_num_lists;
-        std::vector<abs_metadata> m_meta_data;
+        mappable_vector<abs_metadata> m_meta_data;
         sdsl::bit_vector m_data;
         doc_pos_mapper m_dpm;
         bit_istream m_is;
+        std::shared_ptr<mmap_file> m_mapping;
     public:
-        index_abspos(collection& col) : m_docidx(col), m_is(m_data)
+        index_abspos(collection& col,const index_load_options& opts = index_load_options())
+            : m_docidx(col,opts), m_is(m_data)
         {
             file_name = col.path +"index/"+name+"-"+sdsl::util::class_to_hash(*this)+".idx";
             if (utils::file_exists(file_name)) {  // load
                 LOG(INFO) << "LOAD from file '" << file_name << "'";
-                std::ifstream ifs(file_name);
-                load(ifs);
+                m_mapping = load_index_file(*this,file_name,opts);
             } else { // construct
                 {
                     // (2) pos index
@@ -46,15 +48,35 @@ class index_abspos
                     const sdsl::int_vector_mapper<0,std::ios_base::in> C(col.file_map[KEY_C]);
                     m_num_lists = C.size();
                     m_meta_data.resize(m_num_lists);
-                    size_t csum = C[0] + C[1];
-                    for (size_t i=2; i<C.size(); i++) {
-                        size_t n = C[i];
-                        LOG_EVERY_N(C.size()/10, INFO) << "Construct abspos list " << i << " (" << n << ")";
-                        auto begin = POS.begin()+csum;
-                        auto end = begin + n;
-                        m_meta_data[i].offset = plist_type::create(bvo,begin,end);
-                        csum += n;
-                    }
+                    // the terms are encoded in chunks by the workers of the thread pool
+                    struct chunk_data {
+                        sdsl::bit_vector data;
+                        std::vector<uint64_t> offsets;
+                    };
+                    auto encode = [&](const term_chunk& chunk) {
+                        chunk_data cd;
+                        {
+                            bit_ostream os(cd.data);
+                            size_t csum = chunk.first_posting;
+                            for (size_t i=chunk.begin; i<chunk.end; i++) {
+                                size_t n = C[i];
+                                auto begin = POS.begin()+csum;
+                                auto end = begin + n;
+                                cd.offsets.push_back(plist_type::create(os,begin,end));
+                                csum += n;
+                            }
+                        }
+                        return cd;
+                    };
+                    auto chunks = partition_terms(C);
+                    auto commit = [&](const term_chunk& chunk,chunk_data& cd) {
+                        LOG_EVERY_N(std::max<size_t>(1,chunks.size()/10), INFO) << "Construct abspos lists " << chunk.begin << "-" << chunk.end << " of " << C.size();
+                        auto base = append_aligned(bvo,cd.data);
+                        for (size_t i=chunk.begin; i<chunk.end; i++) {
+                            m_meta_data[i].offset = base + cd.offsets[i-chunk.begin];
+                        }
+                    };
+                    encode_chunks(chunks,encode,commit);
                     // prepare input stream
                     m_is.refresh();
                 }
@@ -63,8 +85,7 @@ class index_abspos
                 m_dpm = doc_pos_mapper(col);
 
                 LOG(INFO) << "STORE to file '" << file_name << "'";
-                std::ofstream ofs(file_name);
-                auto bytes = serialize(ofs);
+                auto bytes = store_index_file(*this,file_name);
                 LOG(INFO) << "STORE space usage '" << file_name << ".html'";
                 std::ofstream vofs(file_name+".html");
                 sdsl::write_structure<sdsl::HTML_FORMAT>(vofs,*this,m_docidx);
@@ -78,27 +99,39 @@ class index_abspos
             written_bytes += sdsl::write_member(m_num_lists,out,child,"num plists");
 
             auto* listdata = sdsl::structure_tree::add_child(child, "list metadata","list metadata");
+            written_bytes += write_padding(out);
             out.write((const char*)m_meta_data.data(), m_meta_data.size()*sizeof(abs_metadata));
             written_bytes += m_meta_data.size()*sizeof(abs_metadata);
             sdsl::structure_tree::add_size(listdata, m_meta_data.size()*sizeof(abs_metadata));
 
-            written_bytes += m_data.serialize(out,child,"list data");
+            written_bytes += write_bit_data(m_data,out,child,"list data");
             written_bytes += m_dpm.serialize(out,child,"doc pos mapper");
             sdsl::structure_tree::add_size(child, written_bytes);
             return written_bytes;
         }
-        void load(std::ifstream& ifs)
+        void load(std::istream& in,const mmap_file* mapping = nullptr)
         {
-            sdsl::read_member(m_num_lists,ifs);
-            m_meta_data.resize(m_num_lists);
-            ifs.read((char*)m_meta_data.data(),m_num_lists*sizeof(abs_metadata));
-            m_data.load(ifs);
-            m_dpm.load(ifs);
+            sdsl::read_member(m_num_lists,in);
+            skip_padding(in);
+            m_meta_data.load(in,m_num_lists,mapping);
+            load_bit_data(in,m_data,m_is,mapping);
+            m_dpm.load(in);
+        }
+        // length of the text including the document separators
+        size_type text_size() const
+        {
+            return m_dpm.m_doc_border.size();
+        }
+        size_type num_docs() const
+        {
+            return m_dpm.map_to_id(text_size());
         }
         typename plist_type::list_type
         list(size_t i) const
         {
-            return plist_type::materialize(m_is,m_meta_data[i].offset);
+            // private cursor, the index may be queried by several threads
+            bit_istream is(m_is);
+            return plist_type::materialize(is,m_meta_data[i].offset);
         }
         typename doclist_type::list_type
         doc_list(size_t i) const
@@ -114,8 +147,9 @@ class index_abspos
             }
             return lists;
         }
+        template<class t_strategy=intersect_lazy>
         docfreq_result
-        phrase_list(std::vector<uint64_t> ids) const
+        phrase_list(std::vector<uint64_t> ids,size_t k = no_result_limit) const
         {
             std::vector<typename plist_type::list_type> plists;
             std::vector<offset_proxy_list<typename plist_type::list_type>> lists;
@@ -124,10 +158,11 @@ class index_abspos
                 plists.emplace_back(list(id));
                 lists.emplace_back(offset_proxy_list<typename plist_type::list_type>(plists.back(),i++));
             }
-            return map_to_doc_ids(pos_intersect(lists));
+            return map_to_doc_ids(t_strategy::pos_intersect(lists),k);
         }
+        template<class t_strategy=intersect_daat>
         intersection_result
-        phrase_positions(std::vector<uint64_t> ids) const
+        phrase_positions(std::vector<uint64_t> ids,size_t limit = no_result_limit) const
         {
             std::vector<typename plist_type::list_type> plists;
             std::vector<offset_proxy_list<typename plist_type::list_type>> lists;
@@ -136,24 +171,56 @@ class index_abspos
                 plists.emplace_back(list(id));
                 lists.emplace_back(offset_proxy_list<typename plist_type::list_type>(plists.back(),i++));
             }
-            return pos_intersect(lists);
+            return pos_intersect<t_strategy>(lists,limit);
         }
-        intersection_result
-        doc_intersection(std::vector<uint64_t> ids) const
+        // the phrase positions of a batch of queries, group_size of them interleaved
+        std::vector<intersection_result>
+        batch_phrase_positions(const std::vector<std::vector<uint64_t>>& queries,size_t group_size = default_batch_group_size,
+                               size_t limit = no_result_limit) const
         {
-            std::vector<typename doclist_type::list_type> lists;
-            for (const auto& id : ids) {
-                lists.emplace_back(doc_list(id));
+            using list_type = offset_proxy_list<typename plist_type::list_type>;
+            batch_intersection<list_type> batch;
+            for (const auto& ids : queries) {
+                std::vector<list_type> lists;
+                size_type i = 0;
+                for (const auto& id : ids) {
+                    auto plist = list(id);
+                    lists.emplace_back(list_type(plist,i++));
+                }
+                batch.add_pos(lists,limit);
             }
-            return m_docidx.intersection(ids);
+            return batch.run(group_size);
+        }
+        // the first k documents containing the phrase of each query
+        std::vector<docfreq_result>
+        batch_phrase_list(const std::vector<std::vector<uint64_t>>& queries,size_t group_size = default_batch_group_size,
+                          size_t k = no_result_limit) const
+        {
+            std::vector<docfreq_result> res;
+            for (const auto& positions : batch_phrase_positions(queries,group_size)) {
+                res.emplace_back(map_to_doc_ids(positions,k));
+            }
+            return res;
+        }
+        intersection_result
+        doc_intersection(std::vector<uint64_t> ids,size_t limit = no_result_limit) const
+        {
+            return m_docidx.intersection(ids,limit);
+        }
+        // top-k documents ranked by the scores of the document index
+        topk_result
+        doc_topk(std::vector<uint64_t> ids,size_t k) const
+        {
+            return m_docidx.topk(ids,k);
         }
         template<class t_list>
         docfreq_result
-        map_to_doc_ids(const t_list& list) const
+        map_to_doc_ids(const t_list& list,size_t k = no_result_limit) const
         {
             docfreq_result res;
             auto itr = list.begin();
             auto end = list.end();
+            if (itr == end || k == 0) return res;
             auto prev_docid = m_dpm.map_to_id(*itr);
             //std::cout << "pos = " << *itr << " docid = " << doc_id << std::endl;
             ++itr;
@@ -164,6 +231,7 @@ class index_abspos
                 //std::cout << "pos = " << pos << " docid = " << doc_id << std::endl;
                 if (doc_id != prev_docid) {
                     res.emplace_back(prev_docid,freq);
+                    if (res.size() == k) return res;
                     freq = 1;
                     prev_docid = doc_id;
                 } else {
@@ -0,0 +1,220 @@
+#pragma once
+
+#include "list_types.hpp"
+#include "index_invidx.hpp"
+#include "index_abspos.hpp"
+
+#include "easylogging++.h"
+
+#include <sdsl/sd_vector.hpp>
+
+/* the cover of a phrase of m terms by 2-token lists and term lists, from
+   left to right. (i,true) is the 2-token list of the terms i and i+1,
+   (i,false) the list of term i. stored(i) tells whether the 2-token list
+   of the terms i and i+1 is stored. a last term which is left over
+   overlaps with the 2-token list before it if that list is stored. */
+template<class t_stored>
+std::vector<std::pair<size_t,bool>>
+hybrid_phrase_cover(size_t m,t_stored stored)
+{
+    std::vector<std::pair<size_t,bool>> cover;
+    size_t i = 0;
+    while (i < m) {
+        if (i+1 < m && stored(i)) {
+            cover.emplace_back(i,true);
+            i += 2;
+        } else if (i+1 == m && i > 0 && stored(i-1)) {
+            cover.emplace_back(i-1,true);
+            i++;
+        } else {
+            cover.emplace_back(i,false);
+            i++;
+        }
+    }
+    return cover;
+}
+
+/* abspos index which additionally stores the nextword lists of the 2-tokens
+   whose terms both occur at least t_min_list_size times. the list of such
+   a 2-token is much shorter than the term lists it replaces in the
+   intersection. the 2-tokens of rare terms are not stored, intersecting
+   their short term lists is about as fast. t_min_list_size = 0 stores all
+   2-tokens as index_nextword does, larger values trade phrase latency for
+   a smaller index. */
+template<class t_pospl=optpfor_list<128,true>,class t_invidx = index_invidx<>,uint64_t t_min_list_size = 65536>
+class index_hybrid_nextword
+{
+    public:
+        using size_type = sdsl::int_vector<>::size_type;
+        using plist_type = t_pospl;
+        using abspos_type = index_abspos<t_pospl,t_invidx>;
+        using doclist_type = typename abspos_type::doclist_type;
+        const std::string name = "HYBRIDNEXTWORD";
+        std::string file_name;
+    public:
+        abspos_type m_abspos;
+        size_t m_num_lists;
+        sdsl::sd_vector<> m_meta_data;
+        sdsl::select_support_sd<> m_meta_data_access;
+        sdsl::bit_vector m_data;
+        sdsl::sd_vector<> m_mapper;
+        sdsl::rank_support_sd<> m_mapper_access;
+        uint64_t m_sym_width;
+        bit_istream m_is;
+        std::shared_ptr<mmap_file> m_mapping;
+    public:
+        index_hybrid_nextword(collection& col,const index_load_options& opts = index_load_options())
+            : m_abspos(col,opts), m_is(m_data)
+        {
+            file_name = col.path +"index/"+name+"-"+sdsl::util::class_to_hash(*this)+".idx";
+            if (utils::file_exists(file_name)) {  // load
+                LOG(INFO) << "LOAD from file '" << file_name << "'";
+                m_mapping = load_index_file(*this,file_name,opts);
+                m_num_lists = m_mapper.size() ? m_mapper_access(m_mapper.size()) : 0;
+            } else { // construct
+                LOG(INFO) << "CONSTRUCT hybrid nextword index (min list size " << t_min_list_size << ")";
+                std::vector<uint64_t> meta_data;
+                std::vector<uint64_t> pairs;
+                {
+                    bit_ostream bvo(m_data);
+                    {
+                        const sdsl::int_vector_mapper<0,std::ios_base::in> text(col.file_map[KEY_TEXT]);
+                        m_sym_width = text.width();
+                    }
+                    const sdsl::int_vector_mapper<0,std::ios_base::in> SA(col.file_map[KEY_SA]);
+                    const sdsl::int_vector_mapper<0,std::ios_base::in> CC(col.file_map[KEY_CC]);
+                    const sdsl::int_vector_mapper<0,std::ios_base::in> SCC(col.file_map[KEY_SCC]);
+                    const sdsl::int_vector_mapper<0,std::ios_base::in> C(col.file_map[KEY_C]);
+                    uint64_t sym_mask = sdsl::bits::lo_set[m_sym_width];
+                    size_t csum = 1; // skip 0
+                    size_t skipped_postings = 0;
+                    for (size_t i=0; i<CC.size(); i++) {
+                        size_t n = SCC[i];
+                        uint64_t id1 = CC[i] >> m_sym_width;
+                        uint64_t id2 = CC[i] & sym_mask;
+                        uint64_t min_list_size = std::min<uint64_t>(C[id1],C[id2]);
+                        if (min_list_size >= t_min_list_size) {
+                            auto begin = SA.begin()+csum;
+                            auto end = begin + n;
+                            LOG_EVERY_N(250000, INFO) << "Construct hybrid nextword list " << i << " (" << n << ")";
+                            std::vector<uint64_t> tmp(begin,end);
+                            std::sort(tmp.begin(),tmp.end());
+                            meta_data.push_back(plist_type::create(bvo,tmp.begin(),tmp.end()));
+                            pairs.push_back(CC[i]);
+                        } else {
+                            skipped_postings += n;
+                        }
+                        csum += n;
+                    }
+                    m_num_lists = pairs.size();
+                    LOG(INFO) << "stored " << pairs.size() << " of " << CC.size() << " 2-token lists, "
+                              << skipped_postings << " of " << csum-1 << " postings are left to the term lists";
+                }
+                m_is.refresh(); // init input stream
+
+                m_meta_data = sdsl::sd_vector<>(meta_data.begin(),meta_data.end());
+                m_meta_data_access.set_vector(&m_meta_data);
+
+                // mapping of the stored 2-tokens to list positions
+                m_mapper = sdsl::sd_vector<>(pairs.begin(),pairs.end());
+                m_mapper_access.set_vector(&m_mapper);
+
+                LOG(INFO) << "STORE to file '" << file_name << "'";
+                auto bytes = store_index_file(*this,file_name);
+                LOG(INFO) << "STORE space usage '" << file_name << ".html'";
+                std::ofstream vofs(file_name+".html");
+                sdsl::write_structure<sdsl::HTML_FORMAT>(vofs,*this);
+                LOG(INFO) << "hybrid nextword index size : " << bytes / (1024*1024) << " MB (without the abspos index)";
+            }
+        }
+        size_type serialize(std::ostream& out, sdsl::structure_tree_node* v=NULL, std::string name="") const
+        {
+            sdsl::structure_tree_node* child = sdsl::structure_tree::add_child(v, name, sdsl::util::class_name(*this));
+            size_type written_bytes = 0;
+            written_bytes += sdsl::write_member(m_sym_width,out,child,"sym width");
+            written_bytes += m_meta_data.serialize(out,child,"list metadata");
+            written_bytes += m_mapper.serialize(out,child,"phrase mapper");
+            written_bytes += write_bit_data(m_data,out,child,"list data");
+            sdsl::structure_tree::add_size(child, written_bytes);
+            return written_bytes;
+        }
+        // the sd_vector metadata is copied, the list data is used in place
+        void load(std::istream& in,const mmap_file* mapping = nullptr)
+        {
+            sdsl::read_member(m_sym_width,in);
+            m_meta_data.load(in);
+            m_meta_data_access.set_vector(&m_meta_data);
+            m_mapper.load(in);
+            m_mapper_access.set_vector(&m_mapper);
+            load_bit_data(in,m_data,m_is,mapping);
+        }
+        // is the 2-token list of id1 id2 stored
+        bool exists(uint64_t id1,uint64_t id2) const
+        {
+            uint64_t id = (id1 << m_sym_width) + id2;
+            return (id < m_mapper.size() && m_mapper[id] == 1);
+        }
+        // the 2-token list of id1 id2, it has to be stored
+        typename plist_type::list_type
+        list(uint64_t id1,uint64_t id2) const
+        {
+            uint64_t id = (id1 << m_sym_width) + id2;
+            auto list_number = m_mapper_access(id);
+            auto data_offset = m_meta_data_access(list_number+1);
+            // private cursor, the index may be queried by several threads
+            bit_istream is(m_is);
+            return plist_type::materialize(is,data_offset);
+        }
+        typename plist_type::list_type
+        list(size_t i) const
+        {
+            return m_abspos.list(i);
+        }
+        typename doclist_type::list_type
+        doc_list(size_t i) const
+        {
+            return m_abspos.doc_list(i);
+        }
+        std::vector<typename doclist_type::list_type>
+        doc_lists(std::vector<uint64_t> ids) const
+        {
+            return m_abspos.doc_lists(ids);
+        }
+        // the lists intersected for the phrase, see hybrid_phrase_cover
+        std::vector<offset_proxy_list<typename plist_type::list_type>>
+        phrase_lists(const std::vector<uint64_t>& ids) const
+        {
+            std::vector<offset_proxy_list<typename plist_type::list_type>> lists;
+            auto cover = hybrid_phrase_cover(ids.size(),[&](size_t i) {
+                return exists(ids[i],ids[i+1]);
+            });
+            for (const auto& c : cover) {
+                auto plist = c.second ? list(ids[c.first],ids[c.first+1]) : list(ids[c.first]);
+                lists.emplace_back(plist,c.first);
+            }
+            return lists;
+        }
+        template<class t_strategy=intersect_lazy>
+        docfreq_result
+        phrase_list(std::vector<uint64_t> ids,size_t k = no_result_limit) const
+        {
+            return m_abspos.map_to_doc_ids(t_strategy::pos_intersect(phrase_lists(ids)),k);
+        }
+        template<class t_strategy=intersect_daat>
+        intersection_result
+        phrase_positions(std::vector<uint64_t> ids,size_t limit = no_result_limit) const
+        {
+            return pos_intersect<t_strategy>(phrase_lists(ids),limit);
+        }
+        intersection_result
+        doc_intersection(std::vector<uint64_t> ids,size_t limit = no_result_limit) const
+        {
+            return m_abspos.doc_intersection(ids,limit);
+        }
+        template<class t_list>
+        docfreq_result
+        map_to_doc_ids(const t_list& list,size_t k = no_result_limit) const
+        {
+            return m_abspos.map_to_doc_ids(list,k);
+        }
+};
@@ -4,6 +4,10 @@
 #include "rank_functions.hpp"
 #include "range_iterators.hpp"
 #include "intersection.hpp"
+#include "batch_intersection.hpp"
+#include "wand.hpp"
+#include "mmap_file.hpp"
+#include "parallel_construction.hpp"
 
 #include "easylogging++.h"
 
@@ -11,6 +15,7 @@
 struct list_metadata {
     uint64_t id_offset;
     uint64_t freq_offset;
+    uint8_t id_codec; // codec of the id list if the list type picks one per list
 };
 
 #pragma pack(1)
@@ -21,7 +26,8 @@ struct wand_metadata {
 
 template<class t_pl_ids=optpfor_list<128,true>,
          class t_pl_freqs=optpfor_list<128,false>,
-         class t_rank=rank_bm25<>>
+         class t_rank=rank_bm25<>,
+         uint16_t t_bm_block_size=0> // 0 = no block max scores
 class index_invidx
 {
     public:
@@ -33,17 +39,20 @@ class index_invidx
         std::string file_name;
     private:
         size_t m_num_lists;
-        std::vector<list_metadata> m_meta_data;
-        std::vector<wand_metadata> m_wand_data;
+        mappable_vector<list_metadata> m_meta_data;
+        mappable_vector<wand_metadata> m_wand_data;
+        mappable_vector<uint64_t> m_block_max_offsets;
+        mappable_vector<block_max_metadata> m_block_max_data;
         sdsl::bit_vector m_id_data;
         sdsl::bit_vector m_freq_data;
         rank_type m_ranker;
         doc_perm m_dp;
         bit_istream m_isi;
         bit_istream m_isf;
+        std::shared_ptr<mmap_file> m_mapping;
     private:
         template<class t_itr,class t_fitr>
-        wand_metadata create_wand_data(t_itr ibegin,t_itr iend,t_fitr fbegin,t_fitr fend)
+        wand_metadata create_wand_data(t_itr ibegin,t_itr iend,t_fitr fbegin,t_fitr fend) const
         {
             wand_metadata wm {0.0,0.0};
             auto F_t = std::accumulate(fbegin,fend,0);
@@ -62,14 +71,52 @@ class index_invidx
             }
             return wm;
         }
+        template<class t_itr,class t_fitr>
+        void create_block_max_data(t_itr ibegin,t_itr iend,t_fitr fbegin,t_fitr fend,
+                                   std::vector<block_max_metadata>& block_max_data) const
+        {
+            auto F_t = std::accumulate(fbegin,fend,0);
+            auto f_t = std::distance(ibegin,iend);
+            size_t i = 0;
+            block_max_metadata bm {0,0.0f};
+            double block_max = 0.0;
+            while (ibegin != iend) {
+                auto id = *ibegin;
+                auto f_dt = *fbegin;
+                double W_d = m_ranker.doc_length(id);
+                double score = m_ranker.calculate_docscore(1.0f,f_dt,f_t,F_t,W_d,true);
+                block_max = std::max(block_max,score);
+                ++ibegin;
+                ++fbegin;
+                if (++i % t_bm_block_size == 0 || ibegin == iend) {
+                    bm.last_id = id;
+                    // round up so the stored value is still an upper bound
+                    bm.max_score = block_max;
+                    if (bm.max_score < block_max) bm.max_score = std::nextafter(bm.max_score,std::numeric_limits<float>::max());
+                    block_max_data.push_back(bm);
+                    block_max = 0.0;
+                }
+            }
+        }
+        std::vector<std::pair<uint64_t,size_t>> query_terms(std::vector<uint64_t> ids) const
+        {
+            // repeated query terms become a single term with f_qt > 1
+            std::sort(ids.begin(),ids.end());
+            std::vector<std::pair<uint64_t,size_t>> terms;
+            for (size_t i=0; i<ids.size(); i++) {
+                if (i && ids[i] == ids[i-1]) terms.back().second++;
+                else terms.emplace_back(ids[i],1);
+            }
+            return terms;
+        }
     public:
-        index_invidx(collection& col) : m_isi(m_id_data), m_isf(m_freq_data)
+        index_invidx(collection& col,const index_load_options& opts = index_load_options())
+            : m_isi(m_id_data), m_isf(m_freq_data)
         {
             file_name = col.path +"index/"+name+"-"+sdsl::util::class_to_hash(*this)+".idx";
             if (utils::file_exists(file_name)) {  // load
                 LOG(INFO) << "LOAD from file '" << file_name << "'";
-                std::ifstream ifs(file_name);
-                load(ifs);
+                m_mapping = load_index_file(*this,file_name,opts);
             } else { // construct
                 // (1) ranker loads doc lengths
                 m_ranker = t_rank(col);
@@ -85,36 +132,83 @@ class index_invidx
                     m_num_lists = C.size();
                     m_meta_data.resize(m_num_lists);
                     m_wand_data.resize(m_num_lists);
-                    size_t csum = C[0] + C[1];
-                    for (size_t i=2; i<C.size(); i++) {
-                        size_t n = C[i];
-                        LOG_EVERY_N(C.size()/10, INFO) << "Construct invidx list " << i << " (" << n << ")";
-                        std::vector<uint32_t> tmp(D.begin()+csum,D.begin()+csum+ n);
-                        std::sort(tmp.begin(),tmp.end());
-
-                        using itr_type = std::vector<uint32_t>::const_iterator;
-                        id_range_adaptor<itr_type> id_range(tmp.begin(),tmp.end());
-                        freq_range_adaptor<itr_type> freq_range(tmp.begin(),tmp.end());
-
-                        // (a) ids
-                        m_meta_data[i].id_offset = id_list_type::create(bvi,id_range.begin(),id_range.end());
-                        // (b) freqs
-                        m_meta_data[i].freq_offset = freq_list_type::create(bvf,freq_range.begin(),freq_range.end());
-
-                        // (c) wand data
-                        m_wand_data[i] = create_wand_data(id_range.begin(),id_range.end(),freq_range.begin(),freq_range.end());
-
-                        csum += n;
-                    }
+                    if (t_bm_block_size) m_block_max_offsets.resize(m_num_lists+1,0);
+                    // the terms are encoded in chunks by the workers of the thread pool
+                    struct chunk_data {
+                        sdsl::bit_vector id_data;
+                        sdsl::bit_vector freq_data;
+                        std::vector<list_metadata> meta_data;
+                        std::vector<wand_metadata> wand_data;
+                        std::vector<uint64_t> block_max_offsets;
+                        std::vector<block_max_metadata> block_max_data;
+                    };
+                    auto encode = [&](const term_chunk& chunk) {
+                        chunk_data cd;
+                        {
+                            bit_ostream ci(cd.id_data);
+                            bit_ostream cf(cd.freq_data);
+                            size_t csum = chunk.first_posting;
+                            for (size_t i=chunk.begin; i<chunk.end; i++) {
+                                size_t n = C[i];
+                                std::vector<uint32_t> tmp(D.begin()+csum,D.begin()+csum+ n);
+                                std::sort(tmp.begin(),tmp.end());
+
+                                using itr_type = std::vector<uint32_t>::const_iterator;
+                                id_range_adaptor<itr_type> id_range(tmp.begin(),tmp.end());
+                                freq_range_adaptor<itr_type> freq_range(tmp.begin(),tmp.end());
+
+                                // (a) ids
+                                list_metadata lm;
+                                lm.id_offset = create_list<id_list_type>(ci,id_range.begin(),id_range.end(),lm.id_codec);
+                                // (b) freqs
+                                lm.freq_offset = freq_list_type::create(cf,freq_range.begin(),freq_range.end());
+                                cd.meta_data.push_back(lm);
+
+                                // (c) wand data
+                                cd.wand_data.push_back(create_wand_data(id_range.begin(),id_range.end(),freq_range.begin(),freq_range.end()));
+
+                                // (d) block max data
+                                if (t_bm_block_size) {
+                                    cd.block_max_offsets.push_back(cd.block_max_data.size());
+                                    create_block_max_data(id_range.begin(),id_range.end(),freq_range.begin(),freq_range.end(),cd.block_max_data);
+                                }
+                                csum += n;
+                            }
+                        }
+                        return cd;
+                    };
+                    // (e) append the chunk and rebase its offsets
+                    auto chunks = partition_terms(C);
+                    auto commit = [&](const term_chunk& chunk,chunk_data& cd) {
+                        LOG_EVERY_N(std::max<size_t>(1,chunks.size()/10), INFO) << "Construct invidx lists " << chunk.begin << "-" << chunk.end << " of " << C.size();
+                        auto id_base = append_aligned(bvi,cd.id_data);
+                        auto freq_base = append_aligned(bvf,cd.freq_data);
+                        for (size_t i=chunk.begin; i<chunk.end; i++) {
+                            const auto& lm = cd.meta_data[i-chunk.begin];
+                            m_meta_data[i].id_offset = id_base + lm.id_offset;
+                            m_meta_data[i].freq_offset = freq_base + lm.freq_offset;
+                            m_meta_data[i].id_codec = lm.id_codec;
+                            m_wand_data[i] = cd.wand_data[i-chunk.begin];
+                            if (t_bm_block_size) {
+                                m_block_max_offsets[i] = m_block_max_data.size() + cd.block_max_offsets[i-chunk.begin];
+                            }
+                        }
+                        if (t_bm_block_size) {
+                            for (const auto& bm : cd.block_max_data) m_block_max_data.push_back(bm);
+                            m_block_max_offsets[chunk.end] = m_block_max_data.size();
+                        }
+                    };
+                    encode_chunks(chunks,encode,commit);
+                    size_t csum = 0;
+                    for (size_t i=0; i<C.size(); i++) csum += C[i];
                     LOG(INFO) << "Number of terms: " << C.size()-2;
-                    LOG(INFO) << "Number of postings: " << csum - C[0] + C[1];
+                    LOG(INFO) << "Number of postings: " << csum - C[0] - C[1];
                 }
                 // prepare input streams
                 m_isi.refresh(); m_isf.refresh();
 
                 LOG(INFO) << "STORE to file '" << file_name << "'";
-                std::ofstream ofs(file_name);
-                auto bytes = serialize(ofs);
+                auto bytes = store_index_file(*this,file_name);
                 std::ofstream vofs(file_name+".html");
                 sdsl::write_structure<sdsl::HTML_FORMAT>(vofs,*this);
 
@@ -130,49 +224,131 @@ class index_invidx
             written_bytes += m_dp.serialize(out,child,"doc_perm");
 
             auto* wanddata = sdsl::structure_tree::add_child(child, "wand metadata","wand metadata");
+            written_bytes += write_padding(out);
             out.write((const char*)m_wand_data.data(), m_wand_data.size()*sizeof(wand_metadata));
             written_bytes += m_wand_data.size()*sizeof(wand_metadata);
             sdsl::structure_tree::add_size(wanddata, m_wand_data.size()*sizeof(wand_metadata));
 
+            if (t_bm_block_size) {
+                auto* bmdata = sdsl::structure_tree::add_child(child, "block max metadata","block max metadata");
+                uint64_t num_blocks = m_block_max_data.size();
+                written_bytes += sdsl::write_member(num_blocks,out,bmdata,"num blocks");
+                written_bytes += write_padding(out);
+                out.write((const char*)m_block_max_offsets.data(), m_block_max_offsets.size()*sizeof(uint64_t));
+                written_bytes += write_padding(out);
+                out.write((const char*)m_block_max_data.data(), m_block_max_data.size()*sizeof(block_max_metadata));
+                written_bytes += block_max_size_in_bytes();
+                sdsl::structure_tree::add_size(bmdata, block_max_size_in_bytes());
+            }
+
             auto* listdata = sdsl::structure_tree::add_child(child, "list metadata","list metadata");
+            written_bytes += write_padding(out);
             out.write((const char*)m_meta_data.data(), m_meta_data.size()*sizeof(list_metadata));
             written_bytes += m_meta_data.size()*sizeof(list_metadata);
             sdsl::structure_tree::add_size(listdata, m_meta_data.size()*sizeof(list_metadata));
 
-            written_bytes += m_id_data.serialize(out,child,"id data");
-            written_bytes += m_freq_data.serialize(out,child,"freq data");
+            written_bytes += write_bit_data(m_id_data,out,child,"id data");
+            written_bytes += write_bit_data(m_freq_data,out,child,"freq data");
 
             sdsl::structure_tree::add_size(child, written_bytes);
             return written_bytes;
         }
-        void load(std::ifstream& ifs)
+        /* with a mapping the metadata and the postings are used in place
+           from the mapped file instead of being copied into memory */
+        void load(std::istream& in,const mmap_file* mapping = nullptr)
         {
-            sdsl::read_member(m_num_lists,ifs);
-            m_ranker.load(ifs);
-            m_dp.load(ifs);
-            m_wand_data.resize(m_num_lists);
-            ifs.read((char*)m_wand_data.data(),m_num_lists*sizeof(wand_metadata));
-            m_meta_data.resize(m_num_lists);
-            ifs.read((char*)m_meta_data.data(),m_num_lists*sizeof(list_metadata));
-            m_id_data.load(ifs);
-            m_freq_data.load(ifs);
-            m_isi.refresh();
-            m_isf.refresh();
+            sdsl::read_member(m_num_lists,in);
+            m_ranker.load(in);
+            m_dp.load(in);
+            skip_padding(in);
+            m_wand_data.load(in,m_num_lists,mapping);
+            if (t_bm_block_size) {
+                uint64_t num_blocks;
+                sdsl::read_member(num_blocks,in);
+                skip_padding(in);
+                m_block_max_offsets.load(in,m_num_lists+1,mapping);
+                skip_padding(in);
+                m_block_max_data.load(in,num_blocks,mapping);
+            }
+            skip_padding(in);
+            m_meta_data.load(in,m_num_lists,mapping);
+            load_bit_data(in,m_id_data,m_isi,mapping);
+            load_bit_data(in,m_freq_data,m_isf,mapping);
         }
         std::pair<typename id_list_type::list_type,typename freq_list_type::list_type>
         list(size_t i) const
         {
-            return make_pair(id_list_type::materialize(m_isi,m_meta_data[i].id_offset),
-                             freq_list_type::materialize(m_isf,m_meta_data[i].freq_offset)
+            // private cursors, the index may be queried by several threads
+            bit_istream isi(m_isi);
+            bit_istream isf(m_isf);
+            return make_pair(materialize_list<id_list_type>(isi,m_meta_data[i].id_offset,m_meta_data[i].id_codec),
+                             freq_list_type::materialize(isf,m_meta_data[i].freq_offset)
                             );
         }
+        template<class t_strategy=intersect_adaptive>
         intersection_result
-        intersection(std::vector<uint64_t> ids) const
+        intersection(std::vector<uint64_t> ids,size_t limit = no_result_limit) const
         {
             std::vector<typename id_list_type::list_type> lists;
+            bit_istream isi(m_isi);
             for (const auto& id : ids) {
-                lists.emplace_back(id_list_type::materialize(m_isi,m_meta_data[id].id_offset));
+                lists.emplace_back(materialize_list<id_list_type>(isi,m_meta_data[id].id_offset,m_meta_data[id].id_codec));
             }
-            return intersect(lists);
+            return intersect<t_strategy>(lists,limit);
+        }
+        // the intersections of a batch of queries, group_size of them interleaved
+        std::vector<intersection_result>
+        batch_intersection(const std::vector<std::vector<uint64_t>>& queries,size_t group_size = default_batch_group_size,
+                           size_t limit = no_result_limit) const
+        {
+            ::batch_intersection<typename id_list_type::list_type> batch;
+            bit_istream isi(m_isi);
+            for (const auto& ids : queries) {
+                std::vector<typename id_list_type::list_type> lists;
+                for (const auto& id : ids) {
+                    lists.emplace_back(materialize_list<id_list_type>(isi,m_meta_data[id].id_offset,m_meta_data[id].id_codec));
+                }
+                batch.add(lists,limit);
+            }
+            return batch.run(group_size);
+        }
+        // top-k ranked (disjunctive) retrieval using WAND and the list max scores
+        topk_result
+        topk(std::vector<uint64_t> ids,size_t k) const
+        {
+            using cursor_type = wand_cursor<typename id_list_type::iterator_type,
+                  typename freq_list_type::iterator_type,rank_type>;
+            std::vector<cursor_type> cursors;
+            for (const auto& term : query_terms(ids)) {
+                auto lists = list(term.first);
+                cursors.emplace_back(lists.first.begin(),lists.first.end(),lists.second.begin(),
+                                     &m_ranker,term.second,m_wand_data[term.first].list_max_score);
+            }
+            return wand(cursors,k);
+        }
+        // top-k ranked retrieval using Block-Max WAND and the block max scores
+        topk_result
+        topk_block_max(std::vector<uint64_t> ids,size_t k) const
+        {
+            static_assert(t_bm_block_size != 0,"index has no block max scores.");
+            using cursor_type = block_max_cursor<typename id_list_type::iterator_type,
+                  typename freq_list_type::iterator_type,rank_type>;
+            std::vector<cursor_type> cursors;
+            for (const auto& term : query_terms(ids)) {
+                auto lists = list(term.first);
+                auto bm_offset = m_block_max_offsets[term.first];
+                cursors.emplace_back(lists.first.begin(),lists.first.end(),lists.second.begin(),
+                                     &m_ranker,term.second,m_wand_data[term.first].list_max_score,
+                                     m_block_max_data.data()+bm_offset,m_block_max_offsets[term.first+1]-bm_offset);
+            }
+            return block_max_wand(cursors,k);
+        }
+        size_type num_docs() const
+        {
+            return m_ranker.num_docs;
+        }
+        size_type block_max_size_in_bytes() const
+        {
+            return m_block_max_offsets.size()*sizeof(uint64_t)+m_block_max_data.size()*sizeof(block_max_metadata);
         }
 };
@@ -30,8 +30,10 @@ class index_relnextword
         doc_pos_mapper m_dpm;
         uint64_t m_sym_width;
         bit_istream m_is;
+        std::shared_ptr<mmap_file> m_mapping;
     public:
-        index_relnextword(collection& col) : m_docidx(col), m_is(m_data)
+        index_relnextword(collection& col,const index_load_options& opts = index_load_options())
+            : m_docidx(col,opts), m_is(m_data)
         {
             file_name = col.path +"index/"+name+"-"+sdsl::util::class_to_hash(*this)+".idx";
             if (utils::file_exists(file_name)) {  // load
@@ -40,8 +42,7 @@ class index_relnextword
                     const sdsl::int_vector_mapper<0,std::ios_base::in> CC(col.file_map[KEY_CC]);
                     m_num_lists = CC.size();
                 }
-                std::ifstream ifs(file_name);
-                load(ifs);
+                m_mapping = load_index_file(*this,file_name,opts);
             } else { // construct
                 LOG(INFO) << "CONSTRUCT rel nextword index";
                 // (1) create doc pos mapper
@@ -116,8 +117,7 @@ class index_relnextword
 
                 // (5) write
                 LOG(INFO) << "STORE to file '" << file_name << "'";
-                std::ofstream ofs(file_name);
-                auto bytes = serialize(ofs);
+                auto bytes = store_index_file(*this,file_name);
                 LOG(INFO) << "STORE space usage '" << file_name << ".html'";
                 std::ofstream vofs(file_name+".html");
                 sdsl::write_structure<sdsl::HTML_FORMAT>(vofs,*this,m_docidx);
@@ -131,21 +131,21 @@ class index_relnextword
             written_bytes += sdsl::write_member(m_sym_width,out,child,"sym width");
             written_bytes += m_meta_data.serialize(out,child,"list metadata");
             written_bytes += m_mapper.serialize(out,child,"phrase mapper");
-            written_bytes += m_data.serialize(out,child,"list data");
+            written_bytes += write_bit_data(m_data,out,child,"list data");
             written_bytes += m_dpm.serialize(out,child,"doc pos mapper");
             sdsl::structure_tree::add_size(child, written_bytes);
             return written_bytes;
         }
-        void load(std::ifstream& ifs)
+        // the sd_vector metadata is copied, the list data is used in place
+        void load(std::istream& in,const mmap_file* mapping = nullptr)
         {
-            sdsl::read_member(m_sym_width,ifs);
-            m_meta_data.load(ifs);
+            sdsl::read_member(m_sym_width,in);
+            m_meta_data.load(in);
             m_meta_data_access.set_vector(&m_meta_data);
-            m_mapper.load(ifs);
+            m_mapper.load(in);
             m_mapper_access.set_vector(&m_mapper);
-            m_data.load(ifs);
-            m_dpm.load(ifs);
-            m_is.refresh(); // init input stream
+            load_bit_data(in,m_data,m_is,mapping);
+            m_dpm.load(in);
         }
         bool exists(uint64_t id1,uint64_t id2) const
         {
@@ -167,7 +167,9 @@ class index_relnextword
         {
             auto list_number = m_mapper_access(id);
             auto data_offset = m_meta_data_access(list_number+1);
-            return plist_type::materialize(m_is,data_offset);
+            // private cursor, the index may be queried by several threads
+            bit_istream is(m_is);
+            return plist_type::materialize(is,data_offset);
         }
         typename doclist_type::list_type
         doc_list(size_t i) const
@@ -184,10 +186,10 @@ class index_relnextword
             return lists;
         }
         docfreq_result
-        phrase_list(std::vector<uint64_t> ids) const
+        phrase_list(std::vector<uint64_t> ids,size_t k = no_result_limit) const
         {
             if (ids.size() == 2) {
-                return map_to_doc_ids(list(ids[0],ids[1]));
+                return map_to_doc_ids(list(ids[0],ids[1]),k);
             }
             std::vector<typename plist_type::list_type> plists;
             std::vector<offset_proxy_list<typename plist_type::list_type>> lists;
@@ -201,19 +203,18 @@ class index_relnextword
                 plists.emplace_back(list(ids[ids.size()-2],ids[ids.size()-1]));
                 lists.emplace_back(offset_proxy_list<typename plist_type::list_type>(plists.back(),ids.size()-2));
             }
-            auto res = pos_intersect(lists);
-            return map_to_doc_ids(res);
+            return map_to_doc_ids(lazy_pos_intersect(lists),k);
         }
         intersection_result
-        phrase_positions(std::vector<uint64_t> ids) const
+        phrase_positions(std::vector<uint64_t> ids,size_t limit = no_result_limit) const
         {
             if (ids.size() == 2) {
                 auto lst = list(ids[0],ids[1]);
-                intersection_result res(lst.size());
+                intersection_result res(std::min(lst.size(),limit));
                 auto itr = lst.begin();
                 auto end = lst.end();
                 size_t n=0;
-                while (itr != end) {
+                while (n < res.size() && itr != end) {
                     res[n++] = *itr;
                     ++itr;
                 }
@@ -231,15 +232,16 @@ class index_relnextword
                 plists.emplace_back(list(ids[ids.size()-2],ids[ids.size()-1]));
                 lists.emplace_back(offset_proxy_list<typename plist_type::list_type>(plists.back(),ids.size()-2));
             }
-            return pos_intersect(lists);
+            return pos_intersect(lists,limit);
         }
         template<class t_list>
         docfreq_result
-        map_to_doc_ids(const t_list& list) const
+        map_to_doc_ids(const t_list& list,size_t k = no_result_limit) const
         {
             docfreq_result res;
             auto itr = list.begin();
             auto end = list.end();
+            if (itr == end || k == 0) return res;
             auto prev_docid = m_dpm.map_to_id(*itr);
             ++itr;
             size_t freq = 1;
@@ -248,6 +250,7 @@ class index_relnextword
                 auto doc_id = m_dpm.map_to_id(pos);
                 if (doc_id != prev_docid) {
                     res.emplace_back(prev_docid,freq);
+                    if (res.size() == k) return res;
                     freq = 1;
                     prev_docid = doc_id;
                 } else {
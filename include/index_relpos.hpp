@@ -24,18 +24,19 @@ class index_relpos
     public:
         invidx_type m_docidx;
         size_t m_num_lists;
-        std::vector<rel_metadata> m_meta_data;
+        mappable_vector<rel_metadata> m_meta_data;
         sdsl::bit_vector m_data;
         doc_pos_mapper m_dpm;
         bit_istream m_is;
+        std::shared_ptr<mmap_file> m_mapping;
     public:
-        index_relpos(collection& col) : m_docidx(col), m_is(m_data)
+        index_relpos(collection& col,const index_load_options& opts = index_load_options())
+            : m_docidx(col,opts), m_is(m_data)
         {
             file_name = col.path +"index/"+name+"-"+sdsl::util::class_to_hash(*this)+".idx";
             if (utils::file_exists(file_name)) {  // load
                 LOG(INFO) << "LOAD from file '" << file_name << "'";
-                std::ifstream ifs(file_name);
-                load(ifs);
+                m_mapping = load_index_file(*this,file_name,opts);
             } else { // construct
                 {
                     LOG(INFO) << "CONSTRUCT relpos index";
@@ -44,57 +45,75 @@ class index_relpos
 
                     // (3) pos index
                     bit_ostream bvo(m_data);
-                    sdsl::int_vector_mapper<> POS(col.file_map[KEY_POSPL]);
-                    sdsl::int_vector_mapper<> D(col.file_map[KEY_D]);
+                    const sdsl::int_vector_mapper<0,std::ios_base::in> POS(col.file_map[KEY_POSPL]);
+                    const sdsl::int_vector_mapper<0,std::ios_base::in> D(col.file_map[KEY_D]);
                     sdsl::bit_vector DBV;
                     sdsl::load_from_file(DBV,col.file_map[KEY_DBV]);
-                    sdsl::int_vector_mapper<> C(col.file_map[KEY_C]);
+                    const sdsl::int_vector_mapper<0,std::ios_base::in> C(col.file_map[KEY_C]);
                     m_num_lists = C.size();
                     m_meta_data.resize(m_num_lists);
-                    size_t csum = C[0] + C[1];
-                    for (size_t i=2; i<C.size(); i++) {
-                        size_t n = C[i];
-                        LOG_EVERY_N(C.size()/10, INFO) << "Construct relpos list " << i << " (" << n << ")";
-                        auto begin = POS.begin()+csum;
-                        auto end = begin + n;
-                        std::vector<uint64_t> rel_pos(n);
-                        std::copy(begin,end,rel_pos.begin());
-                        auto prev = 0ULL;
-
-                        auto first_one = 0ULL;
-                        if (DBV[0]==1) first_one = 0ULL;
-                        else first_one = sdsl::bits::next(DBV.data(),0ULL);
-                        auto prev_doc_id = D.size()+1;
-                        for (size_t j=0; j<rel_pos.size(); j++) {
-                            auto p = rel_pos[j];
-                            auto cur_doc_id = m_dpm.map_to_id(p);
-                            auto rpos = 0ULL;
-                            if (cur_doc_id != prev_doc_id) {
-                                // delta to the start of the doc
-                                if (p > first_one) {
-                                    auto one_pos = sdsl::bits::prev(DBV.data(),p);
-                                    rpos = p - (one_pos+1ULL);
-                                } else {
-                                    rpos = p;
+                    auto first_one = 0ULL;
+                    if (DBV[0]==1) first_one = 0ULL;
+                    else first_one = sdsl::bits::next(DBV.data(),0ULL);
+                    // the terms are encoded in chunks by the workers of the thread pool
+                    struct chunk_data {
+                        sdsl::bit_vector data;
+                        std::vector<uint64_t> offsets;
+                    };
+                    auto encode = [&](const term_chunk& chunk) {
+                        chunk_data cd;
+                        {
+                            bit_ostream os(cd.data);
+                            size_t csum = chunk.first_posting;
+                            for (size_t i=chunk.begin; i<chunk.end; i++) {
+                                size_t n = C[i];
+                                auto begin = POS.begin()+csum;
+                                auto end = begin + n;
+                                std::vector<uint64_t> rel_pos(n);
+                                std::copy(begin,end,rel_pos.begin());
+                                auto prev = 0ULL;
+                                auto prev_doc_id = D.size()+1;
+                                for (size_t j=0; j<rel_pos.size(); j++) {
+                                    auto p = rel_pos[j];
+                                    auto cur_doc_id = m_dpm.map_to_id(p);
+                                    auto rpos = 0ULL;
+                                    if (cur_doc_id != prev_doc_id) {
+                                        // delta to the start of the doc
+                                        if (p > first_one) {
+                                            auto one_pos = sdsl::bits::prev(DBV.data(),p);
+                                            rpos = p - (one_pos+1ULL);
+                                        } else {
+                                            rpos = p;
+                                        }
+                                    } else {
+                                        // delta to the prev item
+                                        rpos = p - prev;
+                                    }
+                                    rel_pos[j] = rpos;
+                                    prev = p;
+                                    prev_doc_id = cur_doc_id;
                                 }
-                            } else {
-                                // delta to the prev item
-                                rpos = p - prev;
+                                cd.offsets.push_back(plist_type::create(os,rel_pos.begin(),rel_pos.end()));
+                                csum += n;
                             }
-                            rel_pos[j] = rpos;
-                            prev = p;
-                            prev_doc_id = cur_doc_id;
                         }
-                        m_meta_data[i].offset = plist_type::create(bvo,rel_pos.begin(),rel_pos.end());
-                        csum += n;
-                    }
+                        return cd;
+                    };
+                    auto chunks = partition_terms(C);
+                    auto commit = [&](const term_chunk& chunk,chunk_data& cd) {
+                        LOG_EVERY_N(std::max<size_t>(1,chunks.size()/10), INFO) << "Construct relpos lists " << chunk.begin << "-" << chunk.end << " of " << C.size();
+                        auto base = append_aligned(bvo,cd.data);
+                        for (size_t i=chunk.begin; i<chunk.end; i++) {
+                            m_meta_data[i].offset = base + cd.offsets[i-chunk.begin];
+                        }
+                    };
+                    encode_chunks(chunks,encode,commit);
                     // prepare input stream
                     m_is.refresh();
                 }
 
                 LOG(INFO) << "STORE to file '" << file_name << "'";
-                std::ofstream ofs(file_name);
-                auto bytes = serialize(ofs);
+                auto bytes = store_index_file(*this,file_name);
                 LOG(INFO) << "STORE space usage '" << file_name << ".html'";
                 std::ofstream vofs(file_name+".html");
                 sdsl::write_structure<sdsl::HTML_FORMAT>(vofs,*this,m_docidx);
@@ -108,28 +127,30 @@ class index_relpos
             written_bytes += sdsl::write_member(m_num_lists,out,child,"num plists");
 
             auto* listdata = sdsl::structure_tree::add_child(child, "list metadata","list metadata");
+            written_bytes += write_padding(out);
             out.write((const char*)m_meta_data.data(), m_meta_data.size()*sizeof(rel_metadata));
             written_bytes += m_meta_data.size()*sizeof(rel_metadata);
             sdsl::structure_tree::add_size(listdata, m_meta_data.size()*sizeof(rel_metadata));
 
-            written_bytes += m_data.serialize(out,child,"list data");
+            written_bytes += write_bit_data(m_data,out,child,"list data");
             written_bytes += m_dpm.serialize(out,child,"doc pos mapper");
             sdsl::structure_tree::add_size(child, written_bytes);
             return written_bytes;
         }
-        void load(std::ifstream& ifs)
+        void load(std::istream& in,const mmap_file* mapping = nullptr)
         {
-            sdsl::read_member(m_num_lists,ifs);
-            m_meta_data.resize(m_num_lists);
-            ifs.read((char*)m_meta_data.data(),m_num_lists*sizeof(rel_metadata));
-            m_data.load(ifs);
-            m_dpm.load(ifs);
-            m_is.refresh();
+            sdsl::read_member(m_num_lists,in);
+            skip_padding(in);
+            m_meta_data.load(in,m_num_lists,mapping);
+            load_bit_data(in,m_data,m_is,mapping);
+            m_dpm.load(in);
         }
         typename plist_type::list_type
         list(size_t i) const
         {
-            return plist_type::materialize(m_is,m_meta_data[i].offset);
+            // private cursor, the index may be queried by several threads
+            bit_istream is(m_is);
+            return plist_type::materialize(is,m_meta_data[i].offset);
         }
         typename doclist_type::list_type
         doc_list(size_t i) const
@@ -146,22 +167,23 @@ class index_relpos
             return lists;
         }
         intersection_result
-        phrase_list(std::vector<uint64_t> ids) const
+        phrase_list(std::vector<uint64_t> ids,size_t k = no_result_limit) const
         {
             std::vector<offset_proxy_list<typename plist_type::list_type>> lists;
             size_type i = 0;
             for (const auto& id : ids) {
                 lists.emplace_back(offset_proxy_list<typename plist_type::list_type>(list(id),i++));
             }
-            return map_to_doc_ids(pos_intersect(lists));
+            return map_to_doc_ids(lazy_pos_intersect(lists),k);
         }
         template<class t_list>
         intersection_result
-        map_to_doc_ids(const t_list& list) const
+        map_to_doc_ids(const t_list& list,size_t k = no_result_limit) const
         {
-            intersection_result res(list.size());
             auto itr = list.begin();
             auto end = list.end();
+            if (itr == end || k == 0) return intersection_result(0);
+            intersection_result res(std::min(list.size(),k));
             auto prev_docid = m_dpm.map_to_id(*itr);
             ++itr;
             size_t n=0;
@@ -170,6 +192,7 @@ class index_relpos
                 auto doc_id = m_dpm.map_to_id(pos);
                 if (doc_id != prev_docid) {
                     res[n++] = prev_docid;
+                    if (n == k) return res;
                     prev_docid = doc_id;
                 }
                 ++itr;
@@ -9,6 +9,8 @@
 #include <sdsl/suffix_arrays.hpp>
 #include <sdsl/rmq_support.hpp>
 
+#include "mmap_file.hpp"
+
 using std::vector;
 
 template<
@@ -43,13 +45,12 @@ class index_sada
         mutable sdsl::bit_vector     m_doc_rmin_marked;   // helper bitvector for search process
         mutable sdsl::bit_vector     m_doc_rmax_marked;   // helper bitvector for search process
     public:
-        index_sada(collection& col)
+        index_sada(collection& col,const index_load_options& opts = index_load_options())
         {
             file_name = col.path +"index/"+name+"-"+sdsl::util::class_to_hash(*this)+".idx";
             if (utils::file_exists(file_name)) {  // load
                 LOG(INFO) << "LOAD from file '" << file_name << "'";
-                std::ifstream ifs(file_name);
-                load(ifs);
+                load_index_file(*this,file_name,opts);
                 m_doc_rmin_marked = sdsl::bit_vector(m_doc_cnt, 0);
                 m_doc_rmax_marked = sdsl::bit_vector(m_doc_cnt, 0);
             } else { // construct
@@ -134,8 +135,7 @@ class index_sada
                 m_doc_cnt = m_doc_border_rank(m_doc_border.size());
 
                 LOG(INFO) << "STORE to file '" << file_name << "'";
-                std::ofstream ofs(file_name);
-                auto bytes = serialize(ofs);
+                auto bytes = store_index_file(*this,file_name);
                 std::ofstream vofs(file_name+".html");
                 sdsl::write_structure<sdsl::HTML_FORMAT>(vofs,*this);
 
@@ -159,7 +159,8 @@ class index_sada
             return written_bytes;
         }
 
-        void load(std::istream& in)
+        // the sdsl structures are always copied, also from a mapping
+        void load(std::istream& in,const mmap_file* = nullptr)
         {
             sdsl::read_member(m_doc_cnt, in);
             m_csa_full.load(in);
@@ -192,6 +193,13 @@ class index_sada
             }
         }
 
+        // number of occurrences of the phrase
+        size_type count(std::vector<uint64_t> ids) const
+        {
+            size_type sp=1, ep=0;
+            return sdsl::backward_search(m_csa_full, 0, m_csa_full.size()-1, ids.begin(),ids.end(), sp, ep);
+        }
+
         docfreq_result
         phrase_list(std::vector<uint64_t> ids) const
         {
@@ -0,0 +1,350 @@
+#pragma once
+
+#include <vector>
+#include <map>
+#include <memory>
+#include <mutex>
+#include <thread>
+#include <atomic>
+#include <algorithm>
+#include <functional>
+#include <condition_variable>
+
+#include "sdsl/int_vector.hpp"
+#include "bit_streams.hpp"
+#include "list_basics.hpp"
+#include "intersection.hpp"
+#include "hybrid_list.hpp"
+
+/* documents added to an index after it was built are stored in segments
+   which are queried together with the main index. a segment holds the
+   postings of a range of consecutive documents. doc ids and positions
+   inside a segment are relative to the first document (doc_base) and the
+   first position (pos_base) of the segment, so a segment does not depend
+   on the segments before it. the text of a segment is laid out like the
+   collection text: every document is followed by a separator (symbol 1).
+   symbols 0 and 1 are not indexed. */
+#pragma pack(1)
+struct segment_metadata {
+    uint64_t id_offset;
+    uint64_t freq_offset;
+    uint64_t pos_offset;
+    uint8_t id_codec;
+};
+
+const uint64_t segment_no_list = std::numeric_limits<uint64_t>::max();
+
+template<class t_id_list,class t_freq_list,class t_pos_list,bool t_positions>
+class index_segment
+{
+    public:
+        using size_type = sdsl::int_vector<>::size_type;
+        using id_list_type = t_id_list;
+        using freq_list_type = t_freq_list;
+        using pos_list_type = t_pos_list;
+        // decoded postings of a term with relative doc ids and positions
+        struct postings {
+            std::vector<uint64_t> ids;
+            std::vector<uint64_t> freqs;
+            std::vector<uint64_t> positions;
+        };
+    private:
+        uint64_t m_doc_base = 0;
+        uint64_t m_pos_base = 0;
+        uint64_t m_num_postings = 0;
+        std::vector<uint64_t> m_terms;             // the terms of the segment in increasing order
+        std::vector<segment_metadata> m_meta_data; // the lists of m_terms
+        std::vector<uint64_t> m_doc_ends; // positions of the separators
+        sdsl::bit_vector m_id_data;
+        sdsl::bit_vector m_freq_data;
+        sdsl::bit_vector m_pos_data;
+        bit_istream m_isi;
+        bit_istream m_isf;
+        bit_istream m_isp;
+    private:
+        // encode the lists of term sym. the terms have to be added in increasing order
+        void encode(bit_ostream& osi,bit_ostream& osf,bit_ostream& osp,uint64_t sym,const postings& pl)
+        {
+            segment_metadata md {segment_no_list,segment_no_list,segment_no_list,0};
+            md.id_offset = create_list<id_list_type>(osi,pl.ids.begin(),pl.ids.end(),md.id_codec);
+            md.freq_offset = freq_list_type::create(osf,pl.freqs.begin(),pl.freqs.end());
+            if (t_positions) {
+                md.pos_offset = pos_list_type::create(osp,pl.positions.begin(),pl.positions.end());
+            }
+            m_terms.push_back(sym);
+            m_meta_data.push_back(md);
+            m_num_postings += t_positions ? pl.positions.size() : pl.ids.size();
+        }
+        template<class t_list>
+        static void append(const t_list& list,uint64_t delta,std::vector<uint64_t>& out)
+        {
+            auto end = list.end();
+            for (auto itr = list.begin(); itr != end; ++itr) out.push_back(*itr+delta);
+        }
+        // the index of term i in m_terms or segment_no_list
+        size_t find(uint64_t i) const
+        {
+            auto itr = std::lower_bound(m_terms.begin(),m_terms.end(),i);
+            if (itr == m_terms.end() || *itr != i) return segment_no_list;
+            return itr - m_terms.begin();
+        }
+    public:
+        index_segment(const index_segment&) = delete;
+        index_segment& operator=(const index_segment&) = delete;
+
+        /* index the documents, which are sequences of symbols. the segment
+           starts at document doc_base and text position pos_base. only the
+           terms occurring in the documents are stored */
+        index_segment(const std::vector<std::vector<uint64_t>>& docs,uint64_t doc_base,uint64_t pos_base)
+            : m_doc_base(doc_base), m_pos_base(pos_base), m_isi(m_id_data), m_isf(m_freq_data), m_isp(m_pos_data)
+        {
+            std::map<uint64_t,postings> lists;
+            uint64_t pos = 0;
+            for (size_t d=0; d<docs.size(); d++) {
+                for (const auto& sym : docs[d]) {
+                    if (sym >= 2) {
+                        auto& pl = lists[sym];
+                        if (pl.ids.empty() || pl.ids.back() != d) {
+                            pl.ids.push_back(d);
+                            pl.freqs.push_back(0);
+                        }
+                        pl.freqs.back()++;
+                        if (t_positions) pl.positions.push_back(pos);
+                    }
+                    pos++;
+                }
+                m_doc_ends.push_back(pos++);
+            }
+            {
+                bit_ostream osi(m_id_data);
+                bit_ostream osf(m_freq_data);
+                bit_ostream osp(m_pos_data);
+                for (const auto& list : lists) encode(osi,osf,osp,list.first,list.second);
+            }
+            m_isi.refresh(); m_isf.refresh(); m_isp.refresh();
+        }
+
+        /* concatenate two adjacent segments. the postings of b follow the
+           postings of a, so the lists are decoded, the doc ids and positions
+           of b are rebased and the concatenation is encoded again. the
+           terms of both segments are merged, one list is decoded at a time */
+        index_segment(const index_segment& a,const index_segment& b)
+            : m_doc_base(a.m_doc_base), m_pos_base(a.m_pos_base), m_isi(m_id_data), m_isf(m_freq_data), m_isp(m_pos_data)
+        {
+            uint64_t doc_delta = a.num_docs();
+            uint64_t pos_delta = a.num_positions();
+            {
+                bit_ostream osi(m_id_data);
+                bit_ostream osf(m_freq_data);
+                bit_ostream osp(m_pos_data);
+                size_t i = 0, j = 0;
+                while (i < a.m_terms.size() || j < b.m_terms.size()) {
+                    uint64_t sym;
+                    if (j == b.m_terms.size() || (i < a.m_terms.size() && a.m_terms[i] < b.m_terms[j])) {
+                        sym = a.m_terms[i];
+                    } else {
+                        sym = b.m_terms[j];
+                    }
+                    postings pl;
+                    if (i < a.m_terms.size() && a.m_terms[i] == sym) a.decode_list(i++,0,0,pl);
+                    if (j < b.m_terms.size() && b.m_terms[j] == sym) b.decode_list(j++,doc_delta,pos_delta,pl);
+                    encode(osi,osf,osp,sym,pl);
+                }
+            }
+            m_isi.refresh(); m_isf.refresh(); m_isp.refresh();
+            m_doc_ends = a.m_doc_ends;
+            for (const auto& end : b.m_doc_ends) m_doc_ends.push_back(end+pos_delta);
+        }
+
+        // append the postings of term i with doc ids and positions shifted by the deltas
+        void decode(uint64_t i,uint64_t doc_delta,uint64_t pos_delta,postings& pl) const
+        {
+            size_t k = find(i);
+            if (k != segment_no_list) decode_list(k,doc_delta,pos_delta,pl);
+        }
+        // decode the k-th list of the segment, see decode
+        void decode_list(size_t k,uint64_t doc_delta,uint64_t pos_delta,postings& pl) const
+        {
+            bit_istream isi(m_isi);
+            bit_istream isf(m_isf);
+            append(materialize_list<id_list_type>(isi,m_meta_data[k].id_offset,m_meta_data[k].id_codec),doc_delta,pl.ids);
+            append(freq_list_type::materialize(isf,m_meta_data[k].freq_offset),0,pl.freqs);
+            if (t_positions) {
+                bit_istream isp(m_isp);
+                append(pos_list_type::materialize(isp,m_meta_data[k].pos_offset),pos_delta,pl.positions);
+            }
+        }
+        bool contains(uint64_t i) const
+        {
+            return find(i) != segment_no_list;
+        }
+        // the document list of term i, which has to be contained in the segment
+        typename id_list_type::list_type
+        doc_list(uint64_t i) const
+        {
+            const auto& md = m_meta_data[find(i)];
+            bit_istream isi(m_isi);
+            return materialize_list<id_list_type>(isi,md.id_offset,md.id_codec);
+        }
+        typename pos_list_type::list_type
+        pos_list(uint64_t i) const
+        {
+            static_assert(t_positions,"segment has no positions.");
+            bit_istream isp(m_isp);
+            return pos_list_type::materialize(isp,m_meta_data[find(i)].pos_offset);
+        }
+        // document of a position relative to the segment
+        uint64_t map_to_id(uint64_t pos) const
+        {
+            return std::lower_bound(m_doc_ends.begin(),m_doc_ends.end(),pos)-m_doc_ends.begin();
+        }
+        uint64_t doc_base() const
+        {
+            return m_doc_base;
+        }
+        uint64_t pos_base() const
+        {
+            return m_pos_base;
+        }
+        uint64_t num_docs() const
+        {
+            return m_doc_ends.size();
+        }
+        uint64_t num_positions() const
+        {
+            return m_doc_ends.empty() ? 0 : m_doc_ends.back()+1;
+        }
+        uint64_t num_postings() const
+        {
+            return m_num_postings;
+        }
+        // number of terms of the segment
+        size_t num_lists() const
+        {
+            return m_terms.size();
+        }
+        size_type size_in_bytes() const
+        {
+            return (m_id_data.size()+m_freq_data.size()+m_pos_data.size())/8
+                   + m_meta_data.size()*sizeof(segment_metadata) + m_terms.size()*sizeof(uint64_t)
+                   + m_doc_ends.size()*sizeof(uint64_t);
+        }
+};
+
+/* the segments of an index. queries take a snapshot of the segment list,
+   which is replaced atomically when documents are added or segments are
+   merged, so queries never wait for either. a background thread merges
+   the adjacent pair of segments with the fewest postings as long as there
+   are more than max_segments segments, which bounds the number of lists a
+   query has to touch. */
+template<class t_segment>
+class segment_store
+{
+    public:
+        using segment_list = std::vector<std::shared_ptr<const t_segment>>;
+    private:
+        std::shared_ptr<const segment_list> m_segments;
+        uint64_t m_doc_base;
+        uint64_t m_pos_base;
+        size_t m_max_segments;
+        mutable std::mutex m_mutex; // serializes the updates of m_segments and the bases
+        std::condition_variable m_cv;
+        size_t m_merges_running = 0;
+        bool m_stop = false;
+        std::thread m_merger;
+    private:
+        void publish(std::shared_ptr<const segment_list> segments)
+        {
+            std::atomic_store(&m_segments,segments);
+        }
+        void merge_loop()
+        {
+            std::unique_lock<std::mutex> lock(m_mutex);
+            while (true) {
+                m_cv.wait(lock,[this] { return m_stop || m_segments->size() > m_max_segments; });
+                if (m_stop) return;
+                auto segments = m_segments;
+                size_t best = 0;
+                uint64_t best_size = std::numeric_limits<uint64_t>::max();
+                for (size_t i=0; i+1<segments->size(); i++) {
+                    uint64_t size = (*segments)[i]->num_postings()+(*segments)[i+1]->num_postings();
+                    if (size < best_size) {
+                        best_size = size;
+                        best = i;
+                    }
+                }
+                auto a = (*segments)[best];
+                auto b = (*segments)[best+1];
+                m_merges_running++;
+                lock.unlock();
+                auto merged = std::make_shared<const t_segment>(*a,*b);
+                lock.lock();
+                // segments may have been appended in the meantime
+                auto cur = m_segments;
+                auto next = std::make_shared<segment_list>();
+                for (size_t i=0; i<cur->size(); i++) {
+                    if ((*cur)[i] == a) {
+                        next->push_back(merged);
+                        i++;
+                    } else {
+                        next->push_back((*cur)[i]);
+                    }
+                }
+                publish(next);
+                m_merges_running--;
+                m_cv.notify_all();
+            }
+        }
+    public:
+        /* doc_base and pos_base are the first document and position after
+           the main index */
+        segment_store(uint64_t doc_base,uint64_t pos_base,size_t max_segments = 8)
+            : m_segments(std::make_shared<segment_list>()), m_doc_base(doc_base), m_pos_base(pos_base),
+              m_max_segments(std::max<size_t>(1,max_segments))
+        {
+            m_merger = std::thread([this] { merge_loop(); });
+        }
+        segment_store(const segment_store&) = delete;
+        segment_store& operator=(const segment_store&) = delete;
+        ~segment_store()
+        {
+            {
+                std::lock_guard<std::mutex> lock(m_mutex);
+                m_stop = true;
+            }
+            m_cv.notify_all();
+            m_merger.join();
+        }
+        std::shared_ptr<const segment_list> snapshot() const
+        {
+            return std::atomic_load(&m_segments);
+        }
+        /* index the documents in a new segment. the documents are searchable
+           once add returns. returns the doc id of the first document */
+        uint64_t add(const std::vector<std::vector<uint64_t>>& docs)
+        {
+            std::lock_guard<std::mutex> lock(m_mutex);
+            if (docs.empty()) return m_doc_base;
+            auto segment = std::make_shared<const t_segment>(docs,m_doc_base,m_pos_base);
+            uint64_t first_doc = m_doc_base;
+            m_doc_base += segment->num_docs();
+            m_pos_base += segment->num_positions();
+            auto next = std::make_shared<segment_list>(*m_segments);
+            next->push_back(segment);
+            publish(next);
+            m_cv.notify_all();
+            return first_doc;
+        }
+        // block until the background merges brought the segments below the limit
+        void wait_for_merges()
+        {
+            std::unique_lock<std::mutex> lock(m_mutex);
+            m_cv.wait(lock,[this] { return m_merges_running == 0 && m_segments->size() <= m_max_segments; });
+        }
+        // number of documents of the main index and the segments
+        uint64_t num_docs() const
+        {
+            std::lock_guard<std::mutex> lock(m_mutex);
+            return m_doc_base;
+        }
+};
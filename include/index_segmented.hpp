@@ -0,0 +1,196 @@
+#pragma once
+
+#include "index_invidx.hpp"
+#include "index_abspos.hpp"
+#include "index_segment.hpp"
+
+#include "easylogging++.h"
+
+/* indexes which accept new documents after construction. the main index
+   is built from the collection as before, documents added later are
+   indexed in segments (see index_segment.hpp) and merged in the
+   background. a query runs on the main index and on a snapshot of the
+   segments. the doc ids of the segments follow the doc ids of the main
+   index, so the results are concatenated in increasing order. */
+
+// append the values of part shifted by base to res, up to limit results
+inline void
+append_rebased(intersection_result& res,const intersection_result& part,uint64_t base,size_t limit)
+{
+    size_t n = res.size();
+    size_t m = std::min<size_t>(part.size(),limit-n);
+    res.resize(n+m);
+    for (size_t i=0; i<m; i++) res[n+i] = part.m_data[i]+base;
+}
+
+template<class t_invidx = index_invidx<>>
+class index_segmented_invidx
+{
+    public:
+        using size_type = sdsl::int_vector<>::size_type;
+        using invidx_type = t_invidx;
+        using id_list_type = typename t_invidx::id_list_type;
+        using freq_list_type = typename t_invidx::freq_list_type;
+        using segment_type = index_segment<id_list_type,freq_list_type,id_list_type,false>;
+        const std::string name = "SEGINVIDX";
+    private:
+        invidx_type m_main;
+        segment_store<segment_type> m_segments;
+    public:
+        // t_col is the collection, the main index is built from it
+        template<class t_col>
+        index_segmented_invidx(t_col& col,size_t max_segments = 8,const index_load_options& opts = index_load_options())
+            : m_main(col,opts), m_segments(m_main.num_docs(),0,max_segments) {}
+        /* index the documents and return the doc id of the first one. the
+           documents are searchable once add_documents returns */
+        uint64_t add_documents(const std::vector<std::vector<uint64_t>>& docs)
+        {
+            return m_segments.add(docs);
+        }
+        void wait_for_merges()
+        {
+            m_segments.wait_for_merges();
+        }
+        size_t num_segments() const
+        {
+            return m_segments.snapshot()->size();
+        }
+        uint64_t num_docs() const
+        {
+            return m_segments.num_docs();
+        }
+        const invidx_type& main_index() const
+        {
+            return m_main;
+        }
+        template<class t_strategy=intersect_adaptive>
+        intersection_result
+        intersection(std::vector<uint64_t> ids,size_t limit = no_result_limit) const
+        {
+            auto segments = m_segments.snapshot();
+            auto res = m_main.template intersection<t_strategy>(ids,limit);
+            for (const auto& segment : *segments) {
+                if (res.size() >= limit) break;
+                std::vector<typename id_list_type::list_type> lists;
+                for (const auto& id : ids) {
+                    if (!segment->contains(id)) break;
+                    lists.emplace_back(segment->doc_list(id));
+                }
+                if (lists.size() != ids.size()) continue;
+                append_rebased(res,intersect<t_strategy>(lists,limit-res.size()),segment->doc_base(),limit);
+            }
+            return res;
+        }
+};
+
+template<class t_abspos = index_abspos<>>
+class index_segmented_abspos
+{
+    public:
+        using size_type = sdsl::int_vector<>::size_type;
+        using abspos_type = t_abspos;
+        using plist_type = typename t_abspos::plist_type;
+        using doclist_type = typename t_abspos::doclist_type;
+        using freq_list_type = typename t_abspos::invidx_type::freq_list_type;
+        using segment_type = index_segment<doclist_type,freq_list_type,plist_type,true>;
+        const std::string name = "SEGABSPOS";
+    private:
+        abspos_type m_main;
+        segment_store<segment_type> m_segments;
+    private:
+        // the position lists of the query terms in a segment, empty if a term is missing
+        std::vector<offset_proxy_list<typename plist_type::list_type>>
+        segment_lists(const segment_type& segment,const std::vector<uint64_t>& ids) const
+        {
+            std::vector<offset_proxy_list<typename plist_type::list_type>> lists;
+            size_type i = 0;
+            for (const auto& id : ids) {
+                if (!segment.contains(id)) return {};
+                auto list = segment.pos_list(id);
+                lists.emplace_back(offset_proxy_list<typename plist_type::list_type>(list,i++));
+            }
+            return lists;
+        }
+    public:
+        template<class t_col>
+        index_segmented_abspos(t_col& col,size_t max_segments = 8,const index_load_options& opts = index_load_options())
+            : m_main(col,opts), m_segments(m_main.num_docs(),m_main.text_size(),max_segments) {}
+        /* index the documents and return the doc id of the first one. the
+           documents are searchable once add_documents returns */
+        uint64_t add_documents(const std::vector<std::vector<uint64_t>>& docs)
+        {
+            return m_segments.add(docs);
+        }
+        void wait_for_merges()
+        {
+            m_segments.wait_for_merges();
+        }
+        size_t num_segments() const
+        {
+            return m_segments.snapshot()->size();
+        }
+        uint64_t num_docs() const
+        {
+            return m_segments.num_docs();
+        }
+        const abspos_type& main_index() const
+        {
+            return m_main;
+        }
+        template<class t_strategy=intersect_daat>
+        intersection_result
+        phrase_positions(std::vector<uint64_t> ids,size_t limit = no_result_limit) const
+        {
+            auto segments = m_segments.snapshot();
+            auto res = m_main.template phrase_positions<t_strategy>(ids,limit);
+            for (const auto& segment : *segments) {
+                if (res.size() >= limit) break;
+                auto lists = segment_lists(*segment,ids);
+                if (lists.empty()) continue;
+                append_rebased(res,pos_intersect<t_strategy>(lists,limit-res.size()),segment->pos_base(),limit);
+            }
+            return res;
+        }
+        // documents containing the phrase with the number of occurrences
+        template<class t_strategy=intersect_lazy>
+        docfreq_result
+        phrase_list(std::vector<uint64_t> ids,size_t k = no_result_limit) const
+        {
+            auto segments = m_segments.snapshot();
+            auto res = m_main.template phrase_list<t_strategy>(ids,k);
+            for (const auto& segment : *segments) {
+                if (res.size() >= k) break;
+                auto lists = segment_lists(*segment,ids);
+                if (lists.empty()) continue;
+                auto matches = t_strategy::pos_intersect(lists);
+                auto end = matches.end();
+                for (auto itr = matches.begin(); itr != end; ++itr) {
+                    auto doc_id = segment->doc_base()+segment->map_to_id(*itr);
+                    if (!res.empty() && res.back().first == doc_id) {
+                        res.back().second++;
+                    } else {
+                        if (res.size() == k) break;
+                        res.emplace_back(doc_id,1);
+                    }
+                }
+            }
+            return res;
+        }
+        intersection_result
+        doc_intersection(std::vector<uint64_t> ids,size_t limit = no_result_limit) const
+        {
+            auto segments = m_segments.snapshot();
+            auto res = m_main.doc_intersection(ids,limit);
+            for (const auto& segment : *segments) {
+                if (res.size() >= limit) break;
+                std::vector<typename doclist_type::list_type> lists;
+                for (const auto& id : ids) {
+                    if (!segment->contains(id)) break;
+                    lists.emplace_back(segment->doc_list(id));
+                }
+                if (lists.size() != ids.size()) continue;
+                append_rebased(res,intersect<intersect_adaptive>(lists,limit-res.size()),segment->doc_base(),limit);
+            }
+            return res;
+        }
+};
@@ -8,6 +8,8 @@
 
 #include <sdsl/suffix_arrays.hpp>
 
+#include "mmap_file.hpp"
+
 using std::vector;
 
 template<
@@ -25,13 +27,12 @@ class index_sort
         csa_type  m_csa_full;
         d_type    m_d;
     public:
-        index_sort(collection& col)
+        index_sort(collection& col,const index_load_options& opts = index_load_options())
         {
             file_name = col.path +"index/"+name+"-"+sdsl::util::class_to_hash(*this)+".idx";
             if (utils::file_exists(file_name)) {  // load
                 LOG(INFO) << "LOAD from file '" << file_name << "'";
-                std::ifstream ifs(file_name);
-                load(ifs);
+                load_index_file(*this,file_name,opts);
             } else { // construct
                 LOG(INFO) << "CONSTRUCT sort index";
 
@@ -48,8 +49,7 @@ class index_sort
                 sdsl::load_from_file(m_d,col.file_map[KEY_D]);
 
                 LOG(INFO) << "STORE to file '" << file_name << "'";
-                std::ofstream ofs(file_name);
-                auto bytes = serialize(ofs);
+                auto bytes = store_index_file(*this,file_name);
                 std::ofstream vofs(file_name+".html");
                 sdsl::write_structure<sdsl::HTML_FORMAT>(vofs,*this);
 
@@ -67,7 +67,8 @@ class index_sort
             return written_bytes;
         }
 
-        void load(std::istream& in)
+        // the sdsl structures are always copied, also from a mapping
+        void load(std::istream& in,const mmap_file* = nullptr)
         {
             m_csa_full.load(in);
             m_d.load(in);
@@ -8,6 +8,8 @@
 
 #include <sdsl/suffix_arrays.hpp>
 
+#include "mmap_file.hpp"
+
 using std::vector;
 
 template<
@@ -27,13 +29,12 @@ class index_wt
         csa_type  m_csa_full;
         wtd_type    m_wtd;
     public:
-        index_wt(collection& col)
+        index_wt(collection& col,const index_load_options& opts = index_load_options())
         {
             file_name = col.path +"index/"+name+"-"+sdsl::util::class_to_hash(*this)+".idx";
             if (utils::file_exists(file_name)) {  // load
                 LOG(INFO) << "LOAD from file '" << file_name << "'";
-                std::ifstream ifs(file_name);
-                load(ifs);
+                load_index_file(*this,file_name,opts);
             } else { // construct
                 LOG(INFO) << "CONSTRUCT wt index";
 
@@ -51,8 +52,7 @@ class index_wt
                 m_wtd = wtd_type(D,D.size());
 
                 LOG(INFO) << "STORE to file '" << file_name << "'";
-                std::ofstream ofs(file_name);
-                auto bytes = serialize(ofs);
+                auto bytes = store_index_file(*this,file_name);
                 std::ofstream vofs(file_name+".html");
                 sdsl::write_structure<sdsl::HTML_FORMAT>(vofs,*this);
 
@@ -70,7 +70,8 @@ class index_wt
             return written_bytes;
         }
 
-        void load(std::istream& in)
+        // the sdsl structures are always copied, also from a mapping
+        void load(std::istream& in,const mmap_file* = nullptr)
         {
             m_csa_full.load(in);
             m_wtd.load(in);
@@ -84,6 +85,13 @@ class index_wt
             }
         }
 
+        // number of occurrences of the phrase
+        size_type count(std::vector<uint64_t> ids) const
+        {
+            size_type sp=1, ep=0;
+            return sdsl::backward_search(m_csa_full, 0, m_csa_full.size()-1, ids.begin(),ids.end(), sp, ep);
+        }
+
         docfreq_result
         phrase_list(std::vector<uint64_t> ids) const
         {
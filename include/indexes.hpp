@@ -5,6 +5,8 @@
 #include "index_nextword.hpp"
 #include "index_relpos.hpp"
 #include "index_relnextword.hpp"
+#include "index_hybrid_nextword.hpp"
 #include "index_sort.hpp"
 #include "index_sada.hpp"
-#include "index_wt.hpp"
\ No newline at end of file
+#include "index_wt.hpp"
+#include "index_segmented.hpp"
\ No newline at end of file
@@ -1,31 +1,326 @@
 #pragma once
 
 #include "sdsl/int_vector.hpp"
+#include "list_types.hpp"
+#include "simd_intersection.hpp"
+#include "thread_pool.hpp"
 
+#include <array>
+#include <atomic>
+
+enum class intersect_kernel {merge,gallop,skip,bitmap,simd};
+
+/* thresholds used by intersect() to pick a pairwise kernel. with n the
+   length of the shorter list and m the length of the longer list:
+     m/n < bitmap_ratio : if the longer list covers more than
+                          1/bitmap_density of its value range it is
+                          decoded into a bitmap which is probed
+     m/n < merge_ratio  : linear merge of both lists
+     m/n < gallop_ratio : galloping search in the longer list
+     otherwise          : skip() in the longer list
+   simd_ratio is checked after the bitmap test. below it both lists are
+   decoded in blocks of 128 integers which are intersected with SIMD
+   instructions.
+   the thresholds depend on how fast the longer list can be iterated,
+   skip() and be accessed at random offsets, so they are set per iterator
+   type. they were calibrated with 1M element lists of density 1/4 and
+   1/64 against lists 1 to 256 times shorter. */
+template<class t_itr>
+struct intersect_policy {
+    static constexpr double simd_ratio = 0;
+    static constexpr double bitmap_ratio = 0;
+    static constexpr double bitmap_density = 0;
+    static constexpr double merge_ratio = 4;
+    static constexpr double gallop_ratio = 4;
+};
+
+// fully decoded lists (SvS intermediates). random access is cheap
+template<>
+struct intersect_policy<intersection_res_itr> {
+    static constexpr double simd_ratio = 0;
+    static constexpr double bitmap_ratio = 0;
+    static constexpr double bitmap_density = 0;
+    static constexpr double merge_ratio = 16;
+    static constexpr double gallop_ratio = 256;
+};
+
+template<bool t_sorted,bool t_compact>
+struct intersect_policy<ef_iterator<t_sorted,t_compact>> {
+    static constexpr double simd_ratio = 8;
+    static constexpr double bitmap_ratio = 2;
+    static constexpr double bitmap_density = 4;
+    static constexpr double merge_ratio = 8;
+    static constexpr double gallop_ratio = 8;
+};
+
+template<uint16_t t_skip,bool t_sorted,bool t_compact>
+struct intersect_policy<ef_skip_iterator<t_skip,t_sorted,t_compact>> {
+    static constexpr double simd_ratio = 8;
+    static constexpr double bitmap_ratio = 3;
+    static constexpr double bitmap_density = 4;
+    static constexpr double merge_ratio = 8;
+    static constexpr double gallop_ratio = 8;
+};
+
+template<uint16_t t_skip,bool t_sorted,bool t_compact>
+struct intersect_policy<ef_sskip_iterator<t_skip,t_sorted,t_compact>> {
+    static constexpr double simd_ratio = 8;
+    static constexpr double bitmap_ratio = 3;
+    static constexpr double bitmap_density = 4;
+    static constexpr double merge_ratio = 8;
+    static constexpr double gallop_ratio = 8;
+};
+
+template<uint16_t t_block_size,bool t_sorted>
+struct intersect_policy<optpfor_iterator<t_block_size,t_sorted>> {
+    static constexpr double simd_ratio = 4;
+    static constexpr double bitmap_ratio = 0;
+    static constexpr double bitmap_density = 0;
+    static constexpr double merge_ratio = 4;
+    static constexpr double gallop_ratio = 4;
+};
+
+template<class t_codec,bool t_sorted>
+struct intersect_policy<simd_block_iterator<t_codec,t_sorted>> {
+    static constexpr double simd_ratio = 8;
+    static constexpr double bitmap_ratio = 0;
+    static constexpr double bitmap_density = 0;
+    static constexpr double merge_ratio = 4;
+    static constexpr double gallop_ratio = 4;
+};
+
+/* skip() beats the other kernels unless both lists have about the same
+   length, then decoding both in blocks is faster */
+template<uint16_t t_block_size>
+struct intersect_policy<uniform_ef_iterator<t_block_size>> {
+    static constexpr double simd_ratio = 1.5;
+    static constexpr double bitmap_ratio = 0;
+    static constexpr double bitmap_density = 0;
+    static constexpr double merge_ratio = 1;
+    static constexpr double gallop_ratio = 1;
+};
+
+// the list already is a bitmap
+template<bool t_compact>
+struct intersect_policy<bv_iterator<t_compact>> {
+    static constexpr double simd_ratio = 0;
+    static constexpr double bitmap_ratio = 0;
+    static constexpr double bitmap_density = 0;
+    static constexpr double merge_ratio = 1;
+    static constexpr double gallop_ratio = 1;
+};
+
+/* linear merge. x of the first list matches x+offset of the second list
+   and min(x,x+offset) is reported (same for all kernels below) */
 template<class t_itr,class t_itr2>
 intersection_result
-intersect(t_itr fbegin,t_itr fend,t_itr2 sbegin,t_itr2 send,int64_t offset = 0)
+merge_intersect(t_itr fbegin,t_itr fend,t_itr2 sbegin,t_itr2 send,int64_t offset = 0)
 {
     auto n = std::distance(fbegin,fend);
     auto m = std::distance(sbegin,send);
     intersection_result res(std::min(n,m));
+    size_t value_offset = (size_t) std::min(int64_t(0),offset);
+
+    size_t i=0;
+    if (fbegin == fend || sbegin == send) {
+        res.resize(0);
+        return res;
+    }
+    int64_t first = *fbegin + offset;
+    int64_t second = *sbegin;
+    while (true) {
+        if (first < second) {
+            if (++fbegin == fend) break;
+            first = *fbegin + offset;
+        } else if (second < first) {
+            if (++sbegin == send) break;
+            second = *sbegin;
+        } else {
+            res[i++] = first - offset + value_offset;
+            if (++fbegin == fend || ++sbegin == send) break;
+            first = *fbegin + offset;
+            second = *sbegin;
+        }
+    }
+    res.resize(i);
+    return res;
+}
 
-    // std::vector<uint64_t> ss(m);
-    // auto tmp = sbegin;
-    // size_t k=0;
-    // while(tmp != send) {
-    //     ss[k++] = *tmp;
-    //     ++tmp;
-    // }
+/* exponential search for the first element >= target starting at itr,
+   followed by a binary search in the last interval */
+struct gallop_search {
+    template<class t_itr>
+    bool operator()(t_itr& itr,const t_itr&,uint64_t target)
+    {
+        size_t remaining = itr.remaining();
+        if (*itr >= target) return *itr == target;
+        size_t lo = 0;
+        size_t hi = 1;
+        while (hi < remaining && *(itr+hi) < target) {
+            lo = hi;
+            hi = hi*2;
+        }
+        if (hi > remaining) hi = remaining;
+        // *(itr+lo) < target and (hi == remaining or *(itr+hi) >= target)
+        while (hi - lo > 1) {
+            size_t mid = lo + (hi-lo)/2;
+            if (*(itr+mid) < target) lo = mid;
+            else hi = mid;
+        }
+        itr += hi;
+        return hi < remaining && *itr == target;
+    }
+};
+
+struct skip_search {
+    template<class t_itr>
+    bool operator()(t_itr& itr,const t_itr&,uint64_t target)
+    {
+        return itr.skip(target);
+    }
+};
+
+/* the longer list is decoded into a bitmap over its value range once */
+class bitmap_search
+{
+    private:
+        sdsl::bit_vector m_bv;
+        uint64_t m_first = 0;
+    public:
+        template<class t_itr>
+        bitmap_search(t_itr itr,const t_itr& end)
+        {
+            if (itr == end) return;
+            m_first = *itr;
+            m_bv = sdsl::bit_vector(*(itr+(itr.remaining()-1)) - m_first + 1,0);
+            while (itr != end) {
+                m_bv[*itr - m_first] = 1;
+                ++itr;
+            }
+        }
+        template<class t_itr>
+        bool operator()(t_itr&,const t_itr&,uint64_t target)
+        {
+            return target >= m_first && target - m_first < m_bv.size() && m_bv[target - m_first];
+        }
+};
+
+/* reads a list in blocks of (at most) simd_block_size integers. values
+   below min_value are skipped with skip(), shift is added to all values
+   and the resulting negative values are dropped */
+const size_t simd_block_size = 128;
+
+template<class t_itr>
+struct block_reader {
+    static size_t fill(t_itr& itr,const t_itr& end,uint32_t* buf,int64_t shift,uint64_t min_value)
+    {
+        if (itr == end) return 0;
+        int64_t target = (int64_t)min_value - shift;
+        if (target > 0 && (int64_t)*itr < target) {
+            itr.skip(target);
+            if (itr == end) return 0;
+        }
+        size_t n = 0;
+        while (n < simd_block_size && itr != end) {
+            int64_t value = (int64_t)*itr + shift;
+            ++itr;
+            if (value >= 0) buf[n++] = value;
+        }
+        return n;
+    }
+};
+
+// copy the decoded block directly. skip() does not decode skipped blocks
+template<class t_itr>
+struct decoded_block_reader {
+    static size_t fill(t_itr& itr,const t_itr& end,uint32_t* buf,int64_t shift,uint64_t min_value)
+    {
+        if (itr == end) return 0;
+        int64_t target = (int64_t)min_value - shift;
+        if (target > 0) {
+            itr.skip(target);
+            if (itr == end) return 0;
+        }
+        typename t_itr::size_type len;
+        const uint32_t* values = itr.block_values(len);
+        len = std::min(len,(typename t_itr::size_type)simd_block_size);
+        size_t n = 0;
+        for (size_t i=0; i<len; i++) {
+            int64_t value = (int64_t)values[i] + shift;
+            if (value >= 0) buf[n++] = value;
+        }
+        itr += len;
+        return n;
+    }
+};
+
+template<uint16_t t_block_size>
+struct block_reader<optpfor_iterator<t_block_size,true>> : decoded_block_reader<optpfor_iterator<t_block_size,true>> {};
+
+template<class t_codec>
+struct block_reader<simd_block_iterator<t_codec,true>> : decoded_block_reader<simd_block_iterator<t_codec,true>> {};
+
+/* both lists are decoded in blocks. overlapping blocks are intersected
+   with simd_intersection::intersect, blocks of one list which end before
+   the current block of the other list starts are skipped. lists with
+   values which do not fit into 32 bits are merged instead */
+template<class t_itr,class t_itr2>
+intersection_result
+simd_intersect(t_itr fbegin,t_itr fend,t_itr2 sbegin,t_itr2 send,int64_t offset = 0)
+{
+    auto n = std::distance(fbegin,fend);
+    auto m = std::distance(sbegin,send);
+    if (n == 0 || m == 0) return intersection_result(0);
+    const int64_t max_value = std::numeric_limits<uint32_t>::max();
+    if ((int64_t)*(fbegin+(n-1)) + offset > max_value || (int64_t)*(sbegin+(m-1)) > max_value) {
+        return merge_intersect(fbegin,fend,sbegin,send,offset);
+    }
+    intersection_result res(std::min(n,m));
+    size_t value_offset = (size_t) std::min(int64_t(0),offset);
+
+    uint32_t A[simd_block_size];
+    uint32_t B[simd_block_size];
+    uint32_t out[simd_block_size+4];
+    size_t na = block_reader<t_itr>::fill(fbegin,fend,A,offset,0);
+    size_t nb = block_reader<t_itr2>::fill(sbegin,send,B,0,0);
+    size_t i = 0;
+    while (na && nb) {
+        if (A[na-1] < B[0]) {
+            na = block_reader<t_itr>::fill(fbegin,fend,A,offset,B[0]);
+            continue;
+        }
+        if (B[nb-1] < A[0]) {
+            nb = block_reader<t_itr2>::fill(sbegin,send,B,0,A[0]);
+            continue;
+        }
+        size_t found = simd_intersection::intersect(A,na,B,nb,out);
+        for (size_t j=0; j<found; j++) res[i++] = out[j] - offset + value_offset;
+        uint32_t last_a = A[na-1];
+        uint32_t last_b = B[nb-1];
+        if (last_a <= last_b) na = block_reader<t_itr>::fill(fbegin,fend,A,offset,0);
+        if (last_b <= last_a) nb = block_reader<t_itr2>::fill(sbegin,send,B,0,0);
+    }
+    res.resize(i);
+    return res;
+}
+
+/* every element of the shorter list is searched in the longer list. if the
+   first list is the shorter one x+offset is searched in the second list,
+   otherwise x-offset is searched in the first list */
+template<class t_search,class t_itr,class t_itr2>
+intersection_result
+probe_intersect(t_search search,t_itr fbegin,t_itr fend,t_itr2 sbegin,t_itr2 send,int64_t offset = 0)
+{
+    auto n = std::distance(fbegin,fend);
+    auto m = std::distance(sbegin,send);
+    intersection_result res(std::min(n,m));
 
     size_t i=0;
     if (n < m) {
         size_t value_offset = (size_t) std::min(int64_t(0),offset);
-
         while (fbegin != fend) {
             int64_t cur = *fbegin;
-            if (cur + offset >= 0 && sbegin.skip(cur+offset)) {
-                // std::cout << "1 FOUND " << cur+offset << "(" << cur+value_offset << ")" << std::endl;
+            if (cur + offset >= 0 && search(sbegin,send,cur+offset)) {
                 res[i++] = cur+value_offset;
             }
             if (sbegin == send) break;
@@ -35,8 +330,7 @@ intersect(t_itr fbegin,t_itr fend,t_itr2 sbegin,t_itr2 send,int64_t offset = 0)
         size_t value_offset = (size_t) std::max(int64_t(0),offset);
         while (sbegin != send) {
             int64_t cur = *sbegin;
-            if (cur-offset >= 0 && fbegin.skip(cur-offset)) {
-                // std::cout << "1 FOUND " << cur-offset << "(" << cur-value_offset << ")" << std::endl;
+            if (cur-offset >= 0 && search(fbegin,fend,cur-offset)) {
                 res[i++] = cur-value_offset;
             }
             if (fbegin == fend) break;
@@ -47,17 +341,121 @@ intersect(t_itr fbegin,t_itr fend,t_itr2 sbegin,t_itr2 send,int64_t offset = 0)
     return res;
 }
 
-template<class t_list1,class t_list2>
+template<class t_itr,class t_itr2>
+intersection_result
+intersect(intersect_kernel kernel,t_itr fbegin,t_itr fend,t_itr2 sbegin,t_itr2 send,int64_t offset = 0)
+{
+    switch (kernel) {
+        case intersect_kernel::merge:
+            return merge_intersect(fbegin,fend,sbegin,send,offset);
+        case intersect_kernel::gallop:
+            return probe_intersect(gallop_search(),fbegin,fend,sbegin,send,offset);
+        case intersect_kernel::simd:
+            return simd_intersect(fbegin,fend,sbegin,send,offset);
+        case intersect_kernel::bitmap:
+            if (std::distance(fbegin,fend) < std::distance(sbegin,send))
+                return probe_intersect(bitmap_search(sbegin,send),fbegin,fend,sbegin,send,offset);
+            return probe_intersect(bitmap_search(fbegin,fend),fbegin,fend,sbegin,send,offset);
+        default:
+            return probe_intersect(skip_search(),fbegin,fend,sbegin,send,offset);
+    }
+}
+
+inline const char* intersect_kernel_name(intersect_kernel kernel)
+{
+    switch (kernel) {
+        case intersect_kernel::merge:
+            return "merge";
+        case intersect_kernel::gallop:
+            return "gallop";
+        case intersect_kernel::skip:
+            return "skip";
+        case intersect_kernel::bitmap:
+            return "bitmap";
+        default:
+            return "simd";
+    }
+}
+const size_t num_intersect_kernels = 5;
+
+/* how often select_kernel() picked each kernel, so the benchmarks can
+   report which kernels a run used */
+struct intersect_kernel_counts {
+    std::array<std::atomic<uint64_t>,num_intersect_kernels> count;
+
+    intersect_kernel_counts()
+    {
+        reset();
+    }
+    void reset()
+    {
+        for (auto& c : count) c = 0;
+    }
+    uint64_t operator[](intersect_kernel kernel) const
+    {
+        return count[(size_t)kernel];
+    }
+};
+
+inline intersect_kernel_counts& kernel_counts()
+{
+    static intersect_kernel_counts counts;
+    return counts;
+}
+
+// pick a kernel based on the list lengths and the thresholds of t_policy
+template<class t_policy,class t_itr>
+intersect_kernel
+select_kernel(size_t n,t_itr lbegin,t_itr lend)
+{
+    size_t m = std::distance(lbegin,lend);
+    if (n == 0 || m == 0) return intersect_kernel::skip;
+    double ratio = (double)m / (double)n;
+    if (ratio < t_policy::bitmap_ratio) {
+        double universe = *(lbegin+(m-1)) - *lbegin + 1;
+        if (universe < t_policy::bitmap_density * m) return intersect_kernel::bitmap;
+    }
+    if (ratio < t_policy::simd_ratio) return intersect_kernel::simd;
+    if (ratio < t_policy::merge_ratio) return intersect_kernel::merge;
+    if (ratio < t_policy::gallop_ratio) return intersect_kernel::gallop;
+    return intersect_kernel::skip;
+}
+
+template<template<class> class t_policy = intersect_policy,class t_itr,class t_itr2>
 intersection_result
+intersect(t_itr fbegin,t_itr fend,t_itr2 sbegin,t_itr2 send,int64_t offset = 0)
+{
+    size_t n = std::distance(fbegin,fend);
+    size_t m = std::distance(sbegin,send);
+    intersect_kernel kernel;
+    if (n < m) kernel = select_kernel<t_policy<t_itr2>>(n,sbegin,send);
+    else kernel = select_kernel<t_policy<t_itr>>(m,fbegin,fend);
+    kernel_counts().count[(size_t)kernel].fetch_add(1,std::memory_order_relaxed);
+    return intersect(kernel,fbegin,fend,sbegin,send,offset);
+}
+
+template<template<class> class t_policy = intersect_policy,class t_list1,class t_list2>
+typename std::enable_if<!std::is_arithmetic<t_list2>::value,intersection_result>::type
 intersect(const t_list1& first,const t_list2& second,int64_t offset = 0)
 {
-    return intersect(first.begin(),first.end(),second.begin(),second.end(),offset);
+    return intersect<t_policy>(first.begin(),first.end(),second.begin(),second.end(),offset);
+}
+
+template<class t_list1,class t_list2>
+intersection_result
+intersect(intersect_kernel kernel,const t_list1& first,const t_list2& second,int64_t offset = 0)
+{
+    return intersect(kernel,first.begin(),first.end(),second.begin(),second.end(),offset);
 }
 
+/* result limit of the k-way intersections. only the first limit results
+   (in increasing order) are returned */
+const size_t no_result_limit = std::numeric_limits<size_t>::max();
 
+/* SvS can not stop early, the result is truncated to limit */
 template<class t_list>
 intersection_result
-intersect(std::vector<t_list> lists)
+svs_intersect(std::vector<t_list> lists,size_t limit = no_result_limit)
 {
     // sort by size
     std::sort(lists.begin(),lists.end());
@@ -68,12 +466,13 @@ intersect(std::vector<t_list> lists)
         res = intersect(res,lists[i]);
         if (res.size()==0) break;
     }
+    if (res.size() > limit) res.resize(limit);
     return res;
 }
 
 template<class t_list>
 intersection_result
-pos_intersect(std::vector<t_list> lists)
+svs_pos_intersect(std::vector<t_list> lists,size_t limit = no_result_limit)
 {
     // sort by size
     std::sort(lists.begin(),lists.end());
@@ -89,5 +488,419 @@ pos_intersect(std::vector<t_list> lists)
         res.offset = new_offset;
         if (res.size()==0) break;
     }
+    if (res.size() > limit) res.resize(limit);
     return res;
 }
+
+/* iterator over the k-way document-at-a-time intersection of a set of
+   lists. x is part of the result if list i contains x+deltas[i] for all i.
+   the lists are advanced together with skip() and the next result is only
+   computed when the iterator is moved, so no result buffer is needed. the
+   lists have to be sorted by size so the shortest list proposes candidates.
+
+   size() is the length of the shortest list, an upper bound of the number
+   of results. offset() counts the results passed with ++. skip() does not
+   count the results it passes over. the iterator starts at the first
+   result >= start and is finished once the candidate reaches stop. */
+template<class t_itr>
+class intersection_view_itr : public std::iterator<std::forward_iterator_tag,uint64_t,std::ptrdiff_t>
+{
+    public:
+        using size_type = sdsl::int_vector<>::size_type;
+    private:
+        std::vector<t_itr> m_itrs;
+        std::vector<t_itr> m_ends;
+        std::vector<uint64_t> m_deltas;
+        uint64_t m_cur_elem = 0;
+        uint64_t m_stop = std::numeric_limits<uint64_t>::max();
+        size_type m_cur_offset = 0;
+        size_type m_size = 0;
+        bool m_finished = true;
+    public:
+        intersection_view_itr() = default;
+        intersection_view_itr(const std::vector<t_itr>& itrs,const std::vector<t_itr>& ends,
+                              const std::vector<uint64_t>& deltas,bool end,uint64_t start = 0,
+                              uint64_t stop = std::numeric_limits<uint64_t>::max())
+            : m_itrs(itrs), m_ends(ends), m_deltas(deltas), m_stop(stop), m_finished(end)
+        {
+            if (!m_itrs.empty()) m_size = std::distance(m_itrs[0],m_ends[0]);
+            if (m_itrs.empty() || m_size == 0) m_finished = true;
+            if (!m_finished) find(start);
+        }
+    public:
+        size_type offset() const
+        {
+            return m_cur_offset;
+        }
+        size_type size() const
+        {
+            return m_size;
+        }
+        size_type remaining() const
+        {
+            return m_finished ? 0 : m_size - m_cur_offset;
+        }
+        uint64_t operator*() const
+        {
+            return m_cur_elem;
+        }
+        intersection_view_itr& operator++()
+        {
+            m_cur_offset++;
+            find(m_cur_elem+1);
+            return *this;
+        }
+        intersection_view_itr operator++(int)
+        {
+            intersection_view_itr tmp(*this);
+            ++(*this);
+            return tmp;
+        }
+        bool skip(uint64_t pos)
+        {
+            if (m_finished) return false;
+            if (m_cur_elem < pos) find(pos);
+            return !m_finished && m_cur_elem == pos;
+        }
+        bool operator ==(const intersection_view_itr& b) const
+        {
+            if (m_finished || b.m_finished) return m_finished == b.m_finished;
+            return m_cur_elem == b.m_cur_elem;
+        }
+        bool operator !=(const intersection_view_itr& b) const
+        {
+            return !(*this == b);
+        }
+    private:
+        // move to the smallest result >= candidate which is below m_stop
+        void find(uint64_t candidate)
+        {
+            size_t k = m_itrs.size();
+            size_t matched = 0;
+            for (size_t i=0; ; i = (i+1 == k) ? 0 : i+1) {
+                if (candidate >= m_stop) {
+                    m_finished = true;
+                    return;
+                }
+                auto& itr = m_itrs[i];
+                uint64_t target = candidate + m_deltas[i];
+                itr.skip(target);
+                if (itr == m_ends[i]) {
+                    m_finished = true;
+                    return;
+                }
+                uint64_t cur = *itr;
+                if (cur != target) {
+                    // list i can not contain candidate. cur is the new candidate
+                    candidate = cur - m_deltas[i];
+                    matched = 1;
+                } else {
+                    matched++;
+                }
+                // a single list matches the new candidate on its own
+                if (matched == k) {
+                    m_cur_elem = candidate;
+                    return;
+                }
+            }
+        }
+};
+
+/* lazy intersection of a set of lists which can be used in place of an
+   intersection_result. the lists are stored in the view, the view must
+   not be moved while its iterators are in use. */
+template<class t_list>
+class intersection_view
+{
+    public:
+        using list_itr = decltype(std::declval<const t_list&>().begin());
+        using const_iterator = intersection_view_itr<list_itr>;
+        using size_type = sdsl::int_vector<>::size_type;
+    private:
+        std::vector<t_list> m_lists;
+        std::vector<uint64_t> m_deltas;
+        int64_t m_offset = 0;
+    public:
+        intersection_view(const std::vector<t_list>& lists,const std::vector<uint64_t>& deltas,int64_t offset = 0)
+            : m_lists(lists), m_deltas(deltas), m_offset(offset) {}
+        const_iterator begin() const
+        {
+            return make_itr(false);
+        }
+        // iterator over the results in [start,stop)
+        const_iterator begin(uint64_t start,uint64_t stop = std::numeric_limits<uint64_t>::max()) const
+        {
+            return make_itr(false,start,stop);
+        }
+        const_iterator end() const
+        {
+            return make_itr(true);
+        }
+        // upper bound of the number of results
+        size_type size() const
+        {
+            return m_lists.empty() ? 0 : m_lists[0].size();
+        }
+        int64_t offset() const
+        {
+            return m_offset;
+        }
+    private:
+        const_iterator make_itr(bool end,uint64_t start = 0,
+                                uint64_t stop = std::numeric_limits<uint64_t>::max()) const
+        {
+            std::vector<list_itr> itrs;
+            std::vector<list_itr> ends;
+            if (!end) {
+                for (const auto& list : m_lists) {
+                    itrs.push_back(list.begin());
+                    ends.push_back(list.end());
+                }
+            }
+            return const_iterator(itrs,ends,m_deltas,end,start,stop);
+        }
+};
+
+template<class t_list>
+intersection_view<t_list>
+lazy_intersect(std::vector<t_list> lists)
+{
+    std::sort(lists.begin(),lists.end());
+    return intersection_view<t_list>(lists,std::vector<uint64_t>(lists.size(),0));
+}
+
+template<class t_list>
+intersection_view<t_list>
+lazy_pos_intersect(std::vector<t_list> lists)
+{
+    std::sort(lists.begin(),lists.end());
+    int64_t min_offset = lists[0].offset();
+    for (const auto& list : lists) min_offset = std::min(min_offset,list.offset());
+    std::vector<uint64_t> deltas;
+    for (const auto& list : lists) deltas.push_back(list.offset() - min_offset);
+    return intersection_view<t_list>(lists,deltas,min_offset);
+}
+
+/* k-way document-at-a-time intersection. the results of the intersection
+   view are written to the result until limit results are found */
+template<class t_list>
+intersection_result
+daat_intersect(const std::vector<t_list>& lists,const std::vector<uint64_t>& deltas,size_t limit = no_result_limit)
+{
+    intersection_view<t_list> view(lists,deltas);
+    intersection_result res(std::min(view.size(),limit));
+    size_t n = 0;
+    auto itr = view.begin();
+    auto end = view.end();
+    while (n < limit && itr != end) {
+        res[n++] = *itr;
+        ++itr;
+    }
+    res.resize(n);
+    return res;
+}
+
+template<class t_list>
+intersection_result
+daat_intersect(std::vector<t_list> lists,size_t limit = no_result_limit)
+{
+    std::sort(lists.begin(),lists.end());
+    return daat_intersect(lists,std::vector<uint64_t>(lists.size(),0),limit);
+}
+
+template<class t_list>
+intersection_result
+daat_pos_intersect(std::vector<t_list> lists,size_t limit = no_result_limit)
+{
+    std::sort(lists.begin(),lists.end());
+    int64_t min_offset = lists[0].offset();
+    for (const auto& list : lists) min_offset = std::min(min_offset,list.offset());
+    std::vector<uint64_t> deltas;
+    for (const auto& list : lists) deltas.push_back(list.offset() - min_offset);
+    auto res = daat_intersect(lists,deltas,limit);
+    res.offset = min_offset;
+    return res;
+}
+
+/* ranges of the parallel intersection hold at least this many elements
+   of the shortest list. each thread gets parallel_ranges_per_thread ranges
+   so threads finishing early can pick up the remaining ranges */
+const size_t parallel_min_range_size = 4096;
+const size_t parallel_ranges_per_thread = 4;
+
+/* range partitioned k-way intersection. the universe is split at elements
+   of the shortest list into ranges with the same number of candidates.
+   the ranges are intersected by tasks of the pool, each starting at the
+   first candidate of its range via skip() and stopping at the first
+   candidate of the next range. the results of the ranges are
+   concatenated. the lists have to be sorted by size. */
+template<class t_list>
+intersection_result
+parallel_daat_intersect(const std::vector<t_list>& lists,const std::vector<uint64_t>& deltas,thread_pool& pool)
+{
+    intersection_view<t_list> view(lists,deltas);
+    size_t n = lists[0].size();
+    size_t num_ranges = std::min(pool.size()*parallel_ranges_per_thread,n/parallel_min_range_size);
+    if (num_ranges <= 1) return daat_intersect(lists,deltas);
+
+    // range p contains the candidates [bounds[p],bounds[p+1]) which
+    // correspond to the elements [starts[p],starts[p+1]) of the first list
+    std::vector<uint64_t> bounds(num_ranges+1,0);
+    std::vector<size_t> starts(num_ranges+1,0);
+    auto first = lists[0].begin();
+    for (size_t p=1; p<num_ranges; p++) {
+        starts[p] = p*n/num_ranges;
+        uint64_t value = *(first+starts[p]);
+        bounds[p] = value >= deltas[0] ? value - deltas[0] : 0;
+        if (bounds[p] <= bounds[p-1]) {
+            bounds[p] = bounds[p-1];
+            starts[p] = starts[p-1];
+        }
+    }
+    bounds[num_ranges] = std::numeric_limits<uint64_t>::max();
+    starts[num_ranges] = n;
+
+    std::vector<std::future<intersection_result>> parts;
+    for (size_t p=0; p<num_ranges; p++) {
+        parts.emplace_back(pool.submit([&view,&bounds,&starts,p] {
+            intersection_result res(starts[p+1]-starts[p]);
+            size_t m = 0;
+            if (bounds[p] < bounds[p+1]) {
+                auto itr = view.begin(bounds[p],bounds[p+1]);
+                auto end = view.end();
+                while (itr != end) {
+                    res[m++] = *itr;
+                    ++itr;
+                }
+            }
+            res.resize(m);
+            return res;
+        }));
+    }
+    std::vector<intersection_result> results;
+    size_t total = 0;
+    for (auto& part : parts) {
+        results.emplace_back(pool.wait(part));
+        total += results.back().size();
+    }
+    intersection_result res(total);
+    size_t m = 0;
+    for (auto& r : results) {
+        for (size_t i=0; i<r.size(); i++) res[m++] = r[i];
+    }
+    return res;
+}
+
+template<class t_list>
+intersection_result
+parallel_intersect(std::vector<t_list> lists,thread_pool& pool = shared_thread_pool())
+{
+    std::sort(lists.begin(),lists.end());
+    return parallel_daat_intersect(lists,std::vector<uint64_t>(lists.size(),0),pool);
+}
+
+template<class t_list>
+intersection_result
+parallel_pos_intersect(std::vector<t_list> lists,thread_pool& pool = shared_thread_pool())
+{
+    std::sort(lists.begin(),lists.end());
+    int64_t min_offset = lists[0].offset();
+    for (const auto& list : lists) min_offset = std::min(min_offset,list.offset());
+    std::vector<uint64_t> deltas;
+    for (const auto& list : lists) deltas.push_back(list.offset() - min_offset);
+    auto res = parallel_daat_intersect(lists,deltas,pool);
+    res.offset = min_offset;
+    return res;
+}
+
+/* intersection strategies for intersect(lists) and pos_intersect(lists) */
+struct intersect_svs {
+    template<class t_list>
+    static intersection_result intersect(const std::vector<t_list>& lists,size_t limit = no_result_limit)
+    {
+        return svs_intersect(lists,limit);
+    }
+    template<class t_list>
+    static intersection_result pos_intersect(const std::vector<t_list>& lists,size_t limit = no_result_limit)
+    {
+        return svs_pos_intersect(lists,limit);
+    }
+};
+
+struct intersect_daat {
+    template<class t_list>
+    static intersection_result intersect(const std::vector<t_list>& lists,size_t limit = no_result_limit)
+    {
+        return daat_intersect(lists,limit);
+    }
+    template<class t_list>
+    static intersection_result pos_intersect(const std::vector<t_list>& lists,size_t limit = no_result_limit)
+    {
+        return daat_pos_intersect(lists,limit);
+    }
+};
+
+/* SvS for complete intersections, so each pair of lists is intersected
+   with the kernel intersect_policy picks for it. first-k queries use DAAT
+   which stops after k results */
+struct intersect_adaptive {
+    template<class t_list>
+    static intersection_result intersect(const std::vector<t_list>& lists,size_t limit = no_result_limit)
+    {
+        if (limit != no_result_limit || lists.size() < 2) return daat_intersect(lists,limit);
+        return svs_intersect(lists);
+    }
+    template<class t_list>
+    static intersection_result pos_intersect(const std::vector<t_list>& lists,size_t limit = no_result_limit)
+    {
+        if (limit != no_result_limit || lists.size() < 2) return daat_pos_intersect(lists,limit);
+        return svs_pos_intersect(lists);
+    }
+};
+
+/* intersects ranges of the universe in parallel on the shared thread pool.
+   first-k queries are answered sequentially as DAAT stops after k results */
+struct intersect_parallel {
+    template<class t_list>
+    static intersection_result intersect(const std::vector<t_list>& lists,size_t limit = no_result_limit)
+    {
+        if (limit != no_result_limit) return daat_intersect(lists,limit);
+        return parallel_intersect(lists);
+    }
+    template<class t_list>
+    static intersection_result pos_intersect(const std::vector<t_list>& lists,size_t limit = no_result_limit)
+    {
+        if (limit != no_result_limit) return daat_pos_intersect(lists,limit);
+        return parallel_pos_intersect(lists);
+    }
+};
+
+/* returns an intersection_view instead of the materialized result. only
+   usable where the result is iterated once, e.g. phrase_list(). the
+   consumer stops after as many results as it needs, so there is no limit */
+struct intersect_lazy {
+    template<class t_list>
+    static intersection_view<t_list> intersect(const std::vector<t_list>& lists)
+    {
+        return lazy_intersect(lists);
+    }
+    template<class t_list>
+    static intersection_view<t_list> pos_intersect(const std::vector<t_list>& lists)
+    {
+        return lazy_pos_intersect(lists);
+    }
+};
+
+template<class t_strategy=intersect_daat,class t_list>
+intersection_result
+intersect(const std::vector<t_list>& lists,size_t limit = no_result_limit)
+{
+    return t_strategy::intersect(lists,limit);
+}
+
+template<class t_strategy=intersect_daat,class t_list>
+intersection_result
+pos_intersect(const std::vector<t_list>& lists,size_t limit = no_result_limit)
+{
+    return t_strategy::pos_intersect(lists,limit);
+}
@@ -4,6 +4,25 @@
 
 #include  <algorithm>
 
+/* software prefetching ahead of skip(). a prefetch only hides latency if
+   other work runs before the location is read, so the iterators prefetch
+   what the next skip() reads (prefetch(pos,stage), used by the batch
+   executor) or the block after the one which is decoded. each prefetch
+   fetches the location and the prefetch_distance()-1 cache lines
+   following it. a distance of 0 disables the prefetches. */
+inline size_t& prefetch_distance()
+{
+    static size_t distance = 2;
+    return distance;
+}
+
+// prefetch the cache lines starting at bit offset bit_offset of data
+inline void prefetch_bits(const uint64_t* data,uint64_t bit_offset)
+{
+    const char* ptr = reinterpret_cast<const char*>(data + (bit_offset>>6));
+    for (size_t i=0; i<prefetch_distance(); i++) __builtin_prefetch(ptr + 64*i);
+}
+
 template<class t_itr>
 struct list_dummy {
     using size_type = sdsl::int_vector<>::size_type;
@@ -150,6 +169,7 @@ struct intersection_result {
 };
 
 using docfreq_result = std::vector<std::pair<uint64_t,uint64_t>>;
+using topk_result = std::vector<std::pair<uint64_t,double>>;
 
 template<class t_list>
 struct offset_proxy_list {
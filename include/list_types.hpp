@@ -4,5 +4,8 @@
 #include "eliasfano_skip_list.hpp"
 #include "eliasfano_sskip_list.hpp"
 #include "optpfor_list.hpp"
+#include "simd_block_list.hpp"
 #include "bitvector_list.hpp"
-#include "uniform_elias_fano.hpp"
\ No newline at end of file
+#include "uniform_elias_fano.hpp"
+#include "partitioned_elias_fano.hpp"
+#include "hybrid_list.hpp"
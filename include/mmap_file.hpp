@@ -0,0 +1,342 @@
+#pragma once
+
+#include <string>
+#include <vector>
+#include <memory>
+#include <istream>
+#include <fstream>
+#include <streambuf>
+#include <stdexcept>
+#include <cstring>
+#include <iostream>
+
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <fcntl.h>
+#include <unistd.h>
+
+#include "sdsl/int_vector.hpp"
+#include "sdsl/io.hpp"
+#include "bit_streams.hpp"
+
+enum class mmap_advice {normal,random,sequential,willneed,hugepage};
+
+/* read-only shared mapping of a file. pages are loaded on first access
+   and shared with all other processes mapping the same file */
+class mmap_file
+{
+    private:
+        int m_fd = -1;
+        char* m_data = nullptr;
+        size_t m_size = 0;
+    public:
+        mmap_file(const std::string& file_name,mmap_advice advice = mmap_advice::normal,bool populate = false)
+        {
+            m_fd = open(file_name.c_str(),O_RDONLY);
+            if (m_fd < 0) {
+                throw std::runtime_error("mmap_file: could not open file '"+file_name+"'");
+            }
+            struct stat st;
+            if (fstat(m_fd,&st) != 0) {
+                close(m_fd);
+                throw std::runtime_error("mmap_file: could not stat file '"+file_name+"'");
+            }
+            m_size = st.st_size;
+            if (m_size) {
+                int flags = MAP_SHARED;
+#ifdef MAP_POPULATE
+                if (populate) flags |= MAP_POPULATE;
+#endif
+                void* ptr = mmap(nullptr,m_size,PROT_READ,flags,m_fd,0);
+                if (ptr == MAP_FAILED) {
+                    close(m_fd);
+                    throw std::runtime_error("mmap_file: could not map file '"+file_name+"'");
+                }
+                m_data = (char*) ptr;
+                if (!advise(advice)) {
+                    std::cerr << "mmap_file: madvise failed on '" << file_name << "' (" << strerror(errno) << ")\n";
+                }
+            }
+        }
+        mmap_file(const mmap_file&) = delete;
+        mmap_file& operator=(const mmap_file&) = delete;
+        ~mmap_file()
+        {
+            if (m_data) munmap(m_data,m_size);
+            if (m_fd >= 0) close(m_fd);
+        }
+        const char* data() const
+        {
+            return m_data;
+        }
+        size_t size() const
+        {
+            return m_size;
+        }
+        // madvise the byte range [offset,offset+len). len=0 advises up to the end
+        bool advise(mmap_advice advice,size_t offset = 0,size_t len = 0) const
+        {
+            if (!m_data || advice == mmap_advice::normal) return true;
+            // the range has to start at a page boundary
+            size_t page_size = sysconf(_SC_PAGESIZE);
+            size_t start = offset - (offset % page_size);
+            if (len == 0 || offset+len > m_size) len = m_size - offset;
+            len += offset - start;
+            int adv = MADV_NORMAL;
+            switch (advice) {
+                case mmap_advice::random:
+                    adv = MADV_RANDOM;
+                    break;
+                case mmap_advice::sequential:
+                    adv = MADV_SEQUENTIAL;
+                    break;
+                case mmap_advice::willneed:
+                    adv = MADV_WILLNEED;
+                    break;
+                case mmap_advice::hugepage:
+#ifdef MADV_HUGEPAGE
+                    adv = MADV_HUGEPAGE;
+#endif
+                    break;
+                default:
+                    break;
+            }
+            return madvise(m_data+start,len,adv) == 0;
+        }
+};
+
+/* std::istream interface to a mapped file, used to load the small sdsl
+   members of an index from the mapping */
+class mmap_streambuf : public std::streambuf
+{
+    public:
+        mmap_streambuf(const mmap_file& file)
+        {
+            char* begin = const_cast<char*>(file.data());
+            setg(begin,begin,begin+file.size());
+        }
+    protected:
+        pos_type seekoff(off_type off,std::ios_base::seekdir dir,std::ios_base::openmode) override
+        {
+            char* pos = gptr();
+            if (dir == std::ios_base::beg) pos = eback()+off;
+            if (dir == std::ios_base::cur) pos = gptr()+off;
+            if (dir == std::ios_base::end) pos = egptr()+off;
+            if (pos < eback() || pos > egptr()) return pos_type(off_type(-1));
+            setg(eback(),pos,egptr());
+            return pos_type(pos-eback());
+        }
+        pos_type seekpos(pos_type pos,std::ios_base::openmode which) override
+        {
+            return seekoff(off_type(pos),std::ios_base::beg,which);
+        }
+};
+
+/* how an index is loaded from disk. with mmap the posting list data and
+   the list metadata are read directly from the mapped index file */
+struct index_load_options {
+    bool use_mmap = false;
+    mmap_advice advice = mmap_advice::normal;
+    bool populate = false; // fault in all pages when mapping the file
+};
+
+/* every index file starts with a header word holding index_file_magic
+   and the version of the on-disk layout. the version has to be increased
+   whenever the serialized layout of an index changes, as the file names
+   only depend on the index type.
+   version 2: codec id in the invidx list metadata
+   version 3: format marker in front of every padded array */
+const uint64_t index_file_magic = 0x504f53434d500000ULL; // "POSCMP"
+const uint64_t index_format_version = 3;
+const uint64_t index_format_marker = index_file_magic | index_format_version;
+
+inline uint64_t
+write_index_header(std::ostream& out)
+{
+    return sdsl::write_member(index_format_marker,out);
+}
+
+inline void
+check_index_header(std::istream& in,const std::string& file_name)
+{
+    uint64_t header = 0;
+    sdsl::read_member(header,in);
+    if (!in || (header & ~0xFFFFULL) != index_file_magic) {
+        throw std::runtime_error("index file '"+file_name+"' was written before format version "
+                                 +std::to_string(index_format_version)+". delete it to rebuild the index");
+    }
+    uint64_t version = header & 0xFFFFULL;
+    if (version != index_format_version) {
+        throw std::runtime_error("index file '"+file_name+"' has format version "+std::to_string(version)
+                                 +" instead of "+std::to_string(index_format_version)+". delete it to rebuild the index");
+    }
+}
+
+/* vector which either owns its elements (construction) or is a view of an
+   array inside a mapped file (loading) */
+template<class t_elem>
+class mappable_vector
+{
+    private:
+        std::vector<t_elem> m_vec;
+        const t_elem* m_view = nullptr;
+        size_t m_view_size = 0;
+    public:
+        mappable_vector() = default;
+        mappable_vector(const mappable_vector&) = default;
+        mappable_vector(mappable_vector&&) = default;
+        mappable_vector& operator=(const mappable_vector&) = default;
+        mappable_vector& operator=(mappable_vector&&) = default;
+        // the mapped elements are read-only. modifying a view copies them first
+        void make_owner()
+        {
+            if (m_view) {
+                m_vec.assign(m_view,m_view+m_view_size);
+                m_view = nullptr;
+            }
+        }
+        void resize(size_t n,const t_elem& x = t_elem())
+        {
+            make_owner();
+            m_vec.resize(n,x);
+        }
+        void push_back(const t_elem& x)
+        {
+            make_owner();
+            m_vec.push_back(x);
+        }
+        t_elem& operator[](size_t i)
+        {
+            make_owner();
+            return m_vec[i];
+        }
+        const t_elem& operator[](size_t i) const
+        {
+            return m_view ? m_view[i] : m_vec[i];
+        }
+        size_t size() const
+        {
+            return m_view ? m_view_size : m_vec.size();
+        }
+        const t_elem* data() const
+        {
+            return m_view ? m_view : m_vec.data();
+        }
+        /* read n elements from in. with a mapping the vector becomes a view
+           of the elements in the mapped file if they are suitably aligned.
+           the elements are only used in place if they follow the format
+           marker written by write_padding */
+        void load(std::istream& in,size_t n,const mmap_file* mapping = nullptr)
+        {
+            if (mapping != nullptr) {
+                auto pos = (std::streamoff) in.tellg();
+                const char* ptr = mapping->data() + pos;
+                uint64_t marker = 0;
+                if (pos >= (std::streamoff) sizeof(marker)) std::memcpy(&marker,ptr-sizeof(marker),sizeof(marker));
+                if (marker != index_format_marker) {
+                    throw std::runtime_error("mappable_vector: no format marker in front of the mapped array");
+                }
+                if ((uintptr_t)ptr % alignof(t_elem) == 0) {
+                    m_vec.clear();
+                    m_view = (const t_elem*) ptr;
+                    m_view_size = n;
+                    in.seekg(n*sizeof(t_elem),std::ios_base::cur);
+                    return;
+                }
+            }
+            m_view = nullptr;
+            m_vec.resize(n);
+            in.read((char*)m_vec.data(),n*sizeof(t_elem));
+        }
+};
+
+/* arrays which are used in place from a mapped file have to start at a
+   multiple of 8 bytes. the index files are padded with zero bytes before
+   those arrays, followed by index_format_marker. the padding only depends
+   on the position in the stream. */
+inline uint64_t
+write_padding(std::ostream& out)
+{
+    auto pos = (std::streamoff) out.tellp();
+    uint64_t pad = pos < 0 ? 0 : (8 - pos % 8) % 8;
+    const char zeros[8] = {0};
+    out.write(zeros,pad);
+    return pad + sdsl::write_member(index_format_marker,out);
+}
+
+inline void
+skip_padding(std::istream& in)
+{
+    auto pos = (std::streamoff) in.tellg();
+    in.seekg((8 - pos % 8) % 8,std::ios_base::cur);
+    uint64_t marker = 0;
+    sdsl::read_member(marker,in);
+    if (!in || marker != index_format_marker) {
+        throw std::runtime_error("skip_padding: no format marker after the padding at byte "+std::to_string(pos));
+    }
+}
+
+/* write bv padded to a multiple of 8 bytes and followed by a zero word, as
+   the decoders may read one word past the last bit */
+inline uint64_t
+write_bit_data(const sdsl::bit_vector& bv,std::ostream& out,sdsl::structure_tree_node* v=nullptr,std::string name="")
+{
+    uint64_t written_bytes = write_padding(out);
+    written_bytes += bv.serialize(out,v,name);
+    uint64_t guard = 0;
+    written_bytes += sdsl::write_member(guard,out);
+    return written_bytes;
+}
+
+/* load bit data written by write_bit_data and point is to it. with a
+   mapping the bits are read from the mapped file and bv stays empty. */
+inline void
+load_bit_data(std::istream& in,sdsl::bit_vector& bv,bit_istream& is,const mmap_file* mapping = nullptr)
+{
+    skip_padding(in);
+    uint64_t guard;
+    if (mapping != nullptr) {
+        uint64_t size;
+        sdsl::read_member(size,in);
+        const char* ptr = mapping->data() + (std::streamoff) in.tellg();
+        in.seekg(((size+63)>>6)*sizeof(uint64_t),std::ios_base::cur);
+        sdsl::read_member(guard,in);
+        is = bit_istream((const uint64_t*)ptr,size);
+        return;
+    }
+    bv.load(in);
+    sdsl::read_member(guard,in);
+    is = bit_istream(bv);
+}
+
+/* store idx to file_name behind the index header */
+template<class t_idx>
+uint64_t
+store_index_file(const t_idx& idx,const std::string& file_name)
+{
+    std::ofstream ofs(file_name);
+    uint64_t written_bytes = write_index_header(ofs);
+    written_bytes += idx.serialize(ofs);
+    return written_bytes;
+}
+
+/* load idx from file_name. with opts.use_mmap the file is mapped and the
+   returned mapping has to stay alive as long as the index is used. files
+   of another format version are rejected */
+template<class t_idx>
+std::shared_ptr<mmap_file>
+load_index_file(t_idx& idx,const std::string& file_name,const index_load_options& opts)
+{
+    if (!opts.use_mmap) {
+        std::ifstream ifs(file_name);
+        check_index_header(ifs,file_name);
+        idx.load(ifs);
+        return nullptr;
+    }
+    auto mapping = std::make_shared<mmap_file>(file_name,opts.advice,opts.populate);
+    mmap_streambuf buf(*mapping);
+    std::istream in(&buf);
+    check_index_header(in,file_name);
+    idx.load(in,mapping.get());
+    return mapping;
+}
@@ -12,6 +12,7 @@
 #include "deltautil.h"
 
 #include "list_basics.hpp"
+#include "block_search.hpp"
 
 template<uint16_t t_block_size,bool t_sorted>
 class optpfor_iterator : public std::iterator<std::random_access_iterator_tag,uint64_t,std::ptrdiff_t>
@@ -26,7 +27,7 @@ class optpfor_iterator : public std::iterator<std::random_access_iterator_tag,ui
         const uint32_t* m_block_start;
         const uint32_t* m_block_max;
         const uint32_t* m_data;
-        uint64_t m_num_blocks;
+        uint64_t m_num_blocks = 1;
 
     private:
         mutable comp_codec c;
@@ -136,46 +137,42 @@ class optpfor_iterator : public std::iterator<std::random_access_iterator_tag,ui
         {
             return (difference_type)offset() - (difference_type)b.offset();
         }
+        // the decoded values from the current position to the end of the block
+        const uint32_t* block_values(size_type& n) const
+        {
+            static_assert(t_sorted == true,"block access only works in sorted lists.");
+            if (m_cur_block != m_last_accessed_block) decode_current_block();
+            auto in_block_offset = m_cur_offset%t_block_size;
+            size_t block_size = (m_cur_block == m_num_blocks-1 && m_size % t_block_size != 0)  ? m_size % t_block_size : t_block_size;
+            n = block_size - in_block_offset;
+            return m_tmp_data + in_block_offset;
+        }
         bool skip(uint64_t pos)
         {
             static_assert(t_sorted == true,"skipping only works in sorted lists.");
-            auto in_block_offset = m_cur_offset%t_block_size;
-            if (m_tmp_data[in_block_offset]==pos) return true;
+            if (m_cur_offset >= m_size) return false;
             if (m_size > t_block_size && m_block_max[m_cur_block] < pos) { // more than one block?
                 // find correct block
-                bool found = false;
-                for (size_t i=m_cur_block+1; i<m_num_blocks; i++) {
-                    if (m_block_max[i] >= pos) {
-                        m_cur_block = i;
-                        in_block_offset = 0;
-                        found = true;
-                        if (m_block_max[i] == pos) {
-                            m_cur_block = i;
-                            size_t block_size = (m_cur_block == m_num_blocks-1)  ? m_size % t_block_size : t_block_size;
-                            in_block_offset = block_size-1;
-                            m_cur_offset = m_cur_block*t_block_size + in_block_offset;
-                            return true;
-                        }
-                        decode_current_block();
-                        break;
-                    }
-                }
-                // not found
-                if (!found) {
+                auto block = block_max_search(m_block_max,m_cur_block+1,m_num_blocks,pos);
+                if (block == m_num_blocks) {
                     m_cur_offset = m_size;
                     return false;
                 }
+                m_cur_block = block;
+                if (m_block_max[block] == pos) {
+                    m_cur_offset = m_cur_block*t_block_size + block_length(m_cur_block)-1;
+                    return true;
+                }
+                m_cur_offset = m_cur_block*t_block_size;
             }
+            // we might have moved to this block without decoding it
+            if (m_cur_block != m_last_accessed_block) decode_current_block();
             // search in block
-            size_t block_size = (m_cur_block == m_num_blocks-1 && m_size % t_block_size != 0)  ? m_size % t_block_size : t_block_size;
-            for (size_t i=in_block_offset; i<block_size; i++) {
-                if (m_tmp_data[i] >= pos) {
-                    m_cur_offset = m_cur_block*t_block_size + i;
-                    if (m_tmp_data[i] == pos) {
-                        return true;
-                    }
-                    return false;
-                }
+            size_t block_size = block_length(m_cur_block);
+            auto i = block_lower_bound(m_tmp_data,m_cur_offset%t_block_size,block_size,pos);
+            if (i < block_size) {
+                m_cur_offset = m_cur_block*t_block_size + i;
+                return m_tmp_data[i] == pos;
             }
             // nothing found in the expected block. move to next block
             if (m_cur_block == m_num_blocks-1) {
@@ -187,6 +184,11 @@ class optpfor_iterator : public std::iterator<std::random_access_iterator_tag,ui
             return false;
         }
     private:
+        size_type block_length(size_type block) const
+        {
+            if (block == m_num_blocks-1 && m_size % t_block_size != 0) return m_size % t_block_size;
+            return t_block_size;
+        }
         void decode_current_block() const
         {
             const uint32_t* block_data = m_data + m_block_start[m_cur_block];
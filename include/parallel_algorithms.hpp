@@ -0,0 +1,128 @@
+#pragma once
+
+#include <vector>
+#include <future>
+#include <algorithm>
+#include <iterator>
+#include <functional>
+
+#include "thread_pool.hpp"
+
+// inputs smaller than this are processed by the calling thread
+const size_t parallel_min_task_size = 1ULL << 16;
+
+/* call func(begin,end) on disjoint ranges covering [0,n) and wait until
+   all of them are processed */
+template<class t_func>
+void
+parallel_for(size_t n,t_func func,thread_pool& pool = shared_thread_pool())
+{
+    size_t parts = std::min(pool.size()*4,std::max<size_t>(1,n/parallel_min_task_size));
+    if (parts <= 1) {
+        func(size_t(0),n);
+        return;
+    }
+    std::vector<std::future<void>> res;
+    for (size_t i=0; i<parts; i++) {
+        size_t begin = i*n/parts;
+        size_t end = (i+1)*n/parts;
+        res.push_back(pool.submit([&func,begin,end] { func(begin,end); }));
+    }
+    for (auto& r : res) pool.wait(r);
+}
+
+/* sort [begin,end) by sorting one part per thread and merging the sorted
+   parts pairwise in parallel. uses std::inplace_merge, which needs a
+   buffer of up to half the input size. */
+template<class t_itr,class t_cmp>
+void
+parallel_sort(t_itr begin,t_itr end,t_cmp cmp,thread_pool& pool = shared_thread_pool())
+{
+    size_t n = std::distance(begin,end);
+    size_t parts = std::min(pool.size(),std::max<size_t>(1,n/parallel_min_task_size));
+    if (parts <= 1) {
+        std::sort(begin,end,cmp);
+        return;
+    }
+    std::vector<size_t> bounds(parts+1);
+    for (size_t i=0; i<=parts; i++) bounds[i] = i*n/parts;
+    std::vector<std::future<void>> res;
+    for (size_t i=0; i<parts; i++) {
+        auto b = begin+bounds[i];
+        auto e = begin+bounds[i+1];
+        res.push_back(pool.submit([b,e,&cmp] { std::sort(b,e,cmp); }));
+    }
+    for (auto& r : res) pool.wait(r);
+    for (size_t width=1; width<parts; width*=2) {
+        res.clear();
+        for (size_t i=0; i+width<parts; i+=2*width) {
+            auto b = begin+bounds[i];
+            auto m = begin+bounds[i+width];
+            auto e = begin+bounds[std::min(i+2*width,parts)];
+            res.push_back(pool.submit([b,m,e,&cmp] { std::inplace_merge(b,m,e,cmp); }));
+        }
+        for (auto& r : res) pool.wait(r);
+    }
+}
+
+template<class t_itr>
+void
+parallel_sort(t_itr begin,t_itr end,thread_pool& pool = shared_thread_pool())
+{
+    using value_type = typename std::iterator_traits<t_itr>::value_type;
+    parallel_sort(begin,end,std::less<value_type>(),pool);
+}
+
+/* sort the unsigned integers in keys, which are all smaller than
+   2^key_bits, with a least significant digit radix sort over 8 bit digits.
+   in every pass each thread counts the digits of one part of the keys and
+   then scatters that part to the positions given by the prefix sums over
+   (digit,part). passes where all keys share the digit are skipped. needs a
+   buffer of the input size. */
+template<class t_int>
+void
+parallel_radix_sort(std::vector<t_int>& keys,uint8_t key_bits = sizeof(t_int)*8,thread_pool& pool = shared_thread_pool())
+{
+    const size_t radix_bits = 8;
+    const size_t buckets = 1ULL << radix_bits;
+    size_t n = keys.size();
+    size_t parts = std::min(pool.size()*4,std::max<size_t>(1,n/parallel_min_task_size));
+    if (parts <= 1) {
+        std::sort(keys.begin(),keys.end());
+        return;
+    }
+    std::vector<t_int> buf(n);
+    std::vector<size_t> offsets(parts*buckets);
+    auto run_parts = [&](std::function<void(size_t,size_t,size_t)> func) {
+        std::vector<std::future<void>> res;
+        for (size_t p=0; p<parts; p++) {
+            res.push_back(pool.submit([&func,p,parts,n] { func(p,p*n/parts,(p+1)*n/parts); }));
+        }
+        for (auto& r : res) pool.wait(r);
+    };
+    for (size_t shift=0; shift<key_bits; shift+=radix_bits) {
+        std::fill(offsets.begin(),offsets.end(),0);
+        run_parts([&](size_t p,size_t b,size_t e) {
+            size_t* cnt = offsets.data()+p*buckets;
+            for (size_t i=b; i<e; i++) cnt[(keys[i]>>shift)&(buckets-1)]++;
+        });
+        size_t sum = 0;
+        bool single_digit = false;
+        for (size_t d=0; d<buckets; d++) {
+            size_t digit_sum = 0;
+            for (size_t p=0; p<parts; p++) {
+                size_t cnt = offsets[p*buckets+d];
+                offsets[p*buckets+d] = sum;
+                sum += cnt;
+                digit_sum += cnt;
+            }
+            if (digit_sum == n) single_digit = true;
+        }
+        if (single_digit) continue;
+        run_parts([&](size_t p,size_t b,size_t e) {
+            size_t* pos = offsets.data()+p*buckets;
+            for (size_t i=b; i<e; i++) buf[pos[(keys[i]>>shift)&(buckets-1)]++] = keys[i];
+        });
+        keys.swap(buf);
+    }
+}
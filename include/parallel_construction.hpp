@@ -0,0 +1,95 @@
+#pragma once
+
+#include <vector>
+#include <deque>
+#include <future>
+
+#include "sdsl/int_vector.hpp"
+#include "bit_streams.hpp"
+#include "thread_pool.hpp"
+
+/* the postings lists of an index are encoded in chunks of consecutive
+   terms. every chunk is encoded into a private bit_ostream by a worker of
+   the thread pool and appended to the index at the next 64 bit boundary,
+   so the list encodings (which align to 64 bits) do not depend on where
+   the chunk ends up. the chunks only depend on the list lengths, so the
+   index is the same for any number of threads. */
+const size_t construction_chunk_postings = 1ULL << 22;
+const size_t construction_chunk_terms = 1ULL << 16;
+
+struct term_chunk {
+    size_t begin;         // first term of the chunk
+    size_t end;           // one past the last term
+    size_t first_posting; // offset of the first posting of the chunk in D/POS
+};
+
+/* split the terms [first_term,C.size()) into chunks of at most
+   max_terms terms. a chunk is closed as soon as it holds max_postings
+   postings */
+template<class t_counts>
+std::vector<term_chunk>
+partition_terms(const t_counts& C,size_t first_term = 2,
+                size_t max_postings = construction_chunk_postings,
+                size_t max_terms = construction_chunk_terms)
+{
+    std::vector<term_chunk> chunks;
+    size_t csum = 0;
+    for (size_t i=0; i<first_term && i<C.size(); i++) csum += C[i];
+    term_chunk cur {first_term,first_term,csum};
+    size_t postings = 0;
+    for (size_t i=first_term; i<C.size(); i++) {
+        postings += C[i];
+        csum += C[i];
+        cur.end = i+1;
+        if (postings >= max_postings || cur.end-cur.begin >= max_terms) {
+            chunks.push_back(cur);
+            cur = term_chunk {i+1,i+1,csum};
+            postings = 0;
+        }
+    }
+    if (cur.end != cur.begin) chunks.push_back(cur);
+    return chunks;
+}
+
+/* append the bits of bv to os at the next 64 bit boundary. returns the
+   offset of the first appended bit, which the offsets relative to bv have
+   to be rebased by */
+inline uint64_t
+append_aligned(bit_ostream& os,const sdsl::bit_vector& bv)
+{
+    os.expand_if_needed(64+bv.size());
+    os.align64();
+    auto offset = os.tellp();
+    if (bv.size()) os.write(bv.data(),bv.size());
+    return offset;
+}
+
+/* run encode(chunk) for all chunks on the pool and commit(chunk,result) in
+   chunk order on the calling thread. at most two chunks per thread are
+   encoded ahead of the chunk that is committed next, which bounds the
+   memory used by the private streams. */
+template<class t_chunk,class t_encode,class t_commit>
+void
+encode_chunks(const std::vector<t_chunk>& chunks,t_encode encode,t_commit commit,
+              thread_pool& pool = shared_thread_pool())
+{
+    using result_type = typename std::result_of<t_encode(const t_chunk&)>::type;
+    std::deque<std::future<result_type>> pending;
+    size_t window = 2*pool.size();
+    size_t next = 0;
+    try {
+        for (size_t i=0; i<chunks.size(); i++) {
+            while (next < chunks.size() && pending.size() < window) {
+                const t_chunk* chunk = &chunks[next++];
+                pending.push_back(pool.submit([&encode,chunk] { return encode(*chunk); }));
+            }
+            auto res = pool.wait(pending.front());
+            pending.pop_front();
+            commit(chunks[i],res);
+        }
+    } catch (...) {
+        // the queued tasks reference encode
+        for (auto& res : pending) res.wait();
+        throw;
+    }
+}
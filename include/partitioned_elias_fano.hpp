@@ -0,0 +1,476 @@
+#pragma once
+
+#include <iterator>
+#include <vector>
+#include <algorithm>
+
+#include "bit_streams.hpp"
+#include "bit_coders.hpp"
+#include "bit_magic.hpp"
+
+#include "list_basics.hpp"
+#include "eliasfano_list.hpp"
+#include "bitvector_list.hpp"
+#include "uniform_elias_fano.hpp"
+
+/* partitioned elias-fano (ottaviano and venturini, sigir'14). the list is
+   cut into partitions of variable length which are encoded independently
+   relative to the last element of the previous partition. a partition is
+   either a run of consecutive integers (FULL, no payload), a bitvector or
+   an elias-fano list, whichever is smaller. the partition boundaries are
+   chosen by the approximate dynamic program of the paper which finds a
+   partitioning whose cost is within (1+eps) of the optimum in linear time.
+
+   layout:
+     gamma(m+1) gamma(P+1)
+     P == 1 : gamma(last+1)
+     P  > 1 : gamma(wu) gamma(we) gamma(wo)
+              P records of (last value : wu bits, end offset : we bits,
+                            payload offset : wo bits)
+     payload of all partitions
+   payload offsets are relative to the start of the first payload. */
+
+// width of the low part of an elias-fano list of m elements in [0,u]
+inline uint8_t
+pef_low_width(uint64_t m,uint64_t u)
+{
+    uint8_t logm = sdsl::bits::hi(m)+1;
+    uint8_t logu = sdsl::bits::hi(u)+1;
+    if (logu < logm) return 1;
+    if (logm == logu) logm--;
+    return logu - logm;
+}
+
+// encoding of a partition of m elements whose largest relative value is n
+inline uef_blocktype
+pef_partition_type(uint64_t m,uint64_t n)
+{
+    if (n == m-1) return uef_blocktype::FULL;
+    uint8_t w = pef_low_width(m,n);
+    uint64_t ef_bits = m*w + (n>>w) + m + 1;
+    uint64_t bv_bits = n + 2;
+    if (bv_bits < ef_bits) return uef_blocktype::BV;
+    return uef_blocktype::EF;
+}
+
+// exact payload size of a partition in bits
+inline uint64_t
+pef_partition_bits(uint64_t m,uint64_t n)
+{
+    if (n == m-1) return 0;
+    uint8_t w = pef_low_width(m,n);
+    uint64_t ef_bits = m*w + (n>>w) + m + 1;
+    uint64_t bv_bits = n + 2;
+    return std::min(ef_bits,bv_bits);
+}
+
+/* the approximate optimal partitioning of [begin,end). cost(u,m) is the
+   cost of a partition of m elements spanning a universe of u values. for
+   every cost bound F*(1+eps2)^i up to F/eps1, where F is the cost of the
+   smallest partition, a window is slid over the list which is extended as
+   long as its cost stays below the bound. only the edges to the ends of
+   the windows are relaxed, which makes the shortest path computation
+   linear. returns the end offsets of the partitions. */
+template<class t_itr,class t_cost>
+std::vector<uint64_t>
+optimal_partition(t_itr begin,t_itr end,t_cost cost,double eps1,double eps2)
+{
+    struct cost_window {
+        t_itr start_itr;
+        t_itr end_itr;
+        uint64_t start = 0;
+        uint64_t end = 0;
+        uint64_t min_p = 0; // first value of the universe of the window
+        uint64_t max_p = 0;
+        uint64_t cost_upper_bound;
+        cost_window(t_itr b,uint64_t bound) : start_itr(b), end_itr(b), cost_upper_bound(bound) {}
+        void advance_start()
+        {
+            min_p = *start_itr + 1;
+            ++start;
+            ++start_itr;
+        }
+        void advance_end()
+        {
+            max_p = *end_itr;
+            ++end;
+            ++end_itr;
+        }
+        uint64_t universe() const
+        {
+            return max_p - min_p + 1;
+        }
+        uint64_t size() const
+        {
+            return end - start;
+        }
+    };
+
+    uint64_t size = std::distance(begin,end);
+    uint64_t single_partition_cost = cost(*(end-1)+1,size);
+    std::vector<uint64_t> min_cost(size+1,single_partition_cost);
+    std::vector<uint64_t> path(size+1,0);
+    min_cost[0] = 0;
+
+    std::vector<cost_window> windows;
+    uint64_t cost_lb = cost(1,1);
+    double cost_bound = cost_lb;
+    while (eps1 == 0 || cost_bound < cost_lb/eps1) {
+        windows.emplace_back(begin,(uint64_t)cost_bound);
+        if (cost_bound >= single_partition_cost) break;
+        cost_bound = cost_bound*(1+eps2);
+    }
+
+    for (uint64_t i=0; i<size; i++) {
+        uint64_t last_end = i+1;
+        for (auto& window : windows) {
+            while (window.end < last_end) window.advance_end();
+            while (true) {
+                uint64_t window_cost = cost(window.universe(),window.size());
+                if (min_cost[i] + window_cost < min_cost[window.end]) {
+                    min_cost[window.end] = min_cost[i] + window_cost;
+                    path[window.end] = i;
+                }
+                last_end = window.end;
+                if (window.end == size) break;
+                if (window_cost >= window.cost_upper_bound) break;
+                window.advance_end();
+            }
+            window.advance_start();
+        }
+    }
+
+    std::vector<uint64_t> partition_ends;
+    for (uint64_t cur = size; cur != 0; cur = path[cur]) partition_ends.push_back(cur);
+    std::reverse(partition_ends.begin(),partition_ends.end());
+    return partition_ends;
+}
+
+class partitioned_ef_iterator : public std::iterator<std::random_access_iterator_tag,uint64_t,std::ptrdiff_t>
+{
+    public:
+        using size_type = sdsl::int_vector<>::size_type;
+    private:
+        uint64_t m_size = 0;
+        uint64_t m_num_parts = 0;
+        uint64_t m_last = 0; // last value if there is a single partition
+        uint8_t m_width_upper = 0;
+        uint8_t m_width_end = 0;
+        uint8_t m_width_offset = 0;
+        size_type m_records_offset = 0;
+        size_type m_payload_offset = 0;
+        const uint64_t* m_data = nullptr;
+        size_type m_stream_size = 0;
+    private:
+        mutable value_type m_cur_elem = 0;
+        mutable size_type m_last_accessed_offset = std::numeric_limits<uint64_t>::max();
+        size_type m_cur_offset = 0;
+        mutable size_type m_part = 0;
+        mutable size_type m_part_begin = 0;
+        mutable size_type m_part_end = 0;
+        mutable uint64_t m_part_base = 0;
+        mutable uint64_t m_part_upper = 0;
+        mutable uef_blocktype m_part_type = uef_blocktype::FULL;
+        mutable ef_iterator<true,true> m_ef_itr;
+        mutable bv_iterator<true> m_bv_itr;
+    public:
+        partitioned_ef_iterator() = default;
+        partitioned_ef_iterator(const partitioned_ef_iterator& pi) = default;
+        partitioned_ef_iterator(partitioned_ef_iterator&& pi) = default;
+        partitioned_ef_iterator& operator=(partitioned_ef_iterator&& pi) = default;
+        partitioned_ef_iterator& operator=(const partitioned_ef_iterator& pi) = default;
+    public:
+        partitioned_ef_iterator(const bit_istream& is,size_t start_offset,bool end)
+            : m_stream_size(is.size())
+        {
+            m_data = is.data();
+            is.seek(start_offset);
+            m_size = is.decode<coder::elias_gamma>() - 1;
+            m_num_parts = is.decode<coder::elias_gamma>() - 1;
+            if (m_num_parts == 1) {
+                m_last = is.decode<coder::elias_gamma>() - 1;
+            } else {
+                m_width_upper = is.decode<coder::elias_gamma>();
+                m_width_end = is.decode<coder::elias_gamma>();
+                m_width_offset = is.decode<coder::elias_gamma>();
+                m_records_offset = is.tellg();
+                is.skip(m_num_parts*(m_width_upper+m_width_end+m_width_offset));
+            }
+            m_payload_offset = is.tellg();
+            m_cur_offset = end ? m_size : 0;
+            if (!end) {
+                load_partition(0);
+                access_current_elem();
+            }
+        }
+    public:
+        size_type offset() const
+        {
+            return m_cur_offset;
+        }
+        size_type size() const
+        {
+            return m_size;
+        }
+        size_type remaining() const
+        {
+            return m_size - m_cur_offset;
+        }
+        uint64_t operator*() const
+        {
+            if (m_last_accessed_offset != m_cur_offset) access_current_elem();
+            return m_cur_elem;
+        }
+        bool operator ==(const partitioned_ef_iterator& b) const
+        {
+            return m_cur_offset == b.m_cur_offset;
+        }
+        bool operator !=(const partitioned_ef_iterator& b) const
+        {
+            return m_cur_offset != b.m_cur_offset;
+        }
+        partitioned_ef_iterator operator++(int)
+        {
+            partitioned_ef_iterator tmp(*this);
+            m_cur_offset++;
+            return tmp;
+        }
+        partitioned_ef_iterator& operator++()
+        {
+            m_cur_offset++;
+            return *this;
+        }
+        partitioned_ef_iterator& operator+=(size_type i)
+        {
+            m_cur_offset += i;
+            return *this;
+        }
+        partitioned_ef_iterator operator+(size_type i)
+        {
+            partitioned_ef_iterator tmp(*this);
+            tmp += i;
+            return tmp;
+        }
+        template<class t_itr>
+        auto operator-(const t_itr& b) const -> difference_type
+        {
+            return (difference_type)offset() - (difference_type)b.offset();
+        }
+        bool skip(uint64_t pos)
+        {
+            if (m_cur_offset >= m_size) return false;
+            auto cur = **this; // syncs the partition with the current offset
+            if (cur >= pos) return cur == pos;
+            if (pos > m_part_upper) {
+                auto part = search(m_part+1,pos,[this](size_type p) {
+                    return part_upper(p);
+                });
+                if (part == m_num_parts) {
+                    m_cur_offset = m_size;
+                    return false;
+                }
+                load_partition(part);
+            }
+            // invariant: pos <= m_part_upper so the partition contains an element >= pos
+            auto rel_pos = pos - m_part_base;
+            bool found = true;
+            size_type in_part_offset = rel_pos;
+            switch (m_part_type) {
+                case uef_blocktype::BV:
+                    found = m_bv_itr.skip(rel_pos);
+                    in_part_offset = m_bv_itr.offset();
+                    m_cur_elem = m_part_base + *m_bv_itr;
+                    break;
+                case uef_blocktype::EF:
+                    found = m_ef_itr.skip(rel_pos);
+                    in_part_offset = m_ef_itr.offset();
+                    m_cur_elem = m_part_base + *m_ef_itr;
+                    break;
+                case uef_blocktype::FULL:
+                    m_cur_elem = pos;
+                    break;
+            }
+            m_cur_offset = m_part_begin + in_part_offset;
+            m_last_accessed_offset = m_cur_offset;
+            return found;
+        }
+    private:
+        uint64_t record(size_type p,uint8_t field_offset,uint8_t width) const
+        {
+            auto off = m_records_offset + p*(m_width_upper+m_width_end+m_width_offset) + field_offset;
+            return sdsl::bits::read_int(m_data+(off>>6),off&0x3F,width);
+        }
+        uint64_t part_upper(size_type p) const
+        {
+            if (m_num_parts == 1) return m_last;
+            return record(p,0,m_width_upper);
+        }
+        uint64_t part_end(size_type p) const
+        {
+            if (m_num_parts == 1) return m_size;
+            return record(p,m_width_upper,m_width_end);
+        }
+        uint64_t part_offset(size_type p) const
+        {
+            if (m_num_parts == 1) return 0;
+            return record(p,m_width_upper+m_width_end,m_width_offset);
+        }
+        // the first partition >= p whose key is >= x, galloping from p
+        template<class t_key>
+        size_type search(size_type p,uint64_t x,t_key key) const
+        {
+            size_type lo = p;
+            size_type hi = p;
+            size_type step = 1;
+            while (hi < m_num_parts && key(hi) < x) {
+                lo = hi + 1;
+                hi += step;
+                step *= 2;
+            }
+            hi = std::min<size_type>(hi,m_num_parts);
+            while (lo < hi) {
+                auto mid = lo + (hi-lo)/2;
+                if (key(mid) < x) lo = mid + 1;
+                else hi = mid;
+            }
+            return lo;
+        }
+        void load_partition(size_type p) const
+        {
+            m_part = p;
+            m_part_begin = (p == 0) ? 0 : part_end(p-1);
+            m_part_end = part_end(p);
+            m_part_base = (p == 0) ? 0 : part_upper(p-1) + 1;
+            m_part_upper = part_upper(p);
+            auto m = m_part_end - m_part_begin;
+            auto n = m_part_upper - m_part_base;
+            m_part_type = pef_partition_type(m,n);
+            // private cursor, the iterator may outlive the stream it was created from
+            bit_istream is(m_data,m_stream_size);
+            auto offset = m_payload_offset + part_offset(p);
+            if (m_part_type == uef_blocktype::BV) {
+                m_bv_itr = bitvector_list<true>::materialize(is,offset,m,n).begin();
+            }
+            if (m_part_type == uef_blocktype::EF) {
+                m_ef_itr = eliasfano_list<true,true>::materialize(is,offset,m,n).begin();
+            }
+        }
+        void access_current_elem() const
+        {
+            if (m_cur_offset < m_part_begin) {
+                load_partition(search(0,m_cur_offset+1,[this](size_type p) {
+                    return part_end(p);
+                }));
+            } else if (m_cur_offset >= m_part_end) {
+                load_partition(search(m_part+1,m_cur_offset+1,[this](size_type p) {
+                    return part_end(p);
+                }));
+            }
+            auto in_part_offset = m_cur_offset - m_part_begin;
+            switch (m_part_type) {
+                case uef_blocktype::BV:
+                    if (in_part_offset < m_bv_itr.offset()) load_partition(m_part);
+                    m_bv_itr += in_part_offset - m_bv_itr.offset();
+                    m_cur_elem = m_part_base + *m_bv_itr;
+                    break;
+                case uef_blocktype::EF:
+                    if (in_part_offset < m_ef_itr.offset()) load_partition(m_part);
+                    m_ef_itr += in_part_offset - m_ef_itr.offset();
+                    m_cur_elem = m_part_base + *m_ef_itr;
+                    break;
+                case uef_blocktype::FULL:
+                    m_cur_elem = m_part_base + in_part_offset;
+                    break;
+            }
+            m_last_accessed_offset = m_cur_offset;
+        }
+};
+
+struct partitioned_eliasfano_list {
+    using size_type = sdsl::int_vector<>::size_type;
+    using iterator_type = partitioned_ef_iterator;
+    using list_type = list_dummy<iterator_type>;
+
+    template<class t_itr>
+    static size_type create(bit_ostream& os,t_itr begin,t_itr end)
+    {
+        size_type data_offset = os.tellp();
+
+        uint64_t m = std::distance(begin,end);
+        uint64_t last = *(end-1);
+
+        // (1) partitioning. the fixed cost of a partition is an estimate of its record
+        uint64_t fix_cost = (sdsl::bits::hi(last)+1) + (sdsl::bits::hi(m)+1)
+                            + (sdsl::bits::hi(pef_partition_bits(m,last)+1)+1);
+        auto partition_ends = optimal_partition(begin,end,[fix_cost](uint64_t u,uint64_t n) {
+            return fix_cost + pef_partition_bits(n,u-1);
+        },0.03,0.3);
+        uint64_t num_parts = partition_ends.size();
+
+        // (2) records
+        std::vector<uint64_t> uppers(num_parts);
+        std::vector<uint64_t> offsets(num_parts);
+        uint64_t payload_bits = 0;
+        uint64_t prev_end = 0;
+        uint64_t base = 0;
+        for (size_t p=0; p<num_parts; p++) {
+            uppers[p] = *(begin+(partition_ends[p]-1));
+            offsets[p] = payload_bits;
+            payload_bits += pef_partition_bits(partition_ends[p]-prev_end,uppers[p]-base);
+            prev_end = partition_ends[p];
+            base = uppers[p] + 1;
+        }
+        os.encode_check_size<coder::elias_gamma>(m+1);
+        os.encode_check_size<coder::elias_gamma>(num_parts+1);
+        if (num_parts == 1) {
+            os.encode_check_size<coder::elias_gamma>(last+1);
+        } else {
+            uint8_t width_upper = sdsl::bits::hi(last)+1;
+            uint8_t width_end = sdsl::bits::hi(m)+1;
+            uint8_t width_offset = sdsl::bits::hi(payload_bits|1)+1; // all partitions may be runs
+            os.encode_check_size<coder::elias_gamma>(width_upper);
+            os.encode_check_size<coder::elias_gamma>(width_end);
+            os.encode_check_size<coder::elias_gamma>(width_offset);
+            os.expand_if_needed(num_parts*(width_upper+width_end+width_offset));
+            for (size_t p=0; p<num_parts; p++) {
+                os.put_int_no_size_check(uppers[p],width_upper);
+                os.put_int_no_size_check(partition_ends[p],width_end);
+                os.put_int_no_size_check(offsets[p],width_offset);
+            }
+        }
+
+        // (3) payload
+        std::vector<uint64_t> tmp;
+        auto itr = begin;
+        prev_end = 0;
+        base = 0;
+        for (size_t p=0; p<num_parts; p++) {
+            uint64_t n = uppers[p] - base;
+            uint64_t part_size = partition_ends[p] - prev_end;
+            tmp.resize(part_size);
+            for (size_t j=0; j<part_size; j++) {
+                tmp[j] = *itr - base;
+                ++itr;
+            }
+            switch (pef_partition_type(part_size,n)) {
+                case uef_blocktype::BV:
+                    bitvector_list<true>::create(os,tmp.begin(),tmp.end(),n);
+                    break;
+                case uef_blocktype::EF:
+                    eliasfano_list<true,true>::create(os,tmp.begin(),tmp.end(),part_size,n);
+                    break;
+                case uef_blocktype::FULL:
+                    break;
+            }
+            prev_end = partition_ends[p];
+            base = uppers[p] + 1;
+        }
+
+        return data_offset;
+    }
+
+    static list_dummy<iterator_type> materialize(const bit_istream& is,size_t start_offset)
+    {
+        return list_dummy<iterator_type>(iterator_type(is,start_offset,false),iterator_type(is,start_offset,true));
+    }
+};
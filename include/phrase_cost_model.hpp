@@ -0,0 +1,203 @@
+#pragma once
+
+#include <vector>
+#include <array>
+#include <algorithm>
+#include <limits>
+#include <cmath>
+
+#include "sdsl/int_vector.hpp"
+
+/* cost estimates of the physical plans of a phrase query. the estimates
+   only use the term counts (C), the 2-token counts (CC/SCC) of the
+   collection and optionally the exact number of occurrences taken from a
+   CSA, so a plan can be picked before any list is touched. */
+
+// the physical plans of a phrase query
+enum class phrase_plan {
+    abspos,   // positional intersection of the term lists (index_abspos)
+    nextword, // positional intersection of the 2-token lists (index_nextword)
+    sada,     // backward search and document listing (index_sada)
+    wt,       // backward search and document listing (index_wt)
+    none      // the phrase does not occur, no index is queried
+};
+const size_t num_phrase_plans = 4;
+
+inline const char* phrase_plan_name(phrase_plan plan)
+{
+    switch (plan) {
+        case phrase_plan::abspos:
+            return "ABSPOS";
+        case phrase_plan::nextword:
+            return "NEXTWORD";
+        case phrase_plan::sada:
+            return "SADA";
+        case phrase_plan::wt:
+            return "WT";
+        default:
+            return "NONE";
+    }
+}
+
+/* the cost of the basic operations of the plans in ns. the defaults are
+   rough values for lists and CSAs which do not fit into the cache.
+   index-bench-planner.x reports the estimates next to the measured times
+   of every plan to calibrate them for a machine and collection */
+struct phrase_cost_model {
+    double scan_ns = 4;             // one element of the shortest list
+    double skip_ns = 30;            // one skip() into a longer list, per log2 of the size ratio
+    double map_doc_ns = 15;         // mapping a position to its document
+    double pair_lookup_ns = 250;    // locating a 2-token list
+    double backward_step_ns = 800;  // one step of the backward search
+    double sada_doc_ns = 3000;      // one document reported by index_sada
+    double wt_doc_ns = 100;         // one document and wavelet tree level of index_wt
+};
+
+/* estimated costs of all plans of one phrase. unavailable plans cost
+   infinity */
+struct phrase_estimate {
+    double occ = 0;  // occurrences of the phrase
+    double ndoc = 0; // documents containing the phrase
+    std::array<double,num_phrase_plans> cost;
+
+    phrase_estimate()
+    {
+        cost.fill(std::numeric_limits<double>::infinity());
+    }
+    bool available(phrase_plan plan) const
+    {
+        return cost[(size_t)plan] != std::numeric_limits<double>::infinity();
+    }
+    // the cheapest available plan, none if the phrase does not occur
+    phrase_plan best() const
+    {
+        phrase_plan plan = phrase_plan::none;
+        double min_cost = std::numeric_limits<double>::infinity();
+        for (size_t i=0; i<num_phrase_plans; i++) {
+            if (cost[i] < min_cost) {
+                min_cost = cost[i];
+                plan = (phrase_plan)i;
+            }
+        }
+        return plan;
+    }
+};
+
+/* term and 2-token counts of the collection. pair ids are
+   (id1 << sym_width) + id2 as in CC */
+class phrase_statistics
+{
+    public:
+        using size_type = sdsl::int_vector<>::size_type;
+    private:
+        sdsl::int_vector<> m_C;   // occurrences of each term
+        sdsl::int_vector<> m_CC;  // the distinct 2-token ids in increasing order
+        sdsl::int_vector<> m_SCC; // occurrences of each 2-token id
+        uint64_t m_sym_width = 0;
+        uint64_t m_num_docs = 0;
+    public:
+        phrase_statistics() = default;
+        phrase_statistics(sdsl::int_vector<> C,sdsl::int_vector<> CC,sdsl::int_vector<> SCC,
+                          uint64_t sym_width,uint64_t num_docs)
+            : m_C(std::move(C)), m_CC(std::move(CC)), m_SCC(std::move(SCC)),
+              m_sym_width(sym_width), m_num_docs(num_docs)
+        {
+        }
+        uint64_t num_docs() const
+        {
+            return m_num_docs;
+        }
+        uint64_t term_count(uint64_t id) const
+        {
+            return id < m_C.size() ? m_C[id] : 0;
+        }
+        uint64_t pair_count(uint64_t id1,uint64_t id2) const
+        {
+            uint64_t id = (id1 << m_sym_width) + id2;
+            auto itr = std::lower_bound(m_CC.begin(),m_CC.end(),id);
+            if (itr == m_CC.end() || *itr != id) return 0;
+            return m_SCC[itr-m_CC.begin()];
+        }
+        /* occurrences of the phrase under a first order markov model of
+           the text, bounded by the smallest 2-token count */
+        double estimate_occurrences(const std::vector<uint64_t>& ids) const
+        {
+            if (ids.empty()) return 0;
+            if (ids.size() == 1) return term_count(ids[0]);
+            double occ = pair_count(ids[0],ids[1]);
+            double min_count = occ;
+            for (size_t i=1; i+1<ids.size() && occ > 0; i++) {
+                double count = pair_count(ids[i],ids[i+1]);
+                occ = occ * count / term_count(ids[i]);
+                min_count = std::min(min_count,count);
+            }
+            return std::min(occ,min_count);
+        }
+};
+
+/* the 2-token lists index_nextword intersects for the phrase: the pairs
+   starting at 0,2,4,.. and the last pair if the phrase length is odd */
+inline std::vector<size_t>
+nextword_pair_offsets(size_t m)
+{
+    std::vector<size_t> offsets;
+    for (size_t i=0; i+1<m; i+=2) offsets.push_back(i);
+    if (m > 2 && m%2 != 0) offsets.push_back(m-2);
+    return offsets;
+}
+
+/* the shortest list provides the candidates, every candidate is skipped
+   to in the longer lists. a skip gets more expensive the sparser the
+   candidates are in the list. frac is the part of the result required */
+inline double
+daat_cost(std::vector<uint64_t> sizes,double frac,const phrase_cost_model& model)
+{
+    std::sort(sizes.begin(),sizes.end());
+    double s0 = std::max<uint64_t>(sizes[0],1);
+    double per_candidate = model.scan_ns;
+    for (size_t i=1; i<sizes.size(); i++) {
+        per_candidate += model.skip_ns * (1 + std::log2(1 + sizes[i]/s0));
+    }
+    return s0 * per_candidate * frac;
+}
+
+/* the costs of all plans of the phrase. occ is the number of occurrences
+   if it is known (e.g. from a CSA) and negative otherwise. k is the number
+   of documents or, if positions is set, the number of positions required.
+   the CSA plans only report documents and always report all of them. */
+inline phrase_estimate
+estimate_phrase_cost(const phrase_statistics& stats,const std::vector<uint64_t>& ids,double occ,
+                     size_t k,bool positions,const phrase_cost_model& model = phrase_cost_model())
+{
+    phrase_estimate est;
+    size_t m = ids.size();
+    if (m == 0 || k == 0) return est;
+    // a missing term or 2-token means the phrase does not occur
+    std::vector<uint64_t> term_sizes;
+    for (const auto& id : ids) term_sizes.push_back(stats.term_count(id));
+    if (*std::min_element(term_sizes.begin(),term_sizes.end()) == 0) return est;
+    std::vector<uint64_t> pair_counts;
+    for (size_t i=0; i+1<m; i++) pair_counts.push_back(stats.pair_count(ids[i],ids[i+1]));
+    if (!pair_counts.empty() && *std::min_element(pair_counts.begin(),pair_counts.end()) == 0) return est;
+    std::vector<uint64_t> pair_sizes;
+    for (auto i : nextword_pair_offsets(m)) pair_sizes.push_back(pair_counts[i]);
+    est.occ = occ < 0 ? stats.estimate_occurrences(ids) : occ;
+    if (est.occ == 0) return est;
+    // expected number of distinct documents of occ random occurrences
+    double D = std::max<uint64_t>(stats.num_docs(),1);
+    est.ndoc = std::max(1.0,D * (1 - std::exp(-est.occ/D)));
+
+    double frac = positions ? std::min(1.0,k/est.occ) : std::min(1.0,k/est.ndoc);
+    double map_cost = positions ? 0 : model.map_doc_ns * est.occ * frac;
+    est.cost[(size_t)phrase_plan::abspos] = daat_cost(term_sizes,frac,model) + map_cost;
+    if (m >= 2) {
+        est.cost[(size_t)phrase_plan::nextword] = pair_sizes.size() * model.pair_lookup_ns
+                + daat_cost(pair_sizes,frac,model) + map_cost;
+    }
+    if (!positions) {
+        double search = m * model.backward_step_ns;
+        est.cost[(size_t)phrase_plan::sada] = search + est.ndoc * model.sada_doc_ns;
+        est.cost[(size_t)phrase_plan::wt] = search + est.ndoc * model.wt_doc_ns * std::max(1.0,std::log2(D));
+    }
+    return est;
+}
@@ -0,0 +1,124 @@
+#pragma once
+
+#include "collection.hpp"
+#include "list_basics.hpp"
+#include "phrase_cost_model.hpp"
+
+#include "easylogging++.h"
+
+/* the term and 2-token counts of the collection, see phrase_statistics */
+inline phrase_statistics
+load_phrase_statistics(collection& col)
+{
+    sdsl::int_vector<> C;
+    sdsl::int_vector<> CC;
+    sdsl::int_vector<> SCC;
+    sdsl::int_vector<> DLEN;
+    sdsl::load_from_file(C,col.file_map[KEY_C]);
+    sdsl::load_from_file(CC,col.file_map[KEY_CC]);
+    sdsl::load_from_file(SCC,col.file_map[KEY_SCC]);
+    sdsl::load_from_file(DLEN,col.file_map[KEY_DOCLEN]);
+    uint64_t sym_width;
+    {
+        // CC is built on the permuted text
+        const sdsl::int_vector_mapper<0,std::ios_base::in> text(col.file_map[KEY_TEXTPERM]);
+        sym_width = text.width();
+    }
+    LOG(INFO) << "PLANNER statistics: terms = " << C.size() << " pairs = " << CC.size() << " docs = " << DLEN.size();
+    return phrase_statistics(std::move(C),std::move(CC),std::move(SCC),sym_width,DLEN.size());
+}
+
+/* answers a phrase query with the cheapest of the available indexes.
+   indexes which are not available are passed as nullptr. all indexes have
+   to be built over the same collection so document ids and positions
+   agree. if a CSA is available the number of occurrences is counted by
+   backward search before the plan is picked, otherwise it is estimated
+   from the 2-token counts. */
+template<class t_abspos,class t_nextword,class t_sada,class t_wt>
+class phrase_planner
+{
+    private:
+        const phrase_statistics& m_stats;
+        const t_abspos* m_abspos;
+        const t_nextword* m_nextword;
+        const t_sada* m_sada;
+        const t_wt* m_wt;
+        phrase_cost_model m_model;
+    public:
+        phrase_planner(const phrase_statistics& stats,const t_abspos* abspos,const t_nextword* nextword,
+                       const t_sada* sada,const t_wt* wt,const phrase_cost_model& model = phrase_cost_model())
+            : m_stats(stats), m_abspos(abspos), m_nextword(nextword), m_sada(sada), m_wt(wt), m_model(model)
+        {
+        }
+        // the costs of the plans the available indexes can execute
+        phrase_estimate
+        estimate(const std::vector<uint64_t>& ids,size_t k = no_result_limit,bool positions = false) const
+        {
+            double occ = -1;
+            if (m_wt != nullptr) occ = m_wt->count(ids);
+            else if (m_sada != nullptr) occ = m_sada->count(ids);
+            auto est = estimate_phrase_cost(m_stats,ids,occ,k,positions,m_model);
+            if (m_abspos == nullptr) disable(est,phrase_plan::abspos);
+            if (m_nextword == nullptr) disable(est,phrase_plan::nextword);
+            if (m_sada == nullptr) disable(est,phrase_plan::sada);
+            if (m_wt == nullptr) disable(est,phrase_plan::wt);
+            return est;
+        }
+        phrase_plan plan(const std::vector<uint64_t>& ids,size_t k = no_result_limit) const
+        {
+            return estimate(ids,k).best();
+        }
+        // the first k documents containing the phrase
+        docfreq_result
+        phrase_list(const std::vector<uint64_t>& ids,size_t k = no_result_limit) const
+        {
+            return phrase_list(ids,plan(ids,k),k);
+        }
+        docfreq_result
+        phrase_list(const std::vector<uint64_t>& ids,phrase_plan plan,size_t k) const
+        {
+            docfreq_result res;
+            switch (plan) {
+                case phrase_plan::abspos:
+                    return m_abspos->phrase_list(ids,k);
+                case phrase_plan::nextword:
+                    return m_nextword->phrase_list(ids,k);
+                case phrase_plan::sada:
+                    res = m_sada->phrase_list(ids);
+                    break;
+                case phrase_plan::wt:
+                    res = m_wt->phrase_list(ids);
+                    break;
+                default:
+                    return res;
+            }
+            if (res.size() > k) res.resize(k);
+            return res;
+        }
+        // the first limit positions of the phrase. only the positional indexes can be used
+        intersection_result
+        phrase_positions(const std::vector<uint64_t>& ids,size_t limit = no_result_limit) const
+        {
+            switch (estimate(ids,limit,true).best()) {
+                case phrase_plan::abspos:
+                    return m_abspos->phrase_positions(ids,limit);
+                case phrase_plan::nextword:
+                    return m_nextword->phrase_positions(ids,limit);
+                default:
+                    return intersection_result(0);
+            }
+        }
+    private:
+        static void disable(phrase_estimate& est,phrase_plan plan)
+        {
+            est.cost[(size_t)plan] = std::numeric_limits<double>::infinity();
+        }
+};
+
+template<class t_abspos,class t_nextword,class t_sada,class t_wt>
+phrase_planner<t_abspos,t_nextword,t_sada,t_wt>
+make_phrase_planner(const phrase_statistics& stats,const t_abspos* abspos,const t_nextword* nextword,
+                    const t_sada* sada,const t_wt* wt,const phrase_cost_model& model = phrase_cost_model())
+{
+    return phrase_planner<t_abspos,t_nextword,t_sada,t_wt>(stats,abspos,nextword,sada,wt,model);
+}
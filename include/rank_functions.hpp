@@ -52,7 +52,7 @@ struct rank_bm25 {
         double w_dt = ((k1+1)*f_dt) / (K_d + f_dt);
         return w_dt*w_qt;
     }
-    void load(std::ifstream& ifs)
+    void load(std::istream& ifs)
     {
         sdsl::read_member(num_docs,ifs);
         sdsl::read_member(num_terms,ifs);
@@ -0,0 +1,298 @@
+#pragma once
+
+#include <vector>
+#include <limits>
+#include <utility>
+#include <algorithm>
+
+#include "parallel_algorithms.hpp"
+
+/* suffix array construction for integer alphabets. the text type only
+   needs size() and operator[], so the builders work on in-memory vectors
+   as well as on memory mapped files.
+
+   - prefix_doubling_sa: multi-threaded in-memory construction. suffixes
+     are sorted by their first symbol and every round sorts the groups of
+     suffixes sharing a prefix of length h by the rank of the suffix h
+     positions further (Manber/Myers with group ranks as in Larsson and
+     Sadakane). the groups of a round are sorted in parallel. needs the
+     text plus up to 5 integers and one byte per suffix, see
+     prefix_doubling_sa_space.
+   - bucket_sa: external memory construction for texts larger than the
+     available memory. the suffixes are distributed into batches by their
+     first (and if needed second) symbol so each batch fits into the
+     memory budget. a batch is collected by a scan over the text, sorted
+     by comparing the suffixes in the text and emitted in order. only the
+     batch is kept in memory. repetitive texts with long common prefixes
+     make the comparisons expensive. */
+
+enum class sa_algorithm {automatic,qsufsort,prefix_doubling,bucket};
+
+struct sa_construction_options {
+    sa_algorithm algorithm = sa_algorithm::automatic;
+    uint64_t memory_budget = 0; // bytes, 0 = half of the physical memory
+};
+
+/* bytes prefix_doubling_sa needs for a text of n suffixes (excluding the
+   text). sa and rank take one integer per suffix, the group starts one
+   byte. a group of unsorted suffixes is a pair of integers and has at
+   least two suffixes, so there are at most n/2 of them. while the groups
+   of the next round are collected the current ones are kept and the
+   vectors of the parts may have up to twice their size allocated, which
+   gives up to 1.5n pairs. the merge buffer of parallel_sort (n/2
+   integers) is only needed while the current groups are sorted, before
+   the groups of the next round are collected. */
+inline uint64_t
+prefix_doubling_sa_space(uint64_t n)
+{
+    uint64_t idx_bytes = (n < std::numeric_limits<uint32_t>::max()) ? sizeof(uint32_t) : sizeof(uint64_t);
+    return n*(idx_bytes*2+1) + (n/2*3)*2*idx_bytes;
+}
+
+// move the parts to the end of out, each part is freed once it is copied
+template<class t_value>
+void
+concat_parts(std::vector<std::vector<t_value>>& parts,std::vector<t_value>& out)
+{
+    size_t total = out.size();
+    for (const auto& part : parts) total += part.size();
+    out.reserve(total);
+    for (auto& part : parts) {
+        out.insert(out.end(),part.begin(),part.end());
+        std::vector<t_value>().swap(part);
+    }
+}
+
+template<class t_idx,class t_text>
+void
+prefix_doubling_sa(const t_text& text,std::vector<t_idx>& sa,thread_pool& pool = shared_thread_pool())
+{
+    using group = std::pair<t_idx,t_idx>;
+    size_t n = text.size();
+    sa.resize(n);
+    if (n == 0) return;
+    std::vector<t_idx> rank(n);
+    std::vector<uint8_t> group_start(n,0);
+
+    // (1) sort by the first symbol
+    parallel_for(n,[&](size_t b,size_t e) {
+        for (size_t i=b; i<e; i++) sa[i] = i;
+    },pool);
+    parallel_sort(sa.begin(),sa.end(),[&text](t_idx a,t_idx b) {
+        return text[a] < text[b];
+    },pool);
+
+    // ranks are the position of the first suffix of the group
+    std::vector<group> groups;
+    {
+        std::vector<std::vector<group>> part_groups(pool.size()*4);
+        std::vector<std::pair<size_t,size_t>> part_bounds;
+        size_t parts = part_groups.size();
+        // group boundaries can not cross part boundaries, so split by symbol
+        size_t begin = 0;
+        for (size_t p=0; p<parts && begin < n; p++) {
+            size_t end = std::max(begin+1,(p+1)*n/parts);
+            if (p+1 == parts || end > n) end = n;
+            while (end < n && text[sa[end]] == text[sa[end-1]]) end++;
+            part_bounds.emplace_back(begin,end);
+            begin = end;
+        }
+        std::vector<std::future<void>> res;
+        for (size_t p=0; p<part_bounds.size(); p++) {
+            res.push_back(pool.submit([&,p] {
+                size_t b = part_bounds[p].first;
+                size_t e = part_bounds[p].second;
+                size_t start = b;
+                for (size_t j=b; j<e; j++) {
+                    if (j != b && text[sa[j]] != text[sa[j-1]]) {
+                        if (j-start > 1) part_groups[p].emplace_back(start,j);
+                        start = j;
+                    }
+                    rank[sa[j]] = start;
+                }
+                if (e-start > 1) part_groups[p].emplace_back(start,e);
+            }));
+        }
+        for (auto& r : res) pool.wait(r);
+        concat_parts(part_groups,groups);
+    }
+
+    // (2) double the prefix length until all groups are sorted
+    size_t large_group = std::max(parallel_min_task_size,n/(pool.size()*4));
+    for (size_t h=1; !groups.empty(); h*=2) {
+        // suffixes shorter than h sort before the longer ones
+        auto key = [&rank,h,n](t_idx i) -> uint64_t {
+            return (i+h < n) ? uint64_t(rank[i+h])+1 : 0;
+        };
+        auto cmp = [&key](t_idx a,t_idx b) {
+            return key(a) < key(b);
+        };
+        // (2a) sort the groups and mark the new group boundaries. the ranks
+        // are only read in this phase
+        auto sort_group = [&](const group& g,bool parallel) {
+            if (parallel) parallel_sort(sa.begin()+g.first,sa.begin()+g.second,cmp,pool);
+            else std::sort(sa.begin()+g.first,sa.begin()+g.second,cmp);
+            group_start[g.first] = 1;
+            for (size_t j=g.first+1; j<g.second; j++) {
+                group_start[j] = key(sa[j]) != key(sa[j-1]);
+            }
+        };
+        // split the groups into parts of similar size
+        std::vector<std::pair<size_t,size_t>> parts;
+        {
+            size_t total = 0;
+            for (const auto& g : groups) total += g.second-g.first;
+            size_t part_size = std::max(parallel_min_task_size,total/(pool.size()*4));
+            size_t begin = 0, cur = 0;
+            for (size_t i=0; i<groups.size(); i++) {
+                cur += groups[i].second-groups[i].first;
+                if (cur >= part_size) {
+                    parts.emplace_back(begin,i+1);
+                    begin = i+1;
+                    cur = 0;
+                }
+            }
+            if (begin != groups.size()) parts.emplace_back(begin,groups.size());
+        }
+        std::vector<std::future<void>> res;
+        for (const auto& part : parts) {
+            res.push_back(pool.submit([&,part] {
+                for (size_t i=part.first; i<part.second; i++) {
+                    if (groups[i].second-groups[i].first < large_group) sort_group(groups[i],false);
+                }
+            }));
+        }
+        for (const auto& g : groups) {
+            if (g.second-g.first >= large_group) sort_group(g,true);
+        }
+        for (auto& r : res) pool.wait(r);
+
+        // (2b) assign the new ranks and collect the unsorted groups
+        std::vector<std::vector<group>> part_groups(parts.size());
+        res.clear();
+        for (size_t p=0; p<parts.size(); p++) {
+            res.push_back(pool.submit([&,p] {
+                for (size_t i=parts[p].first; i<parts[p].second; i++) {
+                    size_t start = groups[i].first;
+                    for (size_t j=groups[i].first; j<groups[i].second; j++) {
+                        if (group_start[j]) {
+                            if (j-start > 1) part_groups[p].emplace_back(start,j);
+                            start = j;
+                        }
+                        rank[sa[j]] = start;
+                    }
+                    if (groups[i].second-start > 1) part_groups[p].emplace_back(start,groups[i].second);
+                }
+            }));
+        }
+        for (auto& r : res) pool.wait(r);
+        std::vector<group>().swap(groups);
+        concat_parts(part_groups,groups);
+    }
+}
+
+/* compares two suffixes of the text. a suffix which is a prefix of the
+   other one is smaller */
+template<class t_text>
+struct suffix_less {
+    const t_text& text;
+    suffix_less(const t_text& t) : text(t) {}
+    bool operator()(uint64_t a,uint64_t b) const
+    {
+        size_t n = text.size();
+        while (a < n && b < n) {
+            auto x = text[a];
+            auto y = text[b];
+            if (x != y) return x < y;
+            a++;
+            b++;
+        }
+        return a == n && b != n;
+    }
+};
+
+/* emit(std::vector<uint64_t>& positions) is called with the sorted
+   batches of suffixes in suffix array order. returns false if a batch did
+   not fit into the memory budget (more than half of the text starts with
+   the same two symbols) */
+template<class t_text,class t_emit>
+bool
+bucket_sa(const t_text& text,uint64_t memory_budget,t_emit emit,thread_pool& pool = shared_thread_pool())
+{
+    // a key is the first symbol and the second symbol+1 (0 = end of text)
+    using key_type = std::pair<uint64_t,uint64_t>;
+    size_t n = text.size();
+    if (n == 0) return true;
+    auto key = [&text,n](size_t i) {
+        return key_type(text[i],(i+1 < n) ? uint64_t(text[i+1])+1 : 0);
+    };
+    // positions plus the merge buffer of parallel_sort
+    uint64_t capacity = std::max<uint64_t>(1,memory_budget/(sizeof(uint64_t)*3/2));
+    bool fits = true;
+
+    // (1) first symbol histogram
+    uint64_t sigma = 0;
+    for (size_t i=0; i<n; i++) sigma = std::max<uint64_t>(sigma,text[i]+1);
+    std::vector<uint64_t> counts(sigma,0);
+    for (size_t i=0; i<n; i++) counts[text[i]]++;
+
+    // (2) batches are key ranges [lo,hi)
+    std::vector<std::pair<key_type,key_type>> batches;
+    uint64_t cur_size = 0;
+    uint64_t batch_begin = 0;
+    for (uint64_t c=0; c<sigma; c++) {
+        if (cur_size && cur_size+counts[c] > capacity) {
+            batches.emplace_back(key_type(batch_begin,0),key_type(c,0));
+            batch_begin = c;
+            cur_size = 0;
+        }
+        if (counts[c] > capacity) {
+            // split the symbol by the second symbol
+            std::vector<uint64_t> second(sigma+1,0);
+            for (size_t i=0; i<n; i++) {
+                if (text[i] == c) second[key(i).second]++;
+            }
+            uint64_t sub_begin = 0;
+            uint64_t sub_size = 0;
+            for (uint64_t d=0; d<=sigma; d++) {
+                if (sub_size && sub_size+second[d] > capacity) {
+                    batches.emplace_back(key_type(c,sub_begin),key_type(c,d));
+                    sub_begin = d;
+                    sub_size = 0;
+                }
+                if (second[d] > capacity) fits = false;
+                sub_size += second[d];
+            }
+            batches.emplace_back(key_type(c,sub_begin),key_type(c+1,0));
+            batch_begin = c+1;
+            continue;
+        }
+        cur_size += counts[c];
+    }
+    if (batch_begin < sigma) batches.emplace_back(key_type(batch_begin,0),key_type(sigma,0));
+
+    // (3) collect, sort and emit the batches
+    suffix_less<t_text> cmp(text);
+    size_t parts = pool.size()*4;
+    for (const auto& batch : batches) {
+        std::vector<std::vector<uint64_t>> part_positions(parts);
+        std::vector<std::future<void>> res;
+        for (size_t p=0; p<parts; p++) {
+            res.push_back(pool.submit([&,p] {
+                for (size_t i=p*n/parts; i<(p+1)*n/parts; i++) {
+                    auto k = key(i);
+                    if (batch.first <= k && k < batch.second) part_positions[p].push_back(i);
+                }
+            }));
+        }
+        for (auto& r : res) pool.wait(r);
+        std::vector<uint64_t> positions;
+        for (auto& pp : part_positions) {
+            positions.insert(positions.end(),pp.begin(),pp.end());
+            std::vector<uint64_t>().swap(pp);
+        }
+        parallel_sort(positions.begin(),positions.end(),cmp,pool);
+        emit(positions);
+    }
+    return fits;
+}
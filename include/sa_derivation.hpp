@@ -0,0 +1,76 @@
+#pragma once
+
+#include <vector>
+#include <algorithm>
+
+#include "parallel_construction.hpp"
+
+/* arrays derived from the suffix array: the positions lists (KEY_POSPL)
+   and the document array (KEY_D). both are computed in chunks of the SA
+   which are processed in parallel on the thread pool and passed to
+   emit(values) in SA order, so the output can be written sequentially.
+   the number of chunks in flight is bounded by encode_chunks. */
+
+/* the SA range of every symbol sorted by position. C holds the number of
+   occurrences of every symbol. chunks contain whole SA ranges, so the
+   range of a very frequent symbol forms a chunk of its own. */
+template<class t_sa,class t_counts,class t_emit>
+void
+positions_lists(const t_sa& SA,const t_counts& C,t_emit emit,thread_pool& pool = shared_thread_pool())
+{
+    auto chunks = partition_terms(C,0);
+    auto sort_chunk = [&SA,&C](const term_chunk& chunk) {
+        size_t chunk_size = 0;
+        for (size_t i=chunk.begin; i<chunk.end; i++) chunk_size += C[i];
+        std::vector<uint64_t> pos(SA.begin()+chunk.first_posting,SA.begin()+chunk.first_posting+chunk_size);
+        auto begin = pos.begin();
+        for (size_t i=chunk.begin; i<chunk.end; i++) {
+            std::sort(begin,begin+C[i]);
+            begin += C[i];
+        }
+        return pos;
+    };
+    encode_chunks(chunks,sort_chunk,[&emit](const term_chunk&,const std::vector<uint64_t>& pos) {
+        emit(pos);
+    },pool);
+}
+
+/* the document of every suffix of the SA. borders holds the positions of
+   the document separators in increasing order, suffix SA[i] belongs to the
+   document whose separator is the first one at or after SA[i]. every chunk
+   is sorted by position and merged with the borders, galloping over the
+   documents which do not occur in the chunk. */
+template<class t_sa,class t_emit>
+void
+document_array(const t_sa& SA,const std::vector<uint64_t>& borders,t_emit emit,
+               thread_pool& pool = shared_thread_pool(),size_t chunk_size = construction_chunk_postings)
+{
+    std::vector<std::pair<size_t,size_t>> chunks;
+    for (size_t b=0; b<SA.size(); b+=chunk_size) {
+        chunks.emplace_back(b,std::min<size_t>(b+chunk_size,SA.size()));
+    }
+    size_t m = borders.size();
+    auto map_chunk = [&SA,&borders,m](const std::pair<size_t,size_t>& chunk) {
+        size_t n = chunk.second-chunk.first;
+        // (position,offset in the chunk)
+        std::vector<std::pair<uint64_t,uint64_t>> pos(n);
+        for (size_t i=0; i<n; i++) pos[i] = std::make_pair((uint64_t)SA[chunk.first+i],(uint64_t)i);
+        std::sort(pos.begin(),pos.end());
+        std::vector<uint64_t> docs(n);
+        size_t j = 0; // borders[0,j) are before the current position
+        for (const auto& p : pos) {
+            size_t lo = j;
+            size_t step = 1;
+            while (lo+step < m && borders[lo+step] < p.first) {
+                lo += step;
+                step *= 2;
+            }
+            j = std::lower_bound(borders.begin()+lo,borders.begin()+std::min(lo+step+1,m),p.first)-borders.begin();
+            docs[p.second] = j;
+        }
+        return docs;
+    };
+    encode_chunks(chunks,map_chunk,[&emit](const std::pair<size_t,size_t>&,const std::vector<uint64_t>& docs) {
+        emit(docs);
+    },pool);
+}
@@ -0,0 +1,315 @@
+#pragma once
+
+#include <iterator>
+#include <vector>
+#include <algorithm>
+#include <cstring>
+
+#include "simdunalignedbitpacking.h"
+
+#include "bit_streams.hpp"
+#include "bit_coders.hpp"
+#include "list_basics.hpp"
+#include "stream_vbyte.hpp"
+#include "block_search.hpp"
+
+/* lists of blocks of 128 integers whose blocks are decoded with SIMD
+   instructions. sorted lists store the d-gaps, the first gap of a block
+   is relative to the maximum of the previous block. the block maxima are
+   stored uncompressed and skip() gallops over them, so skipped blocks are
+   never decoded.
+
+   layout:
+     gamma(size) [gamma(min+1) if unsorted] gamma(bytes+1)
+     if more than one block (64 bit aligned):
+       block start u32[num_blocks] (byte offset in the data)
+       block max u32[num_blocks] (sorted only)
+     data (byte aligned, bytes long)
+
+   the block codec encodes n <= 128 integers into bytes and decodes them
+   from bytes which may be read up to the end of the list data. */
+
+// SIMD-BP128: full blocks are bit packed with the width of their largest value
+struct simdbp128_codec {
+    static const size_t max_block_bytes = 1 + 128*4 + 32;
+    static size_t encode(const uint32_t* in,size_t n,uint8_t* out)
+    {
+        if (n != 128) return stream_vbyte::encode(in,n,out); // last block
+        uint32_t bits = 0;
+        uint32_t all = 0;
+        for (size_t i=0; i<n; i++) all |= in[i];
+        if (all) bits = sdsl::bits::hi(all)+1;
+        out[0] = bits;
+        FastPForLib::usimdpackwithoutmask(in,reinterpret_cast<__m128i*>(out+1),bits);
+        return 1 + 16*bits;
+    }
+    static void decode(const uint8_t* in,size_t n,uint32_t* out,const uint8_t* end)
+    {
+        if (n != 128) {
+            stream_vbyte::decode(in,n,out,end);
+        } else {
+            FastPForLib::usimdunpack(reinterpret_cast<const __m128i*>(in+1),out,in[0]);
+        }
+    }
+};
+
+struct streamvbyte_codec {
+    static const size_t max_block_bytes = 32 + 128*4;
+    static size_t encode(const uint32_t* in,size_t n,uint8_t* out)
+    {
+        return stream_vbyte::encode(in,n,out);
+    }
+    static void decode(const uint8_t* in,size_t n,uint32_t* out,const uint8_t* end)
+    {
+        stream_vbyte::decode(in,n,out,end);
+    }
+};
+
+// in place prefix sum of data[0,n) starting at base
+inline void
+prefix_sum(uint32_t* data,size_t n,uint32_t base)
+{
+    size_t i = 0;
+#ifdef __SSE2__
+    __m128i run = _mm_set1_epi32(base);
+    for (; i+4<=n; i+=4) {
+        __m128i x = _mm_loadu_si128((const __m128i*)(data+i));
+        x = _mm_add_epi32(x,_mm_slli_si128(x,4));
+        x = _mm_add_epi32(x,_mm_slli_si128(x,8));
+        x = _mm_add_epi32(x,run);
+        _mm_storeu_si128((__m128i*)(data+i),x);
+        run = _mm_shuffle_epi32(x,_MM_SHUFFLE(3,3,3,3));
+    }
+    if (i) base = data[i-1];
+#endif
+    for (; i<n; i++) {
+        base += data[i];
+        data[i] = base;
+    }
+}
+
+template<class t_codec,bool t_sorted>
+class simd_block_iterator : public std::iterator<std::random_access_iterator_tag,uint64_t,std::ptrdiff_t>
+{
+    public:
+        using size_type = sdsl::int_vector<>::size_type;
+        static const size_type block_size = 128;
+    private:
+        uint64_t m_size = 0;
+        uint64_t m_min_offset = 0;
+        uint64_t m_num_blocks = 1;
+        const uint32_t* m_block_start = nullptr;
+        const uint32_t* m_block_max = nullptr;
+        const uint8_t* m_data = nullptr;
+        const uint8_t* m_data_end = nullptr;
+        mutable uint32_t m_tmp_data[block_size];
+    private:
+        uint64_t m_cur_block = 0;
+        uint64_t m_cur_offset = 0;
+        mutable uint64_t m_last_accessed_block = std::numeric_limits<uint64_t>::max();
+    public:
+        simd_block_iterator(const bit_istream& is,size_t start_offset,bool end)
+        {
+            is.seek(start_offset);
+            m_size = is.decode<coder::elias_gamma>();
+            if (!t_sorted) m_min_offset = is.decode<coder::elias_gamma>() - 1;
+            uint64_t bytes = is.decode<coder::elias_gamma>() - 1;
+            m_num_blocks = (m_size + block_size - 1) / block_size;
+            if (m_num_blocks > 1) {
+                is.align64();
+                m_block_start = reinterpret_cast<const uint32_t*>(is.cur_data());
+                m_block_max = m_block_start + m_num_blocks;
+                is.skip(m_num_blocks*32*(t_sorted ? 2 : 1));
+            }
+            is.skip((8 - (is.tellg()&7))&7);
+            m_data = reinterpret_cast<const uint8_t*>(is.data()) + is.tellg()/8;
+            m_data_end = m_data + bytes;
+            if (end) m_cur_offset = m_size;
+        }
+        simd_block_iterator() = default;
+        simd_block_iterator(const simd_block_iterator& pi) = default;
+        simd_block_iterator(simd_block_iterator&& pi) = default;
+        simd_block_iterator& operator=(const simd_block_iterator& pi) = default;
+        simd_block_iterator& operator=(simd_block_iterator&& pi) = default;
+    public:
+        size_type offset() const
+        {
+            return m_cur_offset;
+        }
+        size_type size() const
+        {
+            return m_size;
+        }
+        size_type remaining() const
+        {
+            return m_size - m_cur_offset;
+        }
+        uint64_t operator*() const
+        {
+            if (m_cur_block != m_last_accessed_block) decode_current_block();
+            return m_tmp_data[m_cur_offset%block_size] + m_min_offset;
+        }
+        bool operator ==(const simd_block_iterator& b) const
+        {
+            return m_cur_offset == b.m_cur_offset;
+        }
+        bool operator !=(const simd_block_iterator& b) const
+        {
+            return m_cur_offset != b.m_cur_offset;
+        }
+        simd_block_iterator operator++(int)
+        {
+            simd_block_iterator tmp(*this);
+            ++(*this);
+            return tmp;
+        }
+        simd_block_iterator& operator++()
+        {
+            m_cur_offset++;
+            m_cur_block = m_cur_offset/block_size;
+            return *this;
+        }
+        simd_block_iterator& operator+=(size_type i)
+        {
+            m_cur_offset += i;
+            m_cur_block = m_cur_offset/block_size;
+            return *this;
+        }
+        simd_block_iterator operator+(size_type i)
+        {
+            simd_block_iterator tmp(*this);
+            tmp += i;
+            return tmp;
+        }
+        template<class t_itr>
+        auto operator-(const t_itr& b) const -> difference_type
+        {
+            return (difference_type)offset() - (difference_type)b.offset();
+        }
+        // the decoded values from the current position to the end of the block
+        const uint32_t* block_values(size_type& n) const
+        {
+            static_assert(t_sorted == true,"block access only works in sorted lists.");
+            if (m_cur_block != m_last_accessed_block) decode_current_block();
+            auto in_block_offset = m_cur_offset%block_size;
+            n = block_length(m_cur_block) - in_block_offset;
+            return m_tmp_data + in_block_offset;
+        }
+        bool skip(uint64_t pos)
+        {
+            static_assert(t_sorted == true,"skipping only works in sorted lists.");
+            if (m_cur_offset >= m_size) return false;
+            if (m_num_blocks > 1 && m_block_max[m_cur_block] < pos) {
+                auto block = block_max_search(m_block_max,m_cur_block+1,m_num_blocks,pos);
+                if (block == m_num_blocks) {
+                    m_cur_offset = m_size;
+                    return false;
+                }
+                m_cur_block = block;
+                m_cur_offset = block*block_size;
+            }
+            if (m_cur_block != m_last_accessed_block) decode_current_block();
+            // pos <= block max unless this is the last block
+            auto n = block_length(m_cur_block);
+            auto i = block_lower_bound(m_tmp_data,m_cur_offset%block_size,n,pos);
+            if (i == n) {
+                m_cur_offset = m_size;
+                return false;
+            }
+            m_cur_offset = m_cur_block*block_size + i;
+            return m_tmp_data[i] == pos;
+        }
+    private:
+        size_type block_length(size_type block) const
+        {
+            if (block == m_num_blocks-1 && m_size % block_size != 0) return m_size % block_size;
+            return block_size;
+        }
+        void decode_current_block() const
+        {
+            const uint8_t* block_data = m_data;
+            if (m_num_blocks > 1) block_data += m_block_start[m_cur_block];
+            auto n = block_length(m_cur_block);
+            t_codec::decode(block_data,n,m_tmp_data,m_data_end);
+            if (t_sorted) {
+                uint32_t base = (m_cur_block != 0) ? m_block_max[m_cur_block-1] : 0;
+                prefix_sum(m_tmp_data,n,base);
+            }
+            m_last_accessed_block = m_cur_block;
+        }
+};
+
+template<class t_codec,bool t_sorted = true>
+struct simd_block_list {
+    using size_type = sdsl::int_vector<>::size_type;
+    using iterator_type = simd_block_iterator<t_codec,t_sorted>;
+    using list_type = list_dummy<iterator_type>;
+    static const size_type block_size = iterator_type::block_size;
+
+    template<class t_itr>
+    static size_type create(bit_ostream& os,t_itr begin,t_itr end)
+    {
+        size_type data_offset = os.tellp();
+
+        uint64_t size = std::distance(begin,end);
+        uint64_t num_blocks = (size + block_size - 1) / block_size;
+        uint64_t min = 0;
+        if (!t_sorted) min = *std::min_element(begin,end);
+
+        // (1) encode the blocks
+        std::vector<uint32_t> block_start(num_blocks);
+        std::vector<uint32_t> block_max(num_blocks);
+        std::vector<uint8_t> data(num_blocks*t_codec::max_block_bytes);
+        uint32_t tmp_data[block_size];
+        size_t bytes = 0;
+        uint64_t prev = 0;
+        auto itr = begin;
+        for (size_t b=0; b<num_blocks; b++) {
+            size_t n = std::min((uint64_t)block_size,size-b*block_size);
+            for (size_t j=0; j<n; j++) {
+                uint64_t value = *itr;
+                if (t_sorted) {
+                    tmp_data[j] = value - prev;
+                    prev = value;
+                } else {
+                    tmp_data[j] = value - min;
+                }
+                ++itr;
+            }
+            block_start[b] = bytes;
+            block_max[b] = prev;
+            bytes += t_codec::encode(tmp_data,n,data.data()+bytes);
+        }
+
+        // (2) meta data
+        os.encode_check_size<coder::elias_gamma>(size);
+        if (!t_sorted) os.encode_check_size<coder::elias_gamma>(min+1);
+        os.encode_check_size<coder::elias_gamma>(bytes+1);
+        if (num_blocks > 1) {
+            os.expand_if_needed(64+num_blocks*64);
+            os.align64();
+            for (size_t b=0; b<num_blocks; b++) os.put_int_no_size_check(block_start[b],32);
+            if (t_sorted) {
+                for (size_t b=0; b<num_blocks; b++) os.put_int_no_size_check(block_max[b],32);
+            }
+        }
+
+        // (3) data
+        os.expand_if_needed(8+bytes*8);
+        os.skip((8 - (os.tellp()&7))&7);
+        std::memcpy(reinterpret_cast<uint8_t*>(os.data()) + os.tellp()/8,data.data(),bytes);
+        os.skip(bytes*8);
+        return data_offset;
+    }
+
+    static list_dummy<iterator_type> materialize(const bit_istream& is,size_t start_offset)
+    {
+        return list_dummy<iterator_type>(iterator_type(is,start_offset,false),iterator_type(is,start_offset,true));
+    }
+};
+
+template<bool t_sorted = true>
+using simdbp128_list = simd_block_list<simdbp128_codec,t_sorted>;
+
+template<bool t_sorted = true>
+using streamvbyte_list = simd_block_list<streamvbyte_codec,t_sorted>;
@@ -0,0 +1,261 @@
+#pragma once
+
+#include <cstdint>
+#include <cstddef>
+#include <algorithm>
+
+#if defined(__x86_64__) || defined(__i386__)
+#include <immintrin.h>
+#define SIMD_INTERSECTION_X86 1
+#endif
+
+/* intersection of two sorted arrays of unique 32bit integers. the kernels
+   follow Lemire, Boytsov and Kurz, "SIMD Compression and the Intersection
+   of Sorted Integers" (V1, V3 and SIMD galloping) and the SSE all-pairs
+   compare and shuffle intersection for arrays of similar length.
+
+   the SIMD kernels are compiled with function level target attributes so
+   the same binary runs on every x86 CPU. the kernel is picked at runtime
+   using the CPU features. all kernels may write up to 4 integers past
+   the last result, so out has to hold min(na,nb)+4 integers. */
+namespace simd_intersection
+{
+
+enum class cpu_level {scalar,sse4,avx2};
+
+inline cpu_level detect_cpu_level()
+{
+#ifdef SIMD_INTERSECTION_X86
+    __builtin_cpu_init();
+    if (__builtin_cpu_supports("avx2")) return cpu_level::avx2;
+    if (__builtin_cpu_supports("sse4.1")) return cpu_level::sse4;
+#endif
+    return cpu_level::scalar;
+}
+
+inline cpu_level cpu()
+{
+    static const cpu_level level = detect_cpu_level();
+    return level;
+}
+
+inline size_t scalar_merge(const uint32_t* A,size_t na,const uint32_t* B,size_t nb,uint32_t* out)
+{
+    size_t i=0,j=0,k=0;
+    while (i < na && j < nb) {
+        if (A[i] < B[j]) {
+            i++;
+        } else if (B[j] < A[i]) {
+            j++;
+        } else {
+            out[k++] = A[i];
+            i++;
+            j++;
+        }
+    }
+    return k;
+}
+
+// every element of the (short) rare array is searched in freq
+inline size_t scalar_gallop(const uint32_t* rare,size_t nr,const uint32_t* freq,size_t nf,uint32_t* out)
+{
+    size_t k=0;
+    const uint32_t* end = freq + nf;
+    for (size_t i=0; i<nr && freq != end; i++) {
+        size_t step = 1;
+        const uint32_t* lo = freq;
+        while (lo + step < end && lo[step] < rare[i]) {
+            lo += step;
+            step *= 2;
+        }
+        freq = std::lower_bound(lo,std::min(lo+step+1,end),rare[i]);
+        if (freq != end && *freq == rare[i]) out[k++] = rare[i];
+    }
+    return k;
+}
+
+#ifdef SIMD_INTERSECTION_X86
+
+// shuffle masks moving the 32bit lanes selected by a 4bit mask to the front
+struct shuffle_table {
+    uint8_t masks[16][16];
+    shuffle_table()
+    {
+        for (size_t m=0; m<16; m++) {
+            size_t k = 0;
+            for (size_t lane=0; lane<4; lane++) {
+                if (m & (1 << lane)) {
+                    for (size_t b=0; b<4; b++) masks[m][k++] = lane*4+b;
+                }
+            }
+            while (k < 16) masks[m][k++] = 0x80;
+        }
+    }
+};
+
+inline const shuffle_table& shuffle_masks()
+{
+    static const shuffle_table table;
+    return table;
+}
+
+// arrays of similar length: compare all pairs of two 4 integer blocks
+__attribute__((target("sse4.1")))
+inline size_t sse_shuffle(const uint32_t* A,size_t na,const uint32_t* B,size_t nb,uint32_t* out)
+{
+    const auto& table = shuffle_masks();
+    size_t i=0,j=0,k=0;
+    size_t qa = na & ~size_t(3);
+    size_t qb = nb & ~size_t(3);
+    while (i < qa && j < qb) {
+        __m128i va = _mm_loadu_si128((const __m128i*)(A+i));
+        __m128i vb = _mm_loadu_si128((const __m128i*)(B+j));
+        __m128i c0 = _mm_cmpeq_epi32(va,vb);
+        __m128i c1 = _mm_cmpeq_epi32(va,_mm_shuffle_epi32(vb,_MM_SHUFFLE(0,3,2,1)));
+        __m128i c2 = _mm_cmpeq_epi32(va,_mm_shuffle_epi32(vb,_MM_SHUFFLE(1,0,3,2)));
+        __m128i c3 = _mm_cmpeq_epi32(va,_mm_shuffle_epi32(vb,_MM_SHUFFLE(2,1,0,3)));
+        __m128i cmp = _mm_or_si128(_mm_or_si128(c0,c1),_mm_or_si128(c2,c3));
+        int mask = _mm_movemask_ps(_mm_castsi128_ps(cmp));
+        __m128i shuf = _mm_loadu_si128((const __m128i*)table.masks[mask]);
+        _mm_storeu_si128((__m128i*)(out+k),_mm_shuffle_epi8(va,shuf));
+        k += __builtin_popcount(mask);
+        uint32_t amax = A[i+3];
+        uint32_t bmax = B[j+3];
+        if (amax <= bmax) i += 4;
+        if (bmax <= amax) j += 4;
+    }
+    return k + scalar_merge(A+i,na-i,B+j,nb-j,out+k);
+}
+
+// V1: compare every rare integer with the next 8 integers of freq
+__attribute__((target("sse4.1")))
+inline size_t sse_v1(const uint32_t* rare,size_t nr,const uint32_t* freq,size_t nf,uint32_t* out)
+{
+    size_t i=0,j=0,k=0;
+    while (i < nr) {
+        uint32_t r = rare[i];
+        while (j + 8 <= nf && freq[j+7] < r) j += 8;
+        if (j + 8 > nf) break;
+        __m128i vr = _mm_set1_epi32(r);
+        __m128i f0 = _mm_loadu_si128((const __m128i*)(freq+j));
+        __m128i f1 = _mm_loadu_si128((const __m128i*)(freq+j+4));
+        __m128i cmp = _mm_or_si128(_mm_cmpeq_epi32(f0,vr),_mm_cmpeq_epi32(f1,vr));
+        if (!_mm_testz_si128(cmp,cmp)) out[k++] = r;
+        i++;
+    }
+    return k + scalar_merge(rare+i,nr-i,freq+j,nf-j,out+k);
+}
+
+// V1 with 256bit registers comparing 16 integers of freq at a time
+__attribute__((target("avx2")))
+inline size_t avx2_v1(const uint32_t* rare,size_t nr,const uint32_t* freq,size_t nf,uint32_t* out)
+{
+    size_t i=0,j=0,k=0;
+    while (i < nr) {
+        uint32_t r = rare[i];
+        while (j + 16 <= nf && freq[j+15] < r) j += 16;
+        if (j + 16 > nf) break;
+        __m256i vr = _mm256_set1_epi32(r);
+        __m256i f0 = _mm256_loadu_si256((const __m256i*)(freq+j));
+        __m256i f1 = _mm256_loadu_si256((const __m256i*)(freq+j+8));
+        __m256i cmp = _mm256_or_si256(_mm256_cmpeq_epi32(f0,vr),_mm256_cmpeq_epi32(f1,vr));
+        if (!_mm256_testz_si256(cmp,cmp)) out[k++] = r;
+        i++;
+    }
+    return k + scalar_merge(rare+i,nr-i,freq+j,nf-j,out+k);
+}
+
+// compare r with the 16 integers starting at freq
+__attribute__((target("sse4.1")))
+inline bool sse_contains16(const uint32_t* freq,uint32_t r)
+{
+    __m128i vr = _mm_set1_epi32(r);
+    __m128i c0 = _mm_cmpeq_epi32(_mm_loadu_si128((const __m128i*)(freq)),vr);
+    __m128i c1 = _mm_cmpeq_epi32(_mm_loadu_si128((const __m128i*)(freq+4)),vr);
+    __m128i c2 = _mm_cmpeq_epi32(_mm_loadu_si128((const __m128i*)(freq+8)),vr);
+    __m128i c3 = _mm_cmpeq_epi32(_mm_loadu_si128((const __m128i*)(freq+12)),vr);
+    __m128i cmp = _mm_or_si128(_mm_or_si128(c0,c1),_mm_or_si128(c2,c3));
+    return !_mm_testz_si128(cmp,cmp);
+}
+
+// V3: skip over freq in blocks of 32 and compare with one half of the block
+__attribute__((target("sse4.1")))
+inline size_t sse_v3(const uint32_t* rare,size_t nr,const uint32_t* freq,size_t nf,uint32_t* out)
+{
+    size_t i=0,j=0,k=0;
+    while (i < nr) {
+        uint32_t r = rare[i];
+        while (j + 32 <= nf && freq[j+31] < r) j += 32;
+        if (j + 32 > nf) break;
+        const uint32_t* half = (freq[j+15] >= r) ? freq+j : freq+j+16;
+        if (sse_contains16(half,r)) out[k++] = r;
+        i++;
+    }
+    return k + scalar_merge(rare+i,nr-i,freq+j,nf-j,out+k);
+}
+
+// galloping over blocks of 32 integers of freq followed by a V3 comparison
+__attribute__((target("sse4.1")))
+inline size_t sse_galloping(const uint32_t* rare,size_t nr,const uint32_t* freq,size_t nf,uint32_t* out)
+{
+    size_t i=0,j=0,k=0;
+    while (i < nr) {
+        uint32_t r = rare[i];
+        if (j + 32 > nf) break;
+        if (freq[j+31] < r) {
+            // find the first block of 32 whose last integer is >= r
+            size_t last_block = (nf - j)/32 - 1;
+            size_t lo = 0;
+            size_t hi = 1;
+            while (hi < last_block && freq[j+32*hi+31] < r) {
+                lo = hi;
+                hi *= 2;
+            }
+            if (hi > last_block) hi = last_block;
+            if (freq[j+32*hi+31] < r) {
+                j += 32*(hi+1);
+                break;
+            }
+            while (hi - lo > 1) {
+                size_t mid = lo + (hi-lo)/2;
+                if (freq[j+32*mid+31] < r) lo = mid;
+                else hi = mid;
+            }
+            j += 32*hi;
+        }
+        const uint32_t* half = (freq[j+15] >= r) ? freq+j : freq+j+16;
+        if (sse_contains16(half,r)) out[k++] = r;
+        i++;
+    }
+    return k + scalar_merge(rare+i,nr-i,freq+j,nf-j,out+k);
+}
+
+#endif
+
+/* intersect A and B with the best kernel for their length ratio and the
+   CPU we are running on */
+inline size_t intersect(const uint32_t* A,size_t na,const uint32_t* B,size_t nb,uint32_t* out)
+{
+    if (na > nb) {
+        std::swap(A,B);
+        std::swap(na,nb);
+    }
+    if (na == 0) return 0;
+    size_t ratio = nb / na;
+#ifdef SIMD_INTERSECTION_X86
+    auto level = cpu();
+    if (level != cpu_level::scalar) {
+        if (ratio < 4) return sse_shuffle(A,na,B,nb,out);
+        if (ratio < 50) {
+            if (level == cpu_level::avx2) return avx2_v1(A,na,B,nb,out);
+            return sse_v1(A,na,B,nb,out);
+        }
+        if (ratio < 1000) return sse_v3(A,na,B,nb,out);
+        return sse_galloping(A,na,B,nb,out);
+    }
+#endif
+    if (ratio < 32) return scalar_merge(A,na,B,nb,out);
+    return scalar_gallop(A,na,B,nb,out);
+}
+
+}
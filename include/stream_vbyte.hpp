@@ -0,0 +1,125 @@
+#pragma once
+
+#include <cstdint>
+#include <cstddef>
+#include <cstring>
+
+#include "simd_intersection.hpp"
+
+/* stream vbyte (Lemire, Kurz and Rupp, "Stream VByte: Faster Byte-Oriented
+   Integer Compression"). the 2 bit length codes of four integers are
+   stored in one control byte, all control bytes precede the data bytes.
+   a group of four integers is decoded with one shuffle whose mask is
+   looked up with the control byte.
+
+   the SSSE3 decoder loads 16 bytes per group, so it is only used for the
+   groups whose 16 bytes end before the end of the readable memory passed
+   to decode. the remaining groups are decoded by the scalar decoder. the
+   SIMD decoder is compiled with a function level target attribute and
+   picked at runtime like the intersection kernels. */
+namespace stream_vbyte
+{
+
+// upper bound of the encoded size of n integers in bytes
+inline size_t max_bytes(size_t n)
+{
+    return (n+3)/4 + 4*n;
+}
+
+inline uint8_t code_length(uint32_t x)
+{
+    if (x < (1U << 8)) return 1;
+    if (x < (1U << 16)) return 2;
+    if (x < (1U << 24)) return 3;
+    return 4;
+}
+
+// returns the number of bytes written to out
+inline size_t encode(const uint32_t* in,size_t n,uint8_t* out)
+{
+    uint8_t* control = out;
+    uint8_t* data = out + (n+3)/4;
+    for (size_t i=0; i<n; i++) {
+        if (i%4 == 0) control[i/4] = 0;
+        uint8_t len = code_length(in[i]);
+        control[i/4] |= (len-1) << (2*(i%4));
+        std::memcpy(data,&in[i],len); // little endian
+        data += len;
+    }
+    return data - out;
+}
+
+struct decode_table {
+    uint8_t shuffle[256][16];
+    uint8_t length[256];
+    decode_table()
+    {
+        for (size_t key=0; key<256; key++) {
+            size_t k = 0;
+            for (size_t lane=0; lane<4; lane++) {
+                size_t len = ((key >> (2*lane)) & 3) + 1;
+                for (size_t b=0; b<4; b++) {
+                    shuffle[key][lane*4+b] = (b < len) ? k+b : 0x80;
+                }
+                k += len;
+            }
+            length[key] = k;
+        }
+    }
+};
+
+inline const decode_table& table()
+{
+    static const decode_table t;
+    return t;
+}
+
+// decode the integers [first,n) whose data starts at data
+inline void decode_scalar(const uint8_t* control,const uint8_t* data,size_t first,size_t n,uint32_t* out)
+{
+    for (size_t i=first; i<n; i++) {
+        uint8_t len = ((control[i/4] >> (2*(i%4))) & 3) + 1;
+        uint32_t x = 0;
+        std::memcpy(&x,data,len);
+        data += len;
+        out[i] = x;
+    }
+}
+
+#ifdef SIMD_INTERSECTION_X86
+// decodes the full groups which can be loaded before end. returns the number of decoded integers
+__attribute__((target("ssse3")))
+inline size_t decode_ssse3(const uint8_t* control,const uint8_t*& data,size_t n,uint32_t* out,const uint8_t* end)
+{
+    const auto& t = table();
+    size_t groups = n/4;
+    size_t g = 0;
+    for (; g<groups && data+16 <= end; g++) {
+        uint8_t key = control[g];
+        __m128i v = _mm_loadu_si128((const __m128i*)data);
+        __m128i mask = _mm_loadu_si128((const __m128i*)t.shuffle[key]);
+        _mm_storeu_si128((__m128i*)(out+4*g),_mm_shuffle_epi8(v,mask));
+        data += t.length[key];
+    }
+    return 4*g;
+}
+#endif
+
+/* decode n integers from in. end is the end of the memory which may be
+   read, at least the encoded bytes of the n integers */
+inline void decode(const uint8_t* in,size_t n,uint32_t* out,const uint8_t* end)
+{
+    const uint8_t* control = in;
+    const uint8_t* data = in + (n+3)/4;
+    size_t first = 0;
+#ifdef SIMD_INTERSECTION_X86
+    if (simd_intersection::cpu() != simd_intersection::cpu_level::scalar) {
+        first = decode_ssse3(control,data,n,out,end);
+    }
+#else
+    (void)end;
+#endif
+    decode_scalar(control,data,first,n,out);
+}
+
+}
@@ -0,0 +1,122 @@
+#pragma once
+
+#include <vector>
+#include <mutex>
+#include <algorithm>
+
+#include "sdsl/bits.hpp"
+
+#include "parallel_algorithms.hpp"
+
+/* symbol statistics of the text used to build C and CC. the text type
+   only needs size() and operator[], so the counts can be computed on a
+   memory mapped text. */
+
+/* number of occurrences of every symbol 0..max(text). every thread counts
+   one part of the text into a dense histogram of its own, the histograms
+   are summed up per symbol range afterwards. texts which are short
+   compared to the alphabet are counted by fewer threads to bound the size
+   of the histograms. */
+template<class t_text>
+std::vector<uint64_t>
+symbol_histogram(const t_text& text,thread_pool& pool = shared_thread_pool())
+{
+    size_t n = text.size();
+    if (n == 0) return std::vector<uint64_t>();
+    uint64_t sigma = 0;
+    {
+        std::mutex m;
+        parallel_for(n,[&](size_t b,size_t e) {
+            uint64_t max_sym = 0;
+            for (size_t i=b; i<e; i++) max_sym = std::max<uint64_t>(max_sym,text[i]);
+            std::lock_guard<std::mutex> lock(m);
+            sigma = std::max(sigma,max_sym+1);
+        },pool);
+    }
+    size_t parts = std::min<size_t>(pool.size(),std::max<size_t>(1,n/std::max<uint64_t>(sigma,parallel_min_task_size)));
+    std::vector<std::vector<uint64_t>> part_counts(parts);
+    std::vector<std::future<void>> res;
+    for (size_t p=0; p<parts; p++) {
+        res.push_back(pool.submit([&,p] {
+            part_counts[p].resize(sigma,0);
+            uint64_t* cnt = part_counts[p].data();
+            for (size_t i=p*n/parts; i<(p+1)*n/parts; i++) cnt[text[i]]++;
+        }));
+    }
+    for (auto& r : res) pool.wait(r);
+    std::vector<uint64_t> counts = std::move(part_counts[0]);
+    parallel_for(sigma,[&](size_t b,size_t e) {
+        for (size_t p=1; p<parts; p++) {
+            for (size_t c=b; c<e; c++) counts[c] += part_counts[p][c];
+        }
+    },pool);
+    return counts;
+}
+
+/* call emit(sym,count) for the distinct 2-token symbols
+   sym = (text[i] << width) + text[i+1] in increasing order. counts holds
+   the occurrences of the single symbols (see symbol_histogram). the first
+   symbols are split into ranges whose 2-token symbols fit into the memory
+   budget. for each range the 2-token symbols are collected by a parallel
+   scan over the text, sorted by a parallel radix sort and counted. a
+   single first symbol with more occurrences than the budget allows is
+   processed on its own and exceeds it. */
+template<class t_text,class t_emit>
+void
+count_symbol_pairs(const t_text& text,uint8_t width,const std::vector<uint64_t>& counts,
+                   uint64_t memory_budget,t_emit emit,thread_pool& pool = shared_thread_pool())
+{
+    size_t n = text.size();
+    if (n < 2) return;
+    // the 2-token symbols plus the buffer of the radix sort
+    uint64_t capacity = std::max<uint64_t>(1,memory_budget/(2*sizeof(uint64_t)));
+    std::vector<std::pair<uint64_t,uint64_t>> ranges;
+    uint64_t range_begin = 0;
+    uint64_t range_size = 0;
+    for (uint64_t c=0; c<counts.size(); c++) {
+        if (range_size && range_size+counts[c] > capacity) {
+            ranges.emplace_back(range_begin,c);
+            range_begin = c;
+            range_size = 0;
+        }
+        range_size += counts[c];
+    }
+    if (range_begin < counts.size()) ranges.emplace_back(range_begin,counts.size());
+
+    size_t parts = pool.size()*4;
+    for (const auto& range : ranges) {
+        // only the bits which differ within the range have to be sorted
+        uint64_t base = range.first << width;
+        uint8_t key_bits = width+sdsl::bits::hi(std::max<uint64_t>(range.second-range.first-1,1))+1;
+        std::vector<std::vector<uint64_t>> part_syms(parts);
+        std::vector<std::future<void>> res;
+        for (size_t p=0; p<parts; p++) {
+            res.push_back(pool.submit([&,p] {
+                size_t b = p*(n-1)/parts;
+                size_t e = (p+1)*(n-1)/parts;
+                for (size_t i=b; i<e; i++) {
+                    uint64_t sym = text[i];
+                    if (range.first <= sym && sym < range.second) {
+                        part_syms[p].push_back(((sym << width) + text[i+1]) - base);
+                    }
+                }
+            }));
+        }
+        for (auto& r : res) pool.wait(r);
+        size_t total = 0;
+        for (const auto& ps : part_syms) total += ps.size();
+        std::vector<uint64_t> syms;
+        syms.reserve(total);
+        for (auto& ps : part_syms) {
+            syms.insert(syms.end(),ps.begin(),ps.end());
+            std::vector<uint64_t>().swap(ps);
+        }
+        parallel_radix_sort(syms,key_bits,pool);
+        for (size_t i=0; i<syms.size();) {
+            size_t j = i+1;
+            while (j < syms.size() && syms[j] == syms[i]) j++;
+            emit(syms[i]+base,j-i);
+            i = j;
+        }
+    }
+}
@@ -0,0 +1,103 @@
+#pragma once
+
+#include <vector>
+#include <deque>
+#include <chrono>
+#include <algorithm>
+#include <thread>
+#include <mutex>
+#include <condition_variable>
+#include <future>
+#include <functional>
+#include <memory>
+
+/* fixed size pool of worker threads executing tasks in fifo order.
+   threads waiting for a result of the pool should use wait() which runs
+   queued tasks in the meantime, so tasks can submit and wait for other
+   tasks without deadlocking the pool. */
+class thread_pool
+{
+    private:
+        std::vector<std::thread> m_workers;
+        std::deque<std::function<void()>> m_tasks;
+        std::mutex m_mutex;
+        std::condition_variable m_cond;
+        bool m_stop = false;
+    public:
+        explicit thread_pool(size_t num_threads)
+        {
+            if (num_threads == 0) num_threads = 1;
+            for (size_t i=0; i<num_threads; i++) {
+                m_workers.emplace_back([this] {
+                    while (true) {
+                        std::function<void()> task;
+                        {
+                            std::unique_lock<std::mutex> lock(m_mutex);
+                            m_cond.wait(lock,[this] { return m_stop || !m_tasks.empty(); });
+                            if (m_stop && m_tasks.empty()) return;
+                            task = std::move(m_tasks.front());
+                            m_tasks.pop_front();
+                        }
+                        task();
+                    }
+                });
+            }
+        }
+        thread_pool(const thread_pool&) = delete;
+        thread_pool& operator=(const thread_pool&) = delete;
+        ~thread_pool()
+        {
+            {
+                std::lock_guard<std::mutex> lock(m_mutex);
+                m_stop = true;
+            }
+            m_cond.notify_all();
+            for (auto& worker : m_workers) worker.join();
+        }
+        size_t size() const
+        {
+            return m_workers.size();
+        }
+        template<class t_func>
+        std::future<typename std::result_of<t_func()>::type>
+        submit(t_func func)
+        {
+            using result_type = typename std::result_of<t_func()>::type;
+            auto task = std::make_shared<std::packaged_task<result_type()>>(std::move(func));
+            auto res = task->get_future();
+            {
+                std::lock_guard<std::mutex> lock(m_mutex);
+                m_tasks.emplace_back([task] { (*task)(); });
+            }
+            m_cond.notify_one();
+            return res;
+        }
+        // run one queued task in the calling thread. false if the queue was empty
+        bool run_pending_task()
+        {
+            std::function<void()> task;
+            {
+                std::lock_guard<std::mutex> lock(m_mutex);
+                if (m_tasks.empty()) return false;
+                task = std::move(m_tasks.front());
+                m_tasks.pop_front();
+            }
+            task();
+            return true;
+        }
+        template<class t_res>
+        t_res wait(std::future<t_res>& res)
+        {
+            while (res.wait_for(std::chrono::seconds(0)) != std::future_status::ready) {
+                if (!run_pending_task()) res.wait();
+            }
+            return res.get();
+        }
+};
+
+// pool shared by all parallel algorithms, one thread per core
+inline thread_pool& shared_thread_pool()
+{
+    static thread_pool pool(std::max(1U,std::thread::hardware_concurrency()));
+    return pool;
+}
@@ -43,8 +43,9 @@ class uniform_ef_iterator : public std::iterator<std::random_access_iterator_tag
         uint64_t m_size;
         uint64_t m_num_blocks;
         const uint64_t* m_data = nullptr;
-        const uint64_t* m_blockstart = nullptr;
-        const bit_istream* m_iss = nullptr;
+        const uint64_t* m_blockstart = nullptr; // block offsets relative to the list start
+        size_type m_list_offset = 0;
+        size_type m_stream_size = 0;
     private:
         mutable value_type m_cur_elem = 0;
         mutable size_type m_last_accessed_offset = std::numeric_limits<uint64_t>::max();
@@ -67,7 +68,8 @@ class uniform_ef_iterator : public std::iterator<std::random_access_iterator_tag
         uniform_ef_iterator& operator=(uniform_ef_iterator&& pi) = default;
         uniform_ef_iterator& operator=(const uniform_ef_iterator& pi) = default;
     public:
-        uniform_ef_iterator(const bit_istream& is,size_t start_offset,bool end) : m_iss(&is)
+        uniform_ef_iterator(const bit_istream& is,size_t start_offset,bool end)
+            : m_list_offset(start_offset), m_stream_size(is.size())
         {
             m_data = is.data();
             is.seek(start_offset);
@@ -100,12 +102,12 @@ class uniform_ef_iterator : public std::iterator<std::random_access_iterator_tag
                     auto items_in_block = (m_size - m_cur_offset) < t_block_size ? m_size - m_cur_offset : t_block_size;
                     m_cur_block_type = determine_block_type(items_in_block,m_cur_block_universe);
                     if (m_cur_block_type == uef_blocktype::BV) {
-                        auto list = bitvector_list<true>::materialize(*m_iss,m_blockstart[0],items_in_block,m_cur_block_universe);
+                        auto list = bitvector_list<true>::materialize(is,m_list_offset+m_blockstart[0],items_in_block,m_cur_block_universe);
                         m_bv_block_itr = list.begin();
                         m_bv_block_end = list.end();
                     }
                     if (m_cur_block_type == uef_blocktype::EF) {
-                        auto list = eliasfano_list<true,true>::materialize(*m_iss,m_blockstart[0],items_in_block,m_cur_block_universe);
+                        auto list = eliasfano_list<true,true>::materialize(is,m_list_offset+m_blockstart[0],items_in_block,m_cur_block_universe);
                         m_ef_block_itr = list.begin();
                         m_ef_block_end = list.end();
                     }
@@ -129,7 +131,7 @@ class uniform_ef_iterator : public std::iterator<std::random_access_iterator_tag
         uint64_t operator*() const
         {
             if (m_num_blocks == 1) return
-                    *(m_top_itr+m_cur_offset);
+                    *(m_top_itr+(m_cur_offset-m_top_itr.offset()));
             if (m_last_accessed_offset != m_cur_offset) {
                 access_current_elem();
                 m_last_accessed_offset = m_cur_offset;
@@ -176,7 +178,15 @@ class uniform_ef_iterator : public std::iterator<std::random_access_iterator_tag
         {
             // std::cout << "pos = " << pos << " m_cur_offset = " << m_cur_offset << std::endl;
             // if(pos == 43402) std::cout << "skip to pos = " << 43402 << std::endl;
-            if (m_num_blocks == 1) return m_top_itr.skip(pos);
+            if (m_num_blocks == 1) {
+                // the top list holds all elements. sync it to our offset first
+                if (m_cur_offset >= m_size) return false;
+                if (m_cur_offset != m_top_itr.offset()) m_top_itr += m_cur_offset - m_top_itr.offset();
+                *m_top_itr;
+                bool found = m_top_itr.skip(pos);
+                m_cur_offset = std::min(m_top_itr.offset(),m_size);
+                return found;
+            }
             auto cur_block = m_cur_offset/t_block_size;
             // if(pos == 43402) std::cout << "m_cur_offset = " << m_cur_offset << std::endl;
             // if(pos == 43402) std::cout << "cur_block = " << cur_block << std::endl;
@@ -204,14 +214,17 @@ class uniform_ef_iterator : public std::iterator<std::random_access_iterator_tag
                     // }
                     auto block_start_offset = new_block*t_block_size;
                     auto items_in_block = (m_size - block_start_offset) < t_block_size ? m_size - block_start_offset : t_block_size;
+                    prefetch_block(new_block);
                     m_cur_block_type = determine_block_type(items_in_block,m_cur_block_universe);
+                    // private cursor, the iterator may outlive the stream it was created from
+                    bit_istream is(m_data,m_stream_size);
                     if (m_cur_block_type == uef_blocktype::BV) {
-                        auto list = bitvector_list<true>::materialize(*m_iss,m_blockstart[new_block],items_in_block,m_cur_block_universe);
+                        auto list = bitvector_list<true>::materialize(is,m_list_offset+m_blockstart[new_block],items_in_block,m_cur_block_universe);
                         m_bv_block_itr = list.begin();
                         m_bv_block_end = list.end();
                     }
                     if (m_cur_block_type == uef_blocktype::EF) {
-                        auto list = eliasfano_list<true,true>::materialize(*m_iss,m_blockstart[new_block],items_in_block,m_cur_block_universe);
+                        auto list = eliasfano_list<true,true>::materialize(is,m_list_offset+m_blockstart[new_block],items_in_block,m_cur_block_universe);
                         m_ef_block_itr = list.begin();
                         m_ef_block_end = list.end();
                     }
@@ -239,12 +252,19 @@ class uniform_ef_iterator : public std::iterator<std::random_access_iterator_tag
                 return found;
             }
             // if(pos == 49) std::cout << "block is full" << std::endl;
-            m_cur_offset = cur_block*t_block_size + rel_pos; // must be found in a full block
+            m_cur_offset = m_top_itr.offset()*t_block_size + rel_pos; // must be found in a full block
             m_cur_elem = m_cur_block_value_offset + rel_pos;
             m_last_accessed_offset = m_cur_offset;
             return true;
         }
     private:
+        /* called before block is materialized. the data of block is read
+           right away, so only the data of the following block is fetched
+           while block is decoded */
+        void prefetch_block(size_type block) const
+        {
+            if (block+1 < m_num_blocks) prefetch_bits(m_data,m_list_offset+m_blockstart[block+1]);
+        }
         void access_current_elem() const
         {
             auto block = m_cur_offset/t_block_size;
@@ -257,14 +277,17 @@ class uniform_ef_iterator : public std::iterator<std::random_access_iterator_tag
                 m_cur_block_universe = *m_top_itr - m_prev_top - 1;
                 auto block_start_offset = block*t_block_size;
                 auto items_in_block = (m_size - block_start_offset) < t_block_size ? m_size - block_start_offset : t_block_size;
+                prefetch_block(block);
                 m_cur_block_type = determine_block_type(items_in_block,m_cur_block_universe);
+                // private cursor, the iterator may outlive the stream it was created from
+                bit_istream is(m_data,m_stream_size);
                 if (m_cur_block_type == uef_blocktype::BV) {
-                    auto list = bitvector_list<true>::materialize(*m_iss,m_blockstart[block],items_in_block,m_cur_block_universe);
+                    auto list = bitvector_list<true>::materialize(is,m_list_offset+m_blockstart[block],items_in_block,m_cur_block_universe);
                     m_bv_block_itr = list.begin();
                     m_bv_block_end = list.end();
                 }
                 if (m_cur_block_type == uef_blocktype::EF) {
-                    auto list = eliasfano_list<true,true>::materialize(*m_iss,m_blockstart[block],items_in_block,m_cur_block_universe);
+                    auto list = eliasfano_list<true,true>::materialize(is,m_list_offset+m_blockstart[block],items_in_block,m_cur_block_universe);
                     m_ef_block_itr = list.begin();
                     m_ef_block_end = list.end();
                 }
@@ -359,7 +382,7 @@ struct uniform_eliasfano_list {
             size_t value_offset = 0;
             for (size_t i=0; i<num_full_blocks; i++) {
                 uint64_t* block_start = os.data()+block_start_offset;
-                block_start[i] = os.tellp();
+                block_start[i] = os.tellp() - data_offset;
                 // (3a) compute block data
                 value_offset = 0;
                 if (i!=0) value_offset = top_lvl[i-1] + 1ULL;
@@ -377,7 +400,7 @@ struct uniform_eliasfano_list {
             if (has_leftover_block) { // encode last block
                 size_t left = num_items%t_block_size;
                 uint64_t* block_start = os.data()+block_start_offset;
-                block_start[num_blocks-1] = os.tellp();
+                block_start[num_blocks-1] = os.tellp() - data_offset;
                 value_offset = 0;
                 if (num_blocks!=1) value_offset = top_lvl[num_blocks-2] + 1;
                 for (size_t j=0; j<left; j++) {
@@ -8,6 +8,7 @@
 
 #include <sys/types.h>
 #include <sys/stat.h>
+#include <sys/resource.h>
 #include <unistd.h>
 
 
@@ -58,6 +59,14 @@ create_directory(std::string dir)
     }
 }
 
+// peak resident set size of the process in bytes
+uint64_t
+peak_memory_bytes()
+{
+    struct rusage usage;
+    if (getrusage(RUSAGE_SELF,&usage) != 0) return 0;
+    return (uint64_t)usage.ru_maxrss*1024;
+}
 
 struct vbyte_coder {
     static size_t encode_num(uint32_t num,uint8_t* out)
@@ -0,0 +1,303 @@
+#pragma once
+
+#include "list_basics.hpp"
+
+#include <algorithm>
+#include <limits>
+
+/* a query term cursor over a (doc id,freq) postings list pair. the id
+   iterator drives the traversal; the freq iterator is only advanced (to
+   the same offset) when a document has to be scored. */
+template<class t_id_itr,class t_freq_itr,class t_rank>
+struct wand_cursor {
+    using size_type = sdsl::int_vector<>::size_type;
+    static const uint64_t finished_id = std::numeric_limits<uint64_t>::max();
+    t_id_itr m_itr;
+    t_id_itr m_end;
+    t_freq_itr m_freq_itr;
+    const t_rank* m_ranker;
+    double m_f_qt;
+    double m_f_t;
+    double m_max_score;
+    uint64_t m_cur_id = finished_id;
+    wand_cursor(const t_id_itr& itr,const t_id_itr& end,const t_freq_itr& fitr,
+                const t_rank* ranker,double f_qt,double max_score)
+        : m_itr(itr), m_end(end), m_freq_itr(fitr), m_ranker(ranker), m_f_qt(f_qt),
+          m_max_score(max_score*f_qt)
+    {
+        m_f_t = m_itr.size();
+        if (m_itr != m_end) m_cur_id = *m_itr;
+    }
+    uint64_t docid() const
+    {
+        return m_cur_id;
+    }
+    bool finished() const
+    {
+        return m_cur_id == finished_id;
+    }
+    double max_score() const
+    {
+        return m_max_score;
+    }
+    void next()
+    {
+        ++m_itr;
+        m_cur_id = (m_itr == m_end) ? finished_id : *m_itr;
+    }
+    // move to the first doc id >= id
+    void next_geq(uint64_t id)
+    {
+        if (id <= m_cur_id) return;
+        m_itr.skip(id);
+        m_cur_id = (m_itr == m_end) ? finished_id : *m_itr;
+    }
+    uint64_t freq()
+    {
+        auto offset = m_itr.offset();
+        if (offset > m_freq_itr.offset()) m_freq_itr += offset - m_freq_itr.offset();
+        return *m_freq_itr;
+    }
+    double score()
+    {
+        double W_d = m_ranker->doc_length(m_cur_id);
+        // F_t is not kept in the index. none of our rankers use it.
+        return m_ranker->calculate_docscore(m_f_qt,freq(),m_f_t,0,W_d,true);
+    }
+};
+
+/* upper bound of the scores inside a block of postings and the last doc
+   id of the block */
+struct block_max_metadata {
+    uint32_t last_id;
+    float max_score;
+};
+
+/* a wand_cursor which in addition knows the score upper bound of each
+   block of its list. the block pointer is moved independently of the
+   postings ("shallow" move) so no postings have to be decoded to refine
+   the bound */
+template<class t_id_itr,class t_freq_itr,class t_rank>
+struct block_max_cursor : public wand_cursor<t_id_itr,t_freq_itr,t_rank> {
+    using base_type = wand_cursor<t_id_itr,t_freq_itr,t_rank>;
+    const block_max_metadata* m_blocks;
+    size_t m_num_blocks;
+    size_t m_cur_block = 0;
+    block_max_cursor(const t_id_itr& itr,const t_id_itr& end,const t_freq_itr& fitr,
+                     const t_rank* ranker,double f_qt,double max_score,
+                     const block_max_metadata* blocks,size_t num_blocks)
+        : base_type(itr,end,fitr,ranker,f_qt,max_score), m_blocks(blocks), m_num_blocks(num_blocks)
+    {
+    }
+    // move the block pointer to the block which may contain id
+    void shallow_next_geq(uint64_t id)
+    {
+        if (m_cur_block < m_num_blocks && m_blocks[m_cur_block].last_id < id) {
+            auto itr = std::lower_bound(m_blocks+m_cur_block,m_blocks+m_num_blocks,id,
+            [](const block_max_metadata& b,uint64_t v) {
+                return b.last_id < v;
+            });
+            m_cur_block = itr - m_blocks;
+        }
+    }
+    double block_max_score() const
+    {
+        if (m_cur_block == m_num_blocks) return 0.0;
+        return this->m_f_qt * m_blocks[m_cur_block].max_score;
+    }
+    uint64_t block_last_id() const
+    {
+        if (m_cur_block == m_num_blocks) return base_type::finished_id - 1;
+        return m_blocks[m_cur_block].last_id;
+    }
+};
+
+/* min-heap holding the k highest scoring documents seen so far. k may
+   come from a client, so only the max_results documents which can enter
+   the heap are reserved */
+struct topk_heap {
+    using entry_type = std::pair<double,uint64_t>;
+    size_t m_k;
+    std::vector<entry_type> m_heap;
+    topk_heap(size_t k,size_t max_results) : m_k(k)
+    {
+        m_heap.reserve(std::min(k,max_results)+1);
+    }
+    static bool heap_cmp(const entry_type& a,const entry_type& b)
+    {
+        return a.first > b.first;
+    }
+    double threshold() const
+    {
+        if (m_heap.size() < m_k) return 0.0;
+        return m_heap.front().first;
+    }
+    bool would_enter(double score) const
+    {
+        if (m_k == 0) return false;
+        return m_heap.size() < m_k || score > m_heap.front().first;
+    }
+    void insert(uint64_t id,double score)
+    {
+        if (!would_enter(score)) return;
+        m_heap.emplace_back(score,id);
+        std::push_heap(m_heap.begin(),m_heap.end(),heap_cmp);
+        if (m_heap.size() > m_k) {
+            std::pop_heap(m_heap.begin(),m_heap.end(),heap_cmp);
+            m_heap.pop_back();
+        }
+    }
+    topk_result topk() const
+    {
+        auto tmp = m_heap;
+        std::sort(tmp.begin(),tmp.end(),[](const entry_type& a,const entry_type& b) {
+            return a.first > b.first || (a.first == b.first && a.second < b.second);
+        });
+        topk_result res;
+        for (const auto& e : tmp) res.emplace_back(e.second,e.first);
+        return res;
+    }
+};
+
+// the number of documents in the lists of the cursors, with duplicates
+template<class t_cursor>
+size_t
+max_results(const std::vector<t_cursor>& cursors)
+{
+    size_t n = 0;
+    for (const auto& c : cursors) n += (size_t)c.m_f_t;
+    return n;
+}
+
+/* WAND (Broder et al., CIKM'03): the cursors are kept sorted by their
+   current doc id. The first cursor at which the sum of the list upper
+   bounds exceeds the heap threshold is the pivot. documents before the
+   pivot doc can not enter the top-k and are skipped. */
+template<class t_cursor>
+topk_result
+wand(std::vector<t_cursor>& cursors,size_t k)
+{
+    topk_heap heap(k,max_results(cursors));
+    std::vector<t_cursor*> ordered;
+    for (auto& c : cursors) ordered.push_back(&c);
+    auto by_docid = [](const t_cursor* a,const t_cursor* b) {
+        return a->docid() < b->docid();
+    };
+    std::sort(ordered.begin(),ordered.end(),by_docid);
+
+    while (true) {
+        // (1) find pivot
+        double upper_bound = 0;
+        size_t pivot = 0;
+        bool found = false;
+        for (pivot=0; pivot<ordered.size(); pivot++) {
+            if (ordered[pivot]->finished()) break;
+            upper_bound += ordered[pivot]->max_score();
+            if (heap.would_enter(upper_bound)) {
+                found = true;
+                break;
+            }
+        }
+        if (!found) break;
+        auto pivot_id = ordered[pivot]->docid();
+        while (pivot+1 < ordered.size() && ordered[pivot+1]->docid() == pivot_id) pivot++;
+
+        if (ordered[0]->docid() == pivot_id) {
+            // (2a) all cursors up to the pivot are on the pivot doc. score it
+            double score = 0;
+            for (size_t i=0; i<=pivot; i++) score += ordered[i]->score();
+            heap.insert(pivot_id,score);
+            for (size_t i=0; i<=pivot; i++) ordered[i]->next();
+            std::sort(ordered.begin(),ordered.end(),by_docid);
+        } else {
+            // (2b) skip the last cursor before the pivot to the pivot doc
+            size_t next_list = pivot;
+            while (ordered[next_list]->docid() == pivot_id) next_list--;
+            ordered[next_list]->next_geq(pivot_id);
+            for (size_t i=next_list+1; i<ordered.size(); i++) {
+                if (ordered[i]->docid() >= ordered[i-1]->docid()) break;
+                std::swap(ordered[i],ordered[i-1]);
+            }
+        }
+    }
+    return heap.topk();
+}
+
+/* Block-Max WAND (Ding and Suel, SIGIR'11): a pivot found with the list
+   upper bounds is checked against the upper bounds of the blocks which
+   contain the pivot doc. if it can not enter the top-k, all docs up to the
+   end of the first of these blocks are skipped. */
+template<class t_cursor>
+topk_result
+block_max_wand(std::vector<t_cursor>& cursors,size_t k)
+{
+    topk_heap heap(k,max_results(cursors));
+    std::vector<t_cursor*> ordered;
+    for (auto& c : cursors) ordered.push_back(&c);
+    auto by_docid = [](const t_cursor* a,const t_cursor* b) {
+        return a->docid() < b->docid();
+    };
+    std::sort(ordered.begin(),ordered.end(),by_docid);
+
+    while (true) {
+        // (1) find pivot
+        double upper_bound = 0;
+        size_t pivot = 0;
+        bool found = false;
+        for (pivot=0; pivot<ordered.size(); pivot++) {
+            if (ordered[pivot]->finished()) break;
+            upper_bound += ordered[pivot]->max_score();
+            if (heap.would_enter(upper_bound)) {
+                found = true;
+                break;
+            }
+        }
+        if (!found) break;
+        auto pivot_id = ordered[pivot]->docid();
+        while (pivot+1 < ordered.size() && ordered[pivot+1]->docid() == pivot_id) pivot++;
+
+        // (2) refine the bound with the blocks containing the pivot doc
+        double block_upper_bound = 0;
+        for (size_t i=0; i<=pivot; i++) {
+            ordered[i]->shallow_next_geq(pivot_id);
+            block_upper_bound += ordered[i]->block_max_score();
+        }
+
+        if (heap.would_enter(block_upper_bound)) {
+            if (ordered[0]->docid() == pivot_id) {
+                // (3a) score the pivot doc
+                double score = 0;
+                for (size_t i=0; i<=pivot; i++) score += ordered[i]->score();
+                heap.insert(pivot_id,score);
+                for (size_t i=0; i<=pivot; i++) ordered[i]->next();
+                std::sort(ordered.begin(),ordered.end(),by_docid);
+                continue;
+            }
+            // (3b) skip the last cursor before the pivot to the pivot doc
+            size_t next_list = pivot;
+            while (ordered[next_list]->docid() == pivot_id) next_list--;
+            ordered[next_list]->next_geq(pivot_id);
+            for (size_t i=next_list+1; i<ordered.size(); i++) {
+                if (ordered[i]->docid() >= ordered[i-1]->docid()) break;
+                std::swap(ordered[i],ordered[i-1]);
+            }
+        } else {
+            // (3c) nothing before the end of the first block or the next
+            //      cursor after the pivot can enter. skip the cursor with
+            //      the largest upper bound behind that point
+            uint64_t next_id = t_cursor::finished_id;
+            size_t next_list = 0;
+            for (size_t i=0; i<=pivot; i++) {
+                next_id = std::min(next_id,ordered[i]->block_last_id()+1);
+                if (ordered[i]->max_score() > ordered[next_list]->max_score()) next_list = i;
+            }
+            if (pivot+1 < ordered.size()) next_id = std::min(next_id,ordered[pivot+1]->docid());
+            ordered[next_list]->next_geq(next_id);
+            for (size_t i=next_list+1; i<ordered.size(); i++) {
+                if (ordered[i]->docid() >= ordered[i-1]->docid()) break;
+                std::swap(ordered[i],ordered[i-1]);
+            }
+        }
+    }
+    return heap.topk();
+}
@@ -18,6 +18,7 @@ typedef struct cmdargs {
     std::string collection_dir;
     std::string pattern_file;
     uint32_t patterns_per_bucket;
+    bool check_kernels;
 } cmdargs_t;
 
 void
@@ -28,6 +29,7 @@ print_usage(const char* program)
     fprintf(stdout,"  -c <collection directory>  : the directory the collection is stored.\n");
     fprintf(stdout,"  -p <pattern file>  : the pattern file.\n");
     fprintf(stdout,"  -n <patterns per bucket>  : number of patterns per bucket to run.\n");
+    fprintf(stdout,"  -k : check that all pairwise intersection kernels give identical results.\n");
 };
 
 cmdargs_t
@@ -38,7 +40,8 @@ parse_args(int argc,const char* argv[])
     args.collection_dir = "";
     args.pattern_file = "";
     args.patterns_per_bucket = 0;
-    while ((op=getopt(argc,(char* const*)argv,"c:p:n:")) != -1) {
+    args.check_kernels = false;
+    while ((op=getopt(argc,(char* const*)argv,"c:p:n:k")) != -1) {
         switch (op) {
             case 'c':
                 args.collection_dir = optarg;
@@ -49,6 +52,9 @@ parse_args(int argc,const char* argv[])
             case 'n':
                 args.patterns_per_bucket = std::stoul(optarg);
                 break;
+            case 'k':
+                args.check_kernels = true;
+                break;
         }
     }
     if (args.collection_dir==""||args.pattern_file=="") {
@@ -98,6 +104,36 @@ void compare_index(const t_idx& indexA,const t_idx2& indexB,const std::vector<pa
     LOG(INFO) << "INDEXB " << dchecksumB;
 }
 
+template<class t_idx>
+void compare_kernels(const t_idx& index,const std::vector<pattern_t>& patterns,const char* name)
+{
+    size_t errors = 0;
+    size_t checked = 0;
+    for (const auto& pattern : patterns) {
+        for (size_t i=1; i<pattern.tokens.size(); i++) {
+            auto listA = index.list(pattern.tokens[i-1]).first;
+            auto listB = index.list(pattern.tokens[i]).first;
+            auto expected = intersect(intersect_kernel::merge,listA,listB);
+            for (size_t k=0; k<num_intersect_kernels; k++) {
+                auto kernel = (intersect_kernel) k;
+                auto result = intersect(kernel,listA,listB);
+                bool equal = result.size() == expected.size();
+                for (size_t j=0; equal && j<result.size(); j++) equal = result[j] == expected[j];
+                if (!equal) {
+                    std::cout << "ERROR!" << std::endl;
+                    std::cout << "pattern id = " << pattern.id << std::endl;
+                    std::cout << "terms = " << pattern.tokens[i-1] << "," << pattern.tokens[i] << std::endl;
+                    std::cout << "kernel = " << intersect_kernel_name(kernel) << std::endl;
+                    std::cout << "|R| = " << result.size() << " expected = " << expected.size() << std::endl;
+                    errors++;
+                }
+            }
+            checked++;
+        }
+    }
+    LOG(INFO) << "INDEX = " << name << " checked " << checked << " list pairs. kernel errors = " << errors;
+}
+
 int main(int argc,const char* argv[])
 {
     _START_EASYLOGGINGPP(argc,argv);
@@ -152,5 +188,13 @@ int main(int argc,const char* argv[])
     invidx_typeB indexB(col);
     compare_index(indexA,indexB,patterns);
 
+    if (args.check_kernels) {
+        compare_kernels(indexA,patterns,"UEF-128");
+        compare_kernels(indexB,patterns,"ESL-64");
+        using invidx_typeC = index_invidx<optpfor_list<128,true>,optpfor_list<128,false>>;
+        invidx_typeC indexC(col);
+        compare_kernels(indexC,patterns,"OPF-128");
+    }
+
     return 0;
 }
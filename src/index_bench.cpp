@@ -17,15 +17,17 @@ _INITIALIZE_EASYLOGGINGPP
 typedef struct cmdargs {
     std::string collection_dir;
     std::string pattern_file;
+    size_t group_size;
 } cmdargs_t;
 
 void
 print_usage(const char* program)
 {
-    fprintf(stdout,"%s -c <collection directory> -p <pattern file>\n",program);
+    fprintf(stdout,"%s -c <collection directory> -p <pattern file> -g <group size>\n",program);
     fprintf(stdout,"where\n");
     fprintf(stdout,"  -c <collection directory>  : the directory the collection is stored.\n");
     fprintf(stdout,"  -p <pattern file>  : the pattern file.\n");
+    fprintf(stdout,"  -g <group size>  : number of interleaved queries of the batched run (default %zu).\n",default_batch_group_size);
 };
 
 cmdargs_t
@@ -35,7 +37,8 @@ parse_args(int argc,const char* argv[])
     int op;
     args.collection_dir = "";
     args.pattern_file = "";
-    while ((op=getopt(argc,(char* const*)argv,"c:p:")) != -1) {
+    args.group_size = default_batch_group_size;
+    while ((op=getopt(argc,(char* const*)argv,"c:p:g:")) != -1) {
         switch (op) {
             case 'c':
                 args.collection_dir = optarg;
@@ -43,6 +46,9 @@ parse_args(int argc,const char* argv[])
             case 'p':
                 args.pattern_file = optarg;
                 break;
+            case 'g':
+                args.group_size = std::max(1ULL,std::stoull(optarg));
+                break;
         }
     }
     if (args.collection_dir==""||args.pattern_file=="") {
@@ -53,7 +59,7 @@ parse_args(int argc,const char* argv[])
     return args;
 }
 
-template<class t_idx>
+template<class t_strategy=intersect_daat,class t_idx>
 void bench_intersection(const t_idx& index,
                         const std::vector<pattern_t>& patterns,
                         const char* name,
@@ -63,7 +69,7 @@ void bench_intersection(const t_idx& index,
     size_t checksum = 0;
     for (const auto& pattern : patterns) {
         auto start = clock::now();
-        auto result = index.phrase_positions(pattern.tokens);
+        auto result = index.template phrase_positions<t_strategy>(pattern.tokens);
         auto stop = clock::now();
         for (const auto& pos : result) {
             checksum += pos;
@@ -82,6 +88,33 @@ void bench_intersection(const t_idx& index,
     LOG(INFO) << "INDEX = " << name << " CHECKSUM = " << checksum;
 }
 
+/* all patterns as one batch with group_size of them interleaved. there
+   are no per pattern times, only the total time is reported. the checksum
+   matches the one of bench_intersection<intersect_daat> */
+template<class t_idx>
+void bench_batch_intersection(const t_idx& index,
+                              const std::vector<pattern_t>& patterns,
+                              size_t group_size,
+                              const char* name)
+{
+    using clock = std::chrono::high_resolution_clock;
+    std::vector<std::vector<uint64_t>> queries;
+    for (const auto& pattern : patterns) queries.push_back(pattern.tokens);
+    auto start = clock::now();
+    auto results = index.batch_phrase_positions(queries,group_size);
+    auto stop = clock::now();
+    size_t checksum = 0;
+    for (const auto& result : results) {
+        for (const auto& pos : result) {
+            checksum += pos;
+        }
+    }
+    LOG(INFO) << "INDEX = " << name << " group size = " << group_size << " CHECKSUM = " << checksum;
+    LOG(INFO) << "INDEX = " << name << " time = " <<
+              std::chrono::duration_cast<std::chrono::milliseconds>(stop-start).count()/1000.0f
+              << " secs";
+}
+
 int main(int argc,const char* argv[])
 {
     _START_EASYLOGGINGPP(argc,argv);
@@ -113,7 +146,23 @@ int main(int argc,const char* argv[])
     {
         using invidx_type = index_invidx<uniform_eliasfano_list<128>,optpfor_list<128,false>>;
         index_abspos<uniform_eliasfano_list<128>,invidx_type> index(col);
-        bench_intersection(index,patterns,"ABSPOS-UEF-128",resfs);
+        bench_intersection<intersect_daat>(index,patterns,"ABSPOS-UEF-128",resfs);
+        bench_intersection<intersect_svs>(index,patterns,"ABSPOS-UEF-128-SVS",resfs);
+        LOG(INFO) << "Parallel intersection with " << shared_thread_pool().size() << " threads";
+        bench_intersection<intersect_parallel>(index,patterns,"ABSPOS-UEF-128-PAR",resfs);
+        bench_batch_intersection(index,patterns,args.group_size,"ABSPOS-UEF-128-BATCH");
+    }
+    {
+        using invidx_type = index_invidx<uniform_eliasfano_list<128>,optpfor_list<128,false>>;
+        index_abspos<partitioned_eliasfano_list,invidx_type> index(col);
+        bench_intersection<intersect_daat>(index,patterns,"ABSPOS-PEF",resfs);
+        bench_batch_intersection(index,patterns,args.group_size,"ABSPOS-PEF-BATCH");
+    }
+    {
+        using invidx_type = index_invidx<uniform_eliasfano_list<128>,optpfor_list<128,false>>;
+        index_abspos<eliasfano_skip_list<64,true>,invidx_type> index(col);
+        bench_intersection<intersect_daat>(index,patterns,"ABSPOS-ESF",resfs);
+        bench_batch_intersection(index,patterns,args.group_size,"ABSPOS-ESF-BATCH");
     }
     // {
     //     using invidx_type = index_invidx<uniform_eliasfano_list<128>,optpfor_list<128,false>>;
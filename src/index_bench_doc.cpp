@@ -18,6 +18,7 @@ typedef struct cmdargs {
     std::string collection_dir;
     std::string pattern_file;
     uint32_t patterns_per_bucket;
+    size_t group_size;
 } cmdargs_t;
 
 void
@@ -28,6 +29,7 @@ print_usage(const char* program)
     fprintf(stdout,"  -c <collection directory>  : the directory the collection is stored.\n");
     fprintf(stdout,"  -p <pattern file>  : the pattern file.\n");
     fprintf(stdout,"  -n <patterns per bucket>  : number of patterns per bucket to run.\n");
+    fprintf(stdout,"  -g <group size>  : number of interleaved queries of the batched run (default %zu).\n",default_batch_group_size);
 };
 
 cmdargs_t
@@ -38,7 +40,8 @@ parse_args(int argc,const char* argv[])
     args.collection_dir = "";
     args.pattern_file = "";
     args.patterns_per_bucket = 100;
-    while ((op=getopt(argc,(char* const*)argv,"c:p:n:")) != -1) {
+    args.group_size = default_batch_group_size;
+    while ((op=getopt(argc,(char* const*)argv,"c:p:n:g:")) != -1) {
         switch (op) {
             case 'c':
                 args.collection_dir = optarg;
@@ -49,6 +52,9 @@ parse_args(int argc,const char* argv[])
             case 'n':
                 args.patterns_per_bucket = std::stoul(optarg);
                 break;
+            case 'g':
+                args.group_size = std::max(1ULL,std::stoull(optarg));
+                break;
         }
     }
     if (args.collection_dir==""||args.pattern_file=="") {
@@ -97,6 +103,35 @@ void bench_doc_intersection(const t_idx& index,
               << " secs";
 }
 
+/* all patterns as one batch with group_size of them interleaved. only the
+   total time is reported, the checksums match bench_doc_intersection */
+template<class t_idx>
+void bench_batch_doc_intersection(const t_idx& index,
+                                  const std::vector<pattern_t>& patterns,
+                                  size_t group_size,
+                                  const char* name)
+{
+    LOG(INFO) << "BENCH = " << name << " group size = " << group_size;
+    using clock = std::chrono::high_resolution_clock;
+    std::vector<std::vector<uint64_t>> queries;
+    for (const auto& pattern : patterns) queries.push_back(pattern.tokens);
+    auto start = clock::now();
+    auto results = index.batch_phrase_list(queries,group_size);
+    auto stop = clock::now();
+    size_t dchecksum = 0;
+    size_t fchecksum = 0;
+    for (const auto& result : results) {
+        for (const auto& df : result) {
+            dchecksum += df.first;
+            fchecksum += df.second;
+        }
+    }
+    LOG(INFO) << "INDEX = " << name << " DCHECKSUM = " << dchecksum << " FCHECKSUM = " << fchecksum;
+    LOG(INFO) << "INDEX = " << name << " time = " <<
+              std::chrono::duration_cast<std::chrono::milliseconds>(stop-start).count()/1000.0f
+              << " secs";
+}
+
 int main(int argc,const char* argv[])
 {
     _START_EASYLOGGINGPP(argc,argv);
@@ -154,6 +189,7 @@ int main(int argc,const char* argv[])
         using invidx_type = index_invidx<uniform_eliasfano_list<128>,optpfor_list<128,false>>;
         index_abspos<uniform_eliasfano_list<128>,invidx_type> index(col);
         bench_doc_intersection(index,patterns,"ABSPOS-UEF-128",resfs);
+        bench_batch_doc_intersection(index,patterns,args.group_size,"ABSPOS-UEF-128-BATCH");
     }
     {
         using invidx_type = index_invidx<uniform_eliasfano_list<128>,optpfor_list<128,false>>;
@@ -164,12 +200,23 @@ int main(int argc,const char* argv[])
         using invidx_type = index_invidx<uniform_eliasfano_list<128>,optpfor_list<128,false>>;
         index_abspos<eliasfano_skip_list<64,true>,invidx_type> index(col);
         bench_doc_intersection(index,patterns,"ABSPOS-ESF",resfs);
+        bench_batch_doc_intersection(index,patterns,args.group_size,"ABSPOS-ESF-BATCH");
     }
     {
         using invidx_type = index_invidx<uniform_eliasfano_list<128>,optpfor_list<128,false>>;
         index_nextword<uniform_eliasfano_list<128>,invidx_type> index(col);
         bench_doc_intersection(index,patterns,"NEXTWORD-UEF-128",resfs);
     }
+    {
+        using invidx_type = index_invidx<uniform_eliasfano_list<128>,optpfor_list<128,false>>;
+        index_hybrid_nextword<uniform_eliasfano_list<128>,invidx_type> index(col);
+        bench_doc_intersection(index,patterns,"HYBRIDNEXTWORD-UEF-128",resfs);
+    }
+    {
+        using invidx_type = index_invidx<uniform_eliasfano_list<128>,optpfor_list<128,false>>;
+        index_hybrid_nextword<uniform_eliasfano_list<128>,invidx_type,1048576> index(col);
+        bench_doc_intersection(index,patterns,"HYBRIDNEXTWORD-1M-UEF-128",resfs);
+    }
     {
         using invidx_type = index_invidx<uniform_eliasfano_list<128>,optpfor_list<128,false>>;
         index_abspos<eliasfano_list<true,false>,invidx_type> index(col);
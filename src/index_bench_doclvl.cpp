@@ -18,6 +18,7 @@ typedef struct cmdargs {
     std::string collection_dir;
     std::string pattern_file;
     uint32_t patterns_per_bucket;
+    size_t group_size;
 } cmdargs_t;
 
 void
@@ -28,6 +29,7 @@ print_usage(const char* program)
     fprintf(stdout,"  -c <collection directory>  : the directory the collection is stored.\n");
     fprintf(stdout,"  -p <pattern file>  : the pattern file.\n");
     fprintf(stdout,"  -n <patterns per bucket>  : number of patterns per bucket to run.\n");
+    fprintf(stdout,"  -g <group size>  : number of interleaved queries of the batched run (default %zu).\n",default_batch_group_size);
 };
 
 cmdargs_t
@@ -38,7 +40,8 @@ parse_args(int argc,const char* argv[])
     args.collection_dir = "";
     args.pattern_file = "";
     args.patterns_per_bucket = 0;
-    while ((op=getopt(argc,(char* const*)argv,"c:p:n:")) != -1) {
+    args.group_size = default_batch_group_size;
+    while ((op=getopt(argc,(char* const*)argv,"c:p:n:g:")) != -1) {
         switch (op) {
             case 'c':
                 args.collection_dir = optarg;
@@ -49,6 +52,9 @@ parse_args(int argc,const char* argv[])
             case 'n':
                 args.patterns_per_bucket = std::stoul(optarg);
                 break;
+            case 'g':
+                args.group_size = std::max(1ULL,std::stoull(optarg));
+                break;
         }
     }
     if (args.collection_dir==""||args.pattern_file=="") {
@@ -59,7 +65,33 @@ parse_args(int argc,const char* argv[])
     return args;
 }
 
-template<class t_idx>
+// the pairwise kernels picked during the last run
+void log_kernel_counts(const char* name)
+{
+    std::string counts;
+    for (size_t i=0; i<num_intersect_kernels; i++) {
+        auto kernel = (intersect_kernel)i;
+        counts += std::string(" ") + intersect_kernel_name(kernel) + " = " + std::to_string(kernel_counts()[kernel]);
+    }
+    LOG(INFO) << "INDEX = " << name << " KERNELS:" << counts;
+}
+
+template<class t_strategy,class t_idx>
+intersection_result
+run_intersection(const t_idx& index,const std::vector<uint64_t>& ids)
+{
+    return index.template intersection<t_strategy>(ids);
+}
+
+// index_wt intersects on the wavelet tree, there is no strategy to pick
+template<class t_strategy,class t_csa,class t_wtd>
+intersection_result
+run_intersection(const index_wt<t_csa,t_wtd>& index,const std::vector<uint64_t>& ids)
+{
+    return index.intersection(ids);
+}
+
+template<class t_strategy=intersect_adaptive,class t_idx>
 void bench_doc_intersection(const t_idx& index,
                             const std::vector<pattern_t>& patterns,
                             const char* name,
@@ -69,9 +101,10 @@ void bench_doc_intersection(const t_idx& index,
     using clock = std::chrono::high_resolution_clock;
     size_t dchecksum = 0;
     std::chrono::nanoseconds total(0);
+    kernel_counts().reset();
     for (const auto& pattern : patterns) {
         auto start = clock::now();
-        auto result = index.intersection(pattern.tokens);
+        auto result = run_intersection<t_strategy>(index,pattern.tokens);
         auto stop = clock::now();
         for (const auto& id : result) {
             dchecksum += id;
@@ -91,6 +124,34 @@ void bench_doc_intersection(const t_idx& index,
     LOG(INFO) << "INDEX = " << name << " time = " <<
               std::chrono::duration_cast<std::chrono::milliseconds>(total).count()/1000.0f
               << " secs";
+    log_kernel_counts(name);
+}
+
+/* all patterns as one batch with group_size of them interleaved. only the
+   total time is reported, the checksum matches bench_doc_intersection */
+template<class t_idx>
+void bench_batch_doc_intersection(const t_idx& index,
+                                  const std::vector<pattern_t>& patterns,
+                                  size_t group_size,
+                                  const char* name)
+{
+    LOG(INFO) << "BENCH = " << name << " group size = " << group_size;
+    using clock = std::chrono::high_resolution_clock;
+    std::vector<std::vector<uint64_t>> queries;
+    for (const auto& pattern : patterns) queries.push_back(pattern.tokens);
+    auto start = clock::now();
+    auto results = index.batch_intersection(queries,group_size);
+    auto stop = clock::now();
+    size_t dchecksum = 0;
+    for (const auto& result : results) {
+        for (const auto& id : result) {
+            dchecksum += id;
+        }
+    }
+    LOG(INFO) << "INDEX = " << name << " DCHECKSUM = " << dchecksum;
+    LOG(INFO) << "INDEX = " << name << " time = " <<
+              std::chrono::duration_cast<std::chrono::milliseconds>(stop-start).count()/1000.0f
+              << " secs";
 }
 
 int main(int argc,const char* argv[])
@@ -152,11 +213,14 @@ int main(int argc,const char* argv[])
         using invidx_type = index_invidx<uniform_eliasfano_list<128>,optpfor_list<128,false>>;
         invidx_type index(col);
         bench_doc_intersection(index,patterns,"UEF-128",resfs);
+        bench_doc_intersection<intersect_daat>(index,patterns,"UEF-128-DAAT",resfs);
+        bench_batch_doc_intersection(index,patterns,args.group_size,"UEF-128-BATCH");
     }
     {
         using invidx_type = index_invidx<eliasfano_skip_list<64,true>,optpfor_list<128,false>>;
         invidx_type index(col);
         bench_doc_intersection(index,patterns,"ESL-64",resfs);
+        bench_batch_doc_intersection(index,patterns,args.group_size,"ESL-64-BATCH");
     }
     {
         using invidx_type = index_invidx<eliasfano_list<true>,optpfor_list<128,false>>;
@@ -167,6 +231,23 @@ int main(int argc,const char* argv[])
         using invidx_type = index_invidx<optpfor_list<128,true>,optpfor_list<128,false>>;
         invidx_type index(col);
         bench_doc_intersection(index,patterns,"OPF-128",resfs);
+        bench_doc_intersection<intersect_daat>(index,patterns,"OPF-128-DAAT",resfs);
+        bench_batch_doc_intersection(index,patterns,args.group_size,"OPF-128-BATCH");
+    }
+    {
+        using invidx_type = index_invidx<simdbp128_list<true>,optpfor_list<128,false>>;
+        invidx_type index(col);
+        bench_doc_intersection(index,patterns,"SIMDBP-128",resfs);
+    }
+    {
+        using invidx_type = index_invidx<streamvbyte_list<true>,optpfor_list<128,false>>;
+        invidx_type index(col);
+        bench_doc_intersection(index,patterns,"SVB-128",resfs);
+    }
+    {
+        using invidx_type = index_invidx<hybrid_list<>,optpfor_list<128,false>>;
+        invidx_type index(col);
+        bench_doc_intersection(index,patterns,"HYBRID",resfs);
     }
     {
         index_wt<> index(col);
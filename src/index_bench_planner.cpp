@@ -0,0 +1,212 @@
+#include "utils.hpp"
+#include "collection.hpp"
+#include "indexes.hpp"
+#include "list_types.hpp"
+#include "patterns.hpp"
+#include "query_planner.hpp"
+
+#include "sdsl/suffix_trees.hpp"
+#include "sdsl/suffix_arrays.hpp"
+
+#include "easylogging++.h"
+
+#include <map>
+#include <functional>
+
+_INITIALIZE_EASYLOGGINGPP
+
+typedef struct cmdargs {
+    std::string collection_dir;
+    std::string pattern_file;
+    uint32_t patterns_per_bucket;
+} cmdargs_t;
+
+void
+print_usage(const char* program)
+{
+    fprintf(stdout,"%s -c <collection directory> -p <pattern file>\n",program);
+    fprintf(stdout,"where\n");
+    fprintf(stdout,"  -c <collection directory>  : the directory the collection is stored.\n");
+    fprintf(stdout,"  -p <pattern file>  : the pattern file.\n");
+    fprintf(stdout,"  -n <patterns per bucket>  : number of patterns per bucket to run.\n");
+};
+
+cmdargs_t
+parse_args(int argc,const char* argv[])
+{
+    cmdargs_t args;
+    int op;
+    args.collection_dir = "";
+    args.pattern_file = "";
+    args.patterns_per_bucket = 100;
+    while ((op=getopt(argc,(char* const*)argv,"c:p:n:")) != -1) {
+        switch (op) {
+            case 'c':
+                args.collection_dir = optarg;
+                break;
+            case 'p':
+                args.pattern_file = optarg;
+                break;
+            case 'n':
+                args.patterns_per_bucket = std::stoul(optarg);
+                break;
+        }
+    }
+    if (args.collection_dir==""||args.pattern_file=="") {
+        std::cerr << "Missing command line parameters.\n";
+        print_usage(argv[0]);
+        exit(EXIT_FAILURE);
+    }
+    return args;
+}
+
+// the time of one query per bench type, summed up per bucket
+struct bucket_stats {
+    std::map<std::string,std::chrono::nanoseconds> total;
+    std::map<std::string,size_t> queries;
+    std::map<std::string,size_t> plans;
+};
+
+void write_result(ostream& ofs,const pattern_t& pattern,const std::string& name,std::chrono::nanoseconds time)
+{
+    ofs << name << ";"
+        << pattern.id << ";"
+        << pattern.m << ";"
+        << pattern.ndoc << ";"
+        << pattern.nocc << ";"
+        << pattern.list_size_sum << ";"
+        << pattern.min_list_size << ";"
+        << pattern.bucket << ";"
+        << time.count() << endl;
+}
+
+/* runs every pattern on each index and on the planner which picks one of
+   them per pattern. ORACLE is the fastest index of each pattern. the
+   estimated cost of each plan is written next to its measured time so
+   the cost model can be calibrated */
+template<class t_planner,class t_abspos,class t_nextword,class t_sada,class t_wt>
+void bench_planner(const t_planner& planner,
+                   const t_abspos& abspos,
+                   const t_nextword& nextword,
+                   const t_sada& sada,
+                   const t_wt& wt,
+                   const std::vector<pattern_t>& patterns,
+                   ostream& ofs,
+                   ostream& cfs)
+{
+    using clock = std::chrono::high_resolution_clock;
+    std::map<std::string,size_t> dchecksum;
+    std::map<size_t,bucket_stats> buckets;
+    for (const auto& pattern : patterns) {
+        LOG(INFO) << "id=" << pattern.id << " m=" << pattern.m << " ndoc=" << pattern.ndoc << " nocc=" << pattern.nocc
+                  << " list_sum=" << pattern.list_size_sum << " min_list=" << pattern.min_list_size;
+        auto& bstats = buckets[pattern.bucket];
+        auto est = planner.estimate(pattern.tokens);
+        std::chrono::nanoseconds oracle = std::chrono::nanoseconds::max();
+        auto run = [&](const std::string& name,phrase_plan plan,std::function<docfreq_result()> query) {
+            auto start = clock::now();
+            auto result = query();
+            auto stop = clock::now();
+            auto time = std::chrono::duration_cast<std::chrono::nanoseconds>(stop-start);
+            for (const auto& df : result) dchecksum[name] += df.first;
+            bstats.total[name] += time;
+            bstats.queries[name]++;
+            write_result(ofs,pattern,name,time);
+            if (plan != phrase_plan::none) {
+                oracle = std::min(oracle,time);
+                cfs << pattern.id << ";" << pattern.bucket << ";" << name << ";"
+                    << est.occ << ";" << est.ndoc << ";" << est.cost[(size_t)plan] << ";" << time.count() << endl;
+            }
+        };
+        run("ABSPOS-UEF-128",phrase_plan::abspos,[&] { return abspos.phrase_list(pattern.tokens); });
+        if (pattern.tokens.size() >= 2) {
+            run("NEXTWORD-UEF-128",phrase_plan::nextword,[&] { return nextword.phrase_list(pattern.tokens); });
+        }
+        run("SADA",phrase_plan::sada,[&] { return sada.phrase_list(pattern.tokens); });
+        run("WT",phrase_plan::wt,[&] { return wt.phrase_list(pattern.tokens); });
+        // the planner time includes counting the occurrences and the estimates
+        run("PLANNER",phrase_plan::none,[&] { return planner.phrase_list(pattern.tokens); });
+        bstats.plans[phrase_plan_name(est.best())]++;
+        bstats.total["ORACLE"] += oracle;
+        bstats.queries["ORACLE"]++;
+        write_result(ofs,pattern,"ORACLE",oracle);
+    }
+    for (const auto& dc : dchecksum) {
+        LOG(INFO) << "INDEX = " << dc.first << " DCHECKSUM = " << dc.second;
+    }
+    for (const auto& b : buckets) {
+        for (const auto& t : b.second.total) {
+            LOG(INFO) << "bucket = " << b.first << " INDEX = " << t.first << " mean time = "
+                      << t.second.count()/b.second.queries.at(t.first)/1000.0f << " usecs";
+        }
+        for (const auto& p : b.second.plans) {
+            LOG(INFO) << "bucket = " << b.first << " PLAN = " << p.first << " cnt = " << p.second;
+        }
+    }
+}
+
+int main(int argc,const char* argv[])
+{
+    _START_EASYLOGGINGPP(argc,argv);
+    el::Loggers::addFlag(el::LoggingFlag::ColoredTerminalOutput);
+    el::Loggers::reconfigureAllLoggers(el::ConfigurationType::Format, "%datetime : %msg");
+
+    /* parse command line */
+    LOG(INFO) << "Parsing command line arguments";
+    cmdargs_t args = parse_args(argc,argv);
+
+    /* parse the collection */
+    LOG(INFO) << "Parsing collection directory " << args.collection_dir;
+    collection col(args.collection_dir);
+
+    /* load pattern file */
+    auto patterns = pattern_parser::parse_file<false>(args.pattern_file);
+    LOG(INFO) << "Parsed " << patterns.size() << " patterns from file " << args.pattern_file;
+
+    /* filter patterns */
+    std::sort(patterns.begin(), patterns.end(), [](const pattern_t& a, const pattern_t& b) {
+        return a.bucket < b.bucket;
+    });
+    size_t freq = 0;
+    size_t cnt = 0;
+    size_t bucket = patterns[0].bucket;
+    auto itr = patterns.begin();
+    while (itr != patterns.end()) {
+        if (itr->bucket != bucket) {
+            LOG(INFO) << "bucket = " << bucket << " cnt = " << cnt;
+            bucket = itr->bucket;
+            freq = 0;
+            cnt = 0;
+        }
+        if (freq >= args.patterns_per_bucket || bucket > 6) {
+            itr = patterns.erase(itr);
+        } else {
+            itr++;
+            cnt++;
+        }
+        freq++;
+    }
+    LOG(INFO) << "bucket = " << bucket << " cnt = " << cnt;
+    LOG(INFO) << "Filtered " << patterns.size() << " patterns";
+
+    /* open output files */
+    std::chrono::system_clock::time_point now = std::chrono::system_clock::now();
+    auto sec_since_epoc = std::chrono::duration_cast<std::chrono::seconds>(now.time_since_epoch());
+    auto time_str = std::to_string(sec_since_epoc.count());
+    ofstream resfs(col.path+"/results/bench_planner-"+time_str+".csv");
+    resfs << "type;id;len;ndoc;nocc;list_sum;min_list_len;bucket;time_ns" << std::endl;
+    ofstream costfs(col.path+"/results/bench_planner_costs-"+time_str+".csv");
+    costfs << "id;bucket;type;est_occ;est_ndoc;est_cost_ns;time_ns" << std::endl;
+
+    /* load indexes and test. all indexes are used by the planner at once */
+    using invidx_type = index_invidx<uniform_eliasfano_list<128>,optpfor_list<128,false>>;
+    index_abspos<uniform_eliasfano_list<128>,invidx_type> abspos(col);
+    index_nextword<uniform_eliasfano_list<128>,invidx_type> nextword(col);
+    index_sada<> sada(col);
+    index_wt<> wt(col);
+    auto stats = load_phrase_statistics(col);
+    auto planner = make_phrase_planner(stats,&abspos,&nextword,&sada,&wt);
+    bench_planner(planner,abspos,nextword,sada,wt,patterns,resfs,costfs);
+
+    return 0;
+}
@@ -0,0 +1,153 @@
+#include "utils.hpp"
+#include "collection.hpp"
+#include "indexes.hpp"
+#include "list_types.hpp"
+#include "patterns.hpp"
+
+#include "easylogging++.h"
+
+_INITIALIZE_EASYLOGGINGPP
+
+typedef struct cmdargs {
+    std::string collection_dir;
+    std::string pattern_file;
+    uint32_t k;
+} cmdargs_t;
+
+void
+print_usage(const char* program)
+{
+    fprintf(stdout,"%s -c <collection directory> -p <pattern file> -k <top-k>\n",program);
+    fprintf(stdout,"where\n");
+    fprintf(stdout,"  -c <collection directory>  : the directory the collection is stored.\n");
+    fprintf(stdout,"  -p <pattern file>  : the pattern file.\n");
+    fprintf(stdout,"  -k <top-k>  : number of results to retrieve (default 10).\n");
+};
+
+cmdargs_t
+parse_args(int argc,const char* argv[])
+{
+    cmdargs_t args;
+    int op;
+    args.collection_dir = "";
+    args.pattern_file = "";
+    args.k = 10;
+    while ((op=getopt(argc,(char* const*)argv,"c:p:k:")) != -1) {
+        switch (op) {
+            case 'c':
+                args.collection_dir = optarg;
+                break;
+            case 'p':
+                args.pattern_file = optarg;
+                break;
+            case 'k':
+                args.k = std::stoul(optarg);
+                break;
+        }
+    }
+    if (args.collection_dir==""||args.pattern_file=="") {
+        std::cerr << "Missing command line parameters.\n";
+        print_usage(argv[0]);
+        exit(EXIT_FAILURE);
+    }
+    return args;
+}
+
+template<class t_idx,class t_func>
+std::chrono::nanoseconds
+bench_topk(const t_idx& index,
+           const std::vector<pattern_t>& patterns,
+           const std::string& name,
+           size_t k,
+           t_func query,
+           ostream& ofs)
+{
+    LOG(INFO) << "BENCH = " << name;
+    using clock = std::chrono::high_resolution_clock;
+    size_t dchecksum = 0;
+    std::chrono::nanoseconds total(0);
+    for (const auto& pattern : patterns) {
+        auto start = clock::now();
+        auto result = query(index,pattern.tokens,k);
+        auto stop = clock::now();
+        for (const auto& res : result) {
+            dchecksum += res.first;
+        }
+        total += (stop-start);
+        ofs << name << ";"
+            << pattern.id << ";"
+            << pattern.m << ";"
+            << pattern.list_size_sum << ";"
+            << pattern.bucket << ";"
+            << k << ";"
+            << index.block_max_size_in_bytes() << ";"
+            << std::chrono::duration_cast<std::chrono::nanoseconds>(stop-start).count() << endl;
+    }
+    LOG(INFO) << "INDEX = " << name << " DCHECKSUM = " << dchecksum;
+    LOG(INFO) << "INDEX = " << name << " time = " <<
+              std::chrono::duration_cast<std::chrono::milliseconds>(total).count()/1000.0f
+              << " secs";
+    return total;
+}
+
+template<class t_idx>
+void bench_wand_vs_bmw(const t_idx& index,
+                       const std::vector<pattern_t>& patterns,
+                       const std::string& name,
+                       size_t k,
+                       ostream& ofs)
+{
+    auto wand_time = bench_topk(index,patterns,name+"-WAND",k,[](const t_idx& idx,const std::vector<uint64_t>& ids,size_t k) {
+        return idx.topk(ids,k);
+    },ofs);
+    auto bmw_time = bench_topk(index,patterns,name+"-BMW",k,[](const t_idx& idx,const std::vector<uint64_t>& ids,size_t k) {
+        return idx.topk_block_max(ids,k);
+    },ofs);
+    auto bound_bytes = index.block_max_size_in_bytes();
+    auto index_bytes = sdsl::size_in_bytes(index);
+    LOG(INFO) << "INDEX = " << name << " block max bounds = " << bound_bytes << " bytes ("
+              << 100.0*bound_bytes/index_bytes << "% of " << index_bytes << " bytes)";
+    LOG(INFO) << "INDEX = " << name << " BMW speedup = "
+              << (double)wand_time.count()/std::max((int64_t)1,(int64_t)bmw_time.count());
+}
+
+int main(int argc,const char* argv[])
+{
+    _START_EASYLOGGINGPP(argc,argv);
+    el::Loggers::addFlag(el::LoggingFlag::ColoredTerminalOutput);
+    el::Loggers::reconfigureAllLoggers(el::ConfigurationType::Format, "%datetime : %msg");
+
+    /* parse command line */
+    LOG(INFO) << "Parsing command line arguments";
+    cmdargs_t args = parse_args(argc,argv);
+
+    /* parse the collection */
+    LOG(INFO) << "Parsing collection directory " << args.collection_dir;
+    collection col(args.collection_dir);
+
+    /* load pattern file */
+    auto patterns = pattern_parser::parse_file<false>(args.pattern_file);
+    LOG(INFO) << "Parsed " << patterns.size() << " patterns from file " << args.pattern_file;
+
+    /* open output file */
+    std::chrono::system_clock::time_point now = std::chrono::system_clock::now();
+    auto sec_since_epoc = std::chrono::duration_cast<std::chrono::seconds>(now.time_since_epoch());
+    auto time_str = std::to_string(sec_since_epoc.count());
+    ofstream resfs(col.path+"/results/bench_topk-"+time_str+".csv");
+
+    resfs << "type;id;len;list_sum;bucket;k;bound_bytes;time_ns" << std::endl;
+
+    /* load indexes and test */
+    {
+        using invidx_type = index_invidx<uniform_eliasfano_list<128>,optpfor_list<128,false>,rank_bm25<>,128>;
+        invidx_type index(col);
+        bench_wand_vs_bmw(index,patterns,"UEF-128",args.k,resfs);
+    }
+    {
+        using invidx_type = index_invidx<optpfor_list<128,true>,optpfor_list<128,false>,rank_bm25<>,128>;
+        invidx_type index(col);
+        bench_wand_vs_bmw(index,patterns,"OPF-128",args.k,resfs);
+    }
+
+    return 0;
+}
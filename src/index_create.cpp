@@ -9,6 +9,8 @@ _INITIALIZE_EASYLOGGINGPP
 
 typedef struct cmdargs {
     std::string collection_dir;
+    sa_construction_options sa_opts;
+    int64_t hybrid_min_list_size;
 } cmdargs_t;
 
 void
@@ -17,6 +19,9 @@ print_usage(const char* program)
     fprintf(stdout,"%s -c <collection directory> \n",program);
     fprintf(stdout,"where\n");
     fprintf(stdout,"  -c <collection directory>  : the directory the collection is stored.\n");
+    fprintf(stdout,"  -m <MB>  : memory budget for the collection construction (default: half of the RAM).\n");
+    fprintf(stdout,"  -s <algorithm>  : suffix array construction: auto, qsufsort, doubling or bucket (default auto).\n");
+    fprintf(stdout,"  -t <min list size>  : also build the hybrid nextword index with this threshold: 0, 65536 or 1048576.\n");
 };
 
 cmdargs_t
@@ -25,11 +30,37 @@ parse_args(int argc,const char* argv[])
     cmdargs_t args;
     int op;
     args.collection_dir = "";
-    while ((op=getopt(argc,(char* const*)argv,"c:")) != -1) {
+    args.hybrid_min_list_size = -1;
+    while ((op=getopt(argc,(char* const*)argv,"c:m:s:t:")) != -1) {
         switch (op) {
             case 'c':
                 args.collection_dir = optarg;
                 break;
+            case 'm':
+                args.sa_opts.memory_budget = std::stoull(optarg)*1024*1024;
+                break;
+            case 's': {
+                    std::string algo = optarg;
+                    if (algo == "auto") args.sa_opts.algorithm = sa_algorithm::automatic;
+                    else if (algo == "qsufsort") args.sa_opts.algorithm = sa_algorithm::qsufsort;
+                    else if (algo == "doubling") args.sa_opts.algorithm = sa_algorithm::prefix_doubling;
+                    else if (algo == "bucket") args.sa_opts.algorithm = sa_algorithm::bucket;
+                    else {
+                        std::cerr << "Unknown suffix array construction '" << algo << "'.\n";
+                        print_usage(argv[0]);
+                        exit(EXIT_FAILURE);
+                    }
+                }
+                break;
+            case 't':
+                args.hybrid_min_list_size = std::stoll(optarg);
+                if (args.hybrid_min_list_size != 0 && args.hybrid_min_list_size != 65536
+                        && args.hybrid_min_list_size != 1048576) {
+                    std::cerr << "Unsupported hybrid nextword threshold '" << optarg << "'.\n";
+                    print_usage(argv[0]);
+                    exit(EXIT_FAILURE);
+                }
+                break;
         }
     }
     if (args.collection_dir=="") {
@@ -40,6 +71,23 @@ parse_args(int argc,const char* argv[])
     return args;
 }
 
+void
+print_build_report(const std::vector<build_step_report>& report)
+{
+    LOG(INFO) << "Collection construction (peak RSS is the peak of the process when the stage finished)";
+    char line[256];
+    snprintf(line,sizeof(line),"%-10s %10s %10s %14s %14s","stage","start [s]","time [s]","estimate [MB]","peak RSS [MB]");
+    LOG(INFO) << line;
+    for (const auto& step : report) {
+        if (step.skipped) {
+            snprintf(line,sizeof(line),"%-10s %10s",step.name.c_str(),"exists");
+        } else {
+            snprintf(line,sizeof(line),"%-10s %10.2f %10.2f %14llu %14llu",step.name.c_str(),step.start,step.time,
+                     (unsigned long long)(step.memory/(1024*1024)),(unsigned long long)(step.peak_rss/(1024*1024)));
+        }
+        LOG(INFO) << line;
+    }
+}
 
 int main(int argc,const char* argv[])
 {
@@ -54,7 +102,8 @@ int main(int argc,const char* argv[])
 
     /* parse the collection */
     LOG(INFO) << "Parsing collection directory " << args.collection_dir;
-    collection col(args.collection_dir);
+    collection col(args.collection_dir,args.sa_opts);
+    print_build_report(col.build_report);
 
     /* create index */
     using invidx_type = index_invidx<uniform_eliasfano_list<128>,optpfor_list<128,false>>;
@@ -64,6 +113,14 @@ int main(int argc,const char* argv[])
     {
         index_relnextword<optpfor_list<128,false>,invidx_type> index(col);
     }
+    // index-bench-doc.x benches the thresholds 65536 and 1048576
+    if (args.hybrid_min_list_size == 0) {
+        index_hybrid_nextword<uniform_eliasfano_list<128>,invidx_type,0> index(col);
+    } else if (args.hybrid_min_list_size == 65536) {
+        index_hybrid_nextword<uniform_eliasfano_list<128>,invidx_type,65536> index(col);
+    } else if (args.hybrid_min_list_size == 1048576) {
+        index_hybrid_nextword<uniform_eliasfano_list<128>,invidx_type,1048576> index(col);
+    }
     // {
     //     index_wt<> index(col);
     // }
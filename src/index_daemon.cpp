@@ -1,4 +1,6 @@
 #include <chrono>
+#include <thread>
+#include <mutex>
 
 #include "utils.hpp"
 #include "collection.hpp"
@@ -6,6 +8,7 @@
 #include "list_types.hpp"
 #include "dict_map.hpp"
 #include "intersection.hpp"
+#include "batch_intersection.hpp"
 
 #include "easylogging++.h"
 #include "zmq.hpp"
@@ -18,6 +21,11 @@ _INITIALIZE_EASYLOGGINGPP
 typedef struct cmdargs {
     std::string collection_dir;
     std::string port;
+    size_t k;
+    size_t num_workers;
+    size_t group_size;
+    bool verbose;
+    index_load_options load_opts;
 } cmdargs_t;
 
 void
@@ -27,6 +35,14 @@ print_usage(const char* program)
     fprintf(stdout,"where\n");
     fprintf(stdout,"  -c <collection directory>  : the directory the collection is stored.\n");
     fprintf(stdout,"  -p <port>  : the port the daemon is running on.\n");
+    fprintf(stdout,"  -k <k>  : number of results returned if the query does not specify it (default 10).\n");
+    fprintf(stdout,"  -t <threads>  : number of worker threads answering queries (default: number of cores).\n");
+    fprintf(stdout,"  -g <group size>  : number of waiting queries a worker answers together (default %zu).\n",default_batch_group_size);
+    fprintf(stdout,"  -v  : print every query and reply.\n");
+    fprintf(stdout,"  -m  : map the index file into memory instead of reading it.\n");
+    fprintf(stdout,"  -a <advice>  : access hint for the mapped index: normal, random, sequential, willneed or hugepage.\n");
+    fprintf(stdout,"  -f  : fault in all pages of the mapped index at startup.\n");
+    fprintf(stdout,"queries have the form <qid>;<terms>[;<k>[;topk]]. topk ranks the documents by score.\n");
 };
 
 cmdargs_t
@@ -36,7 +52,11 @@ parse_args(int argc,const char* argv[])
     int op;
     args.collection_dir = "";
     args.port = std::to_string(5556);
-    while ((op=getopt(argc,(char* const*)argv,"c:p:")) != -1) {
+    args.k = 10;
+    args.num_workers = std::max(1U,std::thread::hardware_concurrency());
+    args.group_size = default_batch_group_size;
+    args.verbose = false;
+    while ((op=getopt(argc,(char* const*)argv,"c:p:k:t:g:vma:f")) != -1) {
         switch (op) {
             case 'c':
                 args.collection_dir = optarg;
@@ -44,6 +64,38 @@ parse_args(int argc,const char* argv[])
             case 'p':
                 args.port = optarg;
                 break;
+            case 'k':
+                args.k = std::stoull(optarg);
+                break;
+            case 't':
+                args.num_workers = std::max(1ULL,std::stoull(optarg));
+                break;
+            case 'g':
+                args.group_size = std::max(1ULL,std::stoull(optarg));
+                break;
+            case 'v':
+                args.verbose = true;
+                break;
+            case 'm':
+                args.load_opts.use_mmap = true;
+                break;
+            case 'a': {
+                    std::string advice = optarg;
+                    if (advice == "normal") args.load_opts.advice = mmap_advice::normal;
+                    else if (advice == "random") args.load_opts.advice = mmap_advice::random;
+                    else if (advice == "sequential") args.load_opts.advice = mmap_advice::sequential;
+                    else if (advice == "willneed") args.load_opts.advice = mmap_advice::willneed;
+                    else if (advice == "hugepage") args.load_opts.advice = mmap_advice::hugepage;
+                    else {
+                        std::cerr << "Unknown advice '" << advice << "'.\n";
+                        print_usage(argv[0]);
+                        exit(EXIT_FAILURE);
+                    }
+                }
+                break;
+            case 'f':
+                args.load_opts.populate = true;
+                break;
         }
     }
     if (args.collection_dir=="") {
@@ -54,12 +106,175 @@ parse_args(int argc,const char* argv[])
     return args;
 }
 
+/* a request received by a worker. the envelope frames identify the client
+   and are sent back in front of the reply */
+struct request_t {
+    std::vector<zmq::message_t> envelope;
+    std::string qry_str;
+};
+
+// receives all frames of a request. false if flags contains ZMQ_DONTWAIT and no request is waiting
+bool
+recv_request(zmq::socket_t& socket,request_t& req,int flags = 0)
+{
+    while (true) {
+        zmq::message_t part;
+        if (!socket.recv(&part,flags)) return false;
+        // the frames of a multipart message arrive together
+        flags = 0;
+        if (!part.more()) {
+            req.qry_str.assign((const char*) part.data(),part.size());
+            return true;
+        }
+        req.envelope.emplace_back(std::move(part));
+    }
+}
+
+void
+send_reply(zmq::socket_t& socket,request_t& req,const std::string& json_str)
+{
+    for (auto& part : req.envelope) {
+        socket.send(part,ZMQ_SNDMORE);
+    }
+    zmq::message_t reply(json_str.size());
+    memcpy(reply.data(),json_str.data(),json_str.size());
+    socket.send(reply);
+}
+
+/* answers a batch of queries, returns the json replies. the unranked
+   queries are intersected together, args.group_size of them interleaved,
+   so their time is the time of the whole batch. the index and the
+   dictionary are only read, so all workers share them */
+template<class t_idx>
+std::vector<std::string>
+process_queries(const t_idx& index,dict_map& dict,const std::vector<request_t>& requests,const cmdargs_t& args)
+{
+    using clock = std::chrono::high_resolution_clock;
+    size_t n = requests.size();
+    std::vector<query_t> parsed_qrys;
+    std::vector<clock::duration> times;
+    std::vector<std::vector<uint64_t>> ids(n);
+    std::vector<std::vector<double>> scores(n);
+
+    // parse and answer the ranked queries
+    batch_intersection<typename t_idx::doclist_type::list_type> batch;
+    std::vector<size_t> batch_qrys;
+    for (size_t i=0; i<n; i++) {
+        auto parse_start = clock::now();
+        parsed_qrys.emplace_back(dict.parse_query(requests[i].qry_str));
+        auto& parsed_qry = parsed_qrys.back();
+        if (parsed_qry.k > index.num_docs()) {
+            parsed_qry.error = "result limit exceeds the number of documents";
+            parsed_qry.ids.clear();
+        }
+        size_t k = parsed_qry.k ? parsed_qry.k : args.k;
+        if (parsed_qry.ids.size() > 0) {
+            if (parsed_qry.ranked) {
+                for (const auto& r : index.doc_topk(parsed_qry.ids,k)) {
+                    ids[i].push_back(r.first);
+                    scores[i].push_back(r.second);
+                }
+            } else {
+                // only the first k ids are computed
+                batch.add(index.doc_lists(parsed_qry.ids),k);
+                batch_qrys.push_back(i);
+            }
+        }
+        times.push_back(clock::now() - parse_start);
+    }
+
+    // answer the unranked queries
+    if (batch.size() > 0) {
+        auto query_start = clock::now();
+        auto results = batch.run(args.group_size);
+        auto query_time = clock::now() - query_start;
+        for (size_t j=0; j<batch_qrys.size(); j++) {
+            auto i = batch_qrys[j];
+            for (const auto& id : results[j]) ids[i].push_back(id);
+            times[i] += query_time;
+        }
+    }
+
+    // json output
+    std::vector<std::string> replies;
+    for (size_t i=0; i<n; i++) {
+        const auto& parsed_qry = parsed_qrys[i];
+        rapidjson::StringBuffer s;
+        rapidjson::Writer<rapidjson::StringBuffer> json_writer(s);
+        json_writer.StartObject();
+
+        json_writer.String("qid");
+        json_writer.Uint(parsed_qry.id);
+
+        if (!parsed_qry.error.empty()) {
+            json_writer.String("error");
+            json_writer.String(parsed_qry.error.c_str());
+        }
+
+        if (parsed_qry.ids.size() > 0) {
+            json_writer.String("ids");
+            json_writer.StartArray();
+            for (const auto& id : ids[i]) {
+                json_writer.Uint(id);
+            }
+            json_writer.EndArray();
+            if (parsed_qry.ranked) {
+                json_writer.String("scores");
+                json_writer.StartArray();
+                for (const auto& score : scores[i]) {
+                    json_writer.Double(score);
+                }
+                json_writer.EndArray();
+            }
+        } else {
+            json_writer.String("id");
+            json_writer.StartArray();
+            json_writer.EndArray();
+        }
+        // time
+        json_writer.String("time");
+        json_writer.Double(std::chrono::duration_cast<std::chrono::microseconds>(times[i]).count()/1000.0);
+        json_writer.EndObject();
+        replies.emplace_back(s.GetString(),s.GetSize());
+    }
+    return replies;
+}
+
+std::mutex print_mutex;
+
+template<class t_idx>
+void
+worker(zmq::context_t& context,const t_idx& index,dict_map& dict,const cmdargs_t& args)
+{
+    zmq::socket_t socket(context, ZMQ_DEALER);
+    socket.connect("inproc://workers");
+    while (true) {
+        /* wait for a request, then take up to group_size-1 more waiting ones */
+        std::vector<request_t> requests(1);
+        recv_request(socket,requests[0]);
+        while (requests.size() < args.group_size) {
+            request_t req;
+            if (!recv_request(socket,req,ZMQ_DONTWAIT)) break;
+            requests.push_back(std::move(req));
+        }
+
+        auto replies = process_queries(index,dict,requests,args);
+
+        for (size_t i=0; i<requests.size(); i++) {
+            if (args.verbose) {
+                std::lock_guard<std::mutex> lock(print_mutex);
+                std::cout << "qry[" << requests[i].qry_str << "] reply = '" << replies[i] << "'" << std::endl;
+            }
+            send_reply(socket,requests[i],replies[i]);
+        }
+    }
+}
+
 int main(int argc,const char* argv[])
 {
     _START_EASYLOGGINGPP(argc,argv);
     el::Loggers::addFlag(el::LoggingFlag::ColoredTerminalOutput);
     el::Loggers::reconfigureAllLoggers(el::ConfigurationType::Format, "%datetime : %msg");
-    using clock = std::chrono::high_resolution_clock;
 
     /* parse command line */
     LOG(INFO) << "Parsing command line arguments";
@@ -71,76 +286,30 @@ int main(int argc,const char* argv[])
 
     /* create/load index */
     using invidx_type = index_invidx<eliasfano_list<true>,eliasfano_list<false>>;
-    index_abspos<eliasfano_list<true>,invidx_type> index(col);
+    index_abspos<eliasfano_list<true>,invidx_type> index(col,args.load_opts);
 
     /* load dict */
     dict_map dict(col);
 
-    /* daemon mode */
+    /* daemon mode: clients connect to the ROUTER socket, which forwards the
+       requests through an inproc DEALER socket to the DEALER sockets of the
+       worker threads. each worker answers the requests waiting for it in
+       batches of up to group_size */
     {
-        std::cout << "Starting daemon mode on port " << args.port << std::endl;
+        std::cout << "Starting daemon mode on port " << args.port << " with " << args.num_workers << " workers" << std::endl;
         zmq::context_t context(1);
-        zmq::socket_t server(context, ZMQ_REP);
-        server.bind(std::string("tcp://*:"+args.port).c_str());
-
-        while (true) {
-            zmq::message_t request;
-            /* wait for msg */
-            server.recv(&request);
-            const char* qry = (const char*) request.data();
-            std::string qry_str(qry,request.size());
-
-            auto parse_start = clock::now();
-            auto parsed_qry = dict.parse_query(qry_str);
-            auto parse_stop = clock::now();
-            auto parse_time = parse_stop - parse_start;
-            auto total_time = parse_time;
-
-            // json output
-            rapidjson::StringBuffer s;
-            rapidjson::Writer<rapidjson::StringBuffer> json_writer(s);
-            json_writer.StartObject();
-
-            json_writer.String("qid");
-            json_writer.Uint(parsed_qry.id);
-
-            // perform query
-            std::cout << "qry[" << parsed_qry << "]" << std::endl;
-            if (parsed_qry.ids.size() > 0) {
-                auto query_start = clock::now();
-                auto doc_lists = index.doc_lists(parsed_qry.ids);
-                auto res_list = intersect(doc_lists);
-                auto query_stop = clock::now();
-                auto query_time = query_stop - query_start;
-                total_time += query_time;
-
-                json_writer.String("ids");
-                json_writer.StartArray();
-                size_t num_ids = std::min((size_t)10,res_list.size());
-                for (size_t i=0; i<num_ids; i++) {
-                    json_writer.Uint(res_list[i]);
-                }
-                json_writer.EndArray();
-            } else {
-                json_writer.String("id");
-                json_writer.StartArray();
-                json_writer.EndArray();
-            }
-            // time
-            json_writer.String("time");
-            json_writer.Double(std::chrono::duration_cast<std::chrono::microseconds>(total_time).count()/1000.0);
-
-            // send
-            json_writer.EndObject();
-            auto json_str = s.GetString();
-            zmq::message_t reply(s.GetSize());
-            memcpy(reply.data(),json_str,s.GetSize());
-            std::cout << "reply = '" << json_str << "'" << std::endl;
-            server.send(reply);
+        zmq::socket_t clients(context, ZMQ_ROUTER);
+        clients.bind(std::string("tcp://*:"+args.port).c_str());
+        zmq::socket_t workers(context, ZMQ_DEALER);
+        workers.bind("inproc://workers");
 
+        std::vector<std::thread> threads;
+        for (size_t i=0; i<args.num_workers; i++) {
+            threads.emplace_back([&] { worker(context,index,dict,args); });
         }
+        zmq::proxy((void*)clients,(void*)workers,nullptr);
+        for (auto& t : threads) t.join();
     }
 
-
     return 0;
-}
\ No newline at end of file
+}
@@ -0,0 +1,154 @@
+#include <chrono>
+#include <thread>
+#include <fstream>
+#include <sstream>
+#include <algorithm>
+#include <vector>
+#include <cstring>
+
+#include "utils.hpp"
+
+#include "easylogging++.h"
+#include "zmq.hpp"
+
+_INITIALIZE_EASYLOGGINGPP
+
+typedef struct cmdargs {
+    std::string server;
+    std::string query_file;
+    std::vector<size_t> clients;
+    size_t num_queries;
+} cmdargs_t;
+
+void
+print_usage(const char* program)
+{
+    fprintf(stdout,"%s -q <query file> \n",program);
+    fprintf(stdout,"where\n");
+    fprintf(stdout,"  -q <query file>  : queries in the daemon format <qid>;<terms>[;<k>[;topk]], one per line.\n");
+    fprintf(stdout,"  -s <server>  : the address of the daemon (default tcp://localhost:5556).\n");
+    fprintf(stdout,"  -c <clients>  : comma separated numbers of concurrent clients (default 1,2,4,8).\n");
+    fprintf(stdout,"  -n <num>  : number of queries sent by each client (default 1000).\n");
+};
+
+cmdargs_t
+parse_args(int argc,const char* argv[])
+{
+    cmdargs_t args;
+    int op;
+    args.server = "tcp://localhost:5556";
+    args.query_file = "";
+    args.clients = {1,2,4,8};
+    args.num_queries = 1000;
+    while ((op=getopt(argc,(char* const*)argv,"q:s:c:n:")) != -1) {
+        switch (op) {
+            case 'q':
+                args.query_file = optarg;
+                break;
+            case 's':
+                args.server = optarg;
+                break;
+            case 'c': {
+                    args.clients.clear();
+                    std::istringstream clients_stream(optarg);
+                    for (std::string c; std::getline(clients_stream,c,',');) {
+                        args.clients.push_back(std::stoull(c));
+                    }
+                }
+                break;
+            case 'n':
+                args.num_queries = std::stoull(optarg);
+                break;
+        }
+    }
+    if (args.query_file=="" || args.clients.empty()) {
+        std::cerr << "Missing command line parameters.\n";
+        print_usage(argv[0]);
+        exit(EXIT_FAILURE);
+    }
+    return args;
+}
+
+/* every client sends its queries one after the other and records the
+   latency of each request */
+void
+client(zmq::context_t& context,const cmdargs_t& args,const std::vector<std::string>& queries,
+       size_t client_id,std::vector<double>& latencies)
+{
+    using clock = std::chrono::high_resolution_clock;
+    zmq::socket_t socket(context, ZMQ_REQ);
+    socket.connect(args.server.c_str());
+    for (size_t i=0; i<args.num_queries; i++) {
+        const auto& qry = queries[(client_id*args.num_queries+i) % queries.size()];
+        zmq::message_t request(qry.size());
+        memcpy(request.data(),qry.data(),qry.size());
+        auto start = clock::now();
+        socket.send(request);
+        zmq::message_t reply;
+        socket.recv(&reply);
+        auto stop = clock::now();
+        latencies.push_back(std::chrono::duration_cast<std::chrono::microseconds>(stop-start).count()/1000.0);
+    }
+}
+
+int main(int argc,const char* argv[])
+{
+    _START_EASYLOGGINGPP(argc,argv);
+    el::Loggers::addFlag(el::LoggingFlag::ColoredTerminalOutput);
+    el::Loggers::reconfigureAllLoggers(el::ConfigurationType::Format, "%datetime : %msg");
+    using clock = std::chrono::high_resolution_clock;
+
+    /* parse command line */
+    LOG(INFO) << "Parsing command line arguments";
+    cmdargs_t args = parse_args(argc,argv);
+
+    /* load queries */
+    std::vector<std::string> queries;
+    {
+        std::ifstream qfs(args.query_file);
+        for (std::string qry; std::getline(qfs,qry);) {
+            if (!qry.empty()) queries.push_back(qry);
+        }
+    }
+    if (queries.empty()) {
+        LOG(FATAL) << "No queries in file " << args.query_file;
+        return EXIT_FAILURE;
+    }
+    LOG(INFO) << "Loaded " << queries.size() << " queries from " << args.query_file;
+
+    /* run one round for each number of clients */
+    zmq::context_t context(1);
+    std::cout << "clients;queries;time_s;qps;mean_ms;p50_ms;p99_ms" << std::endl;
+    for (const auto& num_clients : args.clients) {
+        std::vector<std::vector<double>> latencies(num_clients);
+        std::vector<std::thread> threads;
+        auto start = clock::now();
+        for (size_t i=0; i<num_clients; i++) {
+            threads.emplace_back(client,std::ref(context),std::cref(args),std::cref(queries),i,std::ref(latencies[i]));
+        }
+        for (auto& t : threads) t.join();
+        auto stop = clock::now();
+
+        std::vector<double> all;
+        for (const auto& l : latencies) all.insert(all.end(),l.begin(),l.end());
+        std::sort(all.begin(),all.end());
+        double secs = std::chrono::duration_cast<std::chrono::microseconds>(stop-start).count()/1000000.0;
+        if (all.empty()) {
+            std::cout << num_clients << ";0;" << secs << ";no queries" << std::endl;
+            LOG(ERROR) << num_clients << " clients: no queries were answered";
+            continue;
+        }
+        double sum = 0;
+        for (const auto& l : all) sum += l;
+        std::cout << num_clients << ";"
+                  << all.size() << ";"
+                  << secs << ";"
+                  << all.size()/secs << ";"
+                  << sum/all.size() << ";"
+                  << all[all.size()/2] << ";"
+                  << all[std::min(all.size()-1,all.size()*99/100)] << std::endl;
+        LOG(INFO) << num_clients << " clients: " << all.size()/secs << " queries/s";
+    }
+
+    return 0;
+}
@@ -121,6 +121,23 @@ int main(int argc,const char* argv[])
         index_abspos<eliasfano_skip_list<64,true>,invidx_type> index(col);
         verify_index(index,patterns,"ABS-ESF-64");
     }
+    {
+        using invidx_type = index_invidx<optpfor_list<128,true>,optpfor_list<128,false>>;
+        index_hybrid_nextword<eliasfano_skip_list<64,true>,invidx_type> index(col);
+        verify_index(index,patterns,"HYBRIDNEXT-ESF-64");
+    }
+    {
+        // all 2-tokens are stored
+        using invidx_type = index_invidx<optpfor_list<128,true>,optpfor_list<128,false>>;
+        index_hybrid_nextword<eliasfano_skip_list<64,true>,invidx_type,0> index(col);
+        verify_index(index,patterns,"HYBRIDNEXT-0-ESF-64");
+    }
+    {
+        // small collections mix 2-token and term lists
+        using invidx_type = index_invidx<optpfor_list<128,true>,optpfor_list<128,false>>;
+        index_hybrid_nextword<eliasfano_skip_list<64,true>,invidx_type,64> index(col);
+        verify_index(index,patterns,"HYBRIDNEXT-64-ESF-64");
+    }
     // {
     //     using invidx_type = index_invidx<optpfor_list<128,true>,optpfor_list<128,false>>;
     //     index_abspos<uniform_eliasfano_list<128>,invidx_type> index(col);
@@ -0,0 +1,175 @@
+#include "utils.hpp"
+#include "list_types.hpp"
+
+#include "easylogging++.h"
+
+#include <random>
+#include <chrono>
+
+_INITIALIZE_EASYLOGGINGPP
+
+typedef struct cmdargs {
+    uint64_t list_size;
+    uint64_t mean_gap;
+    uint64_t skips;
+    uint64_t max_distance;
+    uint64_t evict_mib;
+} cmdargs_t;
+
+void
+print_usage(const char* program)
+{
+    fprintf(stdout,"%s -n <list size> -g <mean gap> -s <skips> -d <max distance> -p <prefetch distance> -c <evict MiB>\n",program);
+    fprintf(stdout,"where\n");
+    fprintf(stdout,"  -n <list size>  : the number of postings of the synthetic list (default 50M).\n");
+    fprintf(stdout,"  -g <mean gap>  : the mean gap between the postings (default 8).\n");
+    fprintf(stdout,"  -s <skips>  : the number of skips per distance (default 1M).\n");
+    fprintf(stdout,"  -d <max distance>  : the largest skip distance in postings (default 1M).\n");
+    fprintf(stdout,"  -p <prefetch distance>  : cache lines prefetched ahead of skip(), 0 disables prefetching (default 2).\n");
+    fprintf(stdout,"  -c <evict MiB>  : run cold cache skips, evicting with a buffer of this size (larger than the LLC).\n");
+};
+
+cmdargs_t
+parse_args(int argc,const char* argv[])
+{
+    cmdargs_t args;
+    int op;
+    args.list_size = 50000000;
+    args.mean_gap = 8;
+    args.skips = 1000000;
+    args.max_distance = 1000000;
+    args.evict_mib = 0;
+    while ((op=getopt(argc,(char* const*)argv,"n:g:s:d:p:c:")) != -1) {
+        switch (op) {
+            case 'n':
+                args.list_size = std::stoull(optarg);
+                break;
+            case 'g':
+                args.mean_gap = std::stoull(optarg);
+                break;
+            case 's':
+                args.skips = std::stoull(optarg);
+                break;
+            case 'd':
+                args.max_distance = std::stoull(optarg);
+                break;
+            case 'p':
+                prefetch_distance() = std::stoull(optarg);
+                break;
+            case 'c':
+                args.evict_mib = std::stoull(optarg);
+                break;
+            default:
+                print_usage(argv[0]);
+                exit(EXIT_FAILURE);
+        }
+    }
+    if (args.list_size < 2 || args.mean_gap == 0 || (args.list_size-1)*args.mean_gap*2 > std::numeric_limits<uint32_t>::max()) {
+        std::cerr << "Invalid command line parameters.\n";
+        print_usage(argv[0]);
+        exit(EXIT_FAILURE);
+    }
+    return args;
+}
+
+/* skip() from the current posting to a target distance postings ahead.
+   every second target falls between two postings, so the skips which
+   find the target and the ones which stop at the next larger posting
+   are measured together. a cursor restarts at the beginning of the list
+   when it runs out of postings.
+
+   in the cold cache mode 1024 cursors are spread over the list and the
+   cache is flushed by writing an eviction buffer before every round in
+   which each cursor skips once. the eviction is not timed. */
+template<class t_list>
+void bench_skip(const std::vector<uint32_t>& A,const cmdargs_t& args,const char* name)
+{
+    using clock = std::chrono::high_resolution_clock;
+    sdsl::bit_vector bv;
+    {
+        bit_ostream os(bv);
+        t_list::create(os,A.begin(),A.end());
+    }
+    bit_istream is(bv);
+    auto list = t_list::materialize(is,0);
+    LOG(INFO) << "LIST = " << name << " bits per posting = " << (double)bv.size()/A.size();
+
+    bool cold = args.evict_mib != 0;
+    std::vector<uint8_t> evict(args.evict_mib << 20);
+    size_t num_cursors = cold ? 1024 : 1;
+    size_t skips_per_round = cold ? num_cursors : args.skips;
+    for (uint64_t distance = 1; distance <= args.max_distance && distance < A.size(); distance *= 10) {
+        std::mt19937_64 gen(4711);
+        std::vector<typename t_list::list_type::const_iterator> cursors(num_cursors,list.begin());
+        std::vector<uint64_t> offsets(num_cursors,0);
+        if (cold) {
+            for (size_t c=0; c<num_cursors; c++) {
+                offsets[c] = gen() % A.size();
+                cursors[c].skip(A[offsets[c]]);
+            }
+        }
+        size_t checksum = 0;
+        size_t num_skips = 0;
+        std::chrono::nanoseconds total(0);
+        std::vector<uint64_t> targets(skips_per_round);
+        std::vector<bool> restart(skips_per_round);
+        for (size_t done = 0; done < args.skips; done += skips_per_round) {
+            // the targets are computed before the timing starts
+            for (size_t i=0; i<skips_per_round; i++) {
+                auto& offset = offsets[i%num_cursors];
+                offset += distance;
+                restart[i] = offset >= A.size();
+                if (restart[i]) offset = distance;
+                targets[i] = A[offset] - (i&1);
+            }
+            if (cold) {
+                for (size_t i=0; i<evict.size(); i+=64) evict[i]++;
+            }
+            auto start = clock::now();
+            for (size_t i=0; i<skips_per_round; i++) {
+                auto& itr = cursors[i%num_cursors];
+                if (restart[i]) itr = list.begin();
+                checksum += itr.skip(targets[i]);
+                checksum += itr.offset();
+            }
+            total += clock::now() - start;
+            num_skips += skips_per_round;
+        }
+        LOG(INFO) << "LIST = " << name << " distance = " << distance
+                  << " ns per skip = " << (double)total.count()/num_skips
+                  << " CHECKSUM = " << checksum;
+    }
+}
+
+int main(int argc,const char* argv[])
+{
+    _START_EASYLOGGINGPP(argc,argv);
+    el::Loggers::addFlag(el::LoggingFlag::ColoredTerminalOutput);
+    el::Loggers::reconfigureAllLoggers(el::ConfigurationType::Format, "%datetime : %msg");
+
+    /* parse command line */
+    LOG(INFO) << "Parsing command line arguments";
+    cmdargs_t args = parse_args(argc,argv);
+
+    /* create a list with geometric gaps */
+    LOG(INFO) << "Creating list with " << args.list_size << " postings and mean gap " << args.mean_gap;
+    std::vector<uint32_t> A(args.list_size);
+    {
+        std::mt19937 gen(4711);
+        std::geometric_distribution<uint32_t> dis(1.0/args.mean_gap);
+        uint32_t value = 0;
+        for (auto& a : A) {
+            value += dis(gen) + 1;
+            a = value;
+        }
+    }
+
+    LOG(INFO) << "Prefetch distance " << prefetch_distance() << " cache lines";
+    bench_skip<optpfor_list<128,true>>(A,args,"OPTPFOR-128");
+    bench_skip<simdbp128_list<true>>(A,args,"SIMDBP-128");
+    bench_skip<uniform_eliasfano_list<128>>(A,args,"UEF-128");
+    bench_skip<partitioned_eliasfano_list>(A,args,"PEF");
+    bench_skip<eliasfano_skip_list<64,true>>(A,args,"EFS-64");
+
+    return 0;
+}
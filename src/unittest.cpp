@@ -5,9 +5,31 @@
 #include "bit_coders.hpp"
 #include "list_types.hpp"
 #include "intersection.hpp"
+#include "batch_intersection.hpp"
+#include "wand.hpp"
+#include "mmap_file.hpp"
+#include "parallel_construction.hpp"
+#include "sa_construction.hpp"
+#include "symbol_counts.hpp"
+#include "phrase_cost_model.hpp"
+#include "sa_derivation.hpp"
+#include "build_pipeline.hpp"
+#include "index_segment.hpp"
+#include "index_segmented.hpp"
+#include "index_hybrid_nextword.hpp"
 
 #include <functional>
+#include <map>
+#include <set>
 #include <random>
+#include <fstream>
+
+#include <unistd.h>
+#include <malloc.h>
+#include <sys/wait.h>
+
+// index_segmented.hpp pulls in the index headers, which log
+_INITIALIZE_EASYLOGGINGPP
 
 TEST(bit_magic, next0rand)
 {
@@ -214,6 +236,50 @@ TEST(bit_magic, nextXth1almostempty)
     }
 }
 
+TEST(bit_magic, nextXth_kernels)
+{
+    size_t n = 2000;
+    std::mt19937 gen(4711);
+    std::uniform_int_distribution<uint64_t> dis(0, 0xFFFFFFFFFFFFFFFF);
+    sdsl::bit_vector bv(64*n);
+    for (size_t i=0; i<n; i++) {
+        // dense, sparse and random regions so skips cover many cache lines
+        switch ((i/100)%3) {
+            case 0: bv.data()[i] = dis(gen) & dis(gen) & dis(gen); break;
+            case 1: bv.data()[i] = dis(gen) | dis(gen) | dis(gen); break;
+            default: bv.data()[i] = dis(gen);
+        }
+    }
+    uint64_t ones = 0;
+    for (size_t i=0; i<n; i++) ones += sdsl::bits::cnt(bv.data()[i]);
+    uint64_t max_count = std::min(ones,bv.size()-ones)/4;
+    for (size_t i=0; i<2000; i++) {
+        size_t idx = dis(gen) % (bv.size()/2);
+        uint64_t max_x = (i%2) ? 64 : 10000;
+        uint64_t x = 1 + dis(gen) % max_x;
+        if (x > max_count) continue;
+        auto one = bit_magic::next_Xth_one_generic(bv.data(),idx,x);
+        auto zero = bit_magic::next_Xth_zero_generic(bv.data(),idx,x);
+        ASSERT_EQ(one,bit_magic::next_Xth_one(bv.data(),idx,x));
+        ASSERT_EQ(zero,bit_magic::next_Xth_zero(bv.data(),idx,x));
+#ifdef BIT_MAGIC_X86
+        auto level = bit_magic::select_cpu();
+        if (level >= bit_magic::select_level::bmi2) {
+            ASSERT_EQ(one,bit_magic::next_Xth_bmi2<true>(bv.data(),idx,x));
+            ASSERT_EQ(zero,bit_magic::next_Xth_bmi2<false>(bv.data(),idx,x));
+        }
+        if (level >= bit_magic::select_level::avx2) {
+            ASSERT_EQ(one,bit_magic::next_Xth_avx2<true>(bv.data(),idx,x));
+            ASSERT_EQ(zero,bit_magic::next_Xth_avx2<false>(bv.data(),idx,x));
+        }
+        if (level >= bit_magic::select_level::avx512) {
+            ASSERT_EQ(one,bit_magic::next_Xth_avx512<true>(bv.data(),idx,x));
+            ASSERT_EQ(zero,bit_magic::next_Xth_avx512<false>(bv.data(),idx,x));
+        }
+#endif
+    }
+}
+
 
 TEST(bit_stream, unary)
 {
@@ -1094,6 +1160,272 @@ TEST(optpfor, skip_rand_largegaps_hit)
 }
 
 
+TEST(stream_vbyte, encode_decode)
+{
+    std::mt19937 gen(4711);
+    std::uniform_int_distribution<uint32_t> bytes_dis(0, 3);
+    std::uniform_int_distribution<uint32_t> dis(0, std::numeric_limits<uint32_t>::max());
+    for (size_t n=0; n<=128; n++) {
+        std::vector<uint32_t> A(n);
+        for (auto& x : A) x = dis(gen) >> (8*bytes_dis(gen));
+        std::vector<uint8_t> buf(stream_vbyte::max_bytes(n));
+        size_t bytes = stream_vbyte::encode(A.data(),n,buf.data());
+        ASSERT_LE(bytes,buf.size());
+        std::vector<uint32_t> B(n+4);
+        // only the encoded bytes are readable
+        stream_vbyte::decode(buf.data(),n,B.data(),buf.data()+bytes);
+        for (size_t i=0; i<n; i++) ASSERT_EQ(A[i],B[i]);
+    }
+}
+
+template<class t_list>
+void test_simd_block_list_iterate(bool sorted)
+{
+    std::mt19937 gen(4711);
+    std::uniform_int_distribution<uint64_t> dis(1, 100000);
+    for (size_t i=0; i<20; i++) {
+        size_t len = (i < 5) ? i*60+1 : dis(gen);
+        std::vector<uint32_t> A(len);
+        for (size_t j=0; j<len; j++) A[j] = dis(gen) << (i%4)*4;
+        if (sorted) {
+            std::sort(A.begin(),A.end());
+            A.erase(std::unique(A.begin(),A.end()),A.end());
+        }
+        sdsl::bit_vector bv;
+        size_t offset;
+        {
+            bit_ostream os(bv,i%8);
+            offset = t_list::create(os,A.begin(),A.end());
+        }
+        bit_istream is(bv);
+        auto list = t_list::materialize(is,offset);
+        auto begin = list.begin();
+        auto end = list.end();
+        ASSERT_EQ(begin.size(),A.size());
+        size_t j = 0;
+        while (begin != end) {
+            ASSERT_EQ(*begin,A[j]);
+            j++;
+            ++begin;
+        }
+        ASSERT_EQ(j,A.size());
+        for (size_t j=7; j<A.size(); j+=131) ASSERT_EQ(*(list.begin()+j),A[j]);
+    }
+}
+
+TEST(simd_block_list, iterate)
+{
+    test_simd_block_list_iterate<simdbp128_list<true>>(true);
+    test_simd_block_list_iterate<simdbp128_list<false>>(false);
+    test_simd_block_list_iterate<streamvbyte_list<true>>(true);
+    test_simd_block_list_iterate<streamvbyte_list<false>>(false);
+}
+
+template<class t_list>
+void test_simd_block_list_skip()
+{
+    std::mt19937 gen(4711);
+    std::uniform_int_distribution<uint64_t> dis(1, 1000000);
+    std::uniform_int_distribution<uint64_t> ldis(1, 50000);
+    for (size_t i=0; i<20; i++) {
+        size_t len = ldis(gen);
+        std::vector<uint32_t> A(len);
+        for (size_t j=0; j<len; j++) A[j] = dis(gen);
+        std::sort(A.begin(),A.end());
+        A.erase(std::unique(A.begin(),A.end()),A.end());
+        sdsl::bit_vector bv;
+        {
+            bit_ostream os(bv);
+            t_list::create(os,A.begin(),A.end());
+        }
+        bit_istream is(bv);
+        auto list = t_list::materialize(is,0);
+        auto itr = list.begin();
+        auto end = list.end();
+        uint64_t pos = 0;
+        uint64_t max_step = 1ULL << (i%20);
+        while (itr != end) {
+            pos += dis(gen) % max_step;
+            bool found = itr.skip(pos);
+            auto expected = std::lower_bound(A.begin(),A.end(),pos);
+            if (expected == A.end()) {
+                ASSERT_TRUE(itr == end);
+                break;
+            }
+            ASSERT_EQ((size_t)std::distance(A.begin(),expected),itr.offset());
+            ASSERT_EQ(*expected,*itr);
+            ASSERT_EQ(*expected == pos,found);
+            ++itr;
+            if (itr != end) pos = *itr;
+        }
+    }
+}
+
+TEST(simd_block_list, skip)
+{
+    test_simd_block_list_skip<simdbp128_list<true>>();
+    test_simd_block_list_skip<streamvbyte_list<true>>();
+}
+
+TEST(simd_block_list, intersection)
+{
+    std::mt19937 gen(4711);
+    std::uniform_int_distribution<uint64_t> dis(1, 1000000);
+    std::uniform_int_distribution<uint64_t> ldis(1, 100000);
+    for (size_t i=0; i<20; i++) {
+        std::vector<uint32_t> A(ldis(gen));
+        for (auto& x : A) x = dis(gen);
+        std::sort(A.begin(),A.end());
+        A.erase(std::unique(A.begin(),A.end()),A.end());
+        std::vector<uint32_t> B(ldis(gen));
+        for (auto& x : B) x = dis(gen);
+        std::sort(B.begin(),B.end());
+        B.erase(std::unique(B.begin(),B.end()),B.end());
+
+        sdsl::bit_vector bv;
+        size_t offsetA,offsetB;
+        {
+            bit_ostream os(bv);
+            offsetA = simdbp128_list<true>::create(os,A.begin(),A.end());
+            offsetB = streamvbyte_list<true>::create(os,B.begin(),B.end());
+        }
+        bit_istream is(bv);
+        auto listA = simdbp128_list<true>::materialize(is,offsetA);
+        auto listB = streamvbyte_list<true>::materialize(is,offsetB);
+        std::vector<uint32_t> ires;
+        std::set_intersection(A.begin(),A.end(),B.begin(),B.end(),std::back_inserter(ires));
+        std::vector<intersect_kernel> kernels {intersect_kernel::merge,intersect_kernel::gallop,
+                  intersect_kernel::skip,intersect_kernel::bitmap,intersect_kernel::simd};
+        for (const auto& kernel : kernels) {
+            auto res = intersect(kernel,listA,listB);
+            ASSERT_EQ(ires.size(),res.size());
+            for (size_t j=0; j<ires.size(); j++) ASSERT_EQ(ires[j],res[j]);
+        }
+    }
+}
+
+TEST(block_search, lower_bound_and_block_max)
+{
+    std::mt19937 gen(4711);
+    std::uniform_int_distribution<uint32_t> dis(0, 5000);
+    for (size_t i=0; i<200; i++) {
+        size_t n = i%130;
+        std::vector<uint32_t> A(n);
+        for (auto& a : A) a = (i%3==0) ? dis(gen) + 0x80000000 : dis(gen);
+        std::sort(A.begin(),A.end());
+        for (size_t j=0; j<50; j++) {
+            size_t b = n ? dis(gen)%n : 0;
+            uint64_t pos = (j%5==0) ? std::numeric_limits<uint32_t>::max()+1ULL : dis(gen) + ((i%3==0) ? 0x80000000 : 0);
+            auto expected = std::lower_bound(A.begin()+b,A.end(),pos) - A.begin();
+            ASSERT_EQ((size_t)expected,block_lower_bound(A.data(),b,n,pos));
+            ASSERT_EQ((size_t)expected,block_max_search(A.data(),b,n,pos));
+        }
+    }
+}
+
+// lists from singletons to dense runs and sparse lists, so every codec is picked
+std::vector<uint32_t> hybrid_test_list(std::mt19937& gen,size_t i)
+{
+    std::uniform_int_distribution<uint64_t> ldis(1, 20000);
+    std::uniform_int_distribution<uint64_t> gdis(1, 1ULL << ((i*3)%18));
+    size_t len = (i < 4) ? i+1 : ldis(gen);
+    std::vector<uint32_t> A(len);
+    uint64_t value = (i%2) ? 0 : gdis(gen)-1;
+    for (auto& a : A) {
+        a = value;
+        value += gdis(gen);
+    }
+    return A;
+}
+
+TEST(hybrid_list, codec_selection)
+{
+    std::vector<uint32_t> dense(10000);
+    std::iota(dense.begin(),dense.end(),1);
+    ASSERT_EQ(hybrid_list<>::cost_model::select(dense.begin(),dense.end()),list_codec::BV);
+    // without the time cost the smallest estimate is picked
+    auto bits = hybrid_list<0>::cost_model::estimate_bits(dense.begin(),dense.end());
+    auto codec = hybrid_list<0>::cost_model::select(dense.begin(),dense.end());
+    ASSERT_EQ(*std::min_element(bits.begin(),bits.end()),bits[(size_t)codec]);
+    // a bitvector can not store the universe of a single 0
+    std::vector<uint32_t> zero(1,0);
+    ASSERT_NE(hybrid_list<>::cost_model::select(zero.begin(),zero.end()),list_codec::BV);
+}
+
+TEST(hybrid_list, iterate_skip)
+{
+    std::mt19937 gen(4711);
+    std::set<list_codec> codecs;
+    for (size_t i=0; i<24; i++) {
+        auto A = hybrid_test_list(gen,i);
+        sdsl::bit_vector bv;
+        size_t offset;
+        uint8_t codec;
+        {
+            bit_ostream os(bv,i%8);
+            offset = create_list<hybrid_list<>>(os,A.begin(),A.end(),codec);
+        }
+        codecs.insert((list_codec)codec);
+        bit_istream is(bv);
+        auto list = materialize_list<hybrid_list<>>(is,offset,codec);
+        auto begin = list.begin();
+        auto end = list.end();
+        ASSERT_EQ(begin.codec(),(list_codec)codec);
+        ASSERT_EQ(begin.size(),A.size());
+        size_t j = 0;
+        while (begin != end) {
+            ASSERT_EQ(*begin,A[j]);
+            j++;
+            ++begin;
+        }
+        ASSERT_EQ(j,A.size());
+        for (size_t j=3; j<A.size(); j+=97) ASSERT_EQ(*(list.begin()+j),A[j]);
+
+        auto itr = list.begin();
+        uint64_t pos = 0;
+        std::uniform_int_distribution<uint64_t> sdis(0, 1ULL << ((i*3)%18+4));
+        while (itr != end) {
+            pos += sdis(gen);
+            bool found = itr.skip(pos);
+            auto expected = std::lower_bound(A.begin(),A.end(),pos);
+            if (expected == A.end()) {
+                ASSERT_TRUE(itr == end);
+                break;
+            }
+            ASSERT_EQ((size_t)std::distance(A.begin(),expected),itr.offset());
+            ASSERT_EQ(*expected,*itr);
+            ASSERT_EQ(*expected == pos,found);
+        }
+    }
+    ASSERT_EQ(codecs.size(),num_list_codecs);
+}
+
+TEST(hybrid_list, intersection)
+{
+    std::mt19937 gen(4711);
+    for (size_t i=4; i<24; i++) {
+        auto A = hybrid_test_list(gen,i);
+        auto B = hybrid_test_list(gen,i+1);
+        sdsl::bit_vector bv;
+        size_t offsetA,offsetB;
+        uint8_t codecA,codecB;
+        {
+            bit_ostream os(bv);
+            offsetA = create_list<hybrid_list<>>(os,A.begin(),A.end(),codecA);
+            offsetB = create_list<hybrid_list<>>(os,B.begin(),B.end(),codecB);
+        }
+        bit_istream is(bv);
+        auto listA = materialize_list<hybrid_list<>>(is,offsetA,codecA);
+        auto listB = materialize_list<hybrid_list<>>(is,offsetB,codecB);
+        auto res = intersect(listA,listB);
+
+        std::vector<uint32_t> ires;
+        std::set_intersection(A.begin(),A.end(),B.begin(),B.end(),std::back_inserter(ires));
+        ASSERT_EQ(ires.size(),res.size());
+        for (size_t j=0; j<ires.size(); j++) ASSERT_EQ(ires[j],res[j]);
+    }
+}
+
 TEST(intersection, eliasfano)
 {
     size_t n = 20;
@@ -1262,6 +1594,254 @@ TEST(intersection, multiple)
     }
 }
 
+TEST(intersection, kernels)
+{
+    size_t n = 20;
+    std::mt19937 gen(4711);
+    std::uniform_int_distribution<uint64_t> dis(1, 100000);
+    std::uniform_int_distribution<uint64_t> ldis(1, 50000);
+    std::uniform_int_distribution<int64_t> odis(-5, 5);
+    std::vector<intersect_kernel> kernels {intersect_kernel::merge,intersect_kernel::gallop,
+              intersect_kernel::skip,intersect_kernel::bitmap,intersect_kernel::simd};
+
+    for (size_t i=0; i<n; i++) {
+        size_t len = ldis(gen);
+        std::vector<uint32_t> A(len);
+        for (size_t j=0; j<len; j++) A[j] = dis(gen);
+        std::sort(A.begin(),A.end());
+        A.resize(std::distance(A.begin(),std::unique(A.begin(),A.end())));
+
+        size_t len2 = ldis(gen) % (i+1)*(i+1) + 1;
+        std::vector<uint32_t> B(len2);
+        for (size_t j=0; j<len2; j++) B[j] = dis(gen);
+        std::sort(B.begin(),B.end());
+        B.resize(std::distance(B.begin(),std::unique(B.begin(),B.end())));
+
+        int64_t offset = odis(gen);
+        std::vector<uint64_t> ires;
+        for (const auto& x : A) {
+            if ((int64_t)x + offset >= 0 && std::binary_search(B.begin(),B.end(),x+offset))
+                ires.push_back(std::min((int64_t)x,(int64_t)x+offset));
+        }
+
+        sdsl::bit_vector bv;
+        size_t offsetA,offsetB,offsetC,offsetD;
+        {
+            bit_ostream os(bv);
+            offsetA = uniform_eliasfano_list<>::create(os,A.begin(),A.end());
+            offsetB = uniform_eliasfano_list<>::create(os,B.begin(),B.end());
+            offsetC = optpfor_list<128,true>::create(os,A.begin(),A.end());
+            offsetD = eliasfano_list<true>::create(os,B.begin(),B.end());
+        }
+        {
+            bit_istream is(bv);
+            auto listA = uniform_eliasfano_list<>::materialize(is,offsetA);
+            auto listB = uniform_eliasfano_list<>::materialize(is,offsetB);
+            auto listC = optpfor_list<128,true>::materialize(is,offsetC);
+            auto listD = eliasfano_list<true>::materialize(is,offsetD);
+            for (const auto& kernel : kernels) {
+                auto res = intersect(kernel,listA,listB,offset);
+                auto res2 = intersect(kernel,listC,listD,offset);
+                ASSERT_EQ(ires.size(),res.size());
+                ASSERT_EQ(ires.size(),res2.size());
+                for (size_t i=0; i<ires.size(); i++) {
+                    ASSERT_EQ(ires[i],res[i]);
+                    ASSERT_EQ(ires[i],res2[i]);
+                }
+            }
+            auto res = intersect(listA,listB,offset);
+            ASSERT_EQ(ires.size(),res.size());
+        }
+    }
+}
+
+TEST(simd_intersection, kernels)
+{
+    size_t n = 50;
+    std::mt19937 gen(4711);
+    std::uniform_int_distribution<uint32_t> dis(1, 1000000);
+    std::uniform_int_distribution<uint64_t> ldis(1, 5000);
+    std::uniform_int_distribution<uint64_t> rdis(1, 2000);
+
+    using kernel_type = size_t(*)(const uint32_t*,size_t,const uint32_t*,size_t,uint32_t*);
+    std::vector<kernel_type> kernels {simd_intersection::scalar_merge,simd_intersection::scalar_gallop,
+              simd_intersection::intersect};
+#ifdef SIMD_INTERSECTION_X86
+    if (simd_intersection::cpu() != simd_intersection::cpu_level::scalar) {
+        kernels.push_back(simd_intersection::sse_shuffle);
+        kernels.push_back(simd_intersection::sse_v1);
+        kernels.push_back(simd_intersection::sse_v3);
+        kernels.push_back(simd_intersection::sse_galloping);
+    }
+    if (simd_intersection::cpu() == simd_intersection::cpu_level::avx2) {
+        kernels.push_back(simd_intersection::avx2_v1);
+    }
+#endif
+    for (size_t i=0; i<n; i++) {
+        size_t len = ldis(gen);
+        size_t ratio = rdis(gen);
+        std::set<uint32_t> rare, freq;
+        while (rare.size() < len) rare.insert(dis(gen));
+        while (freq.size() < std::min(len*ratio,(size_t)900000)) freq.insert(dis(gen));
+        std::vector<uint32_t> A(rare.begin(),rare.end());
+        std::vector<uint32_t> B(freq.begin(),freq.end());
+        std::vector<uint32_t> I;
+        std::set_intersection(A.begin(),A.end(),B.begin(),B.end(),std::back_inserter(I));
+
+        std::vector<uint32_t> out(A.size()+4);
+        for (const auto& kernel : kernels) {
+            size_t found = kernel(A.data(),A.size(),B.data(),B.size(),out.data());
+            ASSERT_EQ(I.size(),found);
+            for (size_t j=0; j<found; j++) {
+                ASSERT_EQ(I[j],out[j]);
+            }
+        }
+    }
+}
+
+TEST(intersection, strategies)
+{
+    size_t n = 20;
+    std::mt19937 gen(4711);
+    std::uniform_int_distribution<uint64_t> dis(1, 100000);
+    std::uniform_int_distribution<uint64_t> ldis(1, 50000);
+    std::uniform_int_distribution<uint64_t> ndis(2, 8);
+
+    for (size_t i=0; i<n; i++) {
+        std::vector<size_t> list_offsets;
+        sdsl::bit_vector bv;
+        std::vector<uint32_t> I;
+        {
+            bit_ostream os(bv);
+            auto nlists = ndis(gen);
+            for (size_t j=0; j<nlists; j++) {
+                size_t len = ldis(gen);
+                std::vector<uint32_t> A(len);
+                for (size_t j=0; j<len; j++) A[j] = dis(gen);
+                std::sort(A.begin(),A.end());
+                auto last = std::unique(A.begin(),A.end());
+                size_t offset = uniform_eliasfano_list<>::create(os,A.begin(),last);
+                list_offsets.push_back(offset);
+
+                if (j==0) I = std::vector<uint32_t>(A.begin(),last);
+                else {
+                    std::vector<uint32_t> ires;
+                    std::set_intersection(A.begin(),last,I.begin(),I.end(),std::back_inserter(ires));
+                    I = ires;
+                }
+            }
+        }
+        {
+            std::vector< uniform_eliasfano_list<>::list_type > lists;
+            bit_istream is(bv);
+            for (const auto& o : list_offsets) {
+                lists.emplace_back(uniform_eliasfano_list<>::materialize(is,o));
+            }
+
+            auto res = intersect<intersect_daat>(lists);
+            auto svs_res = intersect<intersect_svs>(lists);
+            auto adaptive_res = intersect<intersect_adaptive>(lists);
+            ASSERT_EQ(I.size(),res.size());
+            ASSERT_EQ(I.size(),svs_res.size());
+            ASSERT_EQ(I.size(),adaptive_res.size());
+            for (size_t i=0; i<I.size(); i++) {
+                ASSERT_EQ(I[i],res[i]);
+                ASSERT_EQ(I[i],svs_res[i]);
+                ASSERT_EQ(I[i],adaptive_res[i]);
+            }
+
+            // first-k results
+            for (size_t k : {(size_t)0,(size_t)1,I.size()/2,I.size()+1}) {
+                auto kres = intersect<intersect_daat>(lists,k);
+                auto svs_kres = intersect<intersect_svs>(lists,k);
+                auto adaptive_kres = intersect<intersect_adaptive>(lists,k);
+                ASSERT_EQ(std::min(k,I.size()),kres.size());
+                ASSERT_EQ(std::min(k,I.size()),svs_kres.size());
+                ASSERT_EQ(std::min(k,I.size()),adaptive_kres.size());
+                for (size_t i=0; i<kres.size(); i++) {
+                    ASSERT_EQ(I[i],kres[i]);
+                    ASSERT_EQ(I[i],svs_kres[i]);
+                    ASSERT_EQ(I[i],adaptive_kres[i]);
+                }
+            }
+        }
+    }
+}
+
+// the kernel picked for two lists of the given lengths
+template<class t_list>
+intersect_kernel adaptive_kernel(size_t n,size_t m)
+{
+    sdsl::bit_vector bv;
+    std::vector<uint64_t> A(n),B(m);
+    for (size_t j=0; j<n; j++) A[j] = 4*j;
+    for (size_t j=0; j<m; j++) B[j] = 4*j*(n/m);
+    size_t offsetA,offsetB;
+    {
+        bit_ostream os(bv);
+        offsetA = t_list::create(os,A.begin(),A.end());
+        offsetB = t_list::create(os,B.begin(),B.end());
+    }
+    bit_istream is(bv);
+    std::vector<typename t_list::list_type> lists;
+    lists.emplace_back(t_list::materialize(is,offsetA));
+    lists.emplace_back(t_list::materialize(is,offsetB));
+    kernel_counts().reset();
+    auto res = intersect<intersect_adaptive>(lists);
+    EXPECT_EQ(m,res.size());
+    for (size_t i=0; i<num_intersect_kernels; i++) {
+        if (kernel_counts()[(intersect_kernel)i] == 1) return (intersect_kernel)i;
+    }
+    return intersect_kernel::merge;
+}
+
+TEST(intersection, adaptive_kernels)
+{
+    using uef_type = uniform_eliasfano_list<128>;
+    using opf_type = optpfor_list<128,true>;
+    ASSERT_EQ(intersect_kernel::simd,adaptive_kernel<uef_type>(10000,10000));
+    ASSERT_EQ(intersect_kernel::skip,adaptive_kernel<uef_type>(10000,1000));
+    ASSERT_EQ(intersect_kernel::simd,adaptive_kernel<opf_type>(10000,5000));
+    ASSERT_EQ(intersect_kernel::skip,adaptive_kernel<opf_type>(10000,1000));
+}
+
+TEST(intersection, single_list)
+{
+    size_t n = 20;
+    std::mt19937 gen(4711);
+    std::uniform_int_distribution<uint64_t> dis(1, 100000);
+    std::uniform_int_distribution<uint64_t> ldis(1, 5000);
+
+    for (size_t i=0; i<n; i++) {
+        sdsl::bit_vector bv;
+        std::vector<uint32_t> A(ldis(gen));
+        for (size_t j=0; j<A.size(); j++) A[j] = dis(gen);
+        std::sort(A.begin(),A.end());
+        A.erase(std::unique(A.begin(),A.end()),A.end());
+        size_t offset;
+        {
+            bit_ostream os(bv);
+            offset = uniform_eliasfano_list<>::create(os,A.begin(),A.end());
+        }
+        bit_istream is(bv);
+        std::vector<offset_proxy_list<uniform_eliasfano_list<>::list_type>> lists;
+        auto list = uniform_eliasfano_list<>::materialize(is,offset);
+        lists.emplace_back(list,3);
+
+        auto res = pos_intersect<intersect_daat>(lists);
+        ASSERT_EQ(3,res.offset);
+        ASSERT_EQ(A.size(),res.size());
+        for (size_t j=0; j<A.size(); j++) ASSERT_EQ(A[j],res[j]);
+        auto kres = pos_intersect<intersect_daat>(lists,A.size()/2);
+        ASSERT_EQ(A.size()/2,kres.size());
+
+        auto view = lazy_pos_intersect(lists);
+        auto itr = view.begin();
+        for (size_t j=0; j<A.size(); j++,++itr) ASSERT_EQ(A[j],*itr);
+        ASSERT_TRUE(itr == view.end());
+    }
+}
+
 TEST(pos_intersection, simple)
 {
     size_t n = 20;
@@ -1365,53 +1945,378 @@ TEST(pos_intersection, mixed)
 }
 
 
-TEST(bvlist, iterate)
+TEST(pos_intersection, strategies)
 {
     size_t n = 20;
     std::mt19937 gen(4711);
     std::uniform_int_distribution<uint64_t> dis(1, 100000);
+    std::uniform_int_distribution<uint64_t> ldis(1, 20000);
+    std::uniform_int_distribution<uint64_t> rdis(1, 100);
+    std::uniform_int_distribution<uint64_t> ndis(2, 8);
 
     for (size_t i=0; i<n; i++) {
-        size_t len = dis(gen);
-        std::vector<uint32_t> A(len);
-        for (size_t j=0; j<len; j++) A[j] = dis(gen);
-        std::sort(A.begin(),A.end());
-        auto last = std::unique(A.begin(),A.end());
-        size_t ln = std::distance(A.begin(),last);
+        // generate phrase start positions
+        size_t rlen = rdis(gen);
+        std::vector<uint32_t> res(rlen);
+        for (size_t j=0; j<rlen; j++) res[j] = dis(gen);
 
+        std::vector<uint64_t> list_offsets;
         sdsl::bit_vector bv;
         {
             bit_ostream os(bv);
-            auto offset = bitvector_list<>::create(os,A.begin(),last);
-            ASSERT_EQ(offset,0ULL);
+            auto nlists = ndis(gen);
+            for (size_t j=0; j<nlists; j++) {
+                auto list_len = ldis(gen);
+                std::vector<uint32_t> L(list_len+rlen);
+                std::copy(res.begin(),res.end(),L.begin());
+                for (size_t x=rlen; x<L.size(); x++) L[x] = dis(gen);
+                for (size_t x=0; x<L.size(); x++) L[x] = L[x] + j;
+                std::sort(L.begin(),L.end());
+                auto llast = std::unique(L.begin(),L.end());
+                list_offsets.push_back(uniform_eliasfano_list<>::create(os,L.begin(),llast));
+            }
         }
         {
             bit_istream is(bv);
-            auto list = bitvector_list<>::materialize(is,0);
-            auto begin = list.begin();
-            auto end = list.end();
-            ASSERT_EQ(begin.size(),ln);
-
-            size_t i = 0;
-            while (begin != end) {
-                ASSERT_EQ(*begin,A[i]);
-                i++;
-                ++begin;
+            std::vector<offset_proxy_list<uniform_eliasfano_list<>::list_type>> lists;
+            for (size_t j=0; j<list_offsets.size(); j++) {
+                auto list = uniform_eliasfano_list<>::materialize(is,list_offsets[j]);
+                lists.emplace_back(list,j);
             }
+
+            auto result = pos_intersect<intersect_daat>(lists);
+            auto svs_result = pos_intersect<intersect_svs>(lists);
+            ASSERT_EQ(svs_result.offset,result.offset);
+            ASSERT_EQ(svs_result.size(),result.size());
+            ASSERT_TRUE(result.size() >= std::set<uint32_t>(res.begin(),res.end()).size());
+            for (size_t i=0; i<result.size(); i++) ASSERT_EQ(svs_result[i],result[i]);
         }
     }
 }
 
-TEST(bvlist, iterate_skip)
+TEST(pos_intersection, parallel)
 {
-    size_t n = 20;
+    size_t n = 10;
     std::mt19937 gen(4711);
-    std::uniform_int_distribution<uint64_t> dis(1, 100000);
+    std::uniform_int_distribution<uint64_t> dis(1, 5000000);
+    std::uniform_int_distribution<uint64_t> ldis(20000, 300000);
+    std::uniform_int_distribution<uint64_t> rdis(1, 5000);
+    std::uniform_int_distribution<uint64_t> ndis(2, 5);
+    thread_pool pool(4);
 
     for (size_t i=0; i<n; i++) {
-        size_t len = dis(gen);
-        std::vector<uint32_t> A(len);
-        for (size_t j=0; j<len; j++) A[j] = dis(gen);
+        size_t rlen = rdis(gen);
+        std::vector<uint32_t> res(rlen);
+        for (size_t j=0; j<rlen; j++) res[j] = dis(gen);
+
+        std::vector<uint64_t> list_offsets;
+        sdsl::bit_vector bv;
+        {
+            bit_ostream os(bv);
+            auto nlists = ndis(gen);
+            for (size_t j=0; j<nlists; j++) {
+                auto list_len = ldis(gen);
+                std::vector<uint32_t> L(list_len+rlen);
+                std::copy(res.begin(),res.end(),L.begin());
+                for (size_t x=rlen; x<L.size(); x++) L[x] = dis(gen);
+                for (size_t x=0; x<L.size(); x++) L[x] = L[x] + j;
+                std::sort(L.begin(),L.end());
+                auto llast = std::unique(L.begin(),L.end());
+                list_offsets.push_back(uniform_eliasfano_list<>::create(os,L.begin(),llast));
+            }
+        }
+        {
+            bit_istream is(bv);
+            std::vector<offset_proxy_list<uniform_eliasfano_list<>::list_type>> lists;
+            std::vector<uniform_eliasfano_list<>::list_type> doc_lists;
+            for (size_t j=0; j<list_offsets.size(); j++) {
+                auto list = uniform_eliasfano_list<>::materialize(is,list_offsets[j]);
+                lists.emplace_back(list,j);
+                doc_lists.push_back(list);
+            }
+
+            auto result = pos_intersect<intersect_daat>(lists);
+            auto par_result = parallel_pos_intersect(lists,pool);
+            ASSERT_EQ(result.offset,par_result.offset);
+            ASSERT_EQ(result.size(),par_result.size());
+            for (size_t i=0; i<result.size(); i++) ASSERT_EQ(result[i],par_result[i]);
+
+            auto doc_result = intersect<intersect_daat>(doc_lists);
+            auto par_doc_result = parallel_intersect(doc_lists,pool);
+            ASSERT_EQ(doc_result.size(),par_doc_result.size());
+            for (size_t i=0; i<doc_result.size(); i++) ASSERT_EQ(doc_result[i],par_doc_result[i]);
+        }
+    }
+}
+
+TEST(pos_intersection, parallel_sparse)
+{
+    // no or a single common element, so most ranges have no result
+    size_t n = 200000;
+    thread_pool pool(4);
+    for (size_t num_common : {0,1}) {
+        std::vector<uint64_t> list_offsets;
+        sdsl::bit_vector bv;
+        {
+            bit_ostream os(bv);
+            for (size_t j=0; j<2; j++) {
+                std::vector<uint32_t> L(n);
+                for (size_t x=0; x<n; x++) L[x] = 2*x+j;
+                if (num_common) L[n-1] = 2*n+1;
+                list_offsets.push_back(uniform_eliasfano_list<>::create(os,L.begin(),L.end()));
+            }
+        }
+        bit_istream is(bv);
+        std::vector<uniform_eliasfano_list<>::list_type> lists;
+        for (size_t j=0; j<list_offsets.size(); j++) {
+            lists.push_back(uniform_eliasfano_list<>::materialize(is,list_offsets[j]));
+        }
+        auto par_result = parallel_intersect(lists,pool);
+        ASSERT_EQ(num_common,par_result.size());
+        if (num_common) {
+            ASSERT_EQ(2*n+1,par_result[0]);
+        }
+
+        // a bounded iterator is finished at the end of its range
+        auto view = lazy_intersect(lists);
+        auto itr = view.begin(0,2*n+1);
+        ASSERT_TRUE(itr == view.end());
+        itr = view.begin(2*n+1,2*n+2);
+        ASSERT_EQ(num_common,(size_t)std::distance(itr,view.end()));
+    }
+}
+
+TEST(pos_intersection, lazy)
+{
+    size_t n = 20;
+    std::mt19937 gen(4711);
+    std::uniform_int_distribution<uint64_t> dis(1, 100000);
+    std::uniform_int_distribution<uint64_t> ldis(1, 20000);
+    std::uniform_int_distribution<uint64_t> rdis(1, 100);
+    std::uniform_int_distribution<uint64_t> ndis(2, 8);
+
+    for (size_t i=0; i<n; i++) {
+        size_t rlen = rdis(gen);
+        std::vector<uint32_t> res(rlen);
+        for (size_t j=0; j<rlen; j++) res[j] = dis(gen);
+
+        std::vector<uint64_t> list_offsets;
+        sdsl::bit_vector bv;
+        {
+            bit_ostream os(bv);
+            auto nlists = ndis(gen);
+            for (size_t j=0; j<nlists; j++) {
+                auto list_len = ldis(gen);
+                std::vector<uint32_t> L(list_len+rlen);
+                std::copy(res.begin(),res.end(),L.begin());
+                for (size_t x=rlen; x<L.size(); x++) L[x] = dis(gen);
+                for (size_t x=0; x<L.size(); x++) L[x] = L[x] + j;
+                std::sort(L.begin(),L.end());
+                auto llast = std::unique(L.begin(),L.end());
+                list_offsets.push_back(optpfor_list<128,true>::create(os,L.begin(),llast));
+            }
+        }
+        {
+            bit_istream is(bv);
+            std::vector<offset_proxy_list<optpfor_list<128,true>::list_type>> lists;
+            for (size_t j=0; j<list_offsets.size(); j++) {
+                auto list = optpfor_list<128,true>::materialize(is,list_offsets[j]);
+                lists.emplace_back(list,j);
+            }
+
+            auto result = pos_intersect<intersect_daat>(lists);
+            auto view = lazy_pos_intersect(lists);
+            ASSERT_EQ(result.offset,view.offset());
+            ASSERT_TRUE(view.size() >= result.size());
+            auto itr = view.begin();
+            auto end = view.end();
+            size_t k = 0;
+            while (itr != end) {
+                ASSERT_TRUE(k < result.size());
+                ASSERT_EQ(result[k],*itr);
+                ASSERT_EQ(k,itr.offset());
+                ++itr;
+                k++;
+            }
+            ASSERT_EQ(result.size(),k);
+
+            // skip to every second result and in between results
+            auto sitr = view.begin();
+            for (size_t j=0; j<result.size(); j+=2) {
+                if (j > 0 && result[j] > result[j-1]+1) {
+                    ASSERT_FALSE(sitr.skip(result[j-1]+1));
+                    ASSERT_EQ(result[j],*sitr);
+                }
+                ASSERT_TRUE(sitr.skip(result[j]));
+                ASSERT_EQ(result[j],*sitr);
+            }
+            ASSERT_FALSE(sitr.skip(std::numeric_limits<uint32_t>::max()));
+            ASSERT_TRUE(sitr == end);
+        }
+    }
+}
+
+TEST(pos_intersection, lazy_single_list)
+{
+    // a single list matches every candidate it moves to on its own
+    size_t n = 20;
+    std::mt19937 gen(4711);
+    std::uniform_int_distribution<uint64_t> dis(1, 100000);
+    std::uniform_int_distribution<uint64_t> ldis(1, 5000);
+
+    for (size_t i=0; i<n; i++) {
+        sdsl::bit_vector bv;
+        std::vector<uint32_t> A(ldis(gen));
+        for (size_t j=0; j<A.size(); j++) A[j] = dis(gen);
+        std::sort(A.begin(),A.end());
+        A.erase(std::unique(A.begin(),A.end()),A.end());
+        size_t offset;
+        {
+            bit_ostream os(bv);
+            offset = optpfor_list<128,true>::create(os,A.begin(),A.end());
+        }
+        bit_istream is(bv);
+        std::vector<offset_proxy_list<optpfor_list<128,true>::list_type>> lists;
+        auto list = optpfor_list<128,true>::materialize(is,offset);
+        lists.emplace_back(list,5);
+
+        auto view = lazy_pos_intersect(lists);
+        ASSERT_EQ(5,view.offset());
+        ASSERT_EQ(A.size(),(size_t)std::distance(view.begin(),view.end()));
+
+        // skip in between the elements, which is a mismatch of the list
+        auto sitr = view.begin();
+        for (size_t j=1; j<A.size(); j++) {
+            if (A[j] > A[j-1]+1) {
+                ASSERT_FALSE(sitr.skip(A[j-1]+1));
+                ASSERT_EQ(A[j],*sitr);
+            }
+        }
+        ASSERT_FALSE(sitr.skip(std::numeric_limits<uint32_t>::max()));
+        ASSERT_TRUE(sitr == view.end());
+    }
+}
+
+template<class t_list>
+void test_batch_intersection()
+{
+    size_t n = 20;
+    std::mt19937 gen(4711);
+    std::uniform_int_distribution<uint64_t> dis(1, 1000000);
+    std::uniform_int_distribution<uint64_t> ldis(1, 50000);
+    std::uniform_int_distribution<uint64_t> rdis(1, 300);
+    std::uniform_int_distribution<uint64_t> ndis(2, 6);
+
+    sdsl::bit_vector bv;
+    std::vector<std::vector<uint64_t>> query_offsets(n);
+    {
+        bit_ostream os(bv);
+        for (size_t i=0; i<n; i++) {
+            size_t rlen = rdis(gen);
+            std::vector<uint32_t> res(rlen);
+            for (size_t j=0; j<rlen; j++) res[j] = dis(gen);
+            auto nlists = ndis(gen);
+            for (size_t j=0; j<nlists; j++) {
+                auto list_len = ldis(gen);
+                std::vector<uint32_t> L(list_len+rlen);
+                std::copy(res.begin(),res.end(),L.begin());
+                for (size_t x=rlen; x<L.size(); x++) L[x] = dis(gen);
+                for (size_t x=0; x<L.size(); x++) L[x] = L[x] + j;
+                std::sort(L.begin(),L.end());
+                auto llast = std::unique(L.begin(),L.end());
+                query_offsets[i].push_back(t_list::create(os,L.begin(),llast));
+            }
+        }
+    }
+    bit_istream is(bv);
+    std::vector<std::vector<offset_proxy_list<typename t_list::list_type>>> pos_queries;
+    std::vector<std::vector<typename t_list::list_type>> doc_queries;
+    for (const auto& offsets : query_offsets) {
+        pos_queries.emplace_back();
+        doc_queries.emplace_back();
+        for (size_t j=0; j<offsets.size(); j++) {
+            auto list = t_list::materialize(is,offsets[j]);
+            pos_queries.back().emplace_back(list,j);
+            doc_queries.back().push_back(list);
+        }
+    }
+
+    for (size_t limit : {no_result_limit,(size_t)1,(size_t)7}) {
+        for (size_t group_size : {1,3,8,64}) {
+            auto results = batch_pos_intersect(pos_queries,group_size,limit);
+            ASSERT_EQ(n,results.size());
+            for (size_t i=0; i<n; i++) {
+                auto expected = pos_intersect<intersect_daat>(pos_queries[i],limit);
+                ASSERT_EQ(expected.offset,results[i].offset);
+                ASSERT_EQ(expected.size(),results[i].size());
+                for (size_t j=0; j<expected.size(); j++) ASSERT_EQ(expected[j],results[i][j]);
+            }
+            auto doc_results = batch_intersect(doc_queries,group_size,limit);
+            ASSERT_EQ(n,doc_results.size());
+            for (size_t i=0; i<n; i++) {
+                auto expected = intersect<intersect_daat>(doc_queries[i],limit);
+                ASSERT_EQ(expected.size(),doc_results[i].size());
+                for (size_t j=0; j<expected.size(); j++) ASSERT_EQ(expected[j],doc_results[i][j]);
+            }
+        }
+    }
+}
+
+TEST(pos_intersection, batch)
+{
+    test_batch_intersection<uniform_eliasfano_list<128>>();
+    test_batch_intersection<eliasfano_skip_list<64,true>>();
+    test_batch_intersection<optpfor_list<128,true>>();
+    test_batch_intersection<eliasfano_list<true>>();
+}
+
+TEST(bvlist, iterate)
+{
+    size_t n = 20;
+    std::mt19937 gen(4711);
+    std::uniform_int_distribution<uint64_t> dis(1, 100000);
+
+    for (size_t i=0; i<n; i++) {
+        size_t len = dis(gen);
+        std::vector<uint32_t> A(len);
+        for (size_t j=0; j<len; j++) A[j] = dis(gen);
+        std::sort(A.begin(),A.end());
+        auto last = std::unique(A.begin(),A.end());
+        size_t ln = std::distance(A.begin(),last);
+
+        sdsl::bit_vector bv;
+        {
+            bit_ostream os(bv);
+            auto offset = bitvector_list<>::create(os,A.begin(),last);
+            ASSERT_EQ(offset,0ULL);
+        }
+        {
+            bit_istream is(bv);
+            auto list = bitvector_list<>::materialize(is,0);
+            auto begin = list.begin();
+            auto end = list.end();
+            ASSERT_EQ(begin.size(),ln);
+
+            size_t i = 0;
+            while (begin != end) {
+                ASSERT_EQ(*begin,A[i]);
+                i++;
+                ++begin;
+            }
+        }
+    }
+}
+
+TEST(bvlist, iterate_skip)
+{
+    size_t n = 20;
+    std::mt19937 gen(4711);
+    std::uniform_int_distribution<uint64_t> dis(1, 100000);
+
+    for (size_t i=0; i<n; i++) {
+        size_t len = dis(gen);
+        std::vector<uint32_t> A(len);
+        for (size_t j=0; j<len; j++) A[j] = dis(gen);
         std::sort(A.begin(),A.end());
         auto last = std::unique(A.begin(),A.end());
         size_t ln = std::distance(A.begin(),last);
@@ -1697,7 +2602,267 @@ TEST(uniform_eliasfano, skip_rand_exist)
     }
 }
 
-TEST(uniform_eliasfano, skip_rand_oneoff)
+TEST(uniform_eliasfano, skip_rand_oneoff)
+{
+    size_t n = 20;
+    std::mt19937 gen(4711);
+    std::uniform_int_distribution<uint64_t> dis(1, 100000);
+
+    for (size_t i=0; i<n; i++) {
+        size_t len = dis(gen);
+        std::vector<uint32_t> A(len);
+        for (size_t j=0; j<len; j++) A[j] = dis(gen);
+        std::sort(A.begin(),A.end());
+        auto last = std::unique(A.begin(),A.end());
+
+        sdsl::bit_vector bv;
+        {
+            bit_ostream os(bv);
+            auto offset = uniform_eliasfano_list<128>::create(os,A.begin(),last);
+            ASSERT_EQ(offset,0ULL);
+        }
+
+        {
+            bit_istream is(bv);
+            auto list = uniform_eliasfano_list<128>::materialize(is,0);
+            auto itr = list.begin();
+            size_t ln = std::distance(A.begin(),last);
+            for (size_t j=1+dis(gen)%255; j<ln; j+=(dis(gen)%25)) {
+                if (A[j-1] == A[j]-1) continue;
+                ASSERT_FALSE(itr.skip(A[j]-1));
+                ASSERT_EQ(*itr,A[j]);
+            }
+        }
+    }
+}
+
+TEST(uniform_eliasfano, skip_rand_largegaps)
+{
+    size_t n = 20;
+    std::mt19937 gen(4711);
+    std::uniform_int_distribution<uint64_t> dis(1, 100000);
+    std::uniform_int_distribution<uint64_t> ldis(1, 100);
+
+    for (size_t i=0; i<n; i++) {
+        size_t len = ldis(gen);
+        std::vector<uint32_t> A(len);
+        for (size_t j=0; j<len; j++) A[j] = dis(gen);
+        std::sort(A.begin(),A.end());
+        auto last = std::unique(A.begin(),A.end());
+
+        sdsl::bit_vector bv;
+        {
+            bit_ostream os(bv);
+            auto offset = uniform_eliasfano_list<128>::create(os,A.begin(),last);
+            ASSERT_EQ(offset,0ULL);
+        }
+
+        {
+            bit_istream is(bv);
+            auto list = uniform_eliasfano_list<128>::materialize(is,0);
+            auto itr = list.begin();
+            size_t ln = std::distance(A.begin(),last);
+            for (size_t j=1+dis(gen)%255; j<ln; j+=(dis(gen)%25)) {
+                if (A[j-1] == A[j]-1) continue;
+                ASSERT_FALSE(itr.skip(A[j]-1));
+                ASSERT_EQ(*itr,A[j]);
+            }
+        }
+    }
+}
+
+TEST(uniform_eliasfano, skip_rand_largegaps_hit)
+{
+    size_t n = 20;
+    std::mt19937 gen(4711);
+    std::uniform_int_distribution<uint64_t> dis(1, 1000000);
+    std::uniform_int_distribution<uint64_t> ldis(1, 1000);
+
+    for (size_t i=0; i<n; i++) {
+        size_t len = ldis(gen);
+        std::vector<uint32_t> A(len);
+        for (size_t j=0; j<len; j++) A[j] = dis(gen);
+        std::sort(A.begin(),A.end());
+        auto last = std::unique(A.begin(),A.end());
+
+
+        sdsl::bit_vector bv;
+        {
+            bit_ostream os(bv);
+            auto offset = uniform_eliasfano_list<128>::create(os,A.begin(),last);
+            ASSERT_EQ(offset,0ULL);
+        }
+
+        {
+            bit_istream is(bv);
+            auto list = uniform_eliasfano_list<128>::materialize(is,0);
+            auto itr = list.begin();
+            size_t ln = std::distance(A.begin(),last);
+            for (size_t j=1+dis(gen)%255; j<ln; j+=(dis(gen)%25)) {
+                ASSERT_TRUE(itr.skip(A[j]));
+                ASSERT_EQ(*itr,A[j]);
+            }
+        }
+    }
+}
+
+
+TEST(uniform_eliasfano, small_lists_skip)
+{
+    size_t n = 200;
+    std::mt19937 gen(4711);
+    std::uniform_int_distribution<uint64_t> dis(1, 10000);
+    std::uniform_int_distribution<uint64_t> ldis(1, 200);
+
+    for (size_t i=0; i<n; i++) {
+        size_t len = ldis(gen);
+        std::vector<uint32_t> A(len);
+        for (size_t j=0; j<len; j++) A[j] = dis(gen);
+        std::sort(A.begin(),A.end());
+        auto last = std::unique(A.begin(),A.end());
+        A.resize(std::distance(A.begin(),last));
+
+        sdsl::bit_vector bv;
+        {
+            bit_ostream os(bv);
+            uniform_eliasfano_list<>::create(os,A.begin(),A.end());
+        }
+        {
+            bit_istream is(bv);
+            auto list = uniform_eliasfano_list<>::materialize(is,0);
+            auto itr = list.begin();
+            auto end = list.end();
+            uint64_t pos = 0;
+            while (itr != end) {
+                pos += dis(gen) % 200;
+                bool found = itr.skip(pos);
+                auto expected = std::lower_bound(A.begin(),A.end(),pos);
+                if (expected == A.end()) {
+                    ASSERT_TRUE(itr == end);
+                    break;
+                }
+                ASSERT_EQ((size_t)std::distance(A.begin(),expected),itr.offset());
+                ASSERT_EQ(*expected,*itr);
+                ASSERT_EQ(*expected == pos,found);
+                pos = *itr;
+                ++itr;
+                if (itr != end) pos = *itr;
+            }
+        }
+    }
+}
+
+TEST(partitioned_eliasfano, iterate)
+{
+    size_t n = 20;
+    std::mt19937 gen(4711);
+    std::uniform_int_distribution<uint64_t> dis(1, 100000);
+
+    for (size_t i=0; i<n; i++) {
+        size_t len = dis(gen);
+        std::vector<uint32_t> A(len);
+        for (size_t j=0; j<len; j++) A[j] = dis(gen);
+        std::sort(A.begin(),A.end());
+        auto last = std::unique(A.begin(),A.end());
+        size_t ln = std::distance(A.begin(),last);
+
+        sdsl::bit_vector bv;
+        {
+            bit_ostream os(bv);
+            auto offset = partitioned_eliasfano_list::create(os,A.begin(),last);
+            ASSERT_EQ(offset,0ULL);
+        }
+        {
+            bit_istream is(bv);
+            auto list = partitioned_eliasfano_list::materialize(is,0);
+            auto begin = list.begin();
+            auto end = list.end();
+            ASSERT_EQ(begin.size(),ln);
+
+            size_t i = 0;
+            while (begin != end) {
+                ASSERT_EQ(*begin,A[i]);
+                i++;
+                ++begin;
+            }
+        }
+    }
+}
+
+TEST(partitioned_eliasfano, skip_asign)
+{
+    size_t n = 20;
+    std::mt19937 gen(4711);
+    std::uniform_int_distribution<uint64_t> dis(1, 100000);
+
+    for (size_t i=0; i<n; i++) {
+        size_t len = dis(gen);
+        std::vector<uint32_t> A(len);
+        for (size_t j=0; j<len; j++) A[j] = dis(gen);
+        std::sort(A.begin(),A.end());
+        auto last = std::unique(A.begin(),A.end());
+        size_t ln = std::distance(A.begin(),last);
+
+        sdsl::bit_vector bv;
+        {
+            bit_ostream os(bv);
+            auto offset = partitioned_eliasfano_list::create(os,A.begin(),last);
+            ASSERT_EQ(offset,0ULL);
+        }
+        {
+            bit_istream is(bv);
+            auto list = partitioned_eliasfano_list::materialize(is,0);
+            auto begin = list.begin();
+            ASSERT_EQ(begin.size(),ln);
+            for (size_t i=5; i<ln; i+=5) {
+                ASSERT_EQ(*(begin+i),A[i]);
+            }
+        }
+    }
+}
+
+TEST(partitioned_eliasfano, intersection)
+{
+    size_t n = 20;
+    std::mt19937 gen(4711);
+    std::uniform_int_distribution<uint64_t> dis(1, 1000000);
+    std::uniform_int_distribution<uint64_t> ldis(1, 10000);
+
+    for (size_t i=0; i<n; i++) {
+        size_t len = ldis(gen);
+        std::vector<uint32_t> A(len);
+        for (size_t j=0; j<len; j++) A[j] = dis(gen);
+        std::sort(A.begin(),A.end());
+        auto last = std::unique(A.begin(),A.end());
+
+        size_t len2 = ldis(gen);
+        std::vector<uint32_t> B(len2);
+        for (size_t j=0; j<len2; j++) B[j] = dis(gen);
+        std::sort(B.begin(),B.end());
+        auto lastB = std::unique(B.begin(),B.end());
+
+        sdsl::bit_vector bv;
+        size_t offsetA,offsetB;
+        {
+            bit_ostream os(bv);
+            offsetA = partitioned_eliasfano_list::create(os,A.begin(),last);
+            offsetB = partitioned_eliasfano_list::create(os,B.begin(),lastB);
+        }
+        {
+            bit_istream is(bv);
+            auto listA = partitioned_eliasfano_list::materialize(is,offsetA);
+            auto listB = partitioned_eliasfano_list::materialize(is,offsetB);
+            auto res = intersect(listA,listB);
+
+            std::vector<uint32_t> ires;
+            std::set_intersection(A.begin(),A.end(),B.begin(),B.end(),std::back_inserter(ires));
+            ASSERT_EQ(ires.size(),res.size());
+            for (size_t i=0; i<ires.size(); i++) ASSERT_EQ(ires[i],res[i]);
+        }
+    }
+}
+
+TEST(partitioned_eliasfano, skip_rand_exist)
 {
     size_t n = 20;
     std::mt19937 gen(4711);
@@ -1713,33 +2878,31 @@ TEST(uniform_eliasfano, skip_rand_oneoff)
         sdsl::bit_vector bv;
         {
             bit_ostream os(bv);
-            auto offset = uniform_eliasfano_list<128>::create(os,A.begin(),last);
+            auto offset = partitioned_eliasfano_list::create(os,A.begin(),last);
             ASSERT_EQ(offset,0ULL);
         }
 
         {
             bit_istream is(bv);
-            auto list = uniform_eliasfano_list<128>::materialize(is,0);
+            auto list = partitioned_eliasfano_list::materialize(is,0);
             auto itr = list.begin();
             size_t ln = std::distance(A.begin(),last);
-            for (size_t j=1+dis(gen)%255; j<ln; j+=(dis(gen)%25)) {
-                if (A[j-1] == A[j]-1) continue;
-                ASSERT_FALSE(itr.skip(A[j]-1));
+            for (size_t j=dis(gen)%255; j<ln; j+=(dis(gen)%255)) {
+                ASSERT_TRUE(itr.skip(A[j]));
                 ASSERT_EQ(*itr,A[j]);
             }
         }
     }
 }
 
-TEST(uniform_eliasfano, skip_rand_largegaps)
+TEST(partitioned_eliasfano, skip_rand_oneoff)
 {
     size_t n = 20;
     std::mt19937 gen(4711);
     std::uniform_int_distribution<uint64_t> dis(1, 100000);
-    std::uniform_int_distribution<uint64_t> ldis(1, 100);
 
     for (size_t i=0; i<n; i++) {
-        size_t len = ldis(gen);
+        size_t len = dis(gen);
         std::vector<uint32_t> A(len);
         for (size_t j=0; j<len; j++) A[j] = dis(gen);
         std::sort(A.begin(),A.end());
@@ -1748,13 +2911,13 @@ TEST(uniform_eliasfano, skip_rand_largegaps)
         sdsl::bit_vector bv;
         {
             bit_ostream os(bv);
-            auto offset = uniform_eliasfano_list<128>::create(os,A.begin(),last);
+            auto offset = partitioned_eliasfano_list::create(os,A.begin(),last);
             ASSERT_EQ(offset,0ULL);
         }
 
         {
             bit_istream is(bv);
-            auto list = uniform_eliasfano_list<128>::materialize(is,0);
+            auto list = partitioned_eliasfano_list::materialize(is,0);
             auto itr = list.begin();
             size_t ln = std::distance(A.begin(),last);
             for (size_t j=1+dis(gen)%255; j<ln; j+=(dis(gen)%25)) {
@@ -1766,42 +2929,63 @@ TEST(uniform_eliasfano, skip_rand_largegaps)
     }
 }
 
-TEST(uniform_eliasfano, skip_rand_largegaps_hit)
+TEST(partitioned_eliasfano, clustered_skip)
 {
-    size_t n = 20;
+    // runs, dense and sparse regions so all partition types are used
+    size_t n = 200;
     std::mt19937 gen(4711);
-    std::uniform_int_distribution<uint64_t> dis(1, 1000000);
-    std::uniform_int_distribution<uint64_t> ldis(1, 1000);
+    std::uniform_int_distribution<uint64_t> dis(1, 10000);
+    std::uniform_int_distribution<uint64_t> ldis(1, 20);
 
     for (size_t i=0; i<n; i++) {
-        size_t len = ldis(gen);
-        std::vector<uint32_t> A(len);
-        for (size_t j=0; j<len; j++) A[j] = dis(gen);
-        std::sort(A.begin(),A.end());
-        auto last = std::unique(A.begin(),A.end());
-
+        std::vector<uint64_t> A;
+        uint64_t cur = dis(gen)%3;
+        size_t regions = ldis(gen);
+        for (size_t r=0; r<regions; r++) {
+            size_t len = ldis(gen)*ldis(gen);
+            uint64_t max_gap = (r%3 == 0) ? 1 : (r%3 == 1) ? 4 : 1000;
+            for (size_t j=0; j<len; j++) {
+                A.push_back(cur);
+                cur += 1 + dis(gen)%max_gap;
+            }
+        }
 
         sdsl::bit_vector bv;
+        size_t offset;
         {
-            bit_ostream os(bv);
-            auto offset = uniform_eliasfano_list<128>::create(os,A.begin(),last);
-            ASSERT_EQ(offset,0ULL);
+            bit_ostream os(bv,(size_t)dis(gen)%64);
+            offset = partitioned_eliasfano_list::create(os,A.begin(),A.end());
         }
-
         {
             bit_istream is(bv);
-            auto list = uniform_eliasfano_list<128>::materialize(is,0);
+            auto list = partitioned_eliasfano_list::materialize(is,offset);
             auto itr = list.begin();
-            size_t ln = std::distance(A.begin(),last);
-            for (size_t j=1+dis(gen)%255; j<ln; j+=(dis(gen)%25)) {
-                ASSERT_TRUE(itr.skip(A[j]));
-                ASSERT_EQ(*itr,A[j]);
+            auto end = list.end();
+            ASSERT_EQ(itr.size(),A.size());
+            for (size_t j=0; j<A.size(); j+=1+dis(gen)%5) {
+                ASSERT_EQ(*(list.begin()+j),A[j]);
+            }
+            uint64_t pos = 0;
+            while (itr != end) {
+                pos += dis(gen) % 50;
+                bool found = itr.skip(pos);
+                auto expected = std::lower_bound(A.begin(),A.end(),pos);
+                if (expected == A.end()) {
+                    ASSERT_TRUE(itr == end);
+                    break;
+                }
+                ASSERT_EQ((size_t)std::distance(A.begin(),expected),itr.offset());
+                ASSERT_EQ(*expected,*itr);
+                ASSERT_EQ(*expected == pos,found);
+                itr += dis(gen)%3;
+                if (itr.offset() >= A.size()) break;
+                pos = *itr;
+                ASSERT_EQ(A[itr.offset()],pos);
             }
         }
     }
 }
 
-
 TEST(eliasfano_skip, iterate)
 {
     size_t n = 20;
@@ -2240,6 +3424,990 @@ TEST(intersection, eliasfano_sskip_list)
     }
 }
 
+struct wand_test_ranker {
+    double doc_length(uint64_t id) const
+    {
+        return 1 + id%17;
+    }
+    double calculate_docscore(double f_qt,double f_dt,double f_t,double,double W_d,bool) const
+    {
+        return f_qt * (f_dt / (f_dt + W_d)) * (1000.0 / f_t);
+    }
+};
+
+template<class t_id_list>
+void wand_vs_exhaustive()
+{
+    using freq_list = optpfor_list<128,false>;
+    size_t n = 20;
+    std::mt19937 gen(4711);
+    std::uniform_int_distribution<uint64_t> dis(1, 100000);
+    std::uniform_int_distribution<uint64_t> ldis(1, 5000);
+    std::uniform_int_distribution<uint64_t> fdis(1, 50);
+    std::uniform_int_distribution<uint64_t> qdis(1, 6);
+    wand_test_ranker ranker;
+
+    for (size_t i=0; i<n; i++) {
+        size_t num_terms = qdis(gen);
+        std::vector<std::vector<uint32_t>> ids(num_terms);
+        std::vector<std::vector<uint32_t>> freqs(num_terms);
+        std::vector<double> max_scores(num_terms);
+        std::vector<std::vector<block_max_metadata>> blocks(num_terms);
+        sdsl::bit_vector bvi,bvf;
+        std::vector<size_t> offi(num_terms),offf(num_terms);
+        {
+            bit_ostream osi(bvi);
+            bit_ostream osf(bvf);
+            for (size_t j=0; j<num_terms; j++) {
+                size_t len = (j%2) ? ldis(gen) : ldis(gen) % 150 + 1;
+                auto& A = ids[j];
+                A.resize(len);
+                for (size_t l=0; l<len; l++) A[l] = dis(gen);
+                std::sort(A.begin(),A.end());
+                A.resize(std::distance(A.begin(),std::unique(A.begin(),A.end())));
+                freqs[j].resize(A.size());
+                for (size_t l=0; l<A.size(); l++) {
+                    freqs[j][l] = fdis(gen);
+                    auto score = ranker.calculate_docscore(1,freqs[j][l],A.size(),0,ranker.doc_length(A[l]),true);
+                    max_scores[j] = std::max(max_scores[j],score);
+                    if (l % 128 == 0) blocks[j].push_back({0,0.0f});
+                    blocks[j].back().last_id = A[l];
+                    float fscore = std::nextafter((float)score,std::numeric_limits<float>::max());
+                    blocks[j].back().max_score = std::max(blocks[j].back().max_score,fscore);
+                }
+                offi[j] = t_id_list::create(osi,A.begin(),A.end());
+                offf[j] = freq_list::create(osf,freqs[j].begin(),freqs[j].end());
+            }
+        }
+        // exhaustive scoring of all documents
+        std::map<uint64_t,double> acc;
+        for (size_t j=0; j<num_terms; j++) {
+            for (size_t l=0; l<ids[j].size(); l++) {
+                acc[ids[j][l]] += ranker.calculate_docscore(1,freqs[j][l],ids[j].size(),0,ranker.doc_length(ids[j][l]),true);
+            }
+        }
+        std::vector<double> all_scores;
+        for (const auto& a : acc) all_scores.push_back(a.second);
+        std::sort(all_scores.begin(),all_scores.end(),std::greater<double>());
+
+        bit_istream isi(bvi);
+        bit_istream isf(bvf);
+        // the last k is larger than any heap which can be allocated
+        for (size_t k : {(size_t)1,(size_t)10,(size_t)100,(size_t)99999999999999}) {
+            using cursor_type = wand_cursor<typename t_id_list::iterator_type,freq_list::iterator_type,wand_test_ranker>;
+            std::vector<cursor_type> cursors;
+            for (size_t j=0; j<num_terms; j++) {
+                auto il = t_id_list::materialize(isi,offi[j]);
+                auto fl = freq_list::materialize(isf,offf[j]);
+                cursors.emplace_back(il.begin(),il.end(),fl.begin(),&ranker,1,max_scores[j]);
+            }
+            auto res = wand(cursors,k);
+            ASSERT_EQ(std::min(k,all_scores.size()),res.size());
+            for (size_t l=0; l<res.size(); l++) {
+                ASSERT_NEAR(all_scores[l],res[l].second,1e-9);
+                ASSERT_NEAR(acc[res[l].first],res[l].second,1e-9);
+            }
+
+            using bm_cursor_type = block_max_cursor<typename t_id_list::iterator_type,freq_list::iterator_type,wand_test_ranker>;
+            std::vector<bm_cursor_type> bm_cursors;
+            for (size_t j=0; j<num_terms; j++) {
+                auto il = t_id_list::materialize(isi,offi[j]);
+                auto fl = freq_list::materialize(isf,offf[j]);
+                bm_cursors.emplace_back(il.begin(),il.end(),fl.begin(),&ranker,1,max_scores[j],blocks[j].data(),blocks[j].size());
+            }
+            auto bm_res = block_max_wand(bm_cursors,k);
+            ASSERT_EQ(res.size(),bm_res.size());
+            for (size_t l=0; l<bm_res.size(); l++) {
+                ASSERT_NEAR(all_scores[l],bm_res[l].second,1e-9);
+                ASSERT_NEAR(acc[bm_res[l].first],bm_res[l].second,1e-9);
+            }
+        }
+    }
+}
+
+TEST(wand, uniform_eliasfano)
+{
+    wand_vs_exhaustive<uniform_eliasfano_list<>>();
+}
+
+TEST(wand, optpfor)
+{
+    wand_vs_exhaustive<optpfor_list<128,true>>();
+}
+
+TEST(mmap_file, zero_copy_lists)
+{
+    size_t n = 20;
+    std::mt19937 gen(4711);
+    std::uniform_int_distribution<uint64_t> dis(1, 100000);
+    std::string file_name = "mmap_file_test.bin";
+
+    std::vector<std::vector<uint32_t>> lists(n);
+    std::vector<uint64_t> offsets;
+    sdsl::bit_vector bv;
+    {
+        bit_ostream os(bv);
+        for (size_t i=0; i<n; i++) {
+            size_t len = dis(gen) % 5000 + 1;
+            for (size_t j=0; j<len; j++) lists[i].push_back(dis(gen));
+            std::sort(lists[i].begin(),lists[i].end());
+            lists[i].erase(std::unique(lists[i].begin(),lists[i].end()),lists[i].end());
+            offsets.push_back(uniform_eliasfano_list<>::create(os,lists[i].begin(),lists[i].end()));
+        }
+    }
+    {
+        // an odd sized header forces padding before both arrays
+        std::ofstream ofs(file_name);
+        uint8_t header = 42;
+        sdsl::write_member(header,ofs);
+        write_padding(ofs);
+        ofs.write((const char*)offsets.data(),offsets.size()*sizeof(uint64_t));
+        sdsl::write_member(header,ofs);
+        write_bit_data(bv,ofs);
+    }
+    for (bool use_mmap : {false,true}) {
+        std::ifstream ifs(file_name);
+        std::shared_ptr<mmap_file> mapping;
+        std::unique_ptr<mmap_streambuf> buf;
+        if (use_mmap) {
+            mapping = std::make_shared<mmap_file>(file_name,mmap_advice::random);
+            buf.reset(new mmap_streambuf(*mapping));
+        }
+        std::istream in(use_mmap ? (std::streambuf*) buf.get() : ifs.rdbuf());
+        uint8_t header;
+        mappable_vector<uint64_t> moffsets;
+        sdsl::bit_vector mbv;
+        bit_istream is(mbv);
+        sdsl::read_member(header,in);
+        skip_padding(in);
+        moffsets.load(in,n,mapping.get());
+        sdsl::read_member(header,in);
+        ASSERT_EQ(header,42);
+        load_bit_data(in,mbv,is,mapping.get());
+        if (use_mmap) {
+            ASSERT_EQ(mbv.size(),0ULL);
+            ASSERT_EQ((const char*)moffsets.data() >= mapping->data(),true);
+            ASSERT_EQ((const char*)is.data() < mapping->data()+mapping->size(),true);
+        }
+        ASSERT_EQ(is.size(),bv.size());
+        for (size_t i=0; i<n; i++) {
+            const auto& view = moffsets;
+            ASSERT_EQ(view[i],offsets[i]);
+            auto list = uniform_eliasfano_list<>::materialize(is,view[i]);
+            ASSERT_EQ(list.size(),lists[i].size());
+            size_t j = 0;
+            for (auto itr = list.begin(); itr != list.end(); ++itr) {
+                ASSERT_EQ(*itr,lists[i][j++]);
+            }
+        }
+    }
+    std::remove(file_name.c_str());
+}
+
+TEST(mmap_file, format_marker)
+{
+    std::string file_name = "mmap_marker_test.bin";
+    std::vector<uint64_t> values = {1,2,3,4711};
+    {
+        std::ofstream ofs(file_name);
+        uint8_t header = 42;
+        sdsl::write_member(header,ofs);
+        write_padding(ofs);
+        ofs.write((const char*)values.data(),values.size()*sizeof(uint64_t));
+    }
+    auto mapping = std::make_shared<mmap_file>(file_name);
+    {
+        mmap_streambuf buf(*mapping);
+        std::istream in(&buf);
+        uint8_t header;
+        sdsl::read_member(header,in);
+        skip_padding(in);
+        mappable_vector<uint64_t> mvalues;
+        mvalues.load(in,values.size(),mapping.get());
+        ASSERT_EQ(4711ULL,mvalues[3]);
+    }
+    {
+        // an array which does not follow the marker is not used in place
+        mmap_streambuf buf(*mapping);
+        std::istream in(&buf);
+        in.seekg(24);
+        mappable_vector<uint64_t> mvalues;
+        ASSERT_THROW(mvalues.load(in,1,mapping.get()),std::runtime_error);
+    }
+    {
+        // the padding of a file of an older format has no marker
+        mmap_streambuf buf(*mapping);
+        std::istream in(&buf);
+        in.seekg(9);
+        ASSERT_THROW(skip_padding(in),std::runtime_error);
+    }
+    std::remove(file_name.c_str());
+}
+
+// minimal index which stores a single word
+struct header_test_index {
+    uint64_t value = 0;
+    uint64_t serialize(std::ostream& out) const
+    {
+        return sdsl::write_member(value,out);
+    }
+    void load(std::istream& in,const mmap_file* = nullptr)
+    {
+        sdsl::read_member(value,in);
+    }
+};
+
+TEST(mmap_file, index_format_version)
+{
+    std::string file_name = "index_header_test.idx";
+    header_test_index idx;
+    idx.value = 4711;
+    store_index_file(idx,file_name);
+    for (bool use_mmap : {false,true}) {
+        index_load_options opts;
+        opts.use_mmap = use_mmap;
+        header_test_index loaded;
+        load_index_file(loaded,file_name,opts);
+        ASSERT_EQ(4711ULL,loaded.value);
+    }
+    // a file without header and a file of another version are rejected
+    for (uint64_t header : {(uint64_t)4711,index_file_magic | (index_format_version-1)}) {
+        {
+            std::ofstream ofs(file_name);
+            sdsl::write_member(header,ofs);
+            idx.serialize(ofs);
+        }
+        for (bool use_mmap : {false,true}) {
+            index_load_options opts;
+            opts.use_mmap = use_mmap;
+            header_test_index loaded;
+            ASSERT_THROW(load_index_file(loaded,file_name,opts),std::runtime_error);
+        }
+    }
+    std::remove(file_name.c_str());
+}
+
+template<class t_list>
+void chunked_vs_serial_construction()
+{
+    size_t n = 2000;
+    std::mt19937 gen(4711);
+    std::uniform_int_distribution<uint64_t> dis(1, 1000000);
+    std::uniform_int_distribution<uint64_t> ldis(1, 2000);
+
+    // C[0] and C[1] are skipped like in the indexes
+    std::vector<uint64_t> C = {3,1};
+    std::vector<uint32_t> POS = {7,8,9,1};
+    for (size_t i=0; i<n; i++) {
+        size_t len = ldis(gen) % (i%50 == 0 ? 2000 : 100) + 1;
+        std::vector<uint32_t> L(len);
+        for (size_t j=0; j<len; j++) L[j] = dis(gen);
+        std::sort(L.begin(),L.end());
+        auto last = std::unique(L.begin(),L.end());
+        C.push_back(std::distance(L.begin(),last));
+        POS.insert(POS.end(),L.begin(),last);
+    }
+
+    auto build = [&](size_t threads,std::vector<uint64_t>& offsets) {
+        thread_pool pool(threads);
+        sdsl::bit_vector bv;
+        offsets.resize(C.size());
+        {
+            bit_ostream os(bv);
+            auto encode = [&](const term_chunk& chunk) {
+                std::pair<sdsl::bit_vector,std::vector<uint64_t>> res;
+                {
+                    bit_ostream cos(res.first);
+                    size_t csum = chunk.first_posting;
+                    for (size_t i=chunk.begin; i<chunk.end; i++) {
+                        res.second.push_back(t_list::create(cos,POS.begin()+csum,POS.begin()+csum+C[i]));
+                        csum += C[i];
+                    }
+                }
+                return res;
+            };
+            auto commit = [&](const term_chunk& chunk,std::pair<sdsl::bit_vector,std::vector<uint64_t>>& res) {
+                auto base = append_aligned(os,res.first);
+                for (size_t i=chunk.begin; i<chunk.end; i++) offsets[i] = base + res.second[i-chunk.begin];
+            };
+            encode_chunks(partition_terms(C,2,5000,97),encode,commit,pool);
+        }
+        return bv;
+    };
+
+    std::vector<uint64_t> serial_offsets;
+    auto serial = build(1,serial_offsets);
+    for (size_t threads : {2,4,7}) {
+        std::vector<uint64_t> offsets;
+        auto bv = build(threads,offsets);
+        ASSERT_EQ(bv.size(),serial.size());
+        for (size_t i=0; i<(bv.size()+63)/64; i++) ASSERT_EQ(bv.data()[i],serial.data()[i]);
+        ASSERT_EQ(offsets,serial_offsets);
+    }
+
+    bit_istream is(serial);
+    size_t csum = C[0] + C[1];
+    for (size_t i=2; i<C.size(); i++) {
+        auto list = t_list::materialize(is,serial_offsets[i]);
+        ASSERT_EQ(list.size(),C[i]);
+        auto itr = list.begin();
+        for (size_t j=0; j<C[i]; j++) {
+            ASSERT_EQ(*itr,POS[csum+j]);
+            ++itr;
+        }
+        csum += C[i];
+    }
+}
+
+TEST(parallel_construction, uniform_eliasfano)
+{
+    chunked_vs_serial_construction<uniform_eliasfano_list<>>();
+}
+
+TEST(parallel_construction, optpfor)
+{
+    chunked_vs_serial_construction<optpfor_list<128,true>>();
+}
+
+TEST(parallel_construction, eliasfano_skip)
+{
+    chunked_vs_serial_construction<eliasfano_skip_list<64,true>>();
+}
+
+// compares the suffixes without suffix_less, which the builders use
+template<class t_text>
+std::vector<uint64_t> naive_sa(const t_text& text)
+{
+    std::vector<uint64_t> sa(text.size());
+    for (size_t i=0; i<sa.size(); i++) sa[i] = i;
+    std::sort(sa.begin(),sa.end(),[&text](uint64_t a,uint64_t b) {
+        return std::lexicographical_compare(text.begin()+a,text.end(),text.begin()+b,text.end());
+    });
+    return sa;
+}
+
+// a field of /proc/self/status in kB, 0 if it is missing
+uint64_t proc_status_kb(const std::string& field)
+{
+    std::ifstream ifs("/proc/self/status");
+    for (std::string line; std::getline(ifs,line);) {
+        if (line.compare(0,field.size()+1,field+":") == 0) return std::stoull(line.substr(field.size()+1));
+    }
+    return 0;
+}
+
+/* the growth of the peak resident set size while func runs, in bytes. func
+   runs in a child process whose peak is reset first. large allocations
+   are mapped fresh instead of reusing memory freed by earlier tests.
+   returns 0 if the peak can not be reset */
+template<class t_func>
+uint64_t peak_rss_growth(t_func func)
+{
+    int fds[2];
+    if (pipe(fds) != 0) return 0;
+    pid_t pid = fork();
+    if (pid == 0) {
+        close(fds[0]);
+        uint64_t peak = 0;
+        mallopt(M_MMAP_THRESHOLD,64*1024);
+        std::ofstream clear_refs("/proc/self/clear_refs");
+        clear_refs << "5" << std::flush;
+        if (clear_refs.good()) {
+            uint64_t base = proc_status_kb("VmRSS");
+            func();
+            peak = (proc_status_kb("VmHWM")-base)*1024;
+        }
+        if (write(fds[1],&peak,sizeof(peak)) != sizeof(peak)) _exit(1);
+        _exit(0);
+    }
+    close(fds[1]);
+    uint64_t peak = 0;
+    if (pid < 0 || read(fds[0],&peak,sizeof(peak)) != sizeof(peak)) peak = 0;
+    close(fds[0]);
+    if (pid > 0) waitpid(pid,nullptr,0);
+    return peak;
+}
+
+TEST(sa_construction, prefix_doubling_and_bucket)
+{
+    size_t n = 10;
+    std::mt19937 gen(4711);
+    std::uniform_int_distribution<uint64_t> ldis(1, 200000);
+    thread_pool pool(4);
+
+    for (size_t i=0; i<n; i++) {
+        // small alphabets and repeated blocks give long common prefixes
+        std::uniform_int_distribution<uint64_t> dis(2, 2+(i%3==0 ? 2 : 1000));
+        size_t len = ldis(gen);
+        std::vector<uint64_t> text(len);
+        for (size_t j=0; j<len; j++) text[j] = dis(gen);
+        if (i%2) {
+            size_t block = std::min<size_t>(len/4+1,5000);
+            for (size_t j=block; j<len; j++) text[j] = (j%64) ? text[j%block] : dis(gen);
+        }
+        if (i%4 == 1) text.back() = 0; // terminated text
+        auto expected = naive_sa(text);
+
+        std::vector<uint32_t> sa;
+        prefix_doubling_sa(text,sa,pool);
+        ASSERT_EQ(sa.size(),expected.size());
+        for (size_t j=0; j<sa.size(); j++) ASSERT_EQ(sa[j],expected[j]);
+
+        for (uint64_t budget : {uint64_t(1) << 30,uint64_t(len*2),uint64_t(64*1024)}) {
+            std::vector<uint64_t> bsa;
+            bucket_sa(text,budget,[&](const std::vector<uint64_t>& positions) {
+                bsa.insert(bsa.end(),positions.begin(),positions.end());
+            },pool);
+            ASSERT_EQ(bsa,expected);
+        }
+    }
+}
+
+TEST(sa_construction, prefix_doubling_space)
+{
+    size_t n = 1 << 20;
+    std::mt19937 gen(4711);
+    for (uint64_t sigma : {(uint64_t)2,(uint64_t)4,(uint64_t)1000000}) {
+        std::uniform_int_distribution<uint64_t> dis(1, sigma);
+        std::vector<uint32_t> text(n);
+        for (size_t j=0; j<n; j++) text[j] = dis(gen);
+        // repeated blocks keep large groups unsorted for several rounds
+        if (sigma == 4) {
+            for (size_t j=4096; j<n; j++) text[j] = text[j%4096];
+        }
+        auto peak = peak_rss_growth([&] {
+            thread_pool pool(4);
+            std::vector<uint32_t> sa;
+            prefix_doubling_sa(text,sa,pool);
+        });
+        if (peak == 0) {
+            std::cout << "peak memory can not be measured" << std::endl;
+            return;
+        }
+        std::cout << "sigma = " << sigma << " peak = " << peak << " estimate = " << prefix_doubling_sa_space(n) << std::endl;
+        ASSERT_LE(peak,prefix_doubling_sa_space(n));
+    }
+}
+
+TEST(symbol_counts, histogram_and_pairs)
+{
+    size_t n = 10;
+    std::mt19937 gen(4711);
+    std::uniform_int_distribution<uint64_t> ldis(1, 500000);
+    thread_pool pool(4);
+
+    for (size_t i=0; i<n; i++) {
+        std::uniform_int_distribution<uint64_t> dis(1, (i%2) ? 50 : 100000);
+        size_t len = ldis(gen);
+        std::vector<uint64_t> text(len);
+        for (size_t j=0; j<len; j++) text[j] = dis(gen);
+        uint8_t width = sdsl::bits::hi(*std::max_element(text.begin(),text.end()))+1;
+
+        std::map<uint64_t,uint64_t> expected_c;
+        std::map<uint64_t,uint64_t> expected_cc;
+        for (size_t j=0; j<len; j++) expected_c[text[j]]++;
+        for (size_t j=0; j+1<len; j++) expected_cc[(text[j] << width) + text[j+1]]++;
+
+        auto counts = symbol_histogram(text,pool);
+        ASSERT_EQ(counts.size(),expected_c.rbegin()->first+1);
+        for (size_t c=0; c<counts.size(); c++) {
+            auto itr = expected_c.find(c);
+            ASSERT_EQ(counts[c],itr == expected_c.end() ? 0 : itr->second);
+        }
+
+        for (uint64_t budget : {uint64_t(1) << 30,uint64_t(len*4),uint64_t(len)}) {
+            std::vector<std::pair<uint64_t,uint64_t>> pairs;
+            count_symbol_pairs(text,width,counts,budget,[&](uint64_t sym,uint64_t cnt) {
+                pairs.emplace_back(sym,cnt);
+            },pool);
+            std::vector<std::pair<uint64_t,uint64_t>> expected(expected_cc.begin(),expected_cc.end());
+            ASSERT_EQ(pairs,expected);
+        }
+    }
+}
+
+TEST(phrase_cost_model, statistics_and_plans)
+{
+    std::mt19937 gen(4711);
+    std::uniform_int_distribution<uint64_t> fdis(2, 9);
+    std::uniform_int_distribution<uint64_t> rdis(10, 999);
+    std::uniform_int_distribution<uint64_t> cdis(0, 1);
+    size_t len = 200000;
+    size_t num_docs = 1000;
+    // half of the text are 8 frequent terms
+    std::vector<uint64_t> text(len);
+    for (size_t j=0; j<len; j++) text[j] = cdis(gen) ? fdis(gen) : rdis(gen);
+    uint8_t width = sdsl::bits::hi(*std::max_element(text.begin(),text.end()))+1;
+    auto counts = symbol_histogram(text);
+    std::vector<std::pair<uint64_t,uint64_t>> pairs;
+    count_symbol_pairs(text,width,counts,uint64_t(1) << 30,[&](uint64_t sym,uint64_t cnt) {
+        pairs.emplace_back(sym,cnt);
+    });
+    sdsl::int_vector<> C(counts.size()), CC(pairs.size()), SCC(pairs.size());
+    for (size_t c=0; c<counts.size(); c++) C[c] = counts[c];
+    for (size_t j=0; j<pairs.size(); j++) {
+        CC[j] = pairs[j].first;
+        SCC[j] = pairs[j].second;
+    }
+    phrase_statistics stats(C,CC,SCC,width,num_docs);
+    ASSERT_EQ(num_docs,stats.num_docs());
+    for (size_t j=0; j+1<len; j+=97) {
+        ASSERT_EQ(counts[text[j]],stats.term_count(text[j]));
+        auto itr = std::lower_bound(pairs.begin(),pairs.end(),std::make_pair((text[j] << width)+text[j+1],uint64_t(0)));
+        ASSERT_EQ(itr->second,stats.pair_count(text[j],text[j+1]));
+    }
+    ASSERT_EQ(0ULL,stats.term_count(5000));
+    ASSERT_EQ(0ULL,stats.pair_count(5000,2));
+
+    // phrases of the text with their exact number of occurrences
+    for (size_t m : {1,2,3,4,5}) {
+        for (size_t j=0; j+m<len; j+=9973) {
+            std::vector<uint64_t> ids(text.begin()+j,text.begin()+j+m);
+            size_t occ = 0;
+            for (size_t x=0; x+m<=len; x++) occ += std::equal(ids.begin(),ids.end(),text.begin()+x);
+            auto est = estimate_phrase_cost(stats,ids,occ,no_result_limit,false);
+            ASSERT_EQ((double)occ,est.occ);
+            ASSERT_TRUE(est.ndoc >= 1 && est.ndoc <= std::min<double>(occ,num_docs)+1);
+            ASSERT_TRUE(est.available(phrase_plan::abspos));
+            ASSERT_EQ(m >= 2,est.available(phrase_plan::nextword));
+            ASSERT_TRUE(est.available(phrase_plan::sada));
+            ASSERT_TRUE(est.available(phrase_plan::wt));
+            ASSERT_NE(phrase_plan::none,est.best());
+            // the markov estimate is bounded by the smallest 2-token count
+            auto markov = stats.estimate_occurrences(ids);
+            for (size_t x=0; x+1<m; x++) ASSERT_TRUE(markov <= stats.pair_count(ids[x],ids[x+1]));
+            // the first result is cheaper than all of them
+            auto kest = estimate_phrase_cost(stats,ids,occ,1,false);
+            ASSERT_TRUE(kest.cost[(size_t)phrase_plan::abspos] <= est.cost[(size_t)phrase_plan::abspos]);
+            // the CSA plans do not report positions
+            auto pest = estimate_phrase_cost(stats,ids,occ,no_result_limit,true);
+            ASSERT_FALSE(pest.available(phrase_plan::sada));
+            ASSERT_FALSE(pest.available(phrase_plan::wt));
+            ASSERT_TRUE(pest.best() == phrase_plan::abspos || pest.best() == phrase_plan::nextword);
+        }
+    }
+
+    // the 2-token list of two frequent terms is much shorter than their lists
+    std::vector<uint64_t> frequent = {2,3};
+    auto est = estimate_phrase_cost(stats,frequent,-1,no_result_limit,false);
+    ASSERT_TRUE(est.cost[(size_t)phrase_plan::nextword] < est.cost[(size_t)phrase_plan::abspos]);
+
+    // missing terms and 2-tokens
+    ASSERT_EQ(phrase_plan::none,estimate_phrase_cost(stats,{2,5000},-1,no_result_limit,false).best());
+    ASSERT_EQ(phrase_plan::none,estimate_phrase_cost(stats,{},-1,no_result_limit,false).best());
+    ASSERT_EQ(phrase_plan::none,estimate_phrase_cost(stats,{2,3},-1,0,false).best());
+}
+
+TEST(index_hybrid_nextword, phrase_cover)
+{
+    using cover_type = std::vector<std::pair<size_t,bool>>;
+    auto cover = [](size_t m,std::set<size_t> stored) {
+        return hybrid_phrase_cover(m,[&](size_t i) {
+            return stored.count(i) != 0;
+        });
+    };
+    ASSERT_EQ(cover_type({{0,false}}),cover(1,{}));
+    ASSERT_EQ(cover_type({{0,true}}),cover(2,{0}));
+    ASSERT_EQ(cover_type({{0,false},{1,false}}),cover(2,{}));
+    ASSERT_EQ(cover_type({{0,true},{2,true}}),cover(4,{0,1,2}));
+    ASSERT_EQ(cover_type({{0,false},{1,true},{3,false}}),cover(4,{1}));
+    ASSERT_EQ(cover_type({{0,true},{2,false}}),cover(3,{0}));
+    ASSERT_EQ(cover_type({{0,false},{1,true}}),cover(3,{1}));
+    // the last term overlaps with the 2-token list before it
+    ASSERT_EQ(cover_type({{0,true},{1,true}}),cover(3,{0,1}));
+    ASSERT_EQ(cover_type({{0,true},{2,true},{3,true}}),cover(5,{0,2,3}));
+    ASSERT_EQ(cover_type({{0,false},{1,true},{3,false},{4,false}}),cover(5,{1}));
+
+    // every term is covered, a term list is only used if no stored list covers the term
+    std::mt19937 gen(4711);
+    for (size_t m=1; m<10; m++) {
+        for (size_t r=0; r<100; r++) {
+            std::set<size_t> stored;
+            for (size_t i=0; i+1<m; i++) {
+                if (gen()%2) stored.insert(i);
+            }
+            auto c = cover(m,stored);
+            std::vector<size_t> covered(m,0);
+            for (size_t j=0; j<c.size(); j++) {
+                size_t i = c[j].first;
+                if (j > 0) {
+                    ASSERT_LT(c[j-1].first,i);
+                }
+                covered[i]++;
+                if (c[j].second) {
+                    ASSERT_TRUE(stored.count(i));
+                    covered[i+1]++;
+                } else {
+                    ASSERT_FALSE(i+1 < m && stored.count(i));
+                    ASSERT_FALSE(i+1 == m && i > 0 && stored.count(i-1));
+                }
+            }
+            for (size_t i=0; i<m; i++) ASSERT_LE(1,covered[i]);
+        }
+    }
+}
+
+TEST(symbol_counts, parallel_radix_sort)
+{
+    std::mt19937 gen(4711);
+    thread_pool pool(4);
+    for (uint8_t bits : {8,20,37,64}) {
+        std::uniform_int_distribution<uint64_t> dis(0, bits == 64 ? ~0ULL : (1ULL << bits)-1);
+        std::vector<uint64_t> keys(1000000);
+        for (auto& k : keys) k = dis(gen);
+        auto expected = keys;
+        std::sort(expected.begin(),expected.end());
+        parallel_radix_sort(keys,bits,pool);
+        ASSERT_EQ(keys,expected);
+    }
+}
+
+TEST(sa_derivation, positions_lists_and_document_array)
+{
+    size_t n = 10;
+    std::mt19937 gen(4711);
+    std::uniform_int_distribution<uint64_t> ldis(1, 1000000);
+    thread_pool pool(4);
+
+    for (size_t i=0; i<n; i++) {
+        size_t len = ldis(gen);
+        std::vector<uint64_t> SA(len);
+        for (size_t j=0; j<len; j++) SA[j] = j;
+        std::shuffle(SA.begin(),SA.end(),gen);
+        // symbol ranges of random length, some of them very large
+        std::vector<uint64_t> C;
+        std::uniform_int_distribution<uint64_t> cdis(0, (i%2) ? 10 : 100000);
+        for (size_t sum=0; sum<len;) {
+            uint64_t c = std::min<uint64_t>(cdis(gen),len-sum);
+            C.push_back(c);
+            sum += c;
+        }
+        std::vector<uint64_t> borders;
+        std::uniform_int_distribution<uint64_t> bdis(1, (i%3) ? 1000 : 10);
+        for (uint64_t b=bdis(gen); b<len; b+=bdis(gen)) borders.push_back(b);
+        borders.push_back(len-1);
+
+        std::vector<uint64_t> expected_pos = SA;
+        for (size_t j=0,cum=0; j<C.size(); cum+=C[j],j++) {
+            std::sort(expected_pos.begin()+cum,expected_pos.begin()+cum+C[j]);
+        }
+        std::vector<uint64_t> pos;
+        positions_lists(SA,C,[&](const std::vector<uint64_t>& p) {
+            pos.insert(pos.end(),p.begin(),p.end());
+        },pool);
+        ASSERT_EQ(pos,expected_pos);
+
+        std::vector<uint64_t> expected_docs(len);
+        for (size_t j=0; j<len; j++) {
+            expected_docs[j] = std::lower_bound(borders.begin(),borders.end(),SA[j])-borders.begin();
+        }
+        for (size_t chunk_size : {size_t(1) << 20,size_t(1000),size_t(1)}) {
+            if (chunk_size == 1 && len > 100000) continue;
+            std::vector<uint64_t> docs;
+            document_array(SA,borders,[&](const std::vector<uint64_t>& d) {
+                docs.insert(docs.end(),d.begin(),d.end());
+            },pool,chunk_size);
+            ASSERT_EQ(docs,expected_docs);
+        }
+    }
+}
+
+TEST(build_pipeline, dependencies_budget_and_resume)
+{
+    // a -> b -> d, a -> c -> d, c -> e
+    std::mutex m;
+    std::set<std::string> artifacts;
+    std::vector<std::string> order;
+    size_t running = 0;
+    size_t max_running = 0;
+    bool fail_c = true;
+    auto step = [&](const std::string& name,std::vector<std::string> inputs,uint64_t memory) {
+        return build_step {name,inputs,{name},memory,[&,name,inputs] {
+            {
+                std::lock_guard<std::mutex> lock(m);
+                for (const auto& in : inputs) ASSERT_EQ(artifacts.count(in),1U);
+                running++;
+                max_running = std::max(max_running,running);
+            }
+            std::this_thread::sleep_for(std::chrono::milliseconds(20));
+            std::lock_guard<std::mutex> lock(m);
+            running--;
+            if (name == "c" && fail_c) throw std::runtime_error("c failed");
+            artifacts.insert(name);
+            order.push_back(name);
+        }
+                          };
+    };
+    auto available = [&](const std::string& key) {
+        std::lock_guard<std::mutex> lock(m);
+        return artifacts.count(key) != 0;
+    };
+    auto make_pipeline = [&](uint64_t budget) {
+        build_pipeline pipeline(budget);
+        pipeline.add(step("a",{},10));
+        pipeline.add(step("b",{"a"},10));
+        pipeline.add(step("c",{"a"},10));
+        pipeline.add(step("d",{"b","c"},10));
+        pipeline.add(step("e",{"c"},30));
+        return pipeline;
+    };
+
+    // c fails: b still finishes, d and e are not started
+    ASSERT_THROW(make_pipeline(100).run(available),std::runtime_error);
+    ASSERT_EQ(artifacts,std::set<std::string>({"a","b"}));
+    ASSERT_EQ(max_running,2U);
+
+    // resume: a and b are skipped
+    fail_c = false;
+    order.clear();
+    max_running = 0;
+    auto report = make_pipeline(20).run(available);
+    ASSERT_EQ(report.size(),5U);
+    ASSERT_TRUE(report[0].skipped && report[1].skipped);
+    ASSERT_EQ(order[0],"c");
+    ASSERT_EQ(artifacts.size(),5U);
+    // e does not fit into the budget next to d
+    ASSERT_EQ(max_running,1U);
+
+    // missing inputs are detected before anything runs
+    build_pipeline broken(100);
+    broken.add(step("x",{"y"},0));
+    ASSERT_THROW(broken.run(available),std::runtime_error);
+}
+
+TEST(index_segment, add_merge_and_query)
+{
+    using segment_type = index_segment<optpfor_list<128,true>,optpfor_list<128,false>,optpfor_list<128,true>,true>;
+    std::mt19937 gen(4711);
+    std::uniform_int_distribution<uint64_t> sym_dis(2, 50);
+    std::uniform_int_distribution<uint64_t> len_dis(0, 200);
+    std::uniform_int_distribution<uint64_t> batch_dis(1, 20);
+    const uint64_t doc_base = 10;
+    const uint64_t pos_base = 1000;
+    segment_store<segment_type> store(doc_base,pos_base,3);
+
+    // the global text of the added documents starting at pos_base
+    std::vector<uint64_t> text;
+    std::vector<uint64_t> doc_of_pos;
+    std::atomic<bool> done(false);
+    // queries run concurrently with the additions and merges
+    std::thread reader([&] {
+        while (!done) {
+            auto segments = store.snapshot();
+            uint64_t next_doc = doc_base;
+            for (const auto& segment : *segments) {
+                ASSERT_EQ(segment->doc_base(),next_doc);
+                next_doc += segment->num_docs();
+            }
+        }
+    });
+    uint64_t next_doc = doc_base;
+    for (size_t b=0; b<50; b++) {
+        std::vector<std::vector<uint64_t>> docs(batch_dis(gen));
+        for (auto& doc : docs) {
+            doc.resize(len_dis(gen));
+            for (auto& sym : doc) {
+                sym = sym_dis(gen);
+                text.push_back(sym);
+                doc_of_pos.push_back(next_doc);
+            }
+            text.push_back(1);
+            doc_of_pos.push_back(next_doc++);
+        }
+        ASSERT_EQ(store.add(docs),next_doc-docs.size());
+    }
+    store.wait_for_merges();
+    done = true;
+    reader.join();
+    auto segments = store.snapshot();
+    ASSERT_LE(segments->size(),3U);
+    ASSERT_EQ(store.num_docs(),doc_of_pos.back()+1);
+
+    for (uint64_t t1=2; t1<=50; t1++) {
+        for (uint64_t t2 : {uint64_t(2),uint64_t(7),uint64_t(31),uint64_t(50)}) {
+            std::vector<uint64_t> expected_docs;
+            std::vector<uint64_t> expected_pos;
+            std::set<uint64_t> docs1,docs2;
+            for (size_t i=0; i<text.size(); i++) {
+                if (text[i] == t1) docs1.insert(doc_of_pos[i]);
+                if (text[i] == t2) docs2.insert(doc_of_pos[i]);
+                if (i+1 < text.size() && text[i] == t1 && text[i+1] == t2) expected_pos.push_back(pos_base+i);
+            }
+            std::set_intersection(docs1.begin(),docs1.end(),docs2.begin(),docs2.end(),std::back_inserter(expected_docs));
+
+            std::vector<uint64_t> docs;
+            std::vector<uint64_t> pos;
+            for (const auto& segment : *segments) {
+                if (!segment->contains(t1) || !segment->contains(t2)) continue;
+                std::vector<decltype(segment->doc_list(t1))> dlists {segment->doc_list(t1),segment->doc_list(t2)};
+                auto dres = intersect(dlists);
+                for (size_t i=0; i<dres.size(); i++) docs.push_back(dres[i]+segment->doc_base());
+                using plist_type = decltype(segment->pos_list(t1));
+                auto l1 = segment->pos_list(t1);
+                auto l2 = segment->pos_list(t2);
+                std::vector<offset_proxy_list<plist_type>> plists {offset_proxy_list<plist_type>(l1,0),offset_proxy_list<plist_type>(l2,1)};
+                auto pres = pos_intersect(plists);
+                for (size_t i=0; i<pres.size(); i++) {
+                    pos.push_back(pres[i]+segment->pos_base());
+                    ASSERT_EQ(segment->doc_base()+segment->map_to_id(pres[i]),doc_of_pos[pres[i]+segment->pos_base()-pos_base]);
+                }
+            }
+            ASSERT_EQ(docs,expected_docs);
+            ASSERT_EQ(pos,expected_pos);
+        }
+    }
+}
+
+// in-memory main index over a set of documents in place of index_invidx/index_abspos
+struct test_main_index {
+    using id_list_type = optpfor_list<128,true>;
+    using freq_list_type = optpfor_list<128,false>;
+    using plist_type = optpfor_list<128,true>;
+    using doclist_type = optpfor_list<128,true>;
+    struct invidx_type {
+        using freq_list_type = optpfor_list<128,false>;
+    };
+    index_segment<id_list_type,freq_list_type,plist_type,true> m_docs;
+
+    test_main_index(const std::vector<std::vector<uint64_t>>& docs,const index_load_options&) : m_docs(docs,0,0) {}
+    uint64_t num_docs() const
+    {
+        return m_docs.num_docs();
+    }
+    uint64_t text_size() const
+    {
+        return m_docs.num_positions();
+    }
+    template<class t_strategy=intersect_daat>
+    intersection_result intersection(std::vector<uint64_t> ids,size_t limit = no_result_limit) const
+    {
+        std::vector<typename doclist_type::list_type> lists;
+        for (const auto& id : ids) {
+            if (!m_docs.contains(id)) return intersection_result(0);
+            lists.emplace_back(m_docs.doc_list(id));
+        }
+        return intersect<t_strategy>(lists,limit);
+    }
+    intersection_result doc_intersection(std::vector<uint64_t> ids,size_t limit = no_result_limit) const
+    {
+        return intersection(ids,limit);
+    }
+    template<class t_strategy=intersect_daat>
+    intersection_result phrase_positions(std::vector<uint64_t> ids,size_t limit = no_result_limit) const
+    {
+        std::vector<offset_proxy_list<typename plist_type::list_type>> lists;
+        for (size_t i=0; i<ids.size(); i++) {
+            if (!m_docs.contains(ids[i])) return intersection_result(0);
+            auto list = m_docs.pos_list(ids[i]);
+            lists.emplace_back(list,i);
+        }
+        return pos_intersect<t_strategy>(lists,limit);
+    }
+    template<class t_strategy=intersect_lazy>
+    docfreq_result phrase_list(std::vector<uint64_t> ids,size_t k = no_result_limit) const
+    {
+        docfreq_result res;
+        auto positions = phrase_positions(ids);
+        for (size_t i=0; i<positions.size(); i++) {
+            auto doc_id = m_docs.map_to_id(positions[i]);
+            if (!res.empty() && res.back().first == doc_id) {
+                res.back().second++;
+            } else {
+                if (res.size() == k) break;
+                res.emplace_back(doc_id,1);
+            }
+        }
+        return res;
+    }
+};
+
+TEST(index_segmented, add_merge_and_query)
+{
+    std::mt19937 gen(4711);
+    std::uniform_int_distribution<uint64_t> sym_dis(2, 30);
+    std::uniform_int_distribution<uint64_t> len_dis(0, 100);
+    std::uniform_int_distribution<uint64_t> batch_dis(1, 10);
+    // term ids far beyond the vocabulary of the other documents
+    const uint64_t large_sym = uint64_t(1) << 40;
+
+    std::vector<std::vector<uint64_t>> main_docs(20);
+    for (auto& doc : main_docs) {
+        doc.resize(len_dis(gen));
+        for (auto& sym : doc) sym = sym_dis(gen);
+    }
+    index_segmented_invidx<test_main_index> invidx(main_docs,3);
+    index_segmented_abspos<test_main_index> abspos(main_docs,3);
+
+    // the global text and the doc ids of its positions
+    std::vector<std::vector<uint64_t>> all_docs = main_docs;
+    for (size_t b=0; b<40; b++) {
+        std::vector<std::vector<uint64_t>> docs(batch_dis(gen));
+        for (auto& doc : docs) {
+            doc.resize(len_dis(gen));
+            for (auto& sym : doc) sym = sym_dis(gen);
+            if (b % 7 == 0 && !doc.empty()) doc[0] = large_sym + b;
+        }
+        ASSERT_EQ(all_docs.size(),invidx.add_documents(docs));
+        ASSERT_EQ(all_docs.size(),abspos.add_documents(docs));
+        all_docs.insert(all_docs.end(),docs.begin(),docs.end());
+    }
+    invidx.wait_for_merges();
+    abspos.wait_for_merges();
+    ASSERT_LE(invidx.num_segments(),3U);
+    ASSERT_LE(abspos.num_segments(),3U);
+    ASSERT_EQ(all_docs.size(),invidx.num_docs());
+    ASSERT_EQ(all_docs.size(),abspos.num_docs());
+    std::vector<uint64_t> text;
+    std::vector<uint64_t> doc_of_pos;
+    for (size_t d=0; d<all_docs.size(); d++) {
+        for (const auto& sym : all_docs[d]) {
+            text.push_back(sym);
+            doc_of_pos.push_back(d);
+        }
+        text.push_back(1);
+        doc_of_pos.push_back(d);
+    }
+
+    std::vector<std::vector<uint64_t>> queries;
+    for (uint64_t t1=2; t1<=30; t1++) {
+        for (uint64_t t2 : {uint64_t(2),uint64_t(9),uint64_t(30),large_sym,large_sym+3}) queries.push_back({t1,t2});
+    }
+    queries.push_back({large_sym+7});
+    queries.push_back({large_sym+14,5});
+    for (const auto& ids : queries) {
+        std::vector<uint64_t> expected_docs;
+        std::vector<uint64_t> expected_pos;
+        docfreq_result expected_freqs;
+        for (size_t d=0; d<all_docs.size(); d++) {
+            bool all = true;
+            for (const auto& id : ids) all = all && std::count(all_docs[d].begin(),all_docs[d].end(),id) > 0;
+            if (all) expected_docs.push_back(d);
+        }
+        for (size_t i=0; i+ids.size()<=text.size(); i++) {
+            if (!std::equal(ids.begin(),ids.end(),text.begin()+i)) continue;
+            expected_pos.push_back(i);
+            if (!expected_freqs.empty() && expected_freqs.back().first == doc_of_pos[i]) expected_freqs.back().second++;
+            else expected_freqs.emplace_back(doc_of_pos[i],1);
+        }
+        auto docs = invidx.intersection(ids);
+        ASSERT_EQ(expected_docs,std::vector<uint64_t>(docs.begin(),docs.end()));
+        auto adocs = abspos.doc_intersection(ids);
+        ASSERT_EQ(expected_docs,std::vector<uint64_t>(adocs.begin(),adocs.end()));
+        auto pos = abspos.phrase_positions(ids);
+        ASSERT_EQ(expected_pos,std::vector<uint64_t>(pos.begin(),pos.end()));
+        ASSERT_EQ(expected_freqs,abspos.phrase_list(ids));
+
+        // first-k results cross the border between the main index and the segments
+        size_t k = 3;
+        auto kdocs = invidx.intersection(ids,k);
+        ASSERT_EQ(std::min(k,expected_docs.size()),kdocs.size());
+        for (size_t i=0; i<kdocs.size(); i++) ASSERT_EQ(expected_docs[i],kdocs[i]);
+        auto kfreqs = abspos.phrase_list(ids,k);
+        ASSERT_EQ(std::min(k,expected_freqs.size()),kfreqs.size());
+        for (size_t i=0; i<kfreqs.size(); i++) ASSERT_EQ(expected_freqs[i],kfreqs[i]);
+    }
+}
+
 int main(int argc, char* argv[])
 {
     ::testing::InitGoogleTest(&argc, argv);